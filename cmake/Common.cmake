@@ -28,6 +28,7 @@ if(NOT ENABLE_MOLD)
 endif()
 
 option(ENABLE_UNIT_TESTING "Enable unit testing" OFF)
+option(ENABLE_BENCHMARKS "Enable benchmarks" OFF)
 
 if(CMAKE_CXX_COMPILER_ID MATCHES "Clang")
   option(ENABLE_FUZZ_TESTING "Enable fuzz testing" OFF)
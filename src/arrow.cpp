@@ -9,13 +9,10 @@
 
 #include "arrow.hpp"
 
-#include <abcgApplication.hpp>
-#include <abcgException.hpp>
+#include "shadertemplate.hpp"
+
 #include <abcgOpenGLFunction.hpp>
 #include <abcgOpenGLShader.hpp>
-#include <abcgUtil.hpp>
-
-#include <fstream>
 
 namespace {
 
@@ -25,28 +22,8 @@ constexpr glm::vec3 kColor{1.0f, 0.8f, 0.2f}; // #ffcc33
 } // namespace
 
 void Arrow::onCreate() {
-  auto const readFile{[](std::filesystem::path const &path) -> std::string {
-    auto const utf8Path{abcg::pathToUtf8(path)};
-    std::stringstream source;
-    if (std::ifstream stream(utf8Path); stream) {
-      source << stream.rdbuf();
-      stream.close();
-    } else {
-      throw abcg::RuntimeError(
-          std::format("Failed to read shader file {}", utf8Path));
-    }
-    return source.str();
-  }};
-
-  static auto const &assetsPath{abcg::Application::getAssetsPath()};
-
-  std::vector<abcg::ShaderSource> const sources{
-      {.source =
-           readFile(assetsPath / std::filesystem::path{kVertexShaderPath}),
-       .stage = abcg::ShaderStage::Vertex},
-      {.source =
-           readFile(assetsPath / std::filesystem::path{kFragmentShaderPath}),
-       .stage = abcg::ShaderStage::Fragment}};
+  auto const sources{
+      loadProgramSources(kVertexShaderPath, kFragmentShaderPath)};
 
   m_program = abcg::createOpenGLProgram(sources);
 
@@ -0,0 +1,29 @@
+#version 300 es
+
+/**
+ * @file accumulate.frag
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+precision highp float;
+
+out vec4 outColor;
+
+uniform sampler2D uAccumulationTexture;
+uniform sampler2D uSampleTexture;
+uniform float uSampleWeight;
+
+// Blends a new sample into the running average of the previous ones. Both
+// textures have the size of the viewport, and colors have premultiplied
+// alpha, so they can be averaged component-wise.
+void main() {
+  ivec2 texel = ivec2(gl_FragCoord.xy);
+  vec4 average = texelFetch(uAccumulationTexture, texel, 0);
+  vec4 sampleColor = texelFetch(uSampleTexture, texel, 0);
+
+  outColor = mix(average, sampleColor, uSampleWeight);
+}
\ No newline at end of file
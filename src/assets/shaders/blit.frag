@@ -17,9 +17,12 @@ out vec4 outColor;
 
 uniform sampler2D uColorTexture;
 uniform vec4 uTintColor;
+uniform vec2 uTexCoordScale;
 
 void main() {
-  vec2 texCoord = fragTexCoord;
+  // Keep the bilinear footprint inside the scaled region
+  vec2 halfTexel = 0.5 / vec2(textureSize(uColorTexture, 0));
+  vec2 texCoord = min(fragTexCoord * uTexCoordScale, uTexCoordScale - halfTexel);
 
   outColor = texture(uColorTexture, texCoord) * uTintColor;
 }
\ No newline at end of file
@@ -23,12 +23,42 @@ layout(location = 2) out vec4 outData2;
 
 @DEFINITIONS@
 
-const float kBoundRadius = float(@BOUND_RADIUS@);
-const float kBoundRadiusSquared = kBoundRadius * kBoundRadius;
-const float kInvBoundRadius = 1.0 / kBoundRadius;
-const float kInvBoundRadius2 = 1.0 / (kBoundRadius * 2.0);
-const vec3 kBoundsMin = vec3(-kBoundRadius);
-const vec3 kBoundsMax = vec3( kBoundRadius);
+// The bound radius is a uniform (uBoundRadius) so that resizing the bounds
+// does not require rebuilding the program
+#define kBoundRadius uBoundRadius
+#define kBoundRadiusSquared (uBoundRadius * uBoundRadius)
+#define kInvBoundRadius (1.0 / uBoundRadius)
+#define kInvBoundRadius2 (1.0 / (uBoundRadius * 2.0))
+#define kBoundsMin vec3(-uBoundRadius)
+#define kBoundsMax vec3( uBoundRadius)
+
+// Values of the rendering options kRaymarchMethod, kRootTest, kGradientMode,
+// kRenderingMode and kSurfaceColorMode. They match the enumerations of
+// RenderState.
+const int kAdaptive = 0;
+const int kFixedStep = 1;
+const int kPolynomial = 2;
+const int kInterval = 3;
+
+const int kSignChange = 0;
+const int kTaylor1stOrder = 1;
+const int kTaylor2ndOrder = 2;
+
+const int kForwardDifference = 0;
+const int kCentralDifference = 1;
+const int kFivePointStencil = 2;
+const int kAnalytic = 3;
+
+const int kLitSurface = 0;
+const int kUnlitSurface = 1;
+const int kDirectVolume = 2;
+
+const int kSideSign = 0;
+const int kUnitNormal = 1;
+const int kNormalMagnitude = 2;
+const int kGaussianCurvature = 3;
+const int kMeanCurvature = 4;
+const int kMaxAbsCurvature = 5;
 
 // MSAA sample patterns
 const vec2 kMSAAPattern2x[2] = vec2[2](
@@ -103,27 +133,104 @@ struct Shading
   float shininess;    //    1N     16N
 };
 
-// Function parameters (allow up to 16 scalar parameters)
+// Function parameters, packed four per element. PARAMS_SIZE is defined for
+// the number of parameters of the function.
 struct Params {
-                // align  offset
-  vec4 data[4]; //    4N      0N
-                //    4N      4N
-                //    4N      8N
-                //    4N     12N
+                          // align  offset
+  vec4 data[PARAMS_SIZE]; //    4N      0N
+                          //    4N      4N
+                          //   ...     ...
 };
 layout (std140) uniform CameraBlock  { Camera uCamera;   };
 layout (std140) uniform ShadingBlock { Shading uShading; };
 layout (std140) uniform ParamsBlock  { Params uParams;   };
 
 uniform float uIsoValue;
+uniform float uBoundRadius;
 uniform sampler2D uColorTexture;
 uniform sampler2D uDepthTexture;
+// Surface positions (xyz) and hit flags (w) of the previous frame, which
+// covered the lower-left uReprojectionSize texels
+uniform bool uReprojectHits;
+uniform sampler2D uPositionTexture;
+uniform ivec2 uReprojectionSize;
+// Offset of the primary rays, in pixels, of the sample of the pixel averaged
+// over frames
+uniform vec2 uSampleOffset;
+// Whether the depth prepass is being rendered, or whether its results in
+// uPrepassTexture are used. uRenderSize is the size of the frame, in pixels.
+uniform bool uRenderPrepass;
+uniform bool uUsePrepass;
+uniform sampler2D uPrepassTexture;
+uniform int uPrepassTileSize;
+uniform ivec2 uRenderSize;
+// Layer of the 3D texture being rendered by the brick map or scalar field
+// passes
+uniform int uRenderLayer;
+// Whether a layer of the brick map is being rendered, or whether rays skip the
+// empty bricks of uBrickMap, a grid of uBrickMapSize^3 bricks over the bounds
+// with the range of the function in each brick. uShowSkippedBricks tints the
+// fragments by the fraction of bricks skipped.
+uniform bool uRenderBrickMap;
+uniform bool uUseBrickMap;
+uniform highp sampler3D uBrickMap;
+uniform int uBrickMapSize;
+uniform bool uShowSkippedBricks;
+// Whether a layer of the scalar field texture is being rendered, or whether
+// the function is sampled from uFieldTexture, which holds the function at a
+// grid of uFieldTextureSize^3 points over the bounds, instead of evaluated
+uniform bool uRenderFieldTexture;
+uniform bool uUseFieldTexture;
+uniform highp sampler3D uFieldTexture;
+uniform int uFieldTextureSize;
+uniform sampler2D uSequentialColormap; // Single-row textures of colormap stops
+uniform sampler2D uDivergingColormap;
 uniform float uGaussianCurvatureFalloff;
 uniform float uMeanCurvatureFalloff;
 uniform float uMaxAbsCurvatureFalloff;
 uniform float uNormalLengthFalloff;
 uniform float uDVRFalloff;
 uniform float uDVRDensity;
+// Accumulated opacity at which direct volume rendering stops marching a ray,
+// and whether its steps are lengthened where the volume is transparent and the
+// transfer function varies slowly along the ray
+uniform float uDVROpacityThreshold;
+uniform bool uDVRAdaptiveStep;
+
+#if defined(GENERIC_VARIANT)
+// In the generic variant, the rendering options are uniforms instead of
+// constants defined by the application, so that a single program can render
+// any mode of the expression while a specialized variant is being built.
+uniform bool uUseBoundingBox;
+uniform int uRaymarchMethod;
+uniform int uRootTest;
+uniform int uGradientMode;
+uniform int uRenderingMode;
+uniform int uSurfaceColorMode;
+uniform bool uUseShadows;
+uniform bool uUseFog;
+uniform bool uInwardNormals;
+uniform bool uShowAxes;
+uniform int uIsosurfaceRaymarchSteps;
+uniform int uDVRRaymarchSteps;
+
+#define kUseBoundingBox uUseBoundingBox
+#define kRaymarchMethod uRaymarchMethod
+#define kRootTest uRootTest
+#define kGradientMode uGradientMode
+#define kRenderingMode uRenderingMode
+#define kSurfaceColorMode uSurfaceColorMode
+#define kUseShadows uUseShadows
+#define kUseFog uUseFog
+#define kInwardNormals uInwardNormals
+#define kShowAxes uShowAxes
+#define ISOSURFACE_RAYMARCH_STEPS uIsosurfaceRaymarchSteps
+#define DVR_RAYMARCH_STEPS uDVRRaymarchSteps
+#endif // GENERIC_VARIANT
+
+#define kUseBlinnPhong (kRenderingMode == kLitSurface)
+#define kShowIsosurface (kRenderingMode != kDirectVolume)
+#define kUseCurvature (kSurfaceColorMode >= kGaussianCurvature)
 
 ////////////////////////////////////////////////////////////////////////////////
 // Function definitions
@@ -230,6 +337,361 @@ float evalFunction(in vec3 P)
   return (@EXPRESSION_LHS@) - uIsoValue;
 }
 
+/*
+ * Constants used by the scalar field texture.
+ */
+// Largest magnitude stored in the texture. Larger values are clamped so that
+// they do not overflow half floats and filter to infinities or NaNs.
+const float kMaxFieldValue = 65000.0;
+
+/*
+ * Returns the function at P interpolated trilinearly from the scalar field
+ * texture. Its texels are centered at the points of the grid of the bounds.
+ */
+float sampleFieldTexture(in vec3 P)
+{
+  float size = float(uFieldTextureSize);
+  vec3 coord = (P - kBoundsMin) * kInvBoundRadius2;
+  return texture(uFieldTexture, (coord * (size - 1.0) + 0.5) / size).r -
+         uIsoValue;
+}
+
+/*
+ * Returns the function at P sampled from the scalar field texture if it is
+ * used, or else evaluated. The ray marching methods and direct volume
+ * rendering use this function, whereas gradients, curvatures, the polynomial
+ * and interval methods, and the brick map always evaluate the function.
+ */
+float evalScalarField(in vec3 P)
+{
+  if (uUseFieldTexture)
+  {
+    return sampleFieldTexture(P);
+  }
+  return evalFunction(P);
+}
+
+#if defined(ANALYTIC_DERIVATIVES)
+// Injected gradient and Hessian of the expression, obtained by symbolic
+// differentiation
+vec3 evalGradientAnalytic(in vec3 P)
+{
+  @CODE_GRADIENT@
+}
+
+mat3 evalHessianAnalytic(in vec3 P)
+{
+  @CODE_HESSIAN@
+}
+#endif
+
+#if defined(POLYNOMIAL_DEGREE)
+const int kPolySize = POLYNOMIAL_DEGREE + 1;
+
+/*
+ * Multiplies the polynomial b of degree n by the linear polynomial
+ * a0 (1 - s) + a1 s, raising the degree of b to n + 1. Polynomials are in the
+ * Bernstein basis of s in [0, 1].
+ */
+void bernsteinMul(inout float b[kPolySize], in int n, in float a0, in float a1)
+{
+  float invDegree = 1.0 / float(n + 1);
+  b[n + 1] = b[n] * a1;
+  for (int k = n; k > 0; --k)
+  {
+    b[k] = (float(n + 1 - k) * b[k] * a0 + float(k) * b[k - 1] * a1) *
+           invDegree;
+  }
+  b[0] *= a0;
+}
+
+/*
+ * Adds the constant c to the polynomial b of degree n.
+ */
+void bernsteinAdd(inout float b[kPolySize], in int n, in float c)
+{
+  for (int k = 0; k <= n; ++k)
+  {
+    b[k] += c;
+  }
+}
+
+/*
+ * Adds the polynomial a to the polynomial b, both of degree n.
+ */
+void bernsteinAdd(inout float b[kPolySize], in int n, in float a[kPolySize])
+{
+  for (int k = 0; k <= n; ++k)
+  {
+    b[k] += a[k];
+  }
+}
+
+// Injected Bernstein coefficients of the expression restricted to the segment
+// from P0 (s = 0) to P1 (s = 1), obtained by expanding it into monomials
+void evalSegmentPolynomial(in vec3 P0, in vec3 P1, out float polyX[kPolySize])
+{
+  float polyY[kPolySize];
+  float polyZ[kPolySize];
+
+  @CODE_POLYNOMIAL@
+}
+#endif
+
+#if defined(INTERVAL_EXTENSION)
+/*
+ * Interval arithmetic.
+ *
+ * An interval is a vec2 of its lower and upper bounds. Each function returns
+ * an interval that contains the results of the corresponding operation for
+ * any arguments within the given intervals. Bounds are not rounded outwards,
+ * so they may be off by the rounding error of the operation. Unbounded
+ * intervals are clamped to kIntervalMax, since infinities are not required
+ * by GLSL ES. Functions that are monotonically increasing, such as exp and
+ * floor, are applied to both bounds directly.
+ */
+const float kIntervalMax = 1e30;
+const vec2 kUnboundedInterval = vec2(-kIntervalMax, kIntervalMax);
+const float kIntervalPi = 3.14159265359;
+const float kIntervalHalfPi = kIntervalPi * 0.5;
+const float kIntervalTwoPi = kIntervalPi * 2.0;
+
+vec2 ineg(in vec2 a)
+{
+  return -a.yx;
+}
+
+vec2 iadd(in vec2 a, in vec2 b)
+{
+  return a + b;
+}
+
+vec2 isub(in vec2 a, in vec2 b)
+{
+  return a - b.yx;
+}
+
+vec2 imul(in vec2 a, in vec2 b)
+{
+  vec4 p = a.xxyy * b.xyxy;
+  return vec2(min(min(p.x, p.y), min(p.z, p.w)),
+              max(max(p.x, p.y), max(p.z, p.w)));
+}
+
+vec2 idiv(in vec2 a, in vec2 b)
+{
+  if (b.x <= 0.0 && b.y >= 0.0)
+  {
+    return kUnboundedInterval;
+  }
+  return imul(a, 1.0 / b.yx);
+}
+
+vec2 iabs(in vec2 a)
+{
+  if (a.x >= 0.0)
+  {
+    return a;
+  }
+  if (a.y <= 0.0)
+  {
+    return -a.yx;
+  }
+  return vec2(0.0, max(-a.x, a.y));
+}
+
+/*
+ * Power with a positive integer exponent n, by repeated squaring of the
+ * bounds. Odd powers are increasing, and even powers are increasing in |a|.
+ */
+vec2 ipow(in vec2 a, in int n)
+{
+  vec2 base = (n & 1) == 1 ? a : iabs(a);
+  vec2 result = vec2(1.0);
+  for (int m = n; m > 0; m >>= 1)
+  {
+    if ((m & 1) == 1)
+    {
+      result *= base;
+    }
+    base *= base;
+  }
+  return result;
+}
+
+/*
+ * Power with a constant exponent c that is not an integer. As pow, it is only
+ * defined for nonnegative bases.
+ */
+vec2 ipow(in vec2 a, in float c)
+{
+  vec2 base = max(a, 0.0);
+  if (c > 0.0)
+  {
+    return pow(base, vec2(c));
+  }
+  if (base.x == 0.0)
+  {
+    return vec2(base.y > 0.0 ? pow(base.y, c) : 0.0, kIntervalMax);
+  }
+  return pow(base.yx, vec2(c));
+}
+
+vec2 ipow(in vec2 a, in vec2 b)
+{
+  if (a.x <= 0.0)
+  {
+    return kUnboundedInterval;
+  }
+  return exp(imul(b, log(a)));
+}
+
+vec2 isqrt(in vec2 a)
+{
+  return sqrt(max(a, 0.0));
+}
+
+vec2 iinversesqrt(in vec2 a)
+{
+  return ipow(a, -0.5);
+}
+
+vec2 ilog(in vec2 a)
+{
+  return vec2(a.x > 0.0 ? log(a.x) : -kIntervalMax,
+              a.y > 0.0 ? log(a.y) : -kIntervalMax);
+}
+
+vec2 ilog2(in vec2 a)
+{
+  return vec2(a.x > 0.0 ? log2(a.x) : -kIntervalMax,
+              a.y > 0.0 ? log2(a.y) : -kIntervalMax);
+}
+
+/*
+ * Returns true if the interval a contains c + 2 pi k for some integer k.
+ */
+bool containsPeriodic(in vec2 a, in float c)
+{
+  return c + ceil((a.x - c) / kIntervalTwoPi) * kIntervalTwoPi <= a.y;
+}
+
+vec2 isin(in vec2 a)
+{
+  vec2 s = sin(a);
+  return vec2(containsPeriodic(a, -kIntervalHalfPi) ? -1.0 : min(s.x, s.y),
+              containsPeriodic(a, kIntervalHalfPi) ? 1.0 : max(s.x, s.y));
+}
+
+vec2 icos(in vec2 a)
+{
+  return isin(a + kIntervalHalfPi);
+}
+
+vec2 itan(in vec2 a)
+{
+  // tan is increasing between its poles at pi/2 + k pi
+  float pole = kIntervalHalfPi +
+               ceil((a.x - kIntervalHalfPi) / kIntervalPi) * kIntervalPi;
+  return pole <= a.y ? kUnboundedInterval : tan(a);
+}
+
+vec2 iasin(in vec2 a)
+{
+  return asin(clamp(a, -1.0, 1.0));
+}
+
+vec2 iacos(in vec2 a)
+{
+  return acos(clamp(a.yx, -1.0, 1.0));
+}
+
+vec2 iatan(in vec2 y, in vec2 x)
+{
+  // atan(y, x) = atan(y / x) in the right half-plane
+  if (x.x > 0.0)
+  {
+    return atan(idiv(y, x));
+  }
+  return vec2(-kIntervalPi, kIntervalPi);
+}
+
+vec2 icosh(in vec2 a)
+{
+  return cosh(iabs(a));
+}
+
+vec2 iacosh(in vec2 a)
+{
+  return acosh(max(a, 1.0));
+}
+
+vec2 iatanh(in vec2 a)
+{
+  return vec2(a.x > -1.0 ? atanh(a.x) : -kIntervalMax,
+              a.y < 1.0 ? atanh(a.y) : kIntervalMax);
+}
+
+vec2 ifract(in vec2 a)
+{
+  return floor(a.x) == floor(a.y) ? fract(a) : vec2(0.0, 1.0);
+}
+
+vec2 imod(in vec2 a, in vec2 b)
+{
+  // mod(a, b) = a - b floor(a / b)
+  return isub(a, imul(b, floor(idiv(a, b))));
+}
+
+vec2 istep(in vec2 edge, in vec2 a)
+{
+  return vec2(step(edge.y, a.x), step(edge.x, a.y));
+}
+
+vec2 iclamp(in vec2 a, in vec2 minValue, in vec2 maxValue)
+{
+  return min(max(a, minValue), maxValue);
+}
+
+vec2 imix(in vec2 a, in vec2 b, in vec2 t)
+{
+  return iadd(a, imul(isub(b, a), t));
+}
+
+vec2 ismoothstep(in vec2 edge0, in vec2 edge1, in vec2 a)
+{
+  // t^2 (3 - 2t) is increasing in t in [0, 1]
+  vec2 t = clamp(idiv(isub(a, edge0), isub(edge1, edge0)), 0.0, 1.0);
+  return t * t * (3.0 - 2.0 * t);
+}
+
+// Intervals of the coordinates x, y and z of a box
+struct IntervalBox
+{
+  vec2 x;
+  vec2 y;
+  vec2 z;
+};
+
+// Injected interval extension of the expression, which bounds its values in
+// the box P
+vec2 evalExpressionInterval(in IntervalBox P)
+{
+  @CODE_INTERVAL@
+}
+
+/*
+ * Returns an interval that contains the function values in the box
+ * [lo, hi].
+ */
+vec2 evalFunctionInterval(in vec3 lo, in vec3 hi)
+{
+  IntervalBox P = IntervalBox(vec2(lo.x, hi.x), vec2(lo.y, hi.y),
+                              vec2(lo.z, hi.z));
+  return evalExpressionInterval(P) - uIsoValue;
+}
+#endif
+
 /*
  * Evaluates a one-sided sigmoid for input x in (-inf, +inf) and falloff k>0.
  * The returned value is in the range [0, 1].
@@ -248,16 +710,23 @@ float sigmoid(in float x, in float k)
   return (tanh(k * x) + 1.0) * 0.5;
 }
 
+/*
+ * Samples a colormap texture for a given x in [0,1].
+ * x is mapped to the range between the centers of the first and last texels,
+ * so that the linear filter interpolates between adjacent colormap stops.
+ */
+vec4 sampleColormap(in sampler2D colormap, in float x)
+{
+  float size = float(textureSize(colormap, 0).x);
+  return textureLod(colormap, vec2((x * (size - 1.0) + 0.5) / size, 0.5), 0.0);
+}
+
 /*
  * Samples the color of a sequential colormap for a given x in [0,1].
  */
 vec4 sampleSequentialColormap(in float x)
 {
-  // SEQ_COLORMAP_SIZE and SEQ_COLORMAP are defined in @DEFINITIONS@
-  float t = x * float(SEQ_COLORMAP_SIZE - 1);
-  int i = int(floor(t));
-  int j = min(i + 1, SEQ_COLORMAP_SIZE - 1);
-  return mix(SEQ_COLORMAP[i], SEQ_COLORMAP[j], fract(t));
+  return sampleColormap(uSequentialColormap, x);
 }
 
 /*
@@ -265,11 +734,7 @@ vec4 sampleSequentialColormap(in float x)
  */
 vec4 sampleDivergingColormap(in float x)
 {
-  // DIV_COLORMAP_SIZE and DIV_COLORMAP are defined in @DEFINITIONS@
-  float t = x * float(DIV_COLORMAP_SIZE - 1);
-  int i = int(floor(t));
-  int j = min(i + 1, DIV_COLORMAP_SIZE - 1);
-  return mix(DIV_COLORMAP[i], DIV_COLORMAP[j], fract(t));
+  return sampleColormap(uDivergingColormap, x);
 }
 
 /*
@@ -337,25 +802,33 @@ vec3 evalGradientFivePoint(in vec3 P)
 
 /*
  * Evaluates gradient at P.
+ * kAnalytic falls back to the 5-point stencil if the function has no analytic
+ * derivatives.
  */
 vec3 evalGradient(in vec3 P)
 {
-#if defined(GRADIENT_FIVE_POINT_STENCIL)
-  return evalGradientFivePoint(P);
-#elif defined(GRADIENT_CENTRAL_DIFFERENCE)
-  return evalGradientCentral(P);
-#else
-  return evalGradientForward(P);
+#if defined(ANALYTIC_DERIVATIVES)
+  if (kGradientMode == kAnalytic)
+  {
+    return evalGradientAnalytic(P);
+  }
 #endif
+  if (kGradientMode == kFivePointStencil || kGradientMode == kAnalytic)
+  {
+    return evalGradientFivePoint(P);
+  }
+  if (kGradientMode == kCentralDifference)
+  {
+    return evalGradientCentral(P);
+  }
+  return evalGradientForward(P);
 }
 
-#if defined(USE_CURVATURE)
-
 /*
- * Computes the Hessian matrix at P.
- * O(h^2) error.
+ * Computes the Hessian matrix at P using central differences.
+ * O(h^2) error, 19 evaluations.
  */
-mat3 evalHessian(in vec3 P)
+mat3 evalHessianCentral(in vec3 P)
 {
   const float h = 1e-2;
   const float invH2 = 1.0 / (h * h);
@@ -387,6 +860,18 @@ mat3 evalHessian(in vec3 P)
   );
 }
 
+/*
+ * Evaluates the Hessian matrix at P, analytically if possible.
+ */
+mat3 evalHessian(in vec3 P)
+{
+#if defined(ANALYTIC_DERIVATIVES)
+  return evalHessianAnalytic(P);
+#else
+  return evalHessianCentral(P);
+#endif
+}
+
 /*
  * Computes the Gaussian curvature K, mean curvature H and
  * principal curvatures k1 and k2 at point P on the surface.
@@ -454,8 +939,6 @@ vec4 computeCurvatures(in vec3 P, bool inside)
   return vec4(K, H, kappa1, kappa2);
 }
 
-#endif // USE_CURVATURE
-
 /*
  * Intersects ray with an axis-aligned bounding box using the slab test.
  */
@@ -588,7 +1071,7 @@ bool taylorTest2ndOrder(in Ray   ray /* ray origin and direction            */,
   float fda = dot(evalGradient(Pa), ray.direction);
   float fdb = dot(evalGradient(Pb), ray.direction);
     // Evaluate function at midpoint
-  float fm = evalFunction(Pm);
+  float fm = evalScalarField(Pm);
 
   // Estimate second derivative using three points
   // f'' ≈ [f(ta) - 2f(tm) + f(tb)] / (h/2)^2
@@ -622,9 +1105,9 @@ bool taylorTest3rdOrder(in Ray   ray /* ray origin and direction            */,
   vec3 Pb = ray.origin + ray.direction * tb;
 
   // Function values
-  float f1 = evalFunction(P1);
-  float f2 = evalFunction(P2);
-  float f3 = evalFunction(P3);
+  float f1 = evalScalarField(P1);
+  float f2 = evalScalarField(P2);
+  float f3 = evalScalarField(P3);
 
   // First derivatives at endpoints
   float fda = dot(evalGradient(Pa), ray.direction);
@@ -645,6 +1128,31 @@ bool taylorTest3rdOrder(in Ray   ray /* ray origin and direction            */,
   return min(min(fa, q), min(r, fb)) * max(max(fa, q), max(r, fb)) <= 0.0;
 }
 
+/*
+ * Checks whether there is a root in a ray parameter interval using the root
+ * test of choice.
+ */
+bool rootTest(in Ray   ray /* ray origin and direction            */,
+              in float ta  /* ray parameter at start of interval  */,
+              in float tb  /* ray parameter at end of interval    */,
+              in float fa  /* function value at start of interval */,
+              in float fb  /* function value at end of interval   */)
+{
+  if (kRootTest == kSignChange)
+  {
+    return signTest(fa, fb);
+  }
+  if (kRootTest == kTaylor1stOrder)
+  {
+    return taylorTest1stOrder(ray, ta, tb, fa, fb);
+  }
+  if (kRootTest == kTaylor2ndOrder)
+  {
+    return taylorTest2ndOrder(ray, ta, tb, fa, fb);
+  }
+  return taylorTest3rdOrder(ray, ta, tb, fa, fb);
+}
+
 /*
  * Intersects ray with implicit surface using ray marching.
  *
@@ -660,26 +1168,14 @@ bool fixedMarch(in  Ray   ray    /* ray origin and direction            */,
   float dt = (tEnd - tStart) / float(ISOSURFACE_RAYMARCH_STEPS);
 
   float t = tStart;
-  float curValue = evalFunction(ray.origin + ray.direction * t);
+  float curValue = evalScalarField(ray.origin + ray.direction * t);
 
   for (int i = 0; i < ISOSURFACE_RAYMARCH_STEPS; ++i)
   {
     t += dt;
-    float nextValue = evalFunction(ray.origin + ray.direction * t);
+    float nextValue = evalScalarField(ray.origin + ray.direction * t);
 
-#if defined(USE_SIGN_TEST)
-    if (signTest(curValue, nextValue))
-#else // USE_SIGN_TEST
-#if defined(USE_TAYLOR_1ST)
-    if (taylorTest1stOrder(ray, t - dt, t, curValue, nextValue))
-#else // USE_TAYLOR_1ST
-#if defined(USE_TAYLOR_2ND)
-    if (taylorTest2ndOrder(ray, t - dt, t, curValue, nextValue))
-#else // USE_TAYLOR_2ND
-    if (taylorTest3rdOrder(ray, t - dt, t, curValue, nextValue))
-#endif // USE_TAYLOR_2ND
-#endif // USE_TAYLOR_1ST
-#endif // USE_SIGN_TEST
+    if (rootTest(ray, t - dt, t, curValue, nextValue))
     {
       tHit = t + (nextValue * dt) / (curValue - nextValue);
       inside = curValue < 0.0 ? true : false;
@@ -693,63 +1189,265 @@ bool fixedMarch(in  Ray   ray    /* ray origin and direction            */,
 }
 
 /*
- * Constants used by adaptiveMarch and adaptiveMarchShadow.
+ * Constants used by the brick map.
  */
-const float minDtScale = 0.25;
-const float maxDtScale = 1.5;
-const float tau = 0.05;
-const float invTau = 1.0 / tau;
-const float piOver180 = 3.14159265359 / 180.0;
-const float epsAngle = cos(85.0 * piOver180);
-const int maxSteps = ISOSURFACE_RAYMARCH_STEPS * int(1.0 / (minDtScale * minDtScale));
+// Samples of the function along each axis of a brick, including both faces
+const int kBrickSamples = 5;
+const int kBrickPlaneSamples = kBrickSamples * kBrickSamples;
+// Scale of the largest difference between adjacent samples of a brick that
+// pads the range of its samples
+const float kBrickPadding = 1.5;
+// Range of the bricks where the function is not finite
+const vec2 kUnboundedRange = vec2(-1e30, 1e30);
+
+// Number of bricks checked and skipped by the rays of the fragment
+int gCheckedBricks = 0;
+int gSkippedBricks = 0;
 
 /*
- * Intersects a ray with an implicit surface using adaptive ray marching.
- *
- * The step size is adjusted according to the function value
- * S: R^3 -> R and its gradient ∇S, evaluated at the current step.
+ * Returns the range of the function in a brick of the brick map.
  *
- * Ray marching starts with a base step size multiplied by |S|,
- * clamped to [s_min, s_max], where s_min and s_max are the minimum
- * and maximum step scaling factors (we use s_min = 0.25 and s_max = 1.5).
- *
- * If |S| < tau, where tau is a small distance from the level set (we use
- * tau = 0.05), and the ray is close to the silhouette of the isosurface,
- * the step size is further multiplied by max{s_min, |S| / tau}. Thus,
- * the step size decreases as the ray approaches the surface near a
- * silhouette. The silhouette condition is tested by checking whether
- * the ray has a small grazing angle relative to the local gradient:
- *
- *   |∇S · r_dir| < cos(pi/2 − theta),
- *
- * where r_dir is the ray direction and theta is the grazing-angle threshold.
- * We use theta = pi/36 = 5°.
- *
- * Since rays exit the bounding geometry with different step sizes,
- * artifacts may appear at exit points. To avoid this, the step size
- * is reduced as the ray approaches the exit. The distance to the exit
- * is measured as l = t_end − t_cur, where t_end is the ray parameter
- * at the exit point and t_cur <= t_end is the current ray parameter.
- * If l is smaller than an epsilon, the step size is multiplied by
- * max{s_min, l / τ}. The epsilon is chosen as the base step size
- * multiplied by s_max.
+ * If the function has an interval extension, the range is the interval that
+ * bounds the function in the brick, which is conservative. Otherwise, the
+ * function is sampled on a regular grid of kBrickSamples^3 points of the
+ * brick. Between the samples, the function may exceed them by up to its
+ * Lipschitz constant times the distance to the nearest sample, so the range
+ * of the samples is padded by the largest difference between adjacent
+ * samples, which estimates this bound, scaled by kBrickPadding. The estimate
+ * is approximate: features thinner than the sample spacing may be missed.
  */
-bool adaptiveMarch(in  Ray   ray    /* ray origin and direction            */,
-                   in  float tStart /* ray parameter at start of interval  */,
-                   in  float tEnd   /* ray parameter at end of interval    */,
-                   out float tHit   /* ray parameter at surface hit        */,
-                   out bool  inside /* true if surface was hit from inside */)
+vec2 evalBrickRange(in ivec3 brick /* index of the brick in the grid */)
 {
-  float baseDt = (tEnd - tStart) / float(ISOSURFACE_RAYMARCH_STEPS);
-  float epsExit = baseDt * maxDtScale;
-  float invEpsExit = 1.0 / epsExit;
+  float brickSize = 2.0 * kBoundRadius / float(uBrickMapSize);
+  vec3 brickMin = kBoundsMin + vec3(brick) * brickSize;
+
+#if defined(INTERVAL_EXTENSION)
+  vec2 bounds = evalFunctionInterval(brickMin, brickMin + vec3(brickSize)) +
+                uIsoValue;
+  if (any(isnan(bounds)) || any(isinf(bounds)))
+  {
+    return kUnboundedRange;
+  }
+  return bounds;
+#else
+  float spacing = brickSize / float(kBrickSamples - 1);
+
+  // Samples of the previous plane, overwritten by the ones of the current
+  // plane as they are evaluated
+  float plane[kBrickPlaneSamples];
+  vec2 range = vec2(1e30, -1e30);
+  float maxDiff = 0.0;
+  for (int k = 0; k < kBrickSamples; ++k)
+  {
+    for (int j = 0; j < kBrickSamples; ++j)
+    {
+      for (int i = 0; i < kBrickSamples; ++i)
+      {
+        vec3 P = brickMin + vec3(i, j, k) * spacing;
+        float value = evalFunction(P) + uIsoValue;
+        if (isnan(value) || isinf(value))
+        {
+          return kUnboundedRange;
+        }
+        range = vec2(min(range.x, value), max(range.y, value));
+
+        int index = j * kBrickSamples + i;
+        if (i > 0)
+        {
+          maxDiff = max(maxDiff, abs(value - plane[index - 1]));
+        }
+        if (j > 0)
+        {
+          maxDiff = max(maxDiff, abs(value - plane[index - kBrickSamples]));
+        }
+        if (k > 0)
+        {
+          maxDiff = max(maxDiff, abs(value - plane[index]));
+        }
+        plane[index] = value;
+      }
+    }
+  }
+
+  return range + vec2(-1.0, 1.0) * maxDiff * kBrickPadding;
+#endif
+}
+
+/*
+ * Returns true if the transfer function of the volume is transparent for
+ * every scalar in the range. The colormap is linearly interpolated, so its
+ * opacity is bounded by the stops around the lookup coordinates of the range.
+ */
+bool isTransparent(in vec2 range /* minimum and maximum scalar */)
+{
+  vec2 x = vec2(sigmoid(range.x, uDVRFalloff), sigmoid(range.y, uDVRFalloff));
+  float lastStop = float(textureSize(uDivergingColormap, 0).x - 1);
+  int firstIndex = int(floor(min(x.x, x.y) * lastStop));
+  int lastIndex = int(ceil(max(x.x, x.y) * lastStop));
+  for (int i = firstIndex; i <= lastIndex; ++i)
+  {
+    if (texelFetch(uDivergingColormap, ivec2(i, 0), 0).a > 0.0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Returns true if rays cannot hit anything in a brick of the given range of
+ * the function: the isosurface if it is shown, or else a visible part of the
+ * volume.
+ */
+bool isBrickEmpty(in vec2 range /* minimum and maximum of the function */)
+{
+  range -= uIsoValue;
+  if (kShowIsosurface)
+  {
+    return range.x > 0.0 || range.y < 0.0;
+  }
+  return isTransparent(range);
+}
+
+/*
+ * Advances the ray parameter t past the empty bricks of the brick map, with a
+ * 3D-DDA traversal of the grid from the brick that contains the ray at t.
+ * Returns the ray parameter where the ray enters the first brick that is not
+ * empty, or tEnd if there is none. tExit is set to the ray parameter where
+ * the ray leaves that brick, so that the marching methods only check the brick
+ * map again past tExit.
+ */
+float skipEmptyBricks(in  Ray   ray   /* ray origin and direction          */,
+                      in  float t     /* ray parameter to start from       */,
+                      in  float tEnd  /* ray parameter at end of interval  */,
+                      out float tExit /* ray parameter at exit of brick    */)
+{
+  tExit = tEnd;
+  if (!uUseBrickMap)
+  {
+    return t;
+  }
+
+  float brickSize = 2.0 * kBoundRadius / float(uBrickMapSize);
+  vec3 P = ray.origin + ray.direction * t;
+  ivec3 brick = clamp(ivec3(floor((P - kBoundsMin) / brickSize)), ivec3(0),
+                      ivec3(uBrickMapSize - 1));
+  ivec3 brickStep = ivec3(sign(ray.direction));
+  // Ray parameters between the boundaries of the bricks along each axis, and
+  // at the next boundary along each axis
+  vec3 dirAbs = max(abs(ray.direction), vec3(1e-20));
+  vec3 tDelta = brickSize / dirAbs;
+  vec3 boundary = kBoundsMin +
+                  (vec3(brick) + step(0.0, ray.direction)) * brickSize;
+  vec3 tNext = t + abs(boundary - P) / dirAbs;
+
+  for (int i = 0; i < 3 * uBrickMapSize; ++i)
+  {
+    tExit = min(min(min(tNext.x, tNext.y), tNext.z), tEnd);
+    ++gCheckedBricks;
+    if (!isBrickEmpty(texelFetch(uBrickMap, brick, 0).rg))
+    {
+      return t;
+    }
+    ++gSkippedBricks;
+
+    t = tExit;
+
+    // Cross the boundaries at t. More than one are crossed at edges and
+    // corners of bricks.
+    vec3 crossed = step(tNext, vec3(t));
+    brick += ivec3(crossed) * brickStep;
+    tNext += crossed * tDelta;
+    if (t >= tEnd || any(lessThan(brick, ivec3(0))) ||
+        any(greaterThanEqual(brick, ivec3(uBrickMapSize))))
+    {
+      tExit = tEnd;
+      return tEnd;
+    }
+  }
+
+  // The brick at t was not checked
+  tExit = t;
+  return t;
+}
+
+/*
+ * Constants used by adaptiveMarch and adaptiveMarchShadow.
+ */
+const float minDtScale = 0.25;
+const float maxDtScale = 1.5;
+const float tau = 0.05;
+const float invTau = 1.0 / tau;
+const float piOver180 = 3.14159265359 / 180.0;
+const float epsAngle = cos(85.0 * piOver180);
+// Not a constant, since ISOSURFACE_RAYMARCH_STEPS is a uniform in the generic
+// variant
+#define maxSteps (ISOSURFACE_RAYMARCH_STEPS * int(1.0 / (minDtScale * minDtScale)))
+
+/*
+ * Intersects a ray with an implicit surface using adaptive ray marching.
+ *
+ * The step size is adjusted according to the function value
+ * S: R^3 -> R and its gradient ∇S, evaluated at the current step.
+ *
+ * Ray marching starts with a base step size multiplied by |S|,
+ * clamped to [s_min, s_max], where s_min and s_max are the minimum
+ * and maximum step scaling factors (we use s_min = 0.25 and s_max = 1.5).
+ *
+ * If |S| < tau, where tau is a small distance from the level set (we use
+ * tau = 0.05), and the ray is close to the silhouette of the isosurface,
+ * the step size is further multiplied by max{s_min, |S| / tau}. Thus,
+ * the step size decreases as the ray approaches the surface near a
+ * silhouette. The silhouette condition is tested by checking whether
+ * the ray has a small grazing angle relative to the local gradient:
+ *
+ *   |∇S · r_dir| < cos(pi/2 − theta),
+ *
+ * where r_dir is the ray direction and theta is the grazing-angle threshold.
+ * We use theta = pi/36 = 5°.
+ *
+ * Since rays exit the bounding geometry with different step sizes,
+ * artifacts may appear at exit points. To avoid this, the step size
+ * is reduced as the ray approaches the exit. The distance to the exit
+ * is measured as l = t_end − t_cur, where t_end is the ray parameter
+ * at the exit point and t_cur <= t_end is the current ray parameter.
+ * If l is smaller than an epsilon, the step size is multiplied by
+ * max{s_min, l / τ}. The epsilon is chosen as the base step size
+ * multiplied by s_max.
+ */
+bool adaptiveMarch(in  Ray   ray    /* ray origin and direction            */,
+                   in  float tStart /* ray parameter at start of interval  */,
+                   in  float tEnd   /* ray parameter at end of interval    */,
+                   out float tHit   /* ray parameter at surface hit        */,
+                   out bool  inside /* true if surface was hit from inside */)
+{
+  float baseDt = (tEnd - tStart) / float(ISOSURFACE_RAYMARCH_STEPS);
+  float epsExit = baseDt * maxDtScale;
+  float invEpsExit = 1.0 / epsExit;
 
   float t = tStart;
   vec3 P = ray.origin + ray.direction * t;
-  float curValue = evalFunction(P);
+  float curValue = evalScalarField(P);
+  float tBrickExit = tStart;
 
   for (int i = 0; i < maxSteps; ++i)
   {
+    // Jump over the empty bricks once the ray leaves its brick
+    if (t >= tBrickExit)
+    {
+      float tNext = skipEmptyBricks(ray, t, tEnd, tBrickExit);
+      if (tNext >= tEnd)
+      {
+        break;
+      }
+      if (tNext > t)
+      {
+        t = tNext;
+        P = ray.origin + ray.direction * t;
+        curValue = evalScalarField(P);
+      }
+    }
+
     float curValueAbs = abs(curValue);
 
     // Step size is proportional to the function value
@@ -774,30 +1472,16 @@ bool adaptiveMarch(in  Ray   ray    /* ray origin and direction            */,
 
     t += dt;
     P += ray.direction * dt;
-    float nextValue = evalFunction(P);
+    float nextValue = evalScalarField(P);
 
-#if defined(USE_SIGN_TEST)
-    if (signTest(curValue, nextValue))
-#else // USE_SIGN_TEST
-#if defined(USE_TAYLOR_1ST)
-    if (taylorTest1stOrder(ray, t - dt, t, curValue, nextValue))
-#else // USE_TAYLOR_1ST
-#if defined(USE_TAYLOR_2ND)
-    if (taylorTest2ndOrder(ray, t - dt, t, curValue, nextValue))
-#else // USE_TAYLOR_2ND
-    if (taylorTest3rdOrder(ray, t - dt, t, curValue, nextValue))
-#endif // USE_TAYLOR_2ND
-#endif // USE_TAYLOR_1ST
-#endif // USE_SIGN_TEST
+    if (rootTest(ray, t - dt, t, curValue, nextValue))
     {
       float diffValue = curValue - nextValue;
-#if !defined(USE_SIGN_TEST)
-      if (abs(diffValue) < 1e-5)
+      if (kRootTest != kSignChange && abs(diffValue) < 1e-5)
       {
         tHit = t - dt;
       }
       else
-#endif // USE_SIGN_TEST
       {
         tHit = t + (nextValue * dt) / diffValue;
       }
@@ -818,19 +1502,497 @@ bool adaptiveMarch(in  Ray   ray    /* ray origin and direction            */,
   return false;
 }
 
+/*
+ * Constants used by refineRoot.
+ */
+const int kRefinementSteps = 8;
+
+/*
+ * Refines the root of the function within the ray interval [ta, tb], whose
+ * function values fa and fb have opposite signs, with a few steps of the
+ * Illinois method. Returns the ray parameter of the root.
+ */
+float refineRoot(in Ray   ray /* ray origin and direction            */,
+                 in float ta  /* ray parameter at start of interval  */,
+                 in float tb  /* ray parameter at end of interval    */,
+                 in float fa  /* function value at start of interval */,
+                 in float fb  /* function value at end of interval   */)
+{
+  for (int j = 0; j < kRefinementSteps && fb != fa; ++j)
+  {
+    float t = (ta * fb - tb * fa) / (fb - fa);
+    float ft = evalFunction(ray.origin + ray.direction * t);
+    if (ft * fb < 0.0)
+    {
+      ta = tb;
+      fa = fb;
+    }
+    else
+    {
+      fa *= 0.5;
+    }
+    tb = t;
+    fb = ft;
+  }
+  return tb;
+}
+
+#if defined(POLYNOMIAL_DEGREE)
+/*
+ * Constants used by polynomialMarch.
+ */
+const int kMinRefinementDepth = 5;
+const int kMaxSubdivisionDepth = 8;
+const int kMaxSubdivisions = 128;
+
+// Coefficients smaller than this fraction of the largest coefficient of the
+// polynomial are within its rounding error, and may have any sign
+const float kCoefficientTolerance = 1e-3;
+
+/*
+ * Classifies the Bernstein coefficients b: returns 0 if they all have the same
+ * sign and none is within the tolerance tol, which means the interval of b has
+ * no root; 1 if their signs change exactly once and none is within the
+ * tolerance, which means the interval has exactly one root; and 2 otherwise.
+ */
+int classifyCoefficients(in float b[kPolySize], in float tol)
+{
+  int count = 0;
+  for (int k = 0; k < kPolySize; ++k)
+  {
+    if (abs(b[k]) <= tol)
+    {
+      return 2;
+    }
+    if (k > 0 && (b[k - 1] < 0.0) != (b[k] < 0.0))
+    {
+      ++count;
+    }
+  }
+  return min(count, 2);
+}
+
+/*
+ * Restricts the polynomial b, defined on [0, 1], to the interval [s0, s1]
+ * using two de Casteljau subdivisions.
+ */
+void bernsteinRestrict(inout float b[kPolySize], in float s0, in float s1)
+{
+  // Left part of the subdivision at s1
+  if (s1 < 1.0)
+  {
+    for (int r = 1; r < kPolySize; ++r)
+    {
+      for (int k = POLYNOMIAL_DEGREE; k >= r; --k)
+      {
+        b[k] = mix(b[k - 1], b[k], s1);
+      }
+    }
+  }
+
+  // Right part of the subdivision of [0, s1] at s0
+  if (s0 > 0.0)
+  {
+    float u = s0 / s1;
+    for (int r = 1; r < kPolySize; ++r)
+    {
+      for (int k = 0; k < kPolySize - r; ++k)
+      {
+        b[k] = mix(b[k], b[k + 1], u);
+      }
+    }
+  }
+}
+
+/*
+ * Intersects a ray with a polynomial isosurface by root isolation.
+ *
+ * Along the ray interval, the function is a univariate polynomial whose
+ * Bernstein coefficients are computed once per ray. The interval is then
+ * recursively halved, visiting the left half first. An interval whose
+ * coefficients have the same sign has no root and is skipped. An interval
+ * with exactly one sign change has exactly one root, which is the first one
+ * along the ray, and is halved until kMinRefinementDepth. Other intervals are
+ * halved until kMaxSubdivisionDepth.
+ *
+ * The coefficients are computed from the expanded polynomial, which may lose
+ * much of its precision to cancellation. Hence, coefficients close to zero
+ * are taken as ambiguous, and the root of an interval is only accepted if
+ * the function, evaluated from its expression, changes sign at the endpoints.
+ * The root is then refined by refineRoot.
+ *
+ * Unlike ray marching, empty intervals are skipped at once, and the only
+ * sign changes that can be missed are the ones within the narrowest
+ * intervals. The traversal visits at most kMaxSubdivisions intervals. If
+ * ambiguous intervals use them up, the rest of the ray is marched by
+ * adaptiveMarch instead of being taken as a miss.
+ */
+bool polynomialMarch(in  Ray   ray    /* ray origin and direction            */,
+                     in  float tStart /* ray parameter at start of interval  */,
+                     in  float tEnd   /* ray parameter at end of interval    */,
+                     out float tHit   /* ray parameter at surface hit        */,
+                     out bool  inside /* true if surface was hit from inside */)
+{
+  float poly[kPolySize];
+  evalSegmentPolynomial(ray.origin + ray.direction * tStart,
+                        ray.origin + ray.direction * tEnd, poly);
+  bernsteinAdd(poly, POLYNOMIAL_DEGREE, -uIsoValue);
+
+  float maxCoefficient = 0.0;
+  for (int k = 0; k < kPolySize; ++k)
+  {
+    maxCoefficient = max(maxCoefficient, abs(poly[k]));
+  }
+  float tol = maxCoefficient * kCoefficientTolerance;
+
+  // The interval at a given depth and index is [index, index + 1] / 2^depth
+  int depth = 0;
+  int index = 0;
+  for (int i = 0; i < kMaxSubdivisions; ++i)
+  {
+    float width = 1.0 / float(1 << depth);
+    float s0 = float(index) * width;
+    float s1 = s0 + width;
+
+    float b[kPolySize] = poly;
+    bernsteinRestrict(b, s0, s1);
+    int numRoots = classifyCoefficients(b, tol);
+
+    // Intervals with one root are also halved until they are narrow enough for
+    // a fast convergence of the refinement
+    if ((numRoots > 1 || (numRoots == 1 && depth < kMinRefinementDepth)) &&
+        depth < kMaxSubdivisionDepth)
+    {
+      ++depth;
+      index <<= 1;
+      continue;
+    }
+
+    if (numRoots > 0)
+    {
+      float ta = mix(tStart, tEnd, s0);
+      float tb = mix(tStart, tEnd, s1);
+      float fa = evalFunction(ray.origin + ray.direction * ta);
+      float fb = evalFunction(ray.origin + ray.direction * tb);
+      if (fa * fb <= 0.0)
+      {
+        inside = fa < 0.0;
+        tHit = refineRoot(ray, ta, tb, fa, fb);
+        return true;
+      }
+    }
+
+    // Move to the next interval to the right
+    while ((index & 1) == 1)
+    {
+      index >>= 1;
+      --depth;
+    }
+    if (depth == 0)
+    {
+      inside = false;
+      return false;
+    }
+    ++index;
+  }
+
+  // No root was found before the next interval to visit
+  float s0 = float(index) / float(1 << depth);
+  return adaptiveMarch(ray, mix(tStart, tEnd, s0), tEnd, tHit, inside);
+}
+#endif
+
+#if defined(INTERVAL_EXTENSION)
+/*
+ * Constants used by intervalMarch.
+ */
+const int kMaxIntervalDepth = 12;
+const int kMaxIntervalSubdivisions = 512;
+
+/*
+ * Intersects a ray with the isosurface by interval subdivision.
+ *
+ * The ray interval is recursively halved, visiting the left half first, as in
+ * polynomialMarch. The interval extension of the function bounds its values
+ * in the bounding box of each segment. A segment whose bounds exclude the
+ * isovalue has no root and is skipped at once. Other segments are halved
+ * until they are about as short as the steps of fixedMarch, and the first one
+ * whose endpoints have function values of opposite signs is refined by
+ * refineRoot.
+ *
+ * Unlike ray marching, empty regions cost a few evaluations regardless of
+ * their length. The traversal visits at most kMaxIntervalSubdivisions
+ * segments. If segments near the surface, where the interval bounds
+ * overestimate the range of the function, use them up, the rest of the ray is
+ * marched by adaptiveMarch instead of being taken as a miss.
+ */
+bool intervalMarch(in  Ray   ray    /* ray origin and direction            */,
+                   in  float tStart /* ray parameter at start of interval  */,
+                   in  float tEnd   /* ray parameter at end of interval    */,
+                   out float tHit   /* ray parameter at surface hit        */,
+                   out bool  inside /* true if surface was hit from inside */)
+{
+  int maxDepth =
+      min(int(ceil(log2(float(ISOSURFACE_RAYMARCH_STEPS)))), kMaxIntervalDepth);
+
+  // The segment at a given depth and index is [index, index + 1] / 2^depth
+  int depth = 0;
+  int index = 0;
+  for (int i = 0; i < kMaxIntervalSubdivisions; ++i)
+  {
+    float width = 1.0 / float(1 << depth);
+    float s0 = float(index) * width;
+    float ta = mix(tStart, tEnd, s0);
+    float tb = mix(tStart, tEnd, s0 + width);
+    vec3 Pa = ray.origin + ray.direction * ta;
+    vec3 Pb = ray.origin + ray.direction * tb;
+
+    // Comparisons with NaN bounds are false, so such segments are kept
+    vec2 bounds = evalFunctionInterval(min(Pa, Pb), max(Pa, Pb));
+    bool mayHaveRoot = !(bounds.x > 0.0 || bounds.y < 0.0);
+
+    if (mayHaveRoot && depth < maxDepth)
+    {
+      ++depth;
+      index <<= 1;
+      continue;
+    }
+
+    if (mayHaveRoot)
+    {
+      float fa = evalFunction(Pa);
+      float fb = evalFunction(Pb);
+      if (fa * fb <= 0.0)
+      {
+        inside = fa < 0.0;
+        tHit = refineRoot(ray, ta, tb, fa, fb);
+        return true;
+      }
+    }
+
+    // Move to the next segment to the right
+    while ((index & 1) == 1)
+    {
+      index >>= 1;
+      --depth;
+    }
+    if (depth == 0)
+    {
+      inside = false;
+      return false;
+    }
+    ++index;
+  }
+
+  // No root was found before the next segment to visit
+  float s0 = float(index) / float(1 << depth);
+  return adaptiveMarch(ray, mix(tStart, tEnd, s0), tEnd, tHit, inside);
+}
+#endif
+
+/*
+ * Intersects a ray with the isosurface using the ray marching method of
+ * choice. kPolynomial and kInterval fall back to kAdaptive if the function is
+ * not a polynomial or has no interval extension.
+ */
+bool isosurfaceMarch(in  Ray   ray    /* ray origin and direction            */,
+                     in  float tStart /* ray parameter at start of interval  */,
+                     in  float tEnd   /* ray parameter at end of interval    */,
+                     out float tHit   /* ray parameter at surface hit        */,
+                     out bool  inside /* true if surface was hit from inside */)
+{
+  // Start where the ray enters the first brick that is not empty
+  float tBrickExit;
+  tStart = skipEmptyBricks(ray, tStart, tEnd, tBrickExit);
+  if (tStart >= tEnd)
+  {
+    inside = false;
+    return false;
+  }
+
+#if defined(POLYNOMIAL_DEGREE)
+  if (kRaymarchMethod == kPolynomial && !uUseFieldTexture)
+  {
+    return polynomialMarch(ray, tStart, tEnd, tHit, inside);
+  }
+#endif
+#if defined(INTERVAL_EXTENSION)
+  if (kRaymarchMethod == kInterval && !uUseFieldTexture)
+  {
+    return intervalMarch(ray, tStart, tEnd, tHit, inside);
+  }
+#endif
+  if (kRaymarchMethod == kFixedStep)
+  {
+    return fixedMarch(ray, tStart, tEnd, tHit, inside);
+  }
+  return adaptiveMarch(ray, tStart, tEnd, tHit, inside);
+}
+
+/*
+ * Constants used by getRayStart.
+ */
+// Distance marched before the hit predicted from the previous frame, relative
+// to the bounds diameter
+const float kReprojectionMargin = 0.02;
+// Number of ray marching steps before the hit predicted by the depth prepass
+const float kPrepassMarginSteps = 2.0;
+
+/*
+ * Predicts the ray parameter of the surface hit from the surface positions of
+ * the previous frame, or returns tStart if it cannot be predicted.
+ *
+ * The positions of the 3x3 texels of the previous frame around the fragment
+ * are projected onto the ray, and marching starts at a safety margin before
+ * the nearest one. For small changes of the view, the surface hit by the ray
+ * is close to the ones hit by the neighboring rays of the previous frame.
+ * Nothing is predicted if any of the texels missed the surface (e.g., near
+ * silhouettes).
+ */
+float getReprojectedRayStart(in Ray   ray    /* ray origin and direction */,
+                             in float tStart /* ray parameter at entry   */,
+                             in float tEnd   /* ray parameter at exit    */)
+{
+  vec2 screenCoord = (fragPosition + 1.0) * 0.5;
+  ivec2 maxTexel = uReprojectionSize - 1;
+  ivec2 centerTexel = clamp(ivec2(screenCoord * vec2(uReprojectionSize)),
+                            ivec2(0), maxTexel);
+
+  float tPredicted = tEnd;
+  for (int y = -1; y <= 1; ++y)
+  {
+    for (int x = -1; x <= 1; ++x)
+    {
+      ivec2 texel = clamp(centerTexel + ivec2(x, y), ivec2(0), maxTexel);
+      vec4 position = texelFetch(uPositionTexture, texel, 0);
+      if (position.w < 0.5)
+      {
+        return tStart;
+      }
+      tPredicted = min(tPredicted,
+                       dot(position.xyz - ray.origin, ray.direction));
+    }
+  }
+
+  return tPredicted - kReprojectionMargin * 2.0 * kBoundRadius;
+}
+
+/*
+ * Predicts the ray parameter of the surface hit from the depth prepass, or
+ * returns tStart if it cannot be predicted.
+ *
+ * The prepass marched the rays through the corners of the tiles of
+ * uPrepassTileSize pixels. Between the corners, the surface may be nearer
+ * than the nearest corner hit by up to the range of the corner hits, and
+ * hits are only accurate up to the step size, so marching starts that much
+ * before. Nothing is predicted if any of the corner rays missed the surface,
+ * as the tile may contain a silhouette or a feature thinner than the tile.
+ */
+float getPrepassRayStart(in Ray   ray    /* ray origin and direction */,
+                         in float tStart /* ray parameter at entry   */,
+                         in float tEnd   /* ray parameter at exit    */)
+{
+  ivec2 tile = ivec2(gl_FragCoord.xy) / uPrepassTileSize;
+
+  float tMin = 1e10;
+  float tMax = -1e10;
+  for (int index = 0; index < 4; ++index)
+  {
+    ivec2 corner = tile + ivec2(index & 1, index >> 1);
+    vec4 prepass = texelFetch(uPrepassTexture, corner, 0);
+    if (prepass.w < 0.5)
+    {
+      return tStart;
+    }
+    tMin = min(tMin, prepass.x);
+    tMax = max(tMax, prepass.x);
+  }
+
+  float baseDt = (tEnd - tStart) / float(ISOSURFACE_RAYMARCH_STEPS);
+  return tMin - (tMax - tMin) - kPrepassMarginSteps * baseDt;
+}
+
+/*
+ * Returns the ray parameter where ray marching can start, skipping the empty
+ * space before the surface predicted by the depth prepass or, where the
+ * prepass cannot predict it, by the previous frame.
+ *
+ * tStart is returned, and the ray is marched in full, if nothing can be
+ * predicted, or if the function has different signs at tStart and at the
+ * predicted start, which means that a surface would be skipped.
+ */
+float getRayStart(in Ray   ray    /* ray origin and direction */,
+                  in float tStart /* ray parameter at entry   */,
+                  in float tEnd   /* ray parameter at exit    */)
+{
+  float tFirst = uUsePrepass ? getPrepassRayStart(ray, tStart, tEnd) : tStart;
+  if (tFirst <= tStart && uReprojectHits)
+  {
+    tFirst = getReprojectedRayStart(ray, tStart, tEnd);
+  }
+
+  if (tFirst <= tStart || tFirst >= tEnd)
+  {
+    return tStart;
+  }
+
+  float startValue = evalScalarField(ray.origin + ray.direction * tStart);
+  float firstValue = evalScalarField(ray.origin + ray.direction * tFirst);
+  if ((startValue < 0.0) != (firstValue < 0.0))
+  {
+    return tStart;
+  }
+
+  return tFirst;
+}
+
+// Maximum factor by which the adaptive steps of direct volume rendering are
+// longer than the base step
+const float kDVRMaxStepScale = 4.0;
+// Opacity of a base step below which the volume is considered transparent
+const float kDVRTransparentAlpha = 0.02;
+// Maximum change of the colormap coordinate within a step, in colormap stops
+const float kDVRMaxStopsPerStep = 0.5;
+
+/*
+ * Returns the factor by which the step following a sample of direct volume
+ * rendering is lengthened, in [1, kDVRMaxStepScale].
+ * Steps are longer where the opacity of the transfer function is low, but
+ * short enough that the colormap coordinate, whose rate of change along the
+ * ray is the slope of the sigmoid times the rate of change of the scalar,
+ * does not skip over a stop.
+ */
+float getDVRStepScale(in float alpha  /* opacity of a base step       */,
+                      in float x      /* colormap coordinate in [0,1] */,
+                      in float dfdt   /* scalar change per unit of t  */,
+                      in float ds     /* base step                    */)
+{
+  float opacityScale = mix(kDVRMaxStepScale, 1.0,
+                           smoothstep(0.0, kDVRTransparentAlpha, alpha));
+
+  // Derivative of the sigmoid: k/2 (1 - tanh^2(kx)) = 2k x (1 - x)
+  float slope = 2.0 * abs(uDVRFalloff) * x * (1.0 - x);
+  float lastStop = float(textureSize(uDivergingColormap, 0).x - 1);
+  float dxds = slope * abs(dfdt) * ds * lastStop;
+  float slopeScale = dxds > 0.0 ? kDVRMaxStopsPerStep / dxds
+                                : kDVRMaxStepScale;
+
+  return clamp(min(opacityScale, slopeScale), 1.0, kDVRMaxStepScale);
+}
+
 /*
  * Direct volume rendering.
  * Front-to-back emission-absorption compositing.
+ * Each sample is composited with the optical depth of the step that follows
+ * it, so that the result does not depend on the step length where the
+ * adaptive steps are longer than the base step.
  */
 vec4 dvrMarch(in Ray   ray    /* ray origin and direction           */,
               in float tStart /* ray parameter at start of interval */,
               in float tEnd   /* ray parameter at end of interval   */)
 {
   float ds = (tEnd - tStart) / float(DVR_RAYMARCH_STEPS);
-  float opticalDepthScale = ds * kInvBoundRadius * uDVRDensity;
-
-  vec3 samplePos = ray.origin + ray.direction * tStart;
-  vec3 rayStep   = ray.direction * ds;
+  float densityScale = kInvBoundRadius * uDVRDensity;
 
   vec3 radiance  = vec3(0.0);
   float opacity  = 0.0;
@@ -843,45 +2005,87 @@ vec4 dvrMarch(in Ray   ray    /* ray origin and direction           */,
   // Average scalar along the ray
   float scalarSum = 0.0;
   float weightSum = 0.0;
+  float tBrickExit = tStart;
+
+  // Scalar and ray parameter of the previous sample, if it is adjacent to the
+  // current one, for estimating the rate of change of the scalar
+  bool hasPrevSample = false;
+  float prevScalar = 0.0;
+  float prevT = tStart;
+  int samples = 0;
 
+  // Steps are at least ds long, so DVR_RAYMARCH_STEPS samples cover the
+  // interval
+  float t = tStart;
   for (int i = 0; i < DVR_RAYMARCH_STEPS; ++i)
   {
+    // Jump to the first sample past the transparent bricks, whose samples
+    // have no opacity, once the ray leaves its brick
+    if (t >= tBrickExit)
+    {
+      float tNext = skipEmptyBricks(ray, t, tEnd, tBrickExit);
+      if (tNext > t)
+      {
+        t = tStart + ceil((tNext - tStart) / ds) * ds;
+        hasPrevSample = false;
+      }
+    }
+    if (t >= tEnd)
+    {
+      break;
+    }
+
     // Sample scalar field -> emission color + base opacity
-    float scalar = evalFunction(samplePos);
-    vec4 emission = sampleDivergingColormap(sigmoid(scalar, uDVRFalloff));
+    float scalar = evalScalarField(ray.origin + ray.direction * t);
+    float x = sigmoid(scalar, uDVRFalloff);
+    vec4 emission = sampleDivergingColormap(x);
+    ++samples;
+
+    float dt = ds;
+    if (uDVRAdaptiveStep && hasPrevSample)
+    {
+      float alpha = 1.0 - exp(-emission.a * ds * densityScale);
+      float dfdt = (scalar - prevScalar) / (t - prevT);
+      dt *= getDVRStepScale(alpha, x, dfdt, ds);
+    }
+    dt = min(dt, tEnd - t);
+    float stepOpticalDepth = emission.a * dt * densityScale;
 
     // Beer-Lambert absorption
-    float alpha = 1.0 - exp(-emission.a * opticalDepthScale);
+    float alpha = 1.0 - exp(-stepOpticalDepth);
 
     // Front-to-back emission-absorption compositing
     float transmittance = 1.0 - opacity;
     radiance += transmittance * alpha * emission.rgb;
     opacity  += transmittance * alpha;
 
-    opticalDepth += emission.a * opticalDepthScale;
+    opticalDepth += stepOpticalDepth;
     float contribution = transmittance * alpha;
     if (contribution > maxContribution)
     {
       maxContribution = contribution;
-      tMax = tStart + float(i) * ds;
+      tMax = t;
     }
 
     scalarSum += scalar * alpha;
     weightSum += alpha;
 
     // Early ray termination
-    if (opacity >= 1.0)
+    if (opacity >= uDVROpacityThreshold)
     {
       break;
     }
 
-    samplePos += rayStep;
+    hasPrevSample = true;
+    prevScalar = scalar;
+    prevT = t;
+    t += dt;
   }
 
   outData1 = vec4(ray.origin + ray.direction * tMax, 1.0);
 
   float avgScalar = (weightSum > 0.0) ? scalarSum / weightSum : 0.0;
-  outData2 = vec4(opticalDepth, avgScalar, opacity, 0.0);
+  outData2 = vec4(opticalDepth, avgScalar, opacity, float(samples));
 
   return vec4(radiance, opacity);
 }
@@ -898,10 +2102,27 @@ bool adaptiveMarchShadow(in Ray   ray  /* ray origin and direction */,
 
   float t = 0.0;
   vec3 P = ray.origin;
-  float curValue = evalFunction(P);
+  float curValue = evalScalarField(P);
+  float tBrickExit = 0.0;
 
   for (int i = 0; i < maxSteps; ++i)
   {
+    // Jump over the empty bricks once the ray leaves its brick
+    if (t >= tBrickExit)
+    {
+      float tNext = skipEmptyBricks(ray, t, tEnd, tBrickExit);
+      if (tNext >= tEnd)
+      {
+        break;
+      }
+      if (tNext > t)
+      {
+        t = tNext;
+        P = ray.origin + ray.direction * t;
+        curValue = evalScalarField(P);
+      }
+    }
+
     float leftValueAbs = abs(curValue);
 
     // Step size is proportional to the function value
@@ -924,7 +2145,7 @@ bool adaptiveMarchShadow(in Ray   ray  /* ray origin and direction */,
     }
 
     P += ray.direction * dt;
-    float nextValue = evalFunction(P);
+    float nextValue = evalScalarField(P);
 
     if (signTest(curValue, nextValue))
     {
@@ -949,23 +2170,36 @@ bool adaptiveMarchShadow(in Ray   ray  /* ray origin and direction */,
 bool inShadow(in vec3 P /* intersection point with surface */,
               in vec3 L /* normalized direction to light source */)
 {
-  const float bias = 2.0 * kBoundRadius / 1e3;
+  float bias = 2.0 * kBoundRadius / 1e3;
   Ray ray = Ray(P + L * bias, L);
 
-#if defined(USE_BOUNDING_BOX)
-  float tEnd = intersectAABBFromInside(ray);
-#else // USE_BOUNDING_BOX
-  float tEnd = intersectSphereFromInside(ray);
-#endif // USE_BOUNDING_BOX
+  float tEnd = kUseBoundingBox ? intersectAABBFromInside(ray)
+                              : intersectSphereFromInside(ray);
+#if defined(POLYNOMIAL_DEGREE)
+  if (kRaymarchMethod == kPolynomial && !uUseFieldTexture)
+  {
+    float tHit;
+    bool inside;
+    return polynomialMarch(ray, 0.0, tEnd, tHit, inside);
+  }
+#endif
+#if defined(INTERVAL_EXTENSION)
+  if (kRaymarchMethod == kInterval && !uUseFieldTexture)
+  {
+    float tHit;
+    bool inside;
+    return intervalMarch(ray, 0.0, tEnd, tHit, inside);
+  }
+#endif
   return adaptiveMarchShadow(ray, tEnd);
 }
 
 /*
  * Determines the color of the shaded surface at P with normal N.
- * Diffuse color may be colorcoded normals (SHOW_NORMAL_VECTOR),
- * normal magnitude (SHOW_NORMAL_MAGNITUDE),
- * curvature (SHOW_GAUSSIAN_CURVATURE,SHOW_MEAN_CURVATURE,
- * SHOW_MAX_CURVATURE), or a constant color.
+ * Diffuse color may be colorcoded normals (kUnitNormal),
+ * normal magnitude (kNormalMagnitude),
+ * curvature (kGaussianCurvature, kMeanCurvature, kMaxAbsCurvature),
+ * or a constant color (kSideSign).
  */
 vec4 shade(in vec3 PView  /* intersection point in view space */,
            in vec3 PModel /* intersection point in model space */,
@@ -973,35 +2207,37 @@ vec4 shade(in vec3 PView  /* intersection point in view space */,
            in bool inside /* whether the ray hit from inside */)
 {
   vec3 KsIs = vec3(1.0);
-#if !defined(SHOW_NORMAL_VECTOR) && !defined(SHOW_NORMAL_MAGNITUDE) && !defined(USE_CURVATURE)
-  vec3 KdId = inside ? uShading.insideKdId : uShading.outsideKdId;
-#else // !SHOW_NORMAL_VECTOR && !SHOW_NORMAL_MAGNITUDE && !USE_CURVATURE
   vec3 KdId = vec3(0.7);
-#endif // !SHOW_NORMAL_VECTOR && !SHOW_NORMAL_MAGNITUDE && !USE_CURVATURE
+  if (kSurfaceColorMode == kSideSign)
+  {
+    KdId = inside ? uShading.insideKdId : uShading.outsideKdId;
+  }
 
   vec3 ambientColor = vec3(0.0);
   vec3 diffuseColor = KdId;
   vec3 specularColor = vec3(0.0);
 
-#if defined(USE_SHADOWS)
   float lightMask = 1.0;
-  vec3 LModel = normalize(mat3(uCamera.invModelMatrix) * (-uShading.lightDirWorld) );
-  if (inShadow(PModel, LModel))
+  if (kUseShadows)
   {
-    lightMask = 0.05;
+    vec3 LModel = normalize(mat3(uCamera.invModelMatrix) * (-uShading.lightDirWorld) );
+    if (inShadow(PModel, LModel))
+    {
+      lightMask = 0.05;
+    }
   }
-#endif // USE_SHADOWS
 
-#if defined(USE_BLINN_PHONG)
-  ambientColor = KdId * 0.25;
-  vec3 NView = normalize(uCamera.normalMatrix * NModel);
-  vec3 N = inside ? -NView : NView;
-  vec3 L = normalize(mat3(uCamera.viewMatrix) * (-uShading.lightDirWorld) );
-  float lambertian = max(dot(N, L), 0.0);
-  if (lambertian > 0.0)
+  // Unlit
+  float lambertian = 1.0;
+  if (kUseBlinnPhong)
   {
-#if defined(USE_SHADOWS)
-    if (lightMask == 1.0)
+    ambientColor = KdId * 0.25;
+    vec3 NView = normalize(uCamera.normalMatrix * NModel);
+    vec3 N = inside ? -NView : NView;
+    vec3 L = normalize(mat3(uCamera.viewMatrix) * (-uShading.lightDirWorld) );
+    lambertian = max(dot(N, L), 0.0);
+    // lightMask is always 1.0 without shadows
+    if (lambertian > 0.0 && lightMask == 1.0)
     {
       vec3 V = normalize(-PView);
       vec3 H = normalize(L + V);
@@ -1009,66 +2245,54 @@ vec4 shade(in vec3 PView  /* intersection point in view space */,
       float specular = pow(angle, uShading.shininess);
       specularColor = KsIs * specular;
     }
-#else // USE_SHADOWS
-    vec3 V = normalize(-PView);
-    vec3 H = normalize(L + V);
-    float angle = max(dot(H, N), 0.0);
-    float specular = pow(angle, uShading.shininess);
-    specularColor = KsIs * specular;
-#endif // USE_SHADOWS
-  }
-#else // USE_BLINN_PHONG
-  // Unlit
-  float lambertian = 1.0;
-#endif // USE_BLINN_PHONG
-
-#if defined(SHOW_NORMAL_VECTOR)
-  vec3 diffuseColorNormal = normalize(NModel);
-#if defined(INWARD_NORMALS)
-  diffuseColorNormal *= inside ? -1.0 : 1.0;
-#endif // INWARD_NORMALS
-  diffuseColor = (diffuseColorNormal + 1.0) * 0.5;
-#endif // SHOW_NORMAL_VECTOR
-
-#if defined(SHOW_NORMAL_MAGNITUDE)
-  float t = halfSigmoid(length(NModel), uNormalLengthFalloff);
-  diffuseColor = sampleSequentialColormap(t).rgb;
-#endif // SHOW_NORMAL_MAGNITUDE
-
-#if defined(USE_CURVATURE)
-  vec4 KHKappas = computeCurvatures(PModel, inside);
-  outData2 = KHKappas;
-#endif // USE_CURVATURE
-
-#if defined(SHOW_GAUSSIAN_CURVATURE)
-  // Negative Gaussian curvature ->  hyperbolic
-  // Zero Gaussian curvature -> parabolic
-  // Positive Gaussian curvature-> elliptic
-  float t = sigmoid(KHKappas.x, uGaussianCurvatureFalloff);
-  diffuseColor = sampleDivergingColormap(t).rgb;
-#endif // SHOW_GAUSSIAN_CURVATURE
-
-#if defined(SHOW_MEAN_CURVATURE)
-  // Negative mean curvature -> concave
-  // Zero mean curvature -> minimal surface
-  // Positive mean curvature -> convex
-  float t = sigmoid(KHKappas.y, uMeanCurvatureFalloff);
-  diffuseColor = sampleDivergingColormap(t).rgb;
-#endif // SHOW_MEAN_CURVATURE
-
-#if defined(SHOW_MAX_CURVATURE)
-  float maxAbsKappas = max(abs(KHKappas.z), abs(KHKappas.w));
-  float t = halfSigmoid(maxAbsKappas, uMaxAbsCurvatureFalloff);
-  // t=0 -> Flat
-  // t=1 -> Highly curved
-  diffuseColor = sampleSequentialColormap(t).rgb;
-#endif // SHOW_MAX_CURVATURE
-
-  diffuseColor *= lambertian;
-
-#if defined(USE_SHADOWS)
-  diffuseColor *= lightMask;
-#endif // USE_SHADOWS
+  }
+
+  if (kSurfaceColorMode == kUnitNormal)
+  {
+    vec3 diffuseColorNormal = normalize(NModel);
+    if (kInwardNormals)
+    {
+      diffuseColorNormal *= inside ? -1.0 : 1.0;
+    }
+    diffuseColor = (diffuseColorNormal + 1.0) * 0.5;
+  }
+  else if (kSurfaceColorMode == kNormalMagnitude)
+  {
+    float t = halfSigmoid(length(NModel), uNormalLengthFalloff);
+    diffuseColor = sampleSequentialColormap(t).rgb;
+  }
+  else if (kUseCurvature)
+  {
+    vec4 KHKappas = computeCurvatures(PModel, inside);
+    outData2 = KHKappas;
+
+    if (kSurfaceColorMode == kGaussianCurvature)
+    {
+      // Negative Gaussian curvature ->  hyperbolic
+      // Zero Gaussian curvature -> parabolic
+      // Positive Gaussian curvature-> elliptic
+      float t = sigmoid(KHKappas.x, uGaussianCurvatureFalloff);
+      diffuseColor = sampleDivergingColormap(t).rgb;
+    }
+    else if (kSurfaceColorMode == kMeanCurvature)
+    {
+      // Negative mean curvature -> concave
+      // Zero mean curvature -> minimal surface
+      // Positive mean curvature -> convex
+      float t = sigmoid(KHKappas.y, uMeanCurvatureFalloff);
+      diffuseColor = sampleDivergingColormap(t).rgb;
+    }
+    else
+    {
+      float maxAbsKappas = max(abs(KHKappas.z), abs(KHKappas.w));
+      float t = halfSigmoid(maxAbsKappas, uMaxAbsCurvatureFalloff);
+      // t=0 -> Flat
+      // t=1 -> Highly curved
+      diffuseColor = sampleSequentialColormap(t).rgb;
+    }
+  }
+
+  diffuseColor *= lambertian * lightMask;
 
   vec3 totalColor = ambientColor + diffuseColor + specularColor;
 
@@ -1076,16 +2300,11 @@ vec4 shade(in vec3 PView  /* intersection point in view space */,
 }
 
 /*
- * Generates the primary ray in world-space coordinates with a
- * given screen-space pixel offset, then transforms it to model space.
+ * Generates the ray through the given position in normalized device
+ * coordinates in world space, then transforms it to model space.
  */
-Ray generatePrimaryRay(vec2 pixelOffset)
+Ray generateRay(vec2 posNDC)
 {
-  vec2 posNDC = fragPosition;
-#if defined(MSAA_ENABLED)
-  posNDC += pixelOffset * uCamera.pixelSize;
-#endif
-
   bool isPerspective = (uCamera.projMatrix[3][3] == 0.0);
 
   vec3 originWorld, dirWorld;
@@ -1122,6 +2341,19 @@ Ray generatePrimaryRay(vec2 pixelOffset)
   return Ray(originModel, dirModel);
 }
 
+/*
+ * Generates the primary ray with a given screen-space pixel offset.
+ */
+Ray generatePrimaryRay(vec2 pixelOffset)
+{
+  vec2 posNDC = fragPosition + uSampleOffset * uCamera.pixelSize;
+#if defined(MSAA_ENABLED)
+  posNDC += pixelOffset * uCamera.pixelSize;
+#endif
+
+  return generateRay(posNDC);
+}
+
 /*
  * Calculates the maximum ray parameter based on depth buffer.
  */
@@ -1168,104 +2400,91 @@ float getMaxRayParamFromDepth(float depth, vec2 screenCoord, Ray rayModel)
  */
 vec4 rayMarch(in Ray rayModel)
 {
-#if defined(SHOW_AXES)
   vec2 screenCoord = (fragPosition + 1.0) * 0.5;
-  vec4 dstColor = texture(uColorTexture, screenCoord);
-#else // SHOW_AXES
-  vec4 dstColor = vec4(0.0);
-#endif // SHOW_AXES
+  vec4 dstColor = kShowAxes ? texture(uColorTexture, screenCoord) : vec4(0.0);
 
   float tStart, tEnd;
-#if defined(USE_BOUNDING_BOX)
-  if (!intersectAABB(rayModel, tStart, tEnd))
-#else // USE_BOUNDING_BOX
-  if (!intersectSphere(rayModel, tStart, tEnd))
-#endif // USE_BOUNDING_BOX
+  bool hitBounds = kUseBoundingBox ? intersectAABB(rayModel, tStart, tEnd)
+                                   : intersectSphere(rayModel, tStart, tEnd);
+  if (!hitBounds)
   {
     gl_FragDepth = 1.0;
     return dstColor;
   }
 
-#if defined(SHOW_AXES)
-  // Limit ray based on depth buffer
-  float dstDepth = texture(uDepthTexture, screenCoord).r;
-  float maxT = getMaxRayParamFromDepth(dstDepth, screenCoord, rayModel);
-  tEnd = min(tEnd, maxT);
-
-  // If the mesh is in front of the bounding volume start, skip rendering
-  if (tEnd < tStart)
+  // Depth of the axes, or the far plane if they are hidden
+  float dstDepth = 1.0;
+  if (kShowAxes)
   {
-    gl_FragDepth = 1.0;
-    return dstColor;
+    // Limit ray based on depth buffer
+    dstDepth = texture(uDepthTexture, screenCoord).r;
+    float maxT = getMaxRayParamFromDepth(dstDepth, screenCoord, rayModel);
+    tEnd = min(tEnd, maxT);
+
+    // If the mesh is in front of the bounding volume start, skip rendering
+    if (tEnd < tStart)
+    {
+      gl_FragDepth = 1.0;
+      return dstColor;
+    }
   }
-#endif // SHOW_AXES
 
   float tHit;
   bool inside;
   vec4 srcColor;
 
-#if defined(SHOW_ISOSURFACE)
-#if defined(USE_ADAPTIVE_RAY_MARCH)
-  if (adaptiveMarch(rayModel, tStart, tEnd, tHit, inside))
-  {
-#else // USE_ADAPTIVE_RAY_MARCH
-  if (fixedMarch(rayModel, tStart, tEnd, tHit, inside))
+  if (kShowIsosurface)
   {
-#endif // USE_ADAPTIVE_RAY_MARCH
+    float tFirst = getRayStart(rayModel, tStart, tEnd);
+    bool hit = isosurfaceMarch(rayModel, tFirst, tEnd, tHit, inside);
+    if (!hit)
+    {
+      gl_FragDepth = dstDepth;
+      return dstColor;
+    }
+
     vec3 PModel = rayModel.origin + rayModel.direction * tHit;
     vec3 PWorld = (uCamera.modelMatrix * vec4(PModel, 1.0)).xyz;
     vec3 PView = (uCamera.viewMatrix * vec4(PWorld, 1.0)).xyz;
     vec3 NModel = evalGradient(PModel);
 
     outData1 = vec4(PModel, 1.0);
-#if defined(SHOW_NORMAL_VECTOR) || defined(SHOW_NORMAL_MAGNITUDE)
-    vec3 outData2Normal = normalize(NModel);
-#if defined(INWARD_NORMALS)
-    outData2Normal *= inside ? -1.0 : 1.0;
-#endif // INWARD_NORMALS
-    outData2 = vec4(outData2Normal, length(NModel));
-#endif // SHOW_NORMAL_VECTOR || SHOW_NORMAL_MAGNITUDE
+    if (kSurfaceColorMode == kUnitNormal ||
+        kSurfaceColorMode == kNormalMagnitude)
+    {
+      vec3 outData2Normal = normalize(NModel);
+      if (kInwardNormals)
+      {
+        outData2Normal *= inside ? -1.0 : 1.0;
+      }
+      outData2 = vec4(outData2Normal, length(NModel));
+    }
 
     srcColor = shade(PView, PModel, NModel, inside);
 
-#if defined(USE_FOG)
-    float worldRadius = kBoundRadius * uCamera.maxModelScale;
-    float distToCenter = length(uCamera.eye);
-    float fogMinDist = distToCenter - worldRadius;
-    float fogMaxDist = distToCenter + worldRadius * 3.0;
-    float d = length(PWorld - uCamera.eye);
-    float t = clamp((d - fogMinDist) / (fogMaxDist - fogMinDist), 0.0, 1.0);
-
-    srcColor.a = 1.0 - t * t; // Quadratic falloff
-#endif // USE_FOG
+    if (kUseFog)
+    {
+      float worldRadius = kBoundRadius * uCamera.maxModelScale;
+      float distToCenter = length(uCamera.eye);
+      float fogMinDist = distToCenter - worldRadius;
+      float fogMaxDist = distToCenter + worldRadius * 3.0;
+      float d = length(PWorld - uCamera.eye);
+      float t = clamp((d - fogMinDist) / (fogMaxDist - fogMinDist), 0.0, 1.0);
+
+      srcColor.a = 1.0 - t * t; // Quadratic falloff
+    }
     dstColor.a = 0.0;
 
     vec4 PClip = uCamera.projMatrix * vec4(PView, 1.0);
     float depthNDC = PClip.z / PClip.w;
-#if defined(SHOW_AXES)
     gl_FragDepth = min(dstDepth, (depthNDC + 1.0) * 0.5);
-#else // SHOW_AXES
-    gl_FragDepth = (depthNDC + 1.0) * 0.5;
-#endif // SHOW_AXES
   }
   else
   {
-#if defined(SHOW_AXES)
+    // Direct volume rendering
+    srcColor = dvrMarch(rayModel, tStart, tEnd);
     gl_FragDepth = dstDepth;
-#else // SHOW_AXES
-    gl_FragDepth = 1.0;
-#endif // SHOW_AXES
-    return dstColor;
   }
-#else
-  // Direct volume rendering
-  srcColor = dvrMarch(rayModel, tStart, tEnd);
-#if defined(SHOW_AXES)
-    gl_FragDepth = dstDepth;
-#else // SHOW_AXES
-    gl_FragDepth = 1.0;
-#endif // SHOW_AXES
-#endif // SHOW_ISOSURFACE
 
   // Blend using premultiplied alpha
   float oneMinusSrcA = 1.0 - srcColor.a;
@@ -1318,13 +2537,67 @@ vec4 rayMarchMSAA()
   return accumColor / float(sampleCount);
 }
 
+/*
+ * Depth prepass.
+ *
+ * Marches the ray through the lower-left corner of the tile of
+ * uPrepassTileSize pixels of the fragment, and returns its surface hit
+ * parameter in x and a hit flag in w.
+ */
+vec4 prepassMarch()
+{
+  vec2 cornerCoord = floor(gl_FragCoord.xy) * float(uPrepassTileSize);
+  Ray rayModel = generateRay(cornerCoord / vec2(uRenderSize) * 2.0 - 1.0);
+
+  float tStart, tEnd;
+  bool hitBounds = kUseBoundingBox ? intersectAABB(rayModel, tStart, tEnd)
+                                   : intersectSphere(rayModel, tStart, tEnd);
+  float tHit;
+  bool inside;
+  if (!hitBounds || !isosurfaceMarch(rayModel, tStart, tEnd, tHit, inside))
+  {
+    return vec4(0.0);
+  }
+
+  return vec4(tHit, 0.0, 0.0, 1.0);
+}
+
 void main()
 {
   outData1 = vec4(0.0);
   outData2 = vec4(0.0);
+  if (uRenderPrepass)
+  {
+    outColor = prepassMarch();
+    gl_FragDepth = 1.0;
+    return;
+  }
+  if (uRenderBrickMap)
+  {
+    ivec3 brick = ivec3(ivec2(gl_FragCoord.xy), uRenderLayer);
+    outColor = vec4(evalBrickRange(brick), 0.0, 0.0);
+    gl_FragDepth = 1.0;
+    return;
+  }
+  if (uRenderFieldTexture)
+  {
+    vec3 texel = vec3(ivec2(gl_FragCoord.xy), uRenderLayer);
+    float spacing = 2.0 * kBoundRadius / float(uFieldTextureSize - 1);
+    float value = evalFunction(kBoundsMin + texel * spacing) + uIsoValue;
+    outColor = vec4(clamp(value, -kMaxFieldValue, kMaxFieldValue));
+    gl_FragDepth = 1.0;
+    return;
+  }
 #if defined(MSAA_ENABLED)
   outColor = rayMarchMSAA();
 #else // MSAA_ENABLED
   outColor = rayMarch(generatePrimaryRay(vec2(0)));
 #endif // MSAA_ENABLED
+
+  // Tint by the fraction of the bricks checked by the rays that were skipped
+  if (uShowSkippedBricks && gCheckedBricks > 0)
+  {
+    float skipped = float(gSkippedBricks) / float(gCheckedBricks);
+    outColor = mix(outColor, vec4(0.0, 0.8, 0.2, 1.0), 0.6 * skipped);
+  }
 }
\ No newline at end of file
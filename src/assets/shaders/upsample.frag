@@ -0,0 +1,63 @@
+#version 300 es
+
+/**
+ * @file upsample.frag
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+precision highp float;
+
+in vec2 fragTexCoord;
+
+out vec4 outColor;
+
+uniform sampler2D uColorTexture;
+// Surface positions (xyz) and hit flags (w) of raycast.frag
+uniform sampler2D uPositionTexture;
+uniform vec4 uTintColor;
+uniform vec2 uTexCoordScale;
+uniform float uPositionTolerance;
+
+// Upsamples the lower-left region of the color texture. The bilinear weight
+// of each of the four texels around the fragment is scaled by how close its
+// surface position is to the one of the nearest texel, so that colors are not
+// blended across silhouettes and depth discontinuities.
+void main() {
+  vec2 size = vec2(textureSize(uColorTexture, 0));
+  ivec2 maxTexel = ivec2(ceil(uTexCoordScale * size)) - 1;
+  vec2 texelCoord = fragTexCoord * uTexCoordScale * size - 0.5;
+  ivec2 baseTexel = ivec2(floor(texelCoord));
+  vec2 fraction = texelCoord - vec2(baseTexel);
+
+  ivec2 nearestTexel =
+      clamp(ivec2(floor(texelCoord + 0.5)), ivec2(0), maxTexel);
+  vec4 reference = texelFetch(uPositionTexture, nearestTexel, 0);
+
+  vec4 color = vec4(0.0);
+  float weightSum = 0.0;
+  for (int index = 0; index < 4; ++index) {
+    ivec2 offset = ivec2(index & 1, index >> 1);
+    ivec2 texel = clamp(baseTexel + offset, ivec2(0), maxTexel);
+    vec4 position = texelFetch(uPositionTexture, texel, 0);
+
+    vec2 bilinear = mix(1.0 - fraction, fraction, vec2(offset));
+    float weight = bilinear.x * bilinear.y;
+    if ((position.w > 0.5) != (reference.w > 0.5)) {
+      weight = 0.0;
+    } else if (reference.w > 0.5) {
+      vec3 delta = (position.xyz - reference.xyz) / uPositionTolerance;
+      weight *= exp(-dot(delta, delta));
+    }
+
+    color += texelFetch(uColorTexture, texel, 0) * weight;
+    weightSum += weight;
+  }
+
+  // The nearest texel has a bilinear weight of at least 1/4 and a similarity
+  // of 1, so the sum is never zero
+  outColor = color / weightSum * uTintColor;
+}
\ No newline at end of file
@@ -9,11 +9,11 @@
 
 #include "axes.hpp"
 
+#include "shadertemplate.hpp"
+
 #include <abcgOpenGL.hpp>
 #include <abcgOpenGLError.hpp>
 
-#include <fstream>
-
 namespace {
 
 constexpr std::array<glm::vec3, 3> kInstanceColors{
@@ -25,28 +25,8 @@ constexpr std::array<glm::vec3, 3> kInstanceColors{
 } // namespace
 
 void Axes::onCreate() {
-  auto const readFile{[](std::filesystem::path const &path) -> std::string {
-    auto const utf8Path{abcg::pathToUtf8(path)};
-    std::stringstream source;
-    if (std::ifstream stream(utf8Path); stream) {
-      source << stream.rdbuf();
-      stream.close();
-    } else {
-      throw abcg::RuntimeError(
-          std::format("Failed to read shader file {}", utf8Path));
-    }
-    return source.str();
-  }};
-
-  auto const &assetsPath{abcg::Application::getAssetsPath()};
-
-  std::vector<abcg::ShaderSource> const sources{
-      {.source =
-           readFile(assetsPath / std::filesystem::path{kVertexShaderPath}),
-       .stage = abcg::ShaderStage::Vertex},
-      {.source =
-           readFile(assetsPath / std::filesystem::path{kFragmentShaderPath}),
-       .stage = abcg::ShaderStage::Fragment}};
+  auto const sources{
+      loadProgramSources(kVertexShaderPath, kFragmentShaderPath)};
 
   m_program = abcg::createOpenGLProgram(sources);
 
@@ -139,6 +119,7 @@ void Axes::onCreate() {
   m_zAxisTip = glm::vec3(0, 0, coneEnd) + glm::vec3(0, 0, 0.075f);
 
   // Texture generated with https://evanw.github.io/font-texture-generator/
+  auto const &assetsPath{abcg::Application::getAssetsPath()};
   auto const path{assetsPath / std::filesystem::path{kGlyphsTexturePath}};
   m_glyphsTexture = abcg::loadOpenGLTexture(
       {.path = path, .generateMipmaps = false, .flipUpsideDown = false});
@@ -169,13 +150,8 @@ void Axes::onCreate() {
   createBillboards();
 
   // Create billboard shader program
-  std::vector<abcg::ShaderSource> const billboardSources{
-      {.source =
-           readFile(assetsPath / std::filesystem::path{kGlyphVertexShaderPath}),
-       .stage = abcg::ShaderStage::Vertex},
-      {.source = readFile(assetsPath /
-                          std::filesystem::path{kGlyphFragmentShaderPath}),
-       .stage = abcg::ShaderStage::Fragment}};
+  auto const billboardSources{
+      loadProgramSources(kGlyphVertexShaderPath, kGlyphFragmentShaderPath)};
 
   m_glyphProgram = abcg::createOpenGLProgram(billboardSources);
 
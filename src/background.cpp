@@ -9,17 +9,13 @@
 
 #include "background.hpp"
 
+#include "shadertemplate.hpp"
+
 void Background::onCreate() {
   abcg::glGenFramebuffers(1, &m_FBO);
 
-  auto const &assetsPath{abcg::Application::getAssetsPath()};
-  std::vector<abcg::ShaderSource> const sources{
-      {.source = abcg::pathToUtf8(assetsPath /
-                                  std::filesystem::path{kVertexShaderPath}),
-       .stage = abcg::ShaderStage::Vertex},
-      {.source = abcg::pathToUtf8(assetsPath /
-                                  std::filesystem::path{kFragmentShaderPath}),
-       .stage = abcg::ShaderStage::Fragment}};
+  auto const sources{
+      loadProgramSources(kVertexShaderPath, kFragmentShaderPath)};
 
   m_program = abcg::createOpenGLProgram(sources);
 
@@ -0,0 +1,49 @@
+/**
+ * @file colormaptexture.cpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#include "colormaptexture.hpp"
+
+#include <abcgOpenGL.hpp>
+
+void ColormapTexture::update(std::vector<glm::vec4> const &colors) {
+  if (m_texture != 0 && colors == m_colors) {
+    return;
+  }
+
+  if (colors.empty()) {
+    throw abcg::RuntimeError("Colormap must have at least one color");
+  }
+
+  if (m_texture == 0) {
+    abcg::glGenTextures(1, &m_texture);
+    abcg::glBindTexture(GL_TEXTURE_2D, m_texture);
+    abcg::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    abcg::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    abcg::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    abcg::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  } else {
+    abcg::glBindTexture(GL_TEXTURE_2D, m_texture);
+  }
+
+  // RGBA16F is the most precise filterable float format in OpenGL ES 3.0
+  abcg::glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F,
+                     gsl::narrow<GLsizei>(colors.size()), 1, 0, GL_RGBA,
+                     GL_FLOAT, &colors.front()[0]);
+  abcg::glBindTexture(GL_TEXTURE_2D, 0);
+
+  m_colors = colors;
+}
+
+void ColormapTexture::destroy() {
+  if (m_texture != 0) {
+    abcg::glDeleteTextures(1, &m_texture);
+    m_texture = 0;
+  }
+  m_colors.clear();
+}
@@ -0,0 +1,45 @@
+/**
+ * @file colormaptexture.hpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#ifndef COLORMAPTEXTURE_HPP_
+#define COLORMAPTEXTURE_HPP_
+
+#include <abcgOpenGLExternal.hpp>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Texture with the color stops of a colormap, one stop per texel.
+//
+// OpenGL ES has no 1D textures, so the stops are stored in a single-row 2D
+// texture. Linear filtering interpolates between adjacent stops, provided that
+// the lookup coordinate is mapped to the range between the first and last texel
+// centers.
+class ColormapTexture {
+public:
+  ColormapTexture() = default;
+  ~ColormapTexture() { destroy(); }
+
+  ColormapTexture(ColormapTexture const &) = delete;
+  ColormapTexture &operator=(ColormapTexture const &) = delete;
+  ColormapTexture(ColormapTexture &&) = delete;
+  ColormapTexture &operator=(ColormapTexture &&) = delete;
+
+  // Uploads the colors, unless they are the same as the last ones uploaded.
+  void update(std::vector<glm::vec4> const &colors);
+  void destroy();
+
+  [[nodiscard]] GLuint getTexture() const noexcept { return m_texture; }
+
+private:
+  GLuint m_texture{};
+  std::vector<glm::vec4> m_colors;
+};
+
+#endif
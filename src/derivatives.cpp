@@ -0,0 +1,965 @@
+/**
+ * @file derivatives.cpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#include "derivatives.hpp"
+
+#include "util.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <numbers>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using NodeKind = Expression::NodeKind;
+
+// Thrown when the expression cannot be differentiated
+class NotDifferentiable : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+constexpr std::array<std::string_view, 3> kCoordinates{"x", "y", "z"};
+
+struct Signature {
+  std::string_view name;
+  std::size_t numArguments{};
+};
+
+// Functions whose derivatives are known
+constexpr std::array kDifferentiableFunctions{
+    Signature{"sin", 1},   Signature{"cos", 1},   Signature{"tan", 1},
+    Signature{"asin", 1},  Signature{"acos", 1},  Signature{"atan", 1},
+    Signature{"atan", 2},  Signature{"sinh", 1},  Signature{"cosh", 1},
+    Signature{"tanh", 1},  Signature{"asinh", 1}, Signature{"acosh", 1},
+    Signature{"atanh", 1}, Signature{"exp", 1},   Signature{"exp2", 1},
+    Signature{"log", 1},   Signature{"log2", 1},  Signature{"abs", 1},
+    Signature{"sign", 1},  Signature{"floor", 1}, Signature{"ceil", 1},
+    Signature{"round", 1}, Signature{"trunc", 1}, Signature{"fract", 1},
+    Signature{"mod", 2},   Signature{"min", 2},   Signature{"max", 2},
+    Signature{"step", 2},  Signature{"mix", 3}};
+
+// Piecewise constant functions, whose derivatives are zero where defined
+constexpr std::array<std::string_view, 6> kPiecewiseConstantFunctions{
+    "sign", "floor", "ceil", "round", "trunc", "step"};
+
+bool isInteger(double value) { return value == std::trunc(value); }
+
+// Returns true if a power with the given exponent is written as a division
+bool isDenominator(std::optional<double> exponent) {
+  return exponent && *exponent < 0.0 && *exponent != -0.5;
+}
+
+// Directed acyclic graph of the terms of an expression and its derivatives.
+//
+// Terms are hash-consed, so equal terms are the same node. Sums and products
+// are n-ary and flat: their constant term or coefficient is kept apart from
+// the remaining operands, which are sorted by node. Since operands are always
+// created before the terms that use them, node order is a topological order.
+class TermGraph {
+public:
+  using Id = std::uint32_t;
+
+  static constexpr Id kNone{std::numeric_limits<Id>::max()};
+
+  // Upper bound of the number of terms plus the number of operands
+  static constexpr std::size_t kMaxSize{std::size_t{1} << 20};
+
+  enum class Kind : std::uint8_t {
+    Constant,
+    Variable, // Coordinate x, y or z
+    Symbol,   // Parameter or any other name that is not a coordinate
+    Sum,      // Value is the constant term
+    Product,  // Value is the coefficient
+    Power,    // Base and exponent
+    Call      // Operands are the arguments
+  };
+
+  struct Term {
+    Kind kind{};
+    double value{};
+    std::string_view name; // Variables, symbols and calls
+    std::uint32_t firstOperand{};
+    std::uint32_t numOperands{};
+  };
+
+  [[nodiscard]] std::size_t size() const noexcept { return m_terms.size(); }
+  [[nodiscard]] Term const &get(Id id) const { return m_terms.at(id); }
+  [[nodiscard]] std::span<Id const> getOperands(Term const &term) const {
+    return std::span{m_operands}.subspan(term.firstOperand, term.numOperands);
+  }
+  [[nodiscard]] bool isConstant(Id id, double value) const {
+    auto const &term{get(id)};
+    return term.kind == Kind::Constant && term.value == value;
+  }
+
+  Id constant(double value) { return intern(Kind::Constant, value, {}, {}); }
+  Id variable(std::string_view name) {
+    return intern(Kind::Variable, 0.0, name, {});
+  }
+  Id symbol(std::string_view name) {
+    return intern(Kind::Symbol, 0.0, name, {});
+  }
+  Id call(std::string_view name, std::vector<Id> const &arguments) {
+    return intern(Kind::Call, 0.0, name, arguments);
+  }
+  Id sum(std::vector<Id> const &terms);
+  Id product(std::vector<Id> const &factors);
+  Id power(Id base, Id exponent);
+
+  Id negate(Id id) { return product({constant(-1.0), id}); }
+  Id subtract(Id lhs, Id rhs) { return sum({lhs, negate(rhs)}); }
+  Id multiply(Id lhs, Id rhs) { return product({lhs, rhs}); }
+  Id reciprocal(Id id) { return power(id, constant(-1.0)); }
+  Id square(Id id) { return power(id, constant(2.0)); }
+
+  // Converts the nodes of a valid expression and returns the root term
+  Id convert(Expression const &expression);
+
+  // Returns the partial derivative of a term with respect to the coordinate
+  // of the given index
+  Id derivative(Id id, std::size_t axis);
+
+private:
+  Id intern(Kind kind, double value, std::string_view name,
+            std::span<Id const> operands);
+  std::vector<Id> copyOperands(Id id) const {
+    auto const operands{getOperands(get(id))};
+    return {operands.begin(), operands.end()};
+  }
+  std::pair<Id, double> splitCoefficient(Id id);
+  std::pair<Id, double> splitExponent(Id id) const;
+
+  Id convertCall(std::string_view name, std::vector<Id> const &arguments);
+  Id computeDerivative(Id id, std::size_t axis);
+  Id differentiateCall(Id id, std::size_t axis);
+
+  std::vector<Term> m_terms;
+  std::vector<Id> m_operands;
+  std::unordered_map<std::string, Id> m_ids;
+  std::string m_key;
+  std::array<std::vector<Id>, kCoordinates.size()> m_derivatives;
+};
+
+TermGraph::Id TermGraph::intern(Kind kind, double value, std::string_view name,
+                                std::span<Id const> operands) {
+  // -0.0 and 0.0 are the same constant
+  if (value == 0.0) {
+    value = 0.0;
+  }
+
+  m_key.clear();
+  m_key += static_cast<char>(kind);
+  auto const valueBytes{std::bit_cast<std::array<char, sizeof value>>(value)};
+  m_key.append(valueBytes.begin(), valueBytes.end());
+  m_key += name;
+  m_key += '\0';
+  for (auto const operand : operands) {
+    auto const bytes{std::bit_cast<std::array<char, sizeof operand>>(operand)};
+    m_key.append(bytes.begin(), bytes.end());
+  }
+
+  auto const [itr, inserted]{
+      m_ids.try_emplace(m_key, static_cast<Id>(m_terms.size()))};
+  if (!inserted) {
+    return itr->second;
+  }
+  if (m_terms.size() + m_operands.size() >= kMaxSize) {
+    throw NotDifferentiable("Derivatives are too large");
+  }
+
+  m_terms.push_back({.kind = kind,
+                     .value = value,
+                     .name = name,
+                     .firstOperand = static_cast<std::uint32_t>(
+                         m_operands.size()),
+                     .numOperands = static_cast<std::uint32_t>(
+                         operands.size())});
+  m_operands.insert(m_operands.end(), operands.begin(), operands.end());
+  return itr->second;
+}
+
+// Returns a term without its coefficient, and the coefficient
+std::pair<TermGraph::Id, double> TermGraph::splitCoefficient(Id id) {
+  auto const term{get(id)};
+  if (term.kind != Kind::Product || term.value == 1.0) {
+    return {id, 1.0};
+  }
+  auto const factors{copyOperands(id)};
+  if (factors.size() == 1) {
+    return {factors.front(), term.value};
+  }
+  return {intern(Kind::Product, 1.0, {}, factors), term.value};
+}
+
+// Returns the base of a power with a constant exponent, and the exponent
+std::pair<TermGraph::Id, double> TermGraph::splitExponent(Id id) const {
+  auto const &term{get(id)};
+  if (term.kind == Kind::Power) {
+    auto const operands{getOperands(term)};
+    auto const &exponent{get(operands[1])};
+    if (exponent.kind == Kind::Constant) {
+      return {operands[0], exponent.value};
+    }
+  }
+  return {id, 1.0};
+}
+
+TermGraph::Id TermGraph::sum(std::vector<Id> const &terms) {
+  auto constantTerm{0.0};
+  std::vector<std::pair<Id, double>> scaledTerms;
+  for (auto const id : terms) {
+    auto const term{get(id)};
+    if (term.kind == Kind::Constant) {
+      constantTerm += term.value;
+    } else if (term.kind == Kind::Sum) {
+      constantTerm += term.value;
+      for (auto const operand : copyOperands(id)) {
+        scaledTerms.push_back(splitCoefficient(operand));
+      }
+    } else {
+      scaledTerms.push_back(splitCoefficient(id));
+    }
+  }
+
+  // Combine like terms
+  std::ranges::sort(scaledTerms, {}, &std::pair<Id, double>::first);
+  std::vector<Id> result;
+  auto hasNestedSum{false};
+  for (std::size_t index{}; index < scaledTerms.size();) {
+    auto const id{scaledTerms[index].first};
+    auto coefficient{0.0};
+    for (; index < scaledTerms.size() && scaledTerms[index].first == id;
+         ++index) {
+      coefficient += scaledTerms[index].second;
+    }
+    if (coefficient == 0.0) {
+      continue;
+    }
+    if (coefficient == 1.0) {
+      hasNestedSum = hasNestedSum || get(id).kind == Kind::Sum;
+      result.push_back(id);
+    } else {
+      result.push_back(product({constant(coefficient), id}));
+    }
+  }
+
+  if (hasNestedSum) {
+    // A scaled sum whose coefficients added up to one
+    result.push_back(constant(constantTerm));
+    return sum(result);
+  }
+  if (result.empty()) {
+    return constant(constantTerm);
+  }
+  if (result.size() == 1 && constantTerm == 0.0) {
+    return result.front();
+  }
+  return intern(Kind::Sum, constantTerm, {}, result);
+}
+
+TermGraph::Id TermGraph::product(std::vector<Id> const &factors) {
+  auto coefficient{1.0};
+  std::vector<std::pair<Id, double>> powers;
+  for (auto const id : factors) {
+    auto const term{get(id)};
+    if (term.kind == Kind::Constant) {
+      coefficient *= term.value;
+    } else if (term.kind == Kind::Product) {
+      coefficient *= term.value;
+      for (auto const operand : copyOperands(id)) {
+        powers.push_back(splitExponent(operand));
+      }
+    } else {
+      powers.push_back(splitExponent(id));
+    }
+  }
+  if (coefficient == 0.0) {
+    return constant(0.0);
+  }
+
+  // Combine powers of the same base
+  std::ranges::sort(powers, {}, &std::pair<Id, double>::first);
+  std::vector<Id> result;
+  auto hasNestedProduct{false};
+  for (std::size_t index{}; index < powers.size();) {
+    auto const base{powers[index].first};
+    auto exponent{0.0};
+    for (; index < powers.size() && powers[index].first == base; ++index) {
+      exponent += powers[index].second;
+    }
+    if (exponent == 0.0) {
+      continue;
+    }
+    auto const factor{power(base, constant(exponent))};
+    auto const &factorTerm{get(factor)};
+    if (factorTerm.kind == Kind::Constant) {
+      coefficient *= factorTerm.value;
+    } else {
+      hasNestedProduct = hasNestedProduct || factorTerm.kind == Kind::Product;
+      result.push_back(factor);
+    }
+  }
+
+  if (hasNestedProduct) {
+    // A power of a product whose exponents added up to one
+    result.push_back(constant(coefficient));
+    return product(result);
+  }
+  if (result.empty()) {
+    return constant(coefficient);
+  }
+  if (result.size() == 1 && coefficient == 1.0) {
+    return result.front();
+  }
+  std::ranges::sort(result);
+  return intern(Kind::Product, coefficient, {}, result);
+}
+
+TermGraph::Id TermGraph::power(Id base, Id exponent) {
+  auto const baseTerm{get(base)};
+  auto const exponentTerm{get(exponent)};
+  if (baseTerm.kind == Kind::Constant && baseTerm.value == 1.0) {
+    return base;
+  }
+  if (exponentTerm.kind == Kind::Constant) {
+    auto const value{exponentTerm.value};
+    if (value == 0.0) {
+      return constant(1.0);
+    }
+    if (value == 1.0) {
+      return base;
+    }
+    if (baseTerm.kind == Kind::Constant) {
+      if (auto const result{std::pow(baseTerm.value, value)};
+          std::isfinite(result)) {
+        return constant(result);
+      }
+    }
+    if (isInteger(value)) {
+      // (b^e)^n = b^(e*n)
+      if (auto const [innerBase, innerExponent]{splitExponent(base)};
+          innerBase != base) {
+        return power(innerBase, constant(innerExponent * value));
+      }
+      // (c*b)^n = c^n*b^n
+      if (auto const [rest, coefficient]{splitCoefficient(base)};
+          rest != base) {
+        return product(
+            {constant(std::pow(coefficient, value)), power(rest, exponent)});
+      }
+    }
+  }
+  return intern(Kind::Power, 0.0, {}, std::array{base, exponent});
+}
+
+TermGraph::Id TermGraph::convert(Expression const &expression) {
+  auto const nodes{expression.getNodes()};
+  std::vector<Id> ids(nodes.size(), kNone);
+  for (std::size_t index{}; index < nodes.size(); ++index) {
+    auto const &node{nodes[index]};
+    std::vector<Id> operands;
+    for (auto const &operand : expression.getOperands(node)) {
+      auto const id{ids[operand.node]};
+      if (operand.op == '-') {
+        operands.push_back(negate(id));
+      } else if (operand.op == '/') {
+        operands.push_back(reciprocal(id));
+      } else {
+        operands.push_back(id);
+      }
+    }
+
+    auto const text{expression.getText(node)};
+    switch (node.kind) {
+    case NodeKind::Number:
+      ids[index] = constant(node.value);
+      break;
+    case NodeKind::Identifier:
+      ids[index] = std::ranges::find(kCoordinates, text) != kCoordinates.end()
+                       ? variable(text)
+                       : symbol(text);
+      break;
+    case NodeKind::Call:
+      ids[index] = convertCall(text, operands);
+      break;
+    case NodeKind::Group:
+    case NodeKind::Identity:
+      ids[index] = operands.front();
+      break;
+    case NodeKind::Negate:
+      ids[index] = negate(operands.front());
+      break;
+    case NodeKind::Sum:
+      ids[index] = sum(operands);
+      break;
+    case NodeKind::Product:
+      ids[index] = product(operands);
+      break;
+    case NodeKind::Power:
+      ids[index] = power(operands[0], operands[1]);
+      break;
+    }
+  }
+  return ids.back();
+}
+
+// Converts a call, rewriting functions that can be expressed by others
+TermGraph::Id TermGraph::convertCall(std::string_view name,
+                                     std::vector<Id> const &arguments) {
+  auto const numArguments{arguments.size()};
+  if (numArguments == 1) {
+    if (name == "sqrt") {
+      return power(arguments[0], constant(0.5));
+    }
+    if (name == "inversesqrt") {
+      return power(arguments[0], constant(-0.5));
+    }
+    if (name == "radians") {
+      return multiply(arguments[0], constant(std::numbers::pi / 180.0));
+    }
+    if (name == "degrees") {
+      return multiply(arguments[0], constant(180.0 / std::numbers::pi));
+    }
+  }
+  if (numArguments == 2 && name == "pow") {
+    return power(arguments[0], arguments[1]);
+  }
+  if (numArguments == 3 && name == "clamp") {
+    return call("min", {call("max", {arguments[0], arguments[1]}),
+                        arguments[2]});
+  }
+  if (numArguments == 3 && name == "smoothstep") {
+    // t^2*(3-2t), with t = clamp((x-e0)/(e1-e0), 0, 1)
+    auto const ratio{
+        product({subtract(arguments[2], arguments[0]),
+                 reciprocal(subtract(arguments[1], arguments[0]))})};
+    auto const t{
+        call("min", {call("max", {ratio, constant(0.0)}), constant(1.0)})};
+    return product(
+        {square(t), sum({constant(3.0), multiply(constant(-2.0), t)})});
+  }
+
+  if (std::ranges::none_of(kDifferentiableFunctions, [&](auto const &function) {
+        return function.name == name && function.numArguments == numArguments;
+      })) {
+    throw NotDifferentiable(std::format("Unknown derivative of {}", name));
+  }
+  return call(name, arguments);
+}
+
+TermGraph::Id TermGraph::derivative(Id id, std::size_t axis) {
+  auto &derivatives{m_derivatives.at(axis)};
+  if (id < derivatives.size() && derivatives[id] != kNone) {
+    return derivatives[id];
+  }
+  auto const result{computeDerivative(id, axis)};
+  if (id >= derivatives.size()) {
+    derivatives.resize(m_terms.size(), kNone);
+  }
+  derivatives[id] = result;
+  return result;
+}
+
+TermGraph::Id TermGraph::computeDerivative(Id id, std::size_t axis) {
+  auto const term{get(id)};
+  auto const operands{copyOperands(id)};
+  switch (term.kind) {
+  case Kind::Constant:
+  case Kind::Symbol:
+    return constant(0.0);
+  case Kind::Variable:
+    return constant(term.name == kCoordinates.at(axis) ? 1.0 : 0.0);
+  case Kind::Sum: {
+    std::vector<Id> terms;
+    for (auto const operand : operands) {
+      terms.push_back(derivative(operand, axis));
+    }
+    return sum(terms);
+  }
+  case Kind::Product: {
+    // Product rule
+    std::vector<Id> terms;
+    for (std::size_t index{}; index < operands.size(); ++index) {
+      auto const factorDerivative{derivative(operands[index], axis)};
+      if (isConstant(factorDerivative, 0.0)) {
+        continue;
+      }
+      auto factors{operands};
+      factors[index] = factorDerivative;
+      factors.push_back(constant(term.value));
+      terms.push_back(product(factors));
+    }
+    return sum(terms);
+  }
+  case Kind::Power: {
+    auto const base{operands[0]};
+    auto const exponent{operands[1]};
+    auto const baseDerivative{derivative(base, axis)};
+    auto const exponentDerivative{derivative(exponent, axis)};
+    if (isConstant(exponentDerivative, 0.0)) {
+      // (b^e)' = e*b^(e-1)*b'
+      return product({exponent, power(base, sum({exponent, constant(-1.0)})),
+                      baseDerivative});
+    }
+    // (b^e)' = b^e*(e'*log(b)+e*b'/b)
+    return product(
+        {id, sum({multiply(exponentDerivative, call("log", {base})),
+                  product({exponent, baseDerivative, reciprocal(base)})})});
+  }
+  case Kind::Call:
+    return differentiateCall(id, axis);
+  }
+  return constant(0.0);
+}
+
+TermGraph::Id TermGraph::differentiateCall(Id id, std::size_t axis) {
+  auto const name{get(id).name};
+  auto const arguments{copyOperands(id)};
+  std::vector<Id> derivatives;
+  for (auto const argument : arguments) {
+    derivatives.push_back(derivative(argument, axis));
+  }
+  if (std::ranges::all_of(derivatives, [this](Id derivative) {
+        return isConstant(derivative, 0.0);
+      }) ||
+      std::ranges::find(kPiecewiseConstantFunctions, name) !=
+          kPiecewiseConstantFunctions.end()) {
+    return constant(0.0);
+  }
+
+  auto const a{arguments[0]};
+  auto const da{derivatives[0]};
+
+  // Two-argument functions: (a, b)
+  if (name == "atan" && arguments.size() == 2) {
+    // atan(y, x)' = (x*y' - y*x')/(x^2 + y^2)
+    auto const b{arguments[1]};
+    auto const db{derivatives[1]};
+    return product({subtract(multiply(b, da), multiply(a, db)),
+                    reciprocal(sum({square(a), square(b)}))});
+  }
+  if (name == "mod") {
+    // mod(a, b) = a - b*floor(a/b)
+    auto const quotient{product({a, reciprocal(arguments[1])})};
+    return subtract(da, multiply(call("floor", {quotient}), derivatives[1]));
+  }
+  auto const select{[this](Id lhs, Id rhs, Id condition) {
+    return lhs == rhs ? lhs : call("mix", {lhs, rhs, condition});
+  }};
+  if (name == "min" || name == "max") {
+    // step(a, b) is 1 where a <= b
+    auto const aIsLeast{call("step", {a, arguments[1]})};
+    return name == "min" ? select(derivatives[1], da, aIsLeast)
+                         : select(da, derivatives[1], aIsLeast);
+  }
+  if (name == "mix") {
+    // mix(a, b, t)' = mix(a', b', t) + (b - a)*t'
+    auto const t{arguments[2]};
+    return sum({select(da, derivatives[1], t),
+                multiply(subtract(arguments[1], a), derivatives[2])});
+  }
+
+  // One-argument functions: f(a)' = f'(a)*a'
+  auto const chain{[&](Id outerDerivative) {
+    return multiply(outerDerivative, da);
+  }};
+  auto const one{constant(1.0)};
+  if (name == "sin") {
+    return chain(call("cos", {a}));
+  }
+  if (name == "cos") {
+    return chain(negate(call("sin", {a})));
+  }
+  if (name == "tan") {
+    return chain(sum({one, square(id)}));
+  }
+  if (name == "asin") {
+    return chain(power(subtract(one, square(a)), constant(-0.5)));
+  }
+  if (name == "acos") {
+    return chain(negate(power(subtract(one, square(a)), constant(-0.5))));
+  }
+  if (name == "atan") {
+    return chain(reciprocal(sum({one, square(a)})));
+  }
+  if (name == "sinh") {
+    return chain(call("cosh", {a}));
+  }
+  if (name == "cosh") {
+    return chain(call("sinh", {a}));
+  }
+  if (name == "tanh") {
+    return chain(subtract(one, square(id)));
+  }
+  if (name == "asinh") {
+    return chain(power(sum({square(a), one}), constant(-0.5)));
+  }
+  if (name == "acosh") {
+    return chain(power(subtract(square(a), one), constant(-0.5)));
+  }
+  if (name == "atanh") {
+    return chain(reciprocal(subtract(one, square(a))));
+  }
+  if (name == "exp") {
+    return chain(id);
+  }
+  if (name == "exp2") {
+    return chain(multiply(id, constant(std::numbers::ln2)));
+  }
+  if (name == "log") {
+    return chain(reciprocal(a));
+  }
+  if (name == "log2") {
+    return chain(multiply(reciprocal(a), constant(1.0 / std::numbers::ln2)));
+  }
+  if (name == "abs") {
+    return chain(call("sign", {a}));
+  }
+  if (name == "fract") {
+    return da;
+  }
+  throw NotDifferentiable(std::format("Unknown derivative of {}", name));
+}
+
+// Writes the GLSL statements that compute and return a set of terms
+class GLSLWriter {
+public:
+  using Id = TermGraph::Id;
+  using Kind = TermGraph::Kind;
+
+  GLSLWriter(TermGraph const &graph, std::span<Id const> roots,
+             std::string_view temporaryPrefix);
+
+  std::string write(std::string_view type);
+
+private:
+  enum class Precedence : std::uint8_t { Sum, Product, Primary };
+
+  static constexpr std::uint32_t kNoTemporary{
+      std::numeric_limits<std::uint32_t>::max()};
+
+  [[nodiscard]] bool isWorthHoisting(Id id) const;
+  [[nodiscard]] std::uint32_t getTemporary(Id id) const {
+    return id == m_definedTerm ? kNoTemporary : m_temporaries[id];
+  }
+  [[nodiscard]] std::optional<double> getConstantExponent(Id id) const;
+  [[nodiscard]] Precedence getPrecedence(Id id) const;
+
+  void emit(Id id, Precedence required);
+  void emitTerm(Id id);
+  void emitSum(TermGraph::Term const &term);
+  void emitProduct(TermGraph::Term const &term, double coefficient);
+  void emitPower(Id base, double exponent);
+
+  TermGraph const &m_graph;
+  std::span<Id const> m_roots;
+  std::string_view m_temporaryPrefix;
+  std::vector<std::uint32_t> m_temporaries;
+  Id m_definedTerm{TermGraph::kNone};
+  std::string m_result;
+};
+
+GLSLWriter::GLSLWriter(TermGraph const &graph, std::span<Id const> roots,
+                       std::string_view temporaryPrefix)
+    : m_graph{graph}, m_roots{roots}, m_temporaryPrefix{temporaryPrefix},
+      m_temporaries(graph.size(), kNoTemporary) {
+  // Count the uses of each term reachable from the roots
+  std::vector<std::uint32_t> numUses(graph.size());
+  std::vector<bool> visited(graph.size());
+  std::vector<Id> stack{roots.begin(), roots.end()};
+  for (auto const root : roots) {
+    ++numUses[root];
+  }
+  while (!stack.empty()) {
+    auto const id{stack.back()};
+    stack.pop_back();
+    if (visited[id]) {
+      continue;
+    }
+    visited[id] = true;
+    for (auto const operand : graph.getOperands(graph.get(id))) {
+      ++numUses[operand];
+      stack.push_back(operand);
+    }
+  }
+
+  // Terms are numbered in topological order, so each temporary is defined
+  // after the ones it uses
+  std::uint32_t numTemporaries{};
+  for (Id id{}; id < graph.size(); ++id) {
+    if (numUses[id] > 1 && isWorthHoisting(id)) {
+      m_temporaries[id] = numTemporaries++;
+    }
+  }
+}
+
+std::string GLSLWriter::write(std::string_view type) {
+  m_result.clear();
+  for (Id id{}; id < m_graph.size(); ++id) {
+    if (m_temporaries[id] == kNoTemporary) {
+      continue;
+    }
+    m_definedTerm = id;
+    m_result +=
+        std::format("float {}{}=", m_temporaryPrefix, m_temporaries[id]);
+    emit(id, Precedence::Sum);
+    m_result += ";\n";
+  }
+  m_definedTerm = TermGraph::kNone;
+
+  m_result += std::format("return {}(", type);
+  for (std::size_t index{}; index < m_roots.size(); ++index) {
+    if (index > 0) {
+      m_result += ',';
+    }
+    emit(m_roots[index], Precedence::Sum);
+  }
+  m_result += ");\n";
+  return m_result;
+}
+
+bool GLSLWriter::isWorthHoisting(Id id) const {
+  auto const &term{m_graph.get(id)};
+  switch (term.kind) {
+  case Kind::Constant:
+  case Kind::Variable:
+  case Kind::Symbol:
+    return false;
+  case Kind::Product: {
+    // A negated leaf costs no more than its temporary
+    auto const operands{m_graph.getOperands(term)};
+    return term.value != -1.0 || operands.size() != 1 ||
+           !m_graph.getOperands(m_graph.get(operands[0])).empty();
+  }
+  default:
+    return true;
+  }
+}
+
+std::optional<double> GLSLWriter::getConstantExponent(Id id) const {
+  auto const &term{m_graph.get(id)};
+  if (term.kind != Kind::Power) {
+    return std::nullopt;
+  }
+  auto const &exponent{m_graph.get(m_graph.getOperands(term)[1])};
+  if (exponent.kind != Kind::Constant) {
+    return std::nullopt;
+  }
+  return exponent.value;
+}
+
+GLSLWriter::Precedence GLSLWriter::getPrecedence(Id id) const {
+  if (getTemporary(id) != kNoTemporary) {
+    return Precedence::Primary;
+  }
+  auto const &term{m_graph.get(id)};
+  switch (term.kind) {
+  case Kind::Constant:
+    return term.value < 0.0 ? Precedence::Product : Precedence::Primary;
+  case Kind::Sum:
+    return Precedence::Sum;
+  case Kind::Product:
+    return Precedence::Product;
+  case Kind::Power:
+    return isDenominator(getConstantExponent(id)) ? Precedence::Product
+                                                  : Precedence::Primary;
+  default:
+    return Precedence::Primary;
+  }
+}
+
+void GLSLWriter::emit(Id id, Precedence required) {
+  auto const parenthesize{getPrecedence(id) < required};
+  if (parenthesize) {
+    m_result += '(';
+  }
+  emitTerm(id);
+  if (parenthesize) {
+    m_result += ')';
+  }
+}
+
+void GLSLWriter::emitTerm(Id id) {
+  if (auto const temporary{getTemporary(id)}; temporary != kNoTemporary) {
+    m_result += std::format("{}{}", m_temporaryPrefix, temporary);
+    return;
+  }
+
+  auto const &term{m_graph.get(id)};
+  auto const operands{m_graph.getOperands(term)};
+  switch (term.kind) {
+  case Kind::Constant:
+    m_result += util::formatFloat(term.value);
+    break;
+  case Kind::Variable:
+    m_result += "@P.@";
+    m_result += term.name;
+    break;
+  case Kind::Symbol:
+    m_result += term.name;
+    break;
+  case Kind::Sum:
+    emitSum(term);
+    break;
+  case Kind::Product:
+    emitProduct(term, term.value);
+    break;
+  case Kind::Power:
+    if (auto const exponent{getConstantExponent(id)}) {
+      if (isDenominator(exponent)) {
+        m_result += "1.0/";
+        emitPower(operands[0], -*exponent);
+      } else {
+        emitPower(operands[0], *exponent);
+      }
+    } else {
+      m_result += "mpow(";
+      emit(operands[0], Precedence::Sum);
+      m_result += ',';
+      emit(operands[1], Precedence::Sum);
+      m_result += ')';
+    }
+    break;
+  case Kind::Call:
+    m_result += term.name;
+    m_result += '(';
+    for (std::size_t index{}; index < operands.size(); ++index) {
+      if (index > 0) {
+        m_result += ',';
+      }
+      emit(operands[index], Precedence::Sum);
+    }
+    m_result += ')';
+    break;
+  }
+}
+
+void GLSLWriter::emitSum(TermGraph::Term const &term) {
+  auto first{true};
+  for (auto const operand : m_graph.getOperands(term)) {
+    auto const &operandTerm{m_graph.get(operand)};
+    if (getTemporary(operand) == kNoTemporary &&
+        operandTerm.kind == Kind::Product && operandTerm.value < 0.0) {
+      // Written as a subtraction
+      emitProduct(operandTerm, operandTerm.value);
+    } else {
+      if (!first) {
+        m_result += '+';
+      }
+      emit(operand, Precedence::Sum);
+    }
+    first = false;
+  }
+  if (term.value != 0.0) {
+    m_result += term.value < 0.0 ? '-' : '+';
+    m_result += util::formatFloat(std::abs(term.value));
+  }
+}
+
+void GLSLWriter::emitProduct(TermGraph::Term const &term, double coefficient) {
+  if (coefficient < 0.0) {
+    m_result += '-';
+    coefficient = -coefficient;
+  }
+
+  std::vector<Id> numerator;
+  std::vector<std::pair<Id, double>> denominator;
+  for (auto const operand : m_graph.getOperands(term)) {
+    auto const exponent{getConstantExponent(operand)};
+    if (getTemporary(operand) == kNoTemporary && isDenominator(exponent)) {
+      auto const base{m_graph.getOperands(m_graph.get(operand))[0]};
+      denominator.emplace_back(base, -*exponent);
+    } else {
+      numerator.push_back(operand);
+    }
+  }
+
+  auto first{true};
+  if (coefficient != 1.0 || numerator.empty()) {
+    m_result += util::formatFloat(coefficient);
+    first = false;
+  }
+  for (auto const factor : numerator) {
+    if (!first) {
+      m_result += '*';
+    }
+    emit(factor, Precedence::Primary);
+    first = false;
+  }
+  for (auto const &[base, exponent] : denominator) {
+    m_result += '/';
+    emitPower(base, exponent);
+  }
+}
+
+// Writes a power with a positive exponent, or an inverse square root
+void GLSLWriter::emitPower(Id base, double exponent) {
+  if (exponent == 1.0) {
+    emit(base, Precedence::Primary);
+    return;
+  }
+
+  if (exponent == 0.5) {
+    m_result += "sqrt(";
+  } else if (exponent == -0.5) {
+    m_result += "inversesqrt(";
+  } else if (isInteger(exponent) && exponent >= 2.0 && exponent <= 16.0) {
+    m_result += std::format("mpow{}(", static_cast<int>(exponent));
+  } else {
+    m_result += "mpow(";
+    emit(base, Precedence::Sum);
+    m_result += std::format(",{})", util::formatFloat(exponent));
+    return;
+  }
+  emit(base, Precedence::Sum);
+  m_result += ')';
+}
+
+} // namespace
+
+std::optional<AnalyticDerivatives>
+differentiate(Expression const &expression, std::string_view temporaryPrefix) {
+  if (!expression.isValid()) {
+    return std::nullopt;
+  }
+
+  try {
+    TermGraph graph;
+    auto const function{graph.convert(expression)};
+
+    std::array<TermGraph::Id, 3> gradient{};
+    for (std::size_t axis{}; axis < gradient.size(); ++axis) {
+      gradient.at(axis) = graph.derivative(function, axis);
+    }
+
+    // Second derivatives are symmetric
+    std::array<TermGraph::Id, 9> hessian{};
+    for (std::size_t row{}; row < 3; ++row) {
+      for (std::size_t column{row}; column < 3; ++column) {
+        auto const derivative{graph.derivative(gradient.at(row), column)};
+        hessian.at((row * 3) + column) = derivative;
+        hessian.at((column * 3) + row) = derivative;
+      }
+    }
+
+    return AnalyticDerivatives{
+        .gradient = GLSLWriter{graph, gradient, temporaryPrefix}.write("vec3"),
+        .hessian = GLSLWriter{graph, hessian, temporaryPrefix}.write("mat3")};
+  } catch (NotDifferentiable const &) {
+    return std::nullopt;
+  }
+}
@@ -0,0 +1,45 @@
+/**
+ * @file derivatives.hpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#ifndef DERIVATIVES_HPP_
+#define DERIVATIVES_HPP_
+
+#include "expression.hpp"
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+// GLSL code of the first and second partial derivatives of an expression with
+// respect to the coordinates x, y and z.
+struct AnalyticDerivatives {
+  // Statements that return the gradient as a vec3
+  std::string gradient;
+  // Statements that return the Hessian matrix as a mat3
+  std::string hessian;
+
+  friend bool operator==(AnalyticDerivatives const &,
+                         AnalyticDerivatives const &) = default;
+};
+
+// Differentiates a valid expression symbolically.
+//
+// The expression is converted into a graph of terms in which equal terms are
+// shared, and is differentiated by the chain rule. Terms are simplified as
+// they are created: constants are folded, sums and products are flattened,
+// and like terms and factors are combined. Terms used more than once are
+// evaluated into temporaries named with 'temporaryPrefix' followed by a
+// number.
+//
+// Returns std::nullopt if the expression calls a function with no known
+// derivative, or if the derivatives grow too large.
+[[nodiscard]] std::optional<AnalyticDerivatives>
+differentiate(Expression const &expression, std::string_view temporaryPrefix);
+
+#endif
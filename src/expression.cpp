@@ -0,0 +1,443 @@
+/**
+ * @file expression.cpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#include "expression.hpp"
+
+#include <array>
+#include <bit>
+#include <cctype>
+#include <cstdlib>
+#include <format>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+class SyntaxError : public std::runtime_error {
+  using std::runtime_error::runtime_error;
+};
+
+bool isDigit(char ch) {
+  return std::isdigit(static_cast<unsigned char>(ch)) != 0;
+}
+
+bool isIdentifierStart(char ch) {
+  return std::isalpha(static_cast<unsigned char>(ch)) != 0 || ch == '_';
+}
+
+bool isIdentifierChar(char ch) {
+  return std::isalnum(static_cast<unsigned char>(ch)) != 0 || ch == '_';
+}
+
+// Returns the length of the number at the start of 'str': digits with an
+// optional fractional part and an optional exponent
+std::size_t scanNumber(std::string_view str) {
+  std::size_t pos{};
+  auto const skipDigits{[&] {
+    while (pos < str.size() && isDigit(str[pos])) {
+      ++pos;
+    }
+  }};
+
+  skipDigits();
+  if (pos < str.size() && str[pos] == '.') {
+    ++pos;
+    skipDigits();
+  }
+  if (pos < str.size() && (str[pos] == 'e' || str[pos] == 'E')) {
+    auto exponentStart{pos + 1};
+    if (exponentStart < str.size() &&
+        (str[exponentStart] == '+' || str[exponentStart] == '-')) {
+      ++exponentStart;
+    }
+    if (exponentStart < str.size() && isDigit(str[exponentStart])) {
+      pos = exponentStart;
+      skipDigits();
+    }
+  }
+  return pos;
+}
+
+} // namespace
+
+std::vector<Expression::Token> Expression::tokenize(std::string_view source) {
+  std::vector<Token> tokens;
+  std::size_t pos{};
+  auto lineBreakBefore{false};
+
+  auto const push{[&](TokenKind kind, std::size_t length) {
+    tokens.push_back({.kind = kind,
+                      .offset = static_cast<std::uint32_t>(pos),
+                      .length = static_cast<std::uint32_t>(length),
+                      .lineBreakBefore = lineBreakBefore});
+    lineBreakBefore = false;
+    pos += length;
+  }};
+
+  while (pos < source.size()) {
+    auto const ch{source[pos]};
+    if (ch == '\n') {
+      lineBreakBefore = true;
+      ++pos;
+      continue;
+    }
+    if (std::isspace(static_cast<unsigned char>(ch)) != 0) {
+      ++pos;
+      continue;
+    }
+
+    auto const next{pos + 1 < source.size() ? source[pos + 1] : '\0'};
+    if (isDigit(ch) || (ch == '.' && isDigit(next))) {
+      push(TokenKind::Number, scanNumber(source.substr(pos)));
+      continue;
+    }
+    if (isIdentifierStart(ch)) {
+      auto length{std::size_t{1}};
+      while (pos + length < source.size() &&
+             isIdentifierChar(source[pos + length])) {
+        ++length;
+      }
+      push(TokenKind::Identifier, length);
+      continue;
+    }
+
+    switch (ch) {
+    case '+':
+      push(TokenKind::Plus, 1);
+      break;
+    case '-':
+      push(TokenKind::Minus, 1);
+      break;
+    case '*':
+      if (next == '*') {
+        push(TokenKind::Caret, 2);
+      } else {
+        push(TokenKind::Asterisk, 1);
+      }
+      break;
+    case '/':
+      push(TokenKind::Slash, 1);
+      break;
+    case '^':
+      push(TokenKind::Caret, 1);
+      break;
+    case '(':
+      push(TokenKind::LeftParen, 1);
+      break;
+    case ')':
+      push(TokenKind::RightParen, 1);
+      break;
+    case '[':
+      push(TokenKind::LeftBracket, 1);
+      break;
+    case ']':
+      push(TokenKind::RightBracket, 1);
+      break;
+    case ',':
+      push(TokenKind::Comma, 1);
+      break;
+    default:
+      push(TokenKind::Invalid, 1);
+      break;
+    }
+  }
+
+  push(TokenKind::End, 0);
+  return tokens;
+}
+
+// Precedence-climbing parser. Nodes are appended to the expression as their
+// subtrees are completed.
+class ExpressionParser {
+public:
+  explicit ExpressionParser(Expression &expression)
+      : m_expression{expression}, m_tokens{expression.m_tokens} {
+    // There are at most as many nodes and operands as tokens
+    m_expression.m_nodes.reserve(m_tokens.size());
+    m_expression.m_operands.reserve(m_tokens.size());
+  }
+
+  void parse() {
+    parseBinary(kSumPrecedence);
+    if (peek().kind != Expression::TokenKind::End) {
+      failUnexpected();
+    }
+  }
+
+private:
+  using TokenKind = Expression::TokenKind;
+  using NodeKind = Expression::NodeKind;
+
+  static constexpr auto kSumPrecedence{1};
+  static constexpr auto kProductPrecedence{2};
+  static constexpr auto kPowerPrecedence{3};
+
+  // Counts the nesting depth of the recursive calls
+  class DepthGuard {
+  public:
+    explicit DepthGuard(ExpressionParser &parser) : m_parser{parser} {
+      if (++m_parser.m_depth > Expression::kMaxNestingDepth) {
+        m_parser.fail("Expression nested too deeply");
+      }
+    }
+    DepthGuard(DepthGuard const &) = delete;
+    DepthGuard &operator=(DepthGuard const &) = delete;
+    ~DepthGuard() { --m_parser.m_depth; }
+
+  private:
+    ExpressionParser &m_parser;
+  };
+
+  [[nodiscard]] Expression::Token const &peek() const {
+    return m_tokens[m_pos];
+  }
+  Expression::Token const &advance() { return m_tokens[m_pos++]; }
+
+  [[noreturn]] void fail(std::string_view what) const {
+    throw SyntaxError(
+        std::format("{} at column {}", what, peek().offset + 1));
+  }
+
+  [[noreturn]] void failUnexpected() const {
+    auto const &token{peek()};
+    if (token.kind == TokenKind::End) {
+      fail("Unexpected end of expression");
+    }
+    fail(std::format("Unexpected '{}'", m_expression.getText(token)));
+  }
+
+  void expect(TokenKind kind) {
+    if (peek().kind != kind) {
+      failUnexpected();
+    }
+    advance();
+  }
+
+  std::uint32_t addNode(Expression::Node node,
+                        std::span<Expression::Operand const> operands = {}) {
+    node.firstOperand =
+        static_cast<std::uint32_t>(m_expression.m_operands.size());
+    node.numOperands = static_cast<std::uint32_t>(operands.size());
+    m_expression.m_operands.insert(m_expression.m_operands.end(),
+                                   operands.begin(), operands.end());
+    m_expression.m_nodes.push_back(node);
+    return static_cast<std::uint32_t>(m_expression.m_nodes.size() - 1);
+  }
+
+  std::uint32_t addNode(NodeKind kind, std::uint32_t operand) {
+    std::array const operands{Expression::Operand{.node = operand}};
+    return addNode({.kind = kind}, operands);
+  }
+
+  static int getPrecedence(TokenKind kind) {
+    switch (kind) {
+    case TokenKind::Plus:
+    case TokenKind::Minus:
+      return kSumPrecedence;
+    case TokenKind::Asterisk:
+    case TokenKind::Slash:
+      return kProductPrecedence;
+    case TokenKind::Caret:
+      return kPowerPrecedence;
+    default:
+      return 0;
+    }
+  }
+
+  static char getOperator(TokenKind kind) {
+    switch (kind) {
+    case TokenKind::Plus:
+      return '+';
+    case TokenKind::Minus:
+      return '-';
+    case TokenKind::Asterisk:
+      return '*';
+    default:
+      return '/';
+    }
+  }
+
+  // Parses operators of precedence greater than or equal to 'minPrecedence'.
+  // The precedence of the operators found at this level never increases, so
+  // operators of equal precedence are collected into a single n-ary node.
+  std::uint32_t parseBinary(int minPrecedence) {
+    DepthGuard const guard{*this};
+
+    auto lhs{parseUnary()};
+    auto const pendingStart{m_pending.size()};
+    auto openPrecedence{0};
+
+    auto const closeOpenNode{[&] {
+      if (m_pending.size() > pendingStart) {
+        lhs = addNode({.kind = openPrecedence == kSumPrecedence
+                                   ? NodeKind::Sum
+                                   : NodeKind::Product},
+                      std::span{m_pending}.subspan(pendingStart));
+        m_pending.resize(pendingStart);
+      }
+    }};
+
+    for (auto precedence{getPrecedence(peek().kind)};
+         precedence != 0 && precedence >= minPrecedence;
+         precedence = getPrecedence(peek().kind)) {
+      auto const &opToken{advance()};
+
+      if (precedence == kPowerPrecedence) {
+        // Right-associative
+        auto const exponent{parseBinary(kPowerPrecedence)};
+        std::array const powerOperands{Expression::Operand{.node = lhs},
+                                       Expression::Operand{.node = exponent}};
+        lhs = addNode({.kind = NodeKind::Power}, powerOperands);
+        continue;
+      }
+
+      if (precedence != openPrecedence) {
+        closeOpenNode();
+        m_pending.push_back({.node = lhs});
+        openPrecedence = precedence;
+      }
+      auto const lineBreakAfter{peek().lineBreakBefore};
+      auto const rhs{parseBinary(precedence + 1)};
+      m_pending.push_back({.node = rhs,
+                           .op = getOperator(opToken.kind),
+                           .lineBreakBefore = opToken.lineBreakBefore,
+                           .lineBreakAfter = lineBreakAfter});
+    }
+
+    closeOpenNode();
+    return lhs;
+  }
+
+  // Unary operators bind tighter than products but looser than powers, so
+  // that -x^2 is -(x^2)
+  std::uint32_t parseUnary() {
+    auto const kind{peek().kind};
+    if (kind == TokenKind::Minus || kind == TokenKind::Plus) {
+      advance();
+      auto const operand{parseBinary(kPowerPrecedence)};
+      return addNode(kind == TokenKind::Minus ? NodeKind::Negate
+                                              : NodeKind::Identity,
+                     operand);
+    }
+    return parsePrimary();
+  }
+
+  std::uint32_t parsePrimary() {
+    auto const &token{peek()};
+    switch (token.kind) {
+    case TokenKind::Number: {
+      advance();
+      // The number is followed by a character that cannot continue it
+      auto const value{std::strtod(
+          m_expression.m_source.c_str() + token.offset, nullptr)};
+      return addNode({.kind = NodeKind::Number,
+                      .offset = token.offset,
+                      .length = token.length,
+                      .value = value});
+    }
+    case TokenKind::Identifier:
+      advance();
+      if (peek().kind == TokenKind::LeftParen) {
+        return parseCall(token);
+      }
+      return addNode({.kind = NodeKind::Identifier,
+                      .offset = token.offset,
+                      .length = token.length});
+    case TokenKind::LeftParen:
+    case TokenKind::LeftBracket: {
+      advance();
+      auto const inner{parseBinary(kSumPrecedence)};
+      expect(token.kind == TokenKind::LeftParen ? TokenKind::RightParen
+                                                : TokenKind::RightBracket);
+      std::array const operands{Expression::Operand{.node = inner}};
+      return addNode(
+          {.kind = NodeKind::Group, .offset = token.offset, .length = 1},
+          operands);
+    }
+    default:
+      failUnexpected();
+    }
+  }
+
+  std::uint32_t parseCall(Expression::Token const &name) {
+    advance(); // '('
+    auto const pendingStart{m_pending.size()};
+    if (peek().kind != TokenKind::RightParen) {
+      m_pending.push_back({.node = parseBinary(kSumPrecedence)});
+      while (peek().kind == TokenKind::Comma) {
+        advance();
+        m_pending.push_back({.node = parseBinary(kSumPrecedence)});
+      }
+    }
+    expect(TokenKind::RightParen);
+    auto const call{addNode(
+        {.kind = NodeKind::Call, .offset = name.offset, .length = name.length},
+        std::span{m_pending}.subspan(pendingStart))};
+    m_pending.resize(pendingStart);
+    return call;
+  }
+
+  Expression &m_expression;
+  std::span<Expression::Token const> m_tokens;
+  std::size_t m_pos{};
+  std::size_t m_depth{};
+  // Operands of the sums, products and calls whose parsing is in progress
+  std::vector<Expression::Operand> m_pending;
+};
+
+Expression::Expression(std::string source)
+    : m_source{std::move(source)}, m_tokens{tokenize(m_source)} {
+  try {
+    ExpressionParser{*this}.parse();
+  } catch (SyntaxError const &exception) {
+    m_nodes.clear();
+    m_operands.clear();
+    m_error = exception.what();
+  }
+}
+
+std::vector<std::uint32_t> Expression::numberValues() const {
+  std::vector<std::uint32_t> numbers(m_nodes.size());
+  std::unordered_map<std::string, std::uint32_t> numbersByKey;
+
+  // The key of a node is its kind, its text or value, and the operators and
+  // value numbers of its operands. Operands come before their parents, so
+  // their numbers are already known.
+  std::string key;
+  auto const appendBytes{[&key](auto const &value) {
+    auto const bytes{std::bit_cast<std::array<char, sizeof(value)>>(value)};
+    key.append(bytes.data(), bytes.size());
+  }};
+
+  for (std::size_t idx{}; idx < m_nodes.size(); ++idx) {
+    auto const &node{m_nodes[idx]};
+    auto const operands{getOperands(node)};
+    if (node.kind == NodeKind::Group) {
+      numbers[idx] = numbers[operands[0].node];
+      continue;
+    }
+
+    key.clear();
+    key += static_cast<char>(node.kind);
+    if (node.kind == NodeKind::Number) {
+      appendBytes(node.value);
+    } else {
+      key += getText(node);
+      key += '\0';
+    }
+    for (auto const &operand : operands) {
+      key += operand.op;
+      appendBytes(numbers[operand.node]);
+    }
+
+    auto const nextNumber{static_cast<std::uint32_t>(numbersByKey.size())};
+    numbers[idx] = numbersByKey.try_emplace(key, nextNumber).first->second;
+  }
+  return numbers;
+}
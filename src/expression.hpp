@@ -0,0 +1,153 @@
+/**
+ * @file expression.hpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#ifndef EXPRESSION_HPP_
+#define EXPRESSION_HPP_
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Syntax tree of the expression of an implicit function, such as
+// "x^2+y^2+z^2-r^2".
+//
+// The source is tokenized once and parsed by precedence climbing. Operators
+// are, from lowest to highest precedence: '+' and '-'; '*' and '/'; unary '-'
+// and '+'; '^' (or "**"), which is right-associative. Parentheses and square
+// brackets group subexpressions, and identifiers followed by '(' are function
+// calls.
+//
+// Nodes are stored in a flat array in post-order, so the root is the last
+// node. Sums and products are n-ary, which keeps long chains of terms from
+// making the tree deep. The nesting depth of the remaining constructs is
+// limited by kMaxNestingDepth, so that walking the tree recursively is safe.
+class Expression {
+public:
+  static constexpr std::size_t kMaxNestingDepth{128};
+
+  enum class TokenKind : std::uint8_t {
+    Number,
+    Identifier,
+    Plus,
+    Minus,
+    Asterisk,
+    Slash,
+    Caret, // '^' or "**"
+    LeftParen,
+    RightParen,
+    LeftBracket,
+    RightBracket,
+    Comma,
+    Invalid,
+    End
+  };
+
+  struct Token {
+    TokenKind kind{};
+    std::uint32_t offset{};
+    std::uint32_t length{};
+    bool lineBreakBefore{}; // Preceded by a line feed
+
+    friend bool operator==(Token const &, Token const &) = default;
+  };
+
+  enum class NodeKind : std::uint8_t {
+    Number,
+    Identifier,
+    Call,     // Operands are the arguments
+    Group,    // Text is the opening bracket
+    Negate,   // Unary '-'
+    Identity, // Unary '+'
+    Sum,      // Terms joined by '+' or '-'
+    Product,  // Factors joined by '*' or '/'
+    Power     // Base and exponent
+  };
+
+  struct Node {
+    NodeKind kind{};
+    // Text of the node in the source (number, name or opening bracket)
+    std::uint32_t offset{};
+    std::uint32_t length{};
+    std::uint32_t firstOperand{};
+    std::uint32_t numOperands{};
+    double value{}; // Numbers only
+
+    friend bool operator==(Node const &, Node const &) = default;
+  };
+
+  struct Operand {
+    std::uint32_t node{};
+    // Operator that precedes the operand in a sum or product, or '\0'
+    char op{};
+    bool lineBreakBefore{}; // Line feed before the operator
+    bool lineBreakAfter{};  // Line feed between the operator and the operand
+
+    friend bool operator==(Operand const &, Operand const &) = default;
+  };
+
+  Expression() = default;
+  explicit Expression(std::string source);
+
+  [[nodiscard]] static std::vector<Token> tokenize(std::string_view source);
+
+  // False if the source has a syntax error. Tokens are still available.
+  [[nodiscard]] bool isValid() const noexcept { return !m_nodes.empty(); }
+  [[nodiscard]] std::string const &getError() const noexcept {
+    return m_error;
+  }
+
+  [[nodiscard]] std::string const &getSource() const noexcept {
+    return m_source;
+  }
+  [[nodiscard]] std::span<Token const> getTokens() const noexcept {
+    return m_tokens;
+  }
+  [[nodiscard]] std::string_view getText(Token const &token) const {
+    return std::string_view{m_source}.substr(token.offset, token.length);
+  }
+
+  [[nodiscard]] Node const &getRoot() const { return m_nodes.back(); }
+  [[nodiscard]] std::span<Node const> getNodes() const noexcept {
+    return m_nodes;
+  }
+  [[nodiscard]] Node const &getNode(std::uint32_t index) const {
+    return m_nodes.at(index);
+  }
+  [[nodiscard]] std::span<Operand const> getOperands(Node const &node) const {
+    return std::span{m_operands}.subspan(node.firstOperand, node.numOperands);
+  }
+  [[nodiscard]] Node const &getOperand(Node const &node,
+                                       std::size_t index) const {
+    return m_nodes.at(getOperands(node)[index].node);
+  }
+  [[nodiscard]] std::string_view getText(Node const &node) const {
+    return std::string_view{m_source}.substr(node.offset, node.length);
+  }
+
+  // Returns, for each node, a number that identifies the value the node
+  // computes. Nodes with equal numbers are equal up to grouping brackets and
+  // the notation of numbers. Numbers are assigned in order of first
+  // occurrence, starting from 0.
+  [[nodiscard]] std::vector<std::uint32_t> numberValues() const;
+
+  friend bool operator==(Expression const &, Expression const &) = default;
+
+private:
+  friend class ExpressionParser;
+
+  std::string m_source;
+  std::vector<Token> m_tokens;
+  std::vector<Node> m_nodes;
+  std::vector<Operand> m_operands;
+  std::string m_error;
+};
+
+#endif
@@ -9,6 +9,9 @@
 
 #include "function.hpp"
 
+#include "derivatives.hpp"
+#include "interval.hpp"
+#include "polynomial.hpp"
 #include "util.hpp"
 
 #include <abcgOpenGL.hpp>
@@ -16,554 +19,786 @@
 
 #include <re2/re2.h>
 
-#ifndef ENABLE_UNIT_TESTING
 namespace {
-#endif
 
-// Returns the position of the first pair of enclosing brackets starting from
-// str[pos].
-//
-// Returns (npos, npos) if the brackets are not found or if there is a
-// non-whitespace character from pos and the opening bracket.
-//
-// Examples using parens:
-// str="f(x)"        pos=1 -> returns (1,3)
-//       ^
-// str="f   ((x)+1)" pos=1 -> returns (4,10)
-//       ^
-// str="f(x)"        pos=0 -> returns (npos, npos)
-//      ^
-std::pair<std::string::size_type, std::string::size_type>
-getBracketsPos(std::string_view str, std::string::size_type pos,
-               std::pair<char, char> brackets) {
-  auto const failed{std::pair{std::string::npos, std::string::npos}};
-
-  // Advance through whitespaces, from pos to the position of the opening
-  // bracket. If any non-whitespace character is found, return (npos, npos)
-  auto startPos{pos};
-  for (; startPos < str.length(); ++startPos) {
-    auto const chr{str.at(startPos)};
-    if (chr == brackets.first) {
-      break; // Opening bracket found
-    }
-    if (std::isspace(chr) == 0) {
-      return failed;
-    }
-  }
-
-  // Look for corresponding closing bracket
-  if (!str.empty()) {
-    auto numNestedParens{0};
-    for (auto endPos{startPos}; endPos + 1 < str.length(); ++endPos) {
-      auto const chr{str.at(endPos + 1)};
-      if (chr == brackets.first) {
-        ++numNestedParens;
-      }
-      if (chr == brackets.second) {
-        if (numNestedParens > 0) {
-          --numNestedParens;
-        } else {
-          ++endPos;
-          assert(startPos <= endPos);
-          return std::pair{startPos, endPos};
-        }
-      }
+using NodeKind = Expression::NodeKind;
+using TokenKind = Expression::TokenKind;
+
+constexpr std::array greekLetters{
+    "alpha", "beta",  "gamma", "Delta",   "delta",   "epsilon", "zeta",
+    "eta",   "Theta", "theta", "iota",    "kappa",   "Lambda",  "lambda",
+    "mu",    "nu",    "Xi",    "xi",      "Pi",      "pi",      "rho",
+    "Sigma", "sigma", "tau",   "Upsilon", "upsilon", "Phi",     "phi",
+    "chi",   "Psi",   "psi",   "Omega",   "omega"};
+
+bool isGreekLetter(std::string_view name) {
+  return std::ranges::find(greekLetters, name) != greekLetters.end();
+}
+
+bool isCoordinate(std::string_view name) {
+  return name == "x" || name == "y" || name == "z";
+}
+
+// Replaces each "\n" (backslash followed by n) with a line feed
+std::string unescapeLineFeeds(std::string_view str) {
+  std::string result;
+  result.reserve(str.size());
+  for (std::size_t pos{}; pos < str.size(); ++pos) {
+    if (str[pos] == '\\' && pos + 1 < str.size() && str[pos + 1] == 'n') {
+      result += '\n';
+      ++pos;
+    } else {
+      result += str[pos];
     }
   }
+  return result;
+}
 
-  return failed;
+// Returns y if the exponent of x^y is an integer literal in the range [1,16],
+// or 0 otherwise
+int getSmallIntegerExponent(Expression const &expression,
+                            Expression::Node const &power) {
+  auto const *exponent{&expression.getOperand(power, 1)};
+  if (exponent->kind == NodeKind::Identity) {
+    exponent = &expression.getOperand(*exponent, 0);
+  }
+  if (exponent->kind != NodeKind::Number) {
+    return 0;
+  }
+
+  auto const maxPowerByMultiplication{16.0};
+  auto const value{exponent->value};
+  auto integralPart{0.0};
+  if (value > 0.0 && value <= maxPowerByMultiplication &&
+      FP_ZERO == std::fpclassify(std::modf(value, &integralPart))) {
+    return gsl::narrow_cast<int>(value);
+  }
+  return 0;
 }
 
-// Returns the position, in reverse order, of the first pair of enclosing
-// brackets starting from str[pos].
-//
-// Returns (npos, npos) if the brackets are not found or if there is a
-// non-whitespace character from pos and the opening bracket.
-//
-// Examples using parens:
-// str="(x)+"        pos=2 -> returns (2,0)
-//        ^
-// str="((x)+1)   +" pos=9 -> returns (6,0)
-//               ^
-// str="(x)+"        pos=3 -> returns (npos, npos)
-//         ^
-std::pair<std::string::size_type, std::string::size_type>
-getBracketsPosReverse(std::string_view str, std::string::size_type pos,
-                      std::pair<char, char> brackets) {
-  auto const failed{std::pair{std::string::npos, std::string::npos}};
-
-  if (pos >= str.size()) {
-    return failed;
-  }
-
-  // Reverse through whitespaces, from pos to the position of the closing
-  // bracket. If any non-whitespace character is found, return (npos, npos)
-  auto startPos{pos};
-  for (; startPos > 0; --startPos) {
-    auto const chr{str.at(startPos)};
-    if (chr == brackets.second) {
-      break; // Closing bracket found
-    }
-    if (std::isspace(chr) == 0) {
-      return failed;
-    }
-  }
-  if (startPos == 0) {
-    return failed;
-  }
-
-  // Look for corresponding opening bracket
-  auto numNestedParens{0};
-  for (auto endPos{startPos}; endPos > 0; --endPos) {
-    auto const chr{str.at(endPos - 1)};
-    if (chr == brackets.second) {
-      ++numNestedParens;
-    }
-    if (chr == brackets.first) {
-      if (numNestedParens > 0) {
-        --numNestedParens;
-      } else {
-        --endPos;
-        return std::pair{startPos, endPos};
-      }
+// Returns the number of arithmetic operations of the GLSL code of a node,
+// without the operations of its operands. A function call counts as one
+// operation, and mpowN(x) counts as the multiplications it performs.
+std::size_t getNumOps(Expression const &expression,
+                      Expression::Node const &node) {
+  // Number of multiplications of mpowN, indexed by N
+  static constexpr std::array<std::size_t, 17> mpowMultiplications{
+      0, 0, 1, 2, 2, 3, 3, 4, 3, 4, 4, 5, 4, 5, 5, 5, 4};
+
+  switch (node.kind) {
+  case NodeKind::Call:
+  case NodeKind::Negate:
+    return 1;
+  case NodeKind::Sum:
+  case NodeKind::Product:
+    return node.numOperands - 1;
+  case NodeKind::Power:
+    if (auto const exponent{getSmallIntegerExponent(expression, node)};
+        exponent > 0) {
+      return mpowMultiplications.at(gsl::narrow_cast<std::size_t>(exponent));
     }
+    return 1;
+  default:
+    return 0;
   }
-  return failed;
 }
 
-// Returns the sizes of the left and right operands of the single-character
-// operator at str[pos], where str in a GLSL expression with no whitespaces. If
-// an operand is a function call, the size of the operand will be different
-// depending on whether the operand is enclosed within parentheses. For example:
-// - In "a+sin(x)", the size of right operand is 3 ("sin").
-// - In "a+(sin(x))", the size of right operand is 8 ("(sin(x))").
-std::pair<std::size_t, std::size_t> getSizesOfGLSLOperands(std::string_view str,
-                                                           std::size_t pos) {
-  auto sizes{std::pair{std::size_t{}, std::size_t{}}};
+// Relative costs of the operations of the cost model, in arithmetic operations
+constexpr auto kTranscendentalCost{8.0};
+constexpr auto kSquareRootCost{4.0};
+// Cost of a call to a function of the global code, whose body is unknown
+constexpr auto kUserFunctionCost{16.0};
+// Number of iterations assumed for a loop whose bound is not a literal
+constexpr auto kDefaultLoopIterations{16.0};
+constexpr auto kMaxLoopIterations{4096.0};
+
+// Returns the estimated cost of a call to the function of the given name
+double getCallCost(std::string_view name) {
+  static constexpr std::array<std::string_view, 17> transcendentalNames{
+      "sin",  "cos",   "tan",   "asin",  "acos", "atan", "sinh", "cosh", "tanh",
+      "asinh", "acosh", "atanh", "exp", "exp2", "log",  "log2", "pow"};
+  static constexpr std::array<std::string_view, 5> squareRootNames{
+      "sqrt", "inversesqrt", "length", "distance", "normalize"};
+  static constexpr std::array<std::string_view, 16> cheapNames{
+      "abs", "sign",  "floor", "ceil", "trunc", "round", "fract",   "mod",
+      "min", "max",   "clamp", "mix",  "step",  "dot",   "radians", "cross"};
+
+  auto const contains{[name](auto const &names) {
+    return std::ranges::find(names, name) != names.end();
+  }};
+  if (contains(transcendentalNames)) {
+    return kTranscendentalCost;
+  }
+  if (contains(squareRootNames)) {
+    return kSquareRootCost;
+  }
+  if (contains(cheapNames) || name.starts_with("mpow")) {
+    return 1.0;
+  }
+  // Constructors, such as vec3(x, y, z)
+  if (std::ranges::any_of(std::array{"float", "int", "bool", "vec", "mat"},
+                          [name](auto const *type) {
+                            return name.starts_with(type);
+                          })) {
+    return 0.0;
+  }
+  return kUserFunctionCost;
+}
 
-  if (pos >= str.size()) {
-    return sizes;
+// Returns the estimated cost of the GLSL code of a node, without the cost of
+// its operands. It is the number of operations of getNumOps, except that calls
+// and powers with non-integer exponents cost more.
+double getCost(Expression const &expression, Expression::Node const &node) {
+  if (node.kind == NodeKind::Call) {
+    return getCallCost(expression.getText(node));
+  }
+  if (node.kind == NodeKind::Power &&
+      getSmallIntegerExponent(expression, node) == 0) {
+    return kTranscendentalCost;
   }
+  return gsl::narrow_cast<double>(getNumOps(expression, node));
+}
 
-  constexpr auto notNameAndNotNumber{[](char chr) {
-    return std::isalnum(chr) == 0 && chr != '_' && chr != '.';
+// Returns the estimated cost of one execution of GLSL code, such as the local
+// code of a function. Operators and calls are weighted as in getCost, and the
+// cost of the body of a loop is multiplied by its number of iterations, which
+// is taken from a literal bound of the loop condition, if any.
+double getCodeCost(std::string_view code) {
+  auto const isIdentifier{[](char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
   }};
 
-  // Compute size of right operand
-  if (auto itr{std::next(str.begin(), gsl::narrow<std::ptrdiff_t>(pos + 1))};
-      itr != str.end()) {
+  // Multipliers of the enclosing blocks, and of the block of the next loop
+  std::vector<double> multipliers{1.0};
+  double loopIterations{1.0};
 
-    if (*itr == '-' || *itr == '+') {
-      itr = std::next(itr);
-    }
-
-    if (*itr == '(') {
-      // Opening bracket
-      auto const startPos{std::distance(str.begin(), itr)};
-      auto const bracketPos{
-          getBracketsPos(str, gsl::narrow<std::size_t>(startPos), {'(', ')'})};
-      if (bracketPos.first != std::string_view::npos) {
-        sizes.second = bracketPos.second - pos;
+  auto cost{0.0};
+  std::size_t pos{};
+  while (pos < code.size()) {
+    auto const c{code[pos]};
+    if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+      auto const start{pos};
+      while (pos < code.size() && isIdentifier(code[pos])) {
+        ++pos;
       }
-    } else {
-      itr = std::find_if(itr, str.end(), notNameAndNotNumber);
-      auto const endPos{std::distance(str.begin(), itr)};
-      auto const opSize{endPos - gsl::narrow<std::ptrdiff_t>(pos) - 1};
-      sizes.second = gsl::narrow<std::size_t>(opSize);
-    }
-  }
-
-  // Compute size of left operand
-  if (auto itr{std::next(str.rbegin(),
-                         gsl::narrow<std::ptrdiff_t>(str.size() - pos))};
-      itr != str.rend()) {
-    if (*itr == ')') {
-      // Closing bracket
-      auto const startPos{std::distance(itr, str.rend()) - 1};
-      auto const bracketPos{getBracketsPosReverse(
-          str, gsl::narrow<std::size_t>(startPos), {'(', ')'})};
-      if (bracketPos.first != std::string_view::npos) {
-        sizes.first = pos - bracketPos.second;
+      auto const name{code.substr(start, pos - start)};
+      auto const next{code.find_first_not_of(" \t\r\n", pos)};
+      auto const isCall{next != std::string_view::npos && code[next] == '('};
+      if (name == "for" || name == "while") {
+        // The bound is the first number after a '<' of the loop header
+        auto const header{code.substr(pos, code.find(')', pos) - pos)};
+        auto iterations{kDefaultLoopIterations};
+        if (auto const less{header.find('<')}; less != std::string_view::npos) {
+          std::string const bound{header.substr(less + 1)};
+          auto const *const begin{
+              bound.c_str() +
+              std::min(bound.find_first_not_of('='), bound.size())};
+          char *end{};
+          if (auto const value{std::strtod(begin, &end)};
+              end != begin && std::isfinite(value)) {
+            iterations = std::clamp(value, 1.0, kMaxLoopIterations);
+          }
+        }
+        loopIterations = iterations;
+      } else if (isCall && name != "if" && name != "return") {
+        cost += multipliers.back() * getCallCost(name);
       }
-    } else {
-      itr = std::find_if(itr, str.rend(), notNameAndNotNumber);
-      auto const endPos{std::distance(itr, str.rend()) - 1};
-      auto const opSize{gsl::narrow<std::ptrdiff_t>(pos) - endPos - 1};
-      sizes.first = gsl::narrow<std::size_t>(opSize);
+      continue;
     }
-  }
 
-  return sizes;
+    if (c == '{') {
+      multipliers.push_back(
+          std::min(multipliers.back() * loopIterations, kMaxLoopIterations));
+      loopIterations = 1.0;
+    } else if (c == '}' && multipliers.size() > 1) {
+      multipliers.pop_back();
+    } else if (c == '+' || c == '-' || c == '*' || c == '/') {
+      cost += multipliers.back();
+    }
+    ++pos;
+  }
+  return cost;
 }
 
-#ifndef ENABLE_UNIT_TESTING
-} // anonymous namespace
-#endif
-
-namespace {
-
-void encloseFunctionCallsInParens(std::string &str) {
-  std::vector<std::string> functionCalls;
-
-  // Match "name(" where name is a function name
-  static RE2 const regex(R"re(\b([a-zA-Z_]*\w*\s*\())re");
-  assert(regex.ok());
+bool isWorthHoisting(Expression const &expression,
+                     Expression::Node const &node) {
+  if (node.kind == NodeKind::Negate) {
+    auto const kind{expression.getOperand(node, 0).kind};
+    return kind != NodeKind::Number && kind != NodeKind::Identifier;
+  }
+  return getNumOps(expression, node) > 0;
+}
 
-  for (std::size_t pos{0}; pos < str.size();) {
-    // Search for the next function call starting from pos
-    re2::StringPiece input(str);
-    input.remove_prefix(pos);
-    re2::StringPiece match;
+constexpr auto kNoTemporary{static_cast<std::size_t>(-1)};
+
+// Subexpressions that would be evaluated more than once, and that are
+// evaluated once into temporaries instead
+struct CommonSubexpressions {
+  std::vector<std::uint32_t> valueNumbers; // Value number of each node
+  // Temporary of each value number, or kNoTemporary
+  std::vector<std::size_t> temporaries;
+  // Node that defines each temporary. Operands come before their parents.
+  std::vector<std::uint32_t> definitions;
+  Function::OpCount opCount;
+  // Estimated cost of one evaluation of the optimized expression
+  double cost{};
+};
 
-    if (!RE2::PartialMatch(input, regex, &match)) {
-      break;
+CommonSubexpressions findCommonSubexpressions(Expression const &expression) {
+  CommonSubexpressions result;
+  result.valueNumbers = expression.numberValues();
+  auto const &valueNumbers{result.valueNumbers};
+  auto const nodes{expression.getNodes()};
+  auto const numValues{std::size_t{*std::ranges::max_element(valueNumbers)} +
+                       1};
+
+  // The first node of each value number represents all nodes of that number
+  std::vector<bool> isRepresentative(nodes.size());
+  std::vector<bool> isNumbered(numValues);
+  for (auto const idx : iter::range(nodes.size())) {
+    if (!isNumbered[valueNumbers[idx]]) {
+      isNumbered[valueNumbers[idx]] = true;
+      isRepresentative[idx] = true;
     }
+  }
 
-    auto const matchPosInInput{
-        gsl::narrow<std::size_t>(match.data() - input.data())};
-    auto const matchPos{pos + matchPosInInput};
-    auto const openParenPos{matchPos + match.size() - 1};
-    auto const [_,
-                closeParensPos]{getBracketsPos(str, openParenPos, {'(', ')'})};
-
-    if (closeParensPos != std::string::npos) {
-      auto const callArgs{
-          str.substr(openParenPos + 1, closeParensPos - openParenPos)};
-
-      // Push "name(" + "...)"
-      functionCalls.push_back(std::string{match} + callArgs);
+  // Count the evaluations of each value from the root down, as parents come
+  // after their operands. A value is hoisted if it would be evaluated more
+  // than once.
+  std::vector<std::size_t> numEvaluations(numValues);
+  std::vector<bool> isHoisted(numValues);
+  numEvaluations[valueNumbers.back()] = 1;
+  for (auto idx{nodes.size()}; idx-- > 0;) {
+    auto const &node{nodes[idx]};
+    result.opCount.original += getNumOps(expression, node);
+    if (!isRepresentative[idx]) {
+      continue;
+    }
 
-      // Move to the character immediately after the opening paren
-      pos = openParenPos + 1;
-    } else {
-      // No matching paren found, skip this match
-      pos = matchPos + 1;
+    auto const value{valueNumbers[idx]};
+    auto numNodeEvaluations{numEvaluations[value]};
+    if (numNodeEvaluations > 1 && isWorthHoisting(expression, node)) {
+      isHoisted[value] = true;
+      numNodeEvaluations = 1;
+    }
+    result.opCount.optimized +=
+        numNodeEvaluations * getNumOps(expression, node);
+    result.cost += gsl::narrow_cast<double>(numNodeEvaluations) *
+                   getCost(expression, node);
+    for (auto const &operand : expression.getOperands(node)) {
+      numEvaluations[valueNumbers[operand.node]] += numNodeEvaluations;
     }
   }
 
-  for (auto const &fcall : functionCalls) {
-    util::replaceAll(str, fcall, std::format("({})", fcall));
+  result.temporaries.assign(numValues, kNoTemporary);
+  for (auto const idx : iter::range(nodes.size())) {
+    if (auto const value{valueNumbers[idx]};
+        isRepresentative[idx] && isHoisted[value]) {
+      result.temporaries[value] = result.definitions.size();
+      result.definitions.push_back(gsl::narrow_cast<std::uint32_t>(idx));
+    }
   }
+  return result;
 }
 
-void encloseMatchesInBrackets(std::string &str, RE2 const &regex,
-                              std::pair<char, char> brackets) {
-  std::size_t pos{};
-  re2::StringPiece match;
+// Returns a prefix for the names of temporaries that does not occur in the
+// user code
+std::string getTemporaryPrefix(Function::Data const &data) {
+  auto const isUsed{[&data](std::string_view name) {
+    return std::ranges::any_of(
+        std::array{&data.expression, &data.codeLocal, &data.codeGlobal},
+        [name](auto const *code) {
+          return code->find(name) != std::string::npos;
+        });
+  }};
 
-  for (std::string ns{str}; RE2::PartialMatch(ns, regex, &match);) {
-    auto const matchPosition{
-        gsl::narrow<std::size_t>(match.data() - ns.c_str())};
-    auto const posAfterName{matchPosition + match.size()};
-    auto const bracketPos{getBracketsPos(ns, posAfterName, {'(', ')'})};
-
-    std::string bracketedArgs{};
-    if (bracketPos.first != std::string::npos &&
-        bracketPos.second != std::string::npos) {
-      assert(bracketPos.second >= bracketPos.first);
-      bracketedArgs =
-          ns.substr(bracketPos.first, 1 + bracketPos.second - bracketPos.first);
-    }
-
-    // "name" + "(...)"
-    auto const what{std::string{match} + bracketedArgs};
-    // "{name(...)}" if brackets are curly brackets
-    auto const with{brackets.first + what + brackets.second};
-    str.replace(pos + matchPosition, what.length(), with.c_str(),
-                with.length());
-    ns.replace(matchPosition, what.length(), with.c_str(), with.length());
-
-    auto const advancePos{matchPosition + match.size()};
-    pos += advancePos;
-    ns = ns.substr(advancePos);
+  std::string prefix{"_cse"};
+  for (auto suffix{0}; isUsed(prefix); ++suffix) {
+    prefix = std::format("_cse{}_", suffix);
   }
+  return prefix;
 }
 
-// Add matches to the given set
-void addMatchesToSet(RE2 const &regex, re2::StringPiece str,
-                     std::set<std::string> &set) {
-  for (std::string match; RE2::FindAndConsume(&str, regex, &match);) {
-    set.insert(match);
+// Generates GLSL code from the syntax tree of an expression.
+//
+// Whitespace is removed, brackets become parentheses, and x^y becomes either
+// mpowy(x) or mpow(x,y). The coordinates x, y, z are written as @P.@x, @P.@y,
+// @P.@z to avoid mixing them up with a user-defined parameter 'p'. Function
+// calls are enclosed in parentheses, but no pair of parentheses is written
+// directly around another one. Common subexpressions are written as the names
+// of their temporaries.
+class GLSLEmitter {
+public:
+  GLSLEmitter(Expression const &expression,
+              CommonSubexpressions const &commonSubexpressions,
+              std::string_view temporaryPrefix)
+      : m_expression{expression}, m_commonSubexpressions{commonSubexpressions},
+        m_temporaryPrefix{temporaryPrefix} {}
+
+  std::string emitExpression() {
+    m_result.clear();
+    m_result.reserve(m_expression.getSource().size() * 2);
+    emit(m_expression.getRoot());
+    return std::move(m_result);
   }
-}
 
-// Remove matches from the given set
-void removeMatchesFromSet(RE2 const &regex, re2::StringPiece str,
-                          std::set<std::string> &set) {
-  for (std::string match; RE2::FindAndConsume(&str, regex, &match);) {
-    set.erase(match);
+  // Returns the declarations of the temporaries, one per line
+  std::string emitTemporaries() {
+    m_result.clear();
+    auto const &definitions{m_commonSubexpressions.definitions};
+    for (auto const idx : iter::range(definitions.size())) {
+      m_definedNode = &m_expression.getNode(definitions[idx]);
+      m_result += std::format("float {}{}=", m_temporaryPrefix, idx);
+      if (m_definedNode->kind == NodeKind::Call) {
+        emitCall(*m_definedNode);
+      } else {
+        emit(*m_definedNode);
+      }
+      m_result += ";\n";
+    }
+    m_definedNode = nullptr;
+    return std::move(m_result);
   }
-}
-
-// Remove from the given set the matches that are not enclosed by a block scope
-void removeMatchesInSameScope(RE2 const &regex, re2::StringPiece str,
-                              std::set<std::string> &set) {
-  // Helper lambda that checks if the character at `str[pos]` is enclosed
-  // by curly brackets (assuming there is an even number of brackets)
-  constexpr auto insideCurlyBrackets{
-      [](std::string_view view, std::size_t pos) {
-        if (pos >= view.length()) {
-          return false;
-        }
-        int groups{};
-        for (auto const idx : iter::range(pos, view.length())) {
-          auto const chr{view.at(idx)};
-          if (chr == '{') {
-            ++groups;
-          }
-          if (chr == '}') {
-            --groups;
-          }
-        }
-        return groups != 0;
-      }};
 
-  for (re2::StringPiece match; RE2::PartialMatch(str, regex, &match);) {
-    auto const matchPosition{
-        gsl::narrow<std::size_t>(match.data() - str.data())};
-    if (!insideCurlyBrackets(str, matchPosition)) {
-      set.erase(std::string{match});
+private:
+  [[nodiscard]] std::size_t getTemporary(Expression::Node const &node) const {
+    if (&node == m_definedNode) {
+      return kNoTemporary;
     }
-    str.remove_prefix(matchPosition + match.size());
+    auto const index{std::distance(m_expression.getNodes().data(), &node)};
+    auto const value{m_commonSubexpressions.valueNumbers.at(
+        gsl::narrow_cast<std::size_t>(index))};
+    return m_commonSubexpressions.temporaries.at(value);
   }
-}
-
-// Reformat integrals as floats (e.g. 42 as 42.0)
-void reformatStringNumbersAsFloats(std::string &str) {
-  // Match integers (e.g. 42) or floats (e.g. .42 or 4.2)
-  static RE2 const regex(R"re(((\.\d+\.?\d*)|\b(\d+\.?\d*)))re");
-  assert(regex.ok());
 
-  std::size_t pos{};
-  re2::StringPiece match;
-
-  for (std::string ns{str}; RE2::PartialMatch(ns, regex, &match);) {
-    auto const matchPosition{
-        gsl::narrow<std::size_t>(match.data() - ns.c_str())};
-
-    auto const number{std::stod(std::string{match})};
-    auto integralPart{0.0};
-    auto const fractionalPart{std::modf(number, &integralPart)};
-    auto const formattedString{FP_ZERO == std::fpclassify(fractionalPart)
-                                   ? std::format("{:.1f}", number)
-                                   : std::format("{:.12g}", number)};
-    str.replace(pos + matchPosition, match.size(), formattedString);
-    pos += formattedString.length() + matchPosition;
-
-    ns = ns.substr(matchPosition + match.size());
+  // Returns true if the code of the node is enclosed in a single pair of
+  // parentheses
+  [[nodiscard]] bool isParenthesized(Expression::Node const &node) const {
+    if (getTemporary(node) != kNoTemporary) {
+      return false;
+    }
+    switch (node.kind) {
+    case NodeKind::Call:
+    case NodeKind::Group:
+      return true;
+    case NodeKind::Power:
+      return getSmallIntegerExponent(m_expression, node) == 1 &&
+             isParenthesized(m_expression.getOperand(node, 0));
+    default:
+      return false;
+    }
   }
-}
 
-// Removes redundant parentheses
-// Examples:
-// "((x+y))" -> "(x+y)"
-// "(sin(x))" -> "sin(x)"
-// "mpow2((max((abs(x)))))" -> "mpow2(max(abs(x)))"
-// "((a)+(b))" -> "(a+b)"
-void removeRedundantParens(std::string &str) {
-  if (str.size() < 2) {
-    return;
+  void emitParenthesized(Expression::Node const &node) {
+    if (isParenthesized(node)) {
+      emit(node);
+    } else {
+      m_result += '(';
+      emit(node);
+      m_result += ')';
+    }
   }
 
-  auto changed{true};
-  while (changed) {
-    changed = false;
-
-    for (std::size_t idx{0}; idx + 1 < str.size(); ++idx) {
-      if (str.at(idx) == '(' && str.at(idx + 1) == '(') {
-        auto const innerParenPos{getBracketsPos(str, idx + 1, {'(', ')'})};
-        if (innerParenPos.first == std::string::npos) {
-          continue;
-        }
-
-        if (innerParenPos.second + 1 < str.size() &&
-            str.at(innerParenPos.second + 1) == ')') {
-          auto const outerParenPos{getBracketsPos(str, idx, {'(', ')'})};
+  void emit(Expression::Node const &node) {
+    if (auto const temporary{getTemporary(node)}; temporary != kNoTemporary) {
+      m_result += std::format("{}{}", m_temporaryPrefix, temporary);
+      return;
+    }
 
-          if (outerParenPos.first == idx &&
-              outerParenPos.second == innerParenPos.second + 1) {
-            str.erase(innerParenPos.second + 1, 1);
-            str.erase(idx, 1);
-            changed = true;
-            break;
-          }
+    auto const operands{m_expression.getOperands(node)};
+    switch (node.kind) {
+    case NodeKind::Number:
+      m_result += util::formatFloat(node.value);
+      break;
+    case NodeKind::Identifier:
+      if (isCoordinate(m_expression.getText(node))) {
+        m_result += "@P.@";
+      }
+      m_result += m_expression.getText(node);
+      break;
+    case NodeKind::Call:
+      m_result += '(';
+      emitCall(node);
+      m_result += ')';
+      break;
+    case NodeKind::Group:
+      emitParenthesized(m_expression.getNode(operands[0].node));
+      break;
+    case NodeKind::Negate:
+    case NodeKind::Identity:
+      m_result += node.kind == NodeKind::Negate ? '-' : '+';
+      emit(m_expression.getNode(operands[0].node));
+      break;
+    case NodeKind::Sum:
+    case NodeKind::Product:
+      for (auto const &operand : operands) {
+        if (operand.op != '\0') {
+          m_result += operand.op;
         }
+        emit(m_expression.getNode(operand.node));
       }
+      break;
+    case NodeKind::Power:
+      emitPower(node);
+      break;
     }
   }
-}
 
-// Helper class to track bracket depths while scanning
-class BracketDepthTracker {
-public:
-  void trackForward(char ch) {
-    if (ch == '(') {
-      ++parenDepth;
-    } else if (ch == ')') {
-      --parenDepth;
-    } else if (ch == '[') {
-      ++bracketDepth;
-    } else if (ch == ']') {
-      --bracketDepth;
-    } else if (ch == '{') {
-      ++braceDepth;
-    } else if (ch == '}') {
-      --braceDepth;
+  void emitCall(Expression::Node const &node) {
+    auto const operands{m_expression.getOperands(node)};
+    m_result += m_expression.getText(node);
+    if (operands.size() == 1) {
+      emitParenthesized(m_expression.getNode(operands[0].node));
+      return;
     }
-  }
-
-  void trackBackward(char ch) {
-    if (ch == ')') {
-      ++parenDepth;
-    } else if (ch == '(') {
-      --parenDepth;
-    } else if (ch == ']') {
-      ++bracketDepth;
-    } else if (ch == '[') {
-      --bracketDepth;
-    } else if (ch == '}') {
-      ++braceDepth;
-    } else if (ch == '{') {
-      --braceDepth;
+    m_result += '(';
+    for (auto const idx : iter::range(operands.size())) {
+      if (idx > 0) {
+        m_result += ',';
+      }
+      emit(m_expression.getNode(operands[idx].node));
     }
+    m_result += ')';
   }
 
-  void reset() {
-    parenDepth = 0;
-    bracketDepth = 0;
-    braceDepth = 0;
+  void emitPower(Expression::Node const &node) {
+    auto const &base{m_expression.getOperand(node, 0)};
+    auto const exponent{getSmallIntegerExponent(m_expression, node)};
+    if (exponent == 1) {
+      emit(base);
+    } else if (exponent > 1) {
+      m_result += std::format("mpow{}", exponent);
+      emitParenthesized(base);
+    } else {
+      m_result += "mpow(";
+      emit(base);
+      m_result += ',';
+      emit(m_expression.getOperand(node, 1));
+      m_result += ')';
+    }
   }
 
-  [[nodiscard]] bool atTopLevel() const {
-    return parenDepth == 0 && bracketDepth == 0 && braceDepth == 0;
-  }
+  Expression const &m_expression;
+  CommonSubexpressions const &m_commonSubexpressions;
+  std::string_view m_temporaryPrefix;
+  Expression::Node const *m_definedNode{};
+  std::string m_result;
+};
 
-  [[nodiscard]] bool hasNegativeDepth() const {
-    return parenDepth < 0 || bracketDepth < 0 || braceDepth < 0;
+// Generates MathJax code from the syntax tree of an expression.
+//
+// Divisions become fractions, multiplication signs are omitted, and the names
+// of Greek letters and of common functions become the corresponding LaTeX
+// commands. Line feeds of the source become line breaks of an aligned
+// environment.
+class MathJaxEmitter {
+public:
+  MathJaxEmitter(Expression const &expression,
+                 std::vector<Function::Parameter> const &parameters)
+      : m_expression{expression}, m_parameters{parameters} {}
+
+  std::string emit() {
+    m_result.reserve(m_expression.getSource().size() * 2);
+    emit(m_expression.getRoot());
+    return std::move(m_result);
   }
 
 private:
-  int parenDepth{0};
-  int bracketDepth{0};
-  int braceDepth{0};
-};
-
-// Check if character is a binary operator that separates terms
-constexpr bool isTermSeparator(char ch) {
-  return ch == '+' || ch == '-' || ch == '*';
-}
-
-// Find the start position of the numerator by scanning backward from division
-std::string::size_type findNumeratorStart(std::string_view result,
-                                          std::string::size_type divPos) {
-  if (divPos == 0) {
-    return 0;
+  void append(std::string_view text) {
+    // Separate a command from a letter that follows it
+    if (m_commandEnded && !text.empty() &&
+        std::isalpha(gsl::narrow_cast<unsigned char>(text.front())) != 0) {
+      m_result += ' ';
+    }
+    m_commandEnded = false;
+    m_result += text;
   }
 
-  BracketDepthTracker tracker;
-  std::string::size_type numStart{divPos};
-
-  for (std::string::size_type i = divPos; i > 0; --i) {
-    auto const ch{result.at(i - 1)};
-    tracker.trackBackward(ch);
+  void appendCommand(std::string_view name) {
+    append("\\");
+    m_result += name;
+    m_commandEnded = true;
+  }
 
-    if (tracker.atTopLevel() && isTermSeparator(ch)) {
-      numStart = i;
-      break;
+  // Returns true if the node is a variable, parameter, constant or digit that
+  // can be used as function argument without parentheses
+  [[nodiscard]] bool isSingleToken(Expression::Node const &node) const {
+    auto const text{m_expression.getText(node)};
+    if (node.kind == NodeKind::Number) {
+      return text.size() == 1;
     }
-    if (tracker.hasNegativeDepth()) {
-      numStart = i;
-      break;
-    }
-    if (i == 1) {
-      numStart = 0;
+    if (node.kind != NodeKind::Identifier) {
+      return false;
     }
+    return isCoordinate(text) || isGreekLetter(text) ||
+           std::ranges::any_of(m_parameters, [&text](auto const &parameter) {
+             return parameter.name == text;
+           });
   }
 
-  return numStart;
-}
+  [[nodiscard]] bool startsWithDigit(Expression::Node const &node) const {
+    switch (node.kind) {
+    case NodeKind::Number:
+      return true;
+    case NodeKind::Call:
+      return m_expression.getText(node) == "exp2";
+    case NodeKind::Product:
+      if (m_expression.getOperands(node)[1].op == '/') {
+        return false; // Fraction
+      }
+      [[fallthrough]];
+    case NodeKind::Sum:
+    case NodeKind::Power:
+      return startsWithDigit(m_expression.getOperand(node, 0));
+    default:
+      return false;
+    }
+  }
 
-// Find the end position of the denominator by scanning forward from division
-std::string::size_type findDenominatorEnd(std::string_view result,
-                                          std::string::size_type divPos) {
-  BracketDepthTracker tracker;
-  std::string::size_type denEnd{divPos + 1};
-
-  for (std::string::size_type i : iter::range(divPos + 1, result.length())) {
-    auto const ch{result.at(i)};
-    tracker.trackForward(ch);
-    if (tracker.atTopLevel() && (isTermSeparator(ch) || ch == '/')) {
-      denEnd = i;
-      break;
+  // Emits the node without the parentheses that may enclose it
+  void emitUngrouped(Expression::Node const &node) {
+    auto const *inner{&node};
+    while (inner->kind == NodeKind::Group &&
+           m_expression.getText(*inner) == "(") {
+      inner = &m_expression.getOperand(*inner, 0);
     }
-    if (tracker.hasNegativeDepth()) {
-      denEnd = i;
-      break;
+    emit(*inner);
+  }
+
+  void emitArgumentList(Expression::Node const &call) {
+    auto const operands{m_expression.getOperands(call)};
+    if (operands.size() == 1) {
+      emitUngrouped(m_expression.getNode(operands[0].node));
+      return;
     }
-    if (i == result.length() - 1) {
-      denEnd = result.length();
+    for (auto const idx : iter::range(operands.size())) {
+      if (idx > 0) {
+        append(",");
+      }
+      emit(m_expression.getNode(operands[idx].node));
     }
   }
 
-  return denEnd;
-}
+  void emitArguments(Expression::Node const &call) {
+    auto const operands{m_expression.getOperands(call)};
+    if (operands.size() == 1 &&
+        isSingleToken(m_expression.getNode(operands[0].node))) {
+      append("{");
+      emit(m_expression.getNode(operands[0].node));
+      append("}");
+      return;
+    }
+    append("\\left(");
+    emitArgumentList(call);
+    append("\\right)");
+  }
 
-// Remove one level of enclosing parentheses if they wrap the entire expression
-void stripOuterParens(std::string &str) {
-  while (str.length() >= 2 && str.front() == '(' && str.back() == ')') {
-    // Verify these parens match and wrap the whole expression
-    auto depth{0};
-    auto wrapsAll{true};
-    for (std::size_t i{}; i < str.length() - 1; ++i) {
-      if (str.at(i) == '(') {
-        depth++;
-      } else if (str.at(i) == ')') {
-        depth--;
+  void emitCall(Expression::Node const &node) {
+    static constexpr std::array functionNames{
+        "asin",  "acos",  "atan", "sinh", "cosh", "tanh", "asinh",
+        "acosh", "atanh", "sin",  "cos",  "tan",  "min",  "max"};
+
+    auto const name{m_expression.getText(node)};
+    if (std::ranges::find(functionNames, name) != functionNames.end()) {
+      appendCommand(name);
+      emitArguments(node);
+    } else if (name == "exp" || name == "exp2") {
+      append(name == "exp" ? "e^{" : "2^{");
+      emitArgumentList(node);
+      append("}");
+    } else if (name == "log" || name == "sign") {
+      appendCommand(name == "log" ? "ln" : "sgn");
+      emitArguments(node);
+    } else if (name == "log2") {
+      append("\\log_2");
+      emitArguments(node);
+    } else if (name == "sqrt") {
+      append("\\sqrt{");
+      emitArgumentList(node);
+      append("}");
+    } else if (name == "abs") {
+      append("|");
+      emitArgumentList(node);
+      append("|");
+    } else if (name == "floor" || name == "ceil") {
+      appendCommand(name == "floor" ? "lfloor" : "lceil");
+      append("{");
+      emitArgumentList(node);
+      append("}");
+      appendCommand(name == "floor" ? "rfloor" : "rceil");
+    } else {
+      if (isGreekLetter(name)) {
+        appendCommand(name);
+      } else {
+        append(name);
       }
-      if (depth == 0 && i < str.length() - 2) {
-        wrapsAll = false;
-        break;
+      // f(x,y,z) is written as f
+      auto const operands{m_expression.getOperands(node)};
+      if (operands.size() == 3 &&
+          std::ranges::equal(
+              operands, std::array{"x", "y", "z"},
+              [this](auto const &operand, std::string_view coordinate) {
+                auto const &argument{m_expression.getNode(operand.node)};
+                return argument.kind == NodeKind::Identifier &&
+                       m_expression.getText(argument) == coordinate;
+              })) {
+        return;
       }
-    }
-    if (wrapsAll) {
-      str = str.substr(1, str.length() - 2);
-    } else {
-      break;
+      append("\\left(");
+      emitArgumentList(node);
+      append("\\right)");
     }
   }
-}
-
-std::string convertDivisionsToFractions(std::string_view expr) {
-  std::string result{expr};
-  std::string::size_type pos{0};
 
-  while ((pos = result.find('/', pos)) != std::string::npos) {
-    auto const numStart{findNumeratorStart(result, pos)};
-    auto const denEnd{findDenominatorEnd(result, pos)};
+  void emitProduct(Expression::Node const &node) {
+    auto const operands{m_expression.getOperands(node)};
+    for (std::size_t idx{}; idx < operands.size();) {
+      auto const &operand{operands[idx]};
+      auto const *factor{&m_expression.getNode(operand.node)};
+
+      if (idx > 0) {
+        if (operand.lineBreakBefore || operand.lineBreakAfter) {
+          append("\\\\&");
+        } else if (startsWithDigit(*factor)) {
+          append("\\cdot");
+        }
+      }
 
-    Expects(numStart <= pos);
-    Expects(denEnd >= pos + 1);
+      // The factor is the numerator of the divisions that follow it
+      std::size_t numDivisions{};
+      while (idx + numDivisions + 1 < operands.size() &&
+             operands[idx + numDivisions + 1].op == '/') {
+        ++numDivisions;
+      }
+      if (numDivisions == 0) {
+        emit(*factor);
+        ++idx;
+        continue;
+      }
 
-    auto numerator{result.substr(numStart, pos - numStart)};
-    auto denominator{result.substr(pos + 1, denEnd - pos - 1)};
+      if (factor->kind == NodeKind::Negate) {
+        append("-");
+        factor = &m_expression.getOperand(*factor, 0);
+      }
+      for ([[maybe_unused]] auto const _ : iter::range(numDivisions)) {
+        append("\\frac{");
+      }
+      emitUngrouped(*factor);
+      for (auto const divisor : iter::range(idx + 1, idx + numDivisions + 1)) {
+        append("}{");
+        emitUngrouped(m_expression.getNode(operands[divisor].node));
+        append("}");
+      }
+      idx += numDivisions + 1;
+    }
+  }
 
-    stripOuterParens(numerator);
-    stripOuterParens(denominator);
+  void emit(Expression::Node const &node) {
+    auto const operands{m_expression.getOperands(node)};
+    auto const text{m_expression.getText(node)};
+    switch (node.kind) {
+    case NodeKind::Number:
+      append(text);
+      break;
+    case NodeKind::Identifier:
+      if (isGreekLetter(text)) {
+        appendCommand(text);
+      } else {
+        append(text);
+      }
+      break;
+    case NodeKind::Call:
+      emitCall(node);
+      break;
+    case NodeKind::Group:
+      append(text == "(" ? "\\left(" : "\\left[");
+      emit(m_expression.getNode(operands[0].node));
+      append(text == "(" ? "\\right)" : "\\right]");
+      break;
+    case NodeKind::Negate:
+    case NodeKind::Identity:
+      append(node.kind == NodeKind::Negate ? "-" : "+");
+      emit(m_expression.getNode(operands[0].node));
+      break;
+    case NodeKind::Sum:
+      for (auto const &operand : operands) {
+        if (operand.lineBreakBefore) {
+          append("\\\\&");
+        }
+        if (operand.op != '\0') {
+          append(std::string_view{&operand.op, 1});
+        }
+        if (operand.lineBreakAfter) {
+          append("\\\\&");
+        }
+        emit(m_expression.getNode(operand.node));
+      }
+      break;
+    case NodeKind::Product:
+      emitProduct(node);
+      break;
+    case NodeKind::Power:
+      emit(m_expression.getOperand(node, 0));
+      append("^{");
+      emitUngrouped(m_expression.getOperand(node, 1));
+      append("}");
+      break;
+    }
+  }
 
-    auto const fraction{
-        std::format("\\frac{{{}}}{{{}}}", numerator, denominator)};
+  Expression const &m_expression;
+  std::vector<Function::Parameter> const &m_parameters;
+  std::string m_result;
+  bool m_commandEnded{};
+};
 
-    result.replace(numStart, denEnd - numStart, fraction);
-    pos = numStart + fraction.length();
+// Remove matches from the given set
+void removeMatchesFromSet(RE2 const &regex, re2::StringPiece str,
+                          std::set<std::string, std::less<>> &set) {
+  for (std::string match; RE2::FindAndConsume(&str, regex, &match);) {
+    set.erase(match);
   }
+}
 
-  return result;
+// Remove from the given set the matches that are not enclosed by a block scope
+void removeMatchesInSameScope(RE2 const &regex, re2::StringPiece str,
+                              std::set<std::string, std::less<>> &set) {
+  // Helper lambda that checks if the character at `str[pos]` is enclosed
+  // by curly brackets (assuming there is an even number of brackets)
+  constexpr auto insideCurlyBrackets{
+      [](std::string_view view, std::size_t pos) {
+        if (pos >= view.length()) {
+          return false;
+        }
+        int groups{};
+        for (auto const idx : iter::range(pos, view.length())) {
+          auto const chr{view.at(idx)};
+          if (chr == '{') {
+            ++groups;
+          }
+          if (chr == '}') {
+            --groups;
+          }
+        }
+        return groups != 0;
+      }};
+
+  for (re2::StringPiece match; RE2::PartialMatch(str, regex, &match);) {
+    auto const matchPosition{
+        gsl::narrow<std::size_t>(match.data() - str.data())};
+    if (!insideCurlyBrackets(str, matchPosition)) {
+      set.erase(std::string{match});
+    }
+    str.remove_prefix(matchPosition + match.size());
+  }
 }
 
 } // namespace
 
 Function::Function(Data data) : m_data(std::move(data)) {
-  util::replaceAll(m_data.expression, "\\n", "\n");
+  m_data.expression = unescapeLineFeeds(m_data.expression);
+  m_expression = Expression{m_data.expression};
+  extractParameters();
   convertToGLSL();
   convertToMathJax();
 }
@@ -600,12 +835,22 @@ bool Function::setParameter(std::string_view name, float value) {
 }
 
 void Function::extractParameters() {
-  std::set<std::string> parameters;
-
-  // Add names
-  static RE2 const regexName{R"re(([A-Za-z_]\w*))re"};
-  assert(regexName.ok());
-  addMatchesToSet(regexName, m_data.expression, parameters);
+  std::set<std::string, std::less<>> parameters;
+  std::set<std::string, std::less<>> functionNames;
+
+  // Add names, except the names of called functions
+  auto const tokens{m_expression.getTokens()};
+  for (auto const idx : iter::range(tokens.size())) {
+    if (tokens[idx].kind != TokenKind::Identifier) {
+      continue;
+    }
+    auto &names{tokens[idx + 1].kind == TokenKind::LeftParen ? functionNames
+                                                               : parameters};
+    if (auto const name{m_expression.getText(tokens[idx])};
+        names.find(name) == names.end()) {
+      names.emplace(name);
+    }
+  }
 
   // Remove reserved names
   static constexpr std::array reservedNames{"x",
@@ -623,10 +868,21 @@ void Function::extractParameters() {
                                             "kMSAAPattern2x",
                                             "kMSAAPattern4x",
                                             "kMSAAPattern8x",
+                                            "kUseBoundingBox",
+                                            "kRaymarchMethod",
+                                            "kRootTest",
+                                            "kGradientMode",
+                                            "kRenderingMode",
+                                            "kSurfaceColorMode",
+                                            "kUseShadows",
+                                            "kUseFog",
+                                            "kInwardNormals",
+                                            "kShowAxes",
                                             "uCamera",
                                             "uShading",
                                             "uParams",
                                             "uIsoValue",
+                                            "uBoundRadius",
                                             "uColorTexture",
                                             "uDepthTexture",
                                             "uGaussianCurvatureFalloff",
@@ -634,16 +890,37 @@ void Function::extractParameters() {
                                             "uMaxAbsCurvatureFalloff",
                                             "uNormalLengthFalloff",
                                             "uDVRFalloff",
-                                            "uDVRAbsorptionCoeff"};
+                                            "uUseBoundingBox",
+                                            "uRaymarchMethod",
+                                            "uRootTest",
+                                            "uGradientMode",
+                                            "uRenderingMode",
+                                            "uSurfaceColorMode",
+                                            "uUseShadows",
+                                            "uUseFog",
+                                            "uInwardNormals",
+                                            "uShowAxes",
+                                            "uIsosurfaceRaymarchSteps",
+                                            "uDVRRaymarchSteps",
+                                            "uDVRAbsorptionCoeff",
+                                            "P0",
+                                            "P1",
+                                            "polyX",
+                                            "polyY",
+                                            "polyZ",
+                                            "bernsteinMul",
+                                            "bernsteinAdd"};
   for (auto const &name : reservedNames) {
     parameters.erase(name);
   }
 
   // Remove function names
+  for (auto const &name : functionNames) {
+    parameters.erase(name);
+  }
   static RE2 const regexFunctionName{R"re((([a-zA-Z_])\w*)\s*\()re"};
   assert(regexFunctionName.ok());
   removeMatchesFromSet(regexFunctionName, m_data.codeGlobal, parameters);
-  removeMatchesFromSet(regexFunctionName, m_data.expression, parameters);
 
   // Remove global constant variables
   static RE2 const regexConstantVariable{
@@ -669,228 +946,83 @@ void Function::extractParameters() {
 }
 
 void Function::convertToGLSL() {
-  std::string result{m_data.expression};
-
-  // Remove whitespaces
-  std::erase_if(result, [](char c) {
-    return std::isspace(gsl::narrow_cast<unsigned char>(c));
-  });
-
-  // Replace [] with ()
-  util::replaceAll(result, "[", "(");
-  util::replaceAll(result, "]", ")");
-
-  // Replace fun(...) with (fun(...))
-  encloseFunctionCallsInParens(result);
-
-  // Given the operands of the expression x^y, returns either the string
-  // "mpowy(x)" or "mpow(x,y)". The former is returned iff y is an integer
-  // in the range [1,16].
-  auto const mpowExpression{[](std::string const &leftOperand,
-                               std::string const &rightOperand) -> std::string {
-    char *strEnd{};
-    auto const exponent{std::strtod(rightOperand.c_str(), &strEnd)};
-    auto const maxPowerByMultiplication{16.0};
-    if (exponent != HUGE_VAL && exponent > 0.0 &&
-        exponent <= maxPowerByMultiplication) {
-      auto integralPart{0.0};
-      auto const fractionalPart{std::modf(exponent, &integralPart)};
-      if (auto const isIntegral{FP_ZERO == std::fpclassify(fractionalPart)};
-          isIntegral) {
-        return gsl::narrow_cast<int>(exponent) == 1
-                   ? std::format("{}", leftOperand)
-                   : std::format("mpow{:.0f}({})", exponent, leftOperand);
+  if (m_expression.isValid()) {
+    auto const commonSubexpressions{findCommonSubexpressions(m_expression)};
+    auto const temporaryPrefix{getTemporaryPrefix(m_data)};
+    GLSLEmitter emitter{m_expression, commonSubexpressions, temporaryPrefix};
+    m_exprGLSL = emitter.emitExpression();
+    m_codeGLSLTemporaries = emitter.emitTemporaries();
+    m_opCount = commonSubexpressions.opCount;
+    m_evaluationCost =
+        commonSubexpressions.cost + getCodeCost(m_data.codeLocal);
+
+    // Local and global code are opaque to differentiation
+    auto const isBlank{[](std::string_view code) {
+      return code.find_first_not_of(" \t\r\n") == std::string_view::npos;
+    }};
+    if (isBlank(m_data.codeLocal) && isBlank(m_data.codeGlobal)) {
+      if (auto derivatives{differentiate(m_expression, temporaryPrefix)}) {
+        m_codeGLSLGradient = std::move(derivatives->gradient);
+        m_codeGLSLHessian = std::move(derivatives->hessian);
       }
     }
-    return std::format("mpow({},{})", leftOperand, rightOperand);
-  }};
-
-  // Replace "**" with "^" (exponentiation)
-  util::replaceAll(result, "**", "^");
-
-  // Change all occurrences of x^y with mpowy(x) or mpow(x,y)
-  std::size_t idx{};
-  while ((idx = result.find_first_of('^', idx)) != std::string::npos) {
-    auto const operandSizes{getSizesOfGLSLOperands(result, idx)};
-    auto const exprSize{operandSizes.first + operandSizes.second + 1};
-    auto const exprStartPosInResult{idx - operandSizes.first};
-    auto const leftOperand{
-        result.substr(exprStartPosInResult, operandSizes.first)};
-    auto const rightOperand{result.substr(
-        exprStartPosInResult + operandSizes.first + 1, operandSizes.second)};
-
-    result.replace(exprStartPosInResult, exprSize,
-                   mpowExpression(leftOperand, rightOperand));
-
-    idx = exprStartPosInResult;
+    // Names of the global code are constants, but the local code may define
+    // names that depend on the coordinates
+    if (isBlank(m_data.codeLocal)) {
+      if (auto polynomial{expandPolynomial(m_expression)}) {
+        m_codeGLSLPolynomial = std::move(polynomial->code);
+        m_polynomialDegree = polynomial->degree;
+      }
+      if (auto interval{extendToIntervals(m_expression, temporaryPrefix)}) {
+        m_codeGLSLInterval = std::move(*interval);
+      }
+    }
+    return;
   }
 
-  // Replace x with @P.@x, y with @P.@y, z with @P.@z. This is necessary to
-  // avoid mixing up the user-defined parameter 'p' with the local scope shader
-  // variable 'p'
-  static constexpr std::array xyz{"x", "y", "z"};
-  for (auto const *chr : xyz) {
-    util::replaceAll(result, chr, std::format("@P.@{}", chr), true);
+  // Keep the tokens of an invalid expression so that the syntax error is
+  // reported when the shader is compiled
+  auto const *source{m_expression.getSource().c_str()};
+  std::string result;
+  for (auto const &token : m_expression.getTokens()) {
+    auto const text{m_expression.getText(token)};
+    switch (token.kind) {
+    case TokenKind::Number:
+      result += util::formatFloat(std::strtod(source + token.offset, nullptr));
+      break;
+    case TokenKind::Identifier:
+      if (isCoordinate(text)) {
+        result += "@P.@";
+      }
+      result += text;
+      break;
+    case TokenKind::LeftBracket:
+      result += '(';
+      break;
+    case TokenKind::RightBracket:
+      result += ')';
+      break;
+    default:
+      result += text;
+      break;
+    }
   }
-
-  reformatStringNumbersAsFloats(result);
-
-  removeRedundantParens(result);
-
   m_exprGLSL = result;
 }
 
 void Function::convertToMathJax() {
-  std::string result{m_data.expression};
-
-  static constexpr std::array greekLetters{
-      "alpha", "beta",  "gamma", "Delta",   "delta",   "epsilon", "zeta",
-      "eta",   "Theta", "theta", "iota",    "kappa",   "Lambda",  "lambda",
-      "mu",    "nu",    "Xi",    "xi",      "Pi",      "pi",      "rho",
-      "Sigma", "sigma", "tau",   "Upsilon", "upsilon", "Phi",     "phi",
-      "chi",   "Psi",   "psi",   "Omega",   "omega"};
-
-  // Single-token arguments (variables, parameters and constants)
-  std::vector<std::string> singleTokenArgs{"0", "1", "2", "3", "4", "5", "6",
-                                           "7", "8", "9", "x", "y", "z"};
-  if (m_parameters.empty()) {
-    extractParameters();
-  }
-  for (auto const &param : m_parameters) {
-    singleTokenArgs.push_back(param.name);
-  }
-  for (auto const &greekLetter : greekLetters) {
-    singleTokenArgs.emplace_back(greekLetter);
-  }
-
-  // Remove "\" (backslash)
-  std::erase(result, '\\');
-
-  // Replace [,] with \left[,\right]
-  util::replaceAll(result, "[", "\\left[");
-  util::replaceAll(result, "]", "\\right]");
-
-  // Remove whitespaces except line feeds
-  std::erase_if(result, [](char c) {
-    return std::isspace(gsl::narrow_cast<unsigned char>(c)) && c != '\n';
-  });
-
-  // Replace "\n" with "\\\\&" (newline)
-  util::replaceAll(result, "\n", "\\\\&");
-
-  // Replace "**" with "^" (exponentiation)
-  util::replaceAll(result, "**", "^");
-
-  // Convert divisions to fractions
-  result = convertDivisionsToFractions(result);
-
-  // Replace "name" with "\name "
-  for (auto const &name : greekLetters) {
-    auto const with{std::string{"\\"} + name + ' '};
-    util::replaceAll(result, name, with, true);
+  if (m_expression.isValid()) {
+    m_exprMathJax = MathJaxEmitter{m_expression, m_parameters}.emit();
+    return;
   }
 
-  // From inout[pos], replace the first group of srcBrackets with dstBrackets
-  std::pair const srcBrackets{'(', ')'};
-  std::pair dstBrackets{'{', '}'};
-  auto replaceBrackets{[&srcBrackets, &dstBrackets](
-                           std::string &inout, std::string::size_type pos) {
-    if (auto const bracketsPos{getBracketsPos(inout, pos, srcBrackets)};
-        bracketsPos.first != std::string::npos) {
-      inout.at(bracketsPos.first) = dstBrackets.first;
-      inout.at(bracketsPos.second) = dstBrackets.second;
+  // Show the tokens of an invalid expression without backslashes, which
+  // would be read as commands
+  std::string result;
+  for (auto const &token : m_expression.getTokens()) {
+    if (auto const text{m_expression.getText(token)}; text != "\\") {
+      result += text;
     }
-  }};
-
-  // Replace "^expr" with "^{expr}"
-  static RE2 const regexExponent{R"re(\^([a-zA-Z_]*[a-zA-Z0-9_.]*\s*))re"};
-  assert(regexExponent.ok());
-  encloseMatchesInBrackets(result, regexExponent, {'{', '}'});
-
-  // Replace "name(x)" with "name{x}" where x is a single-token argument
-  auto reformatCallWithSingleToken{
-      [&singleTokenArgs](std::string &str, std::string_view name) {
-        for (auto const &variable : singleTokenArgs) {
-          util::replaceAll(str, std::format("{}({})", name, variable),
-                           std::format("{}{{{}}}", name, variable));
-        }
-      }};
-
-  static constexpr std::array functionNames{
-      "asin",  "acos",  "atan", "sinh", "cosh", "tanh", "asinh",
-      "acosh", "atanh", "sin",  "cos",  "tan",  "min",  "max"};
-  for (auto const &name : functionNames) {
-    auto const with{std::string{"\\"} + name};
-    // Replace "name" with "\name"
-    util::replaceAll(result, name, with, true);
-    // f(x) to f{x}
-    reformatCallWithSingleToken(result, with);
   }
-
-  // Replace "exp(...)" with "e^{...}"
-  util::replaceAllAndInvoke(result, "exp", "e^", replaceBrackets, true);
-
-  // Replace "exp2(...)" with "2^{...}"
-  util::replaceAllAndInvoke(result, "exp2", "2^", replaceBrackets, true);
-
-  // Replace "log" with "\ln"
-  util::replaceAll(result, "log", "\\ln", true);
-  reformatCallWithSingleToken(result, "\\ln"); // ln(x) to ln{x}
-
-  // Replace "log2" with "\log_2"
-  util::replaceAll(result, "log2", "\\log_2", true);
-  reformatCallWithSingleToken(result, "\\log_2"); // log_2(x) to log_2{x}
-
-  // Replace "sign" with "\sgn"
-  util::replaceAll(result, "sign", "\\sgn", true);
-  reformatCallWithSingleToken(result, "\\sgn"); // sgn(x) to sgn{x}
-
-  // Replace "sqrt(...)" with "\sqrt{...}"
-  util::replaceAllAndInvoke(result, "sqrt", "\\sqrt", replaceBrackets, true);
-
-  // Replace "abs(...)" with "|...|"
-  dstBrackets = std::pair{'|', '|'};
-  util::replaceAllAndInvoke(result, "abs", "", replaceBrackets, true);
-
-  // Replace "floor(...)" with "@...#"
-  dstBrackets = std::pair{'@', '#'};
-  util::replaceAllAndInvoke(result, "floor", "", replaceBrackets, true);
-
-  // Replace "@" with "\lfloor"
-  util::replaceAll(result, "@", "\\lfloor", false);
-
-  // Replace "#" with "\rfloor"
-  util::replaceAll(result, "#", "\\rfloor", false);
-
-  // Replace "ceil(...)" with "@...#"
-  util::replaceAllAndInvoke(result, "ceil", "", replaceBrackets, true);
-
-  // Replace "@" with "\lceil"
-  util::replaceAll(result, "@", "\\lceil", false);
-
-  // Replace "#" with "\rceil"
-  util::replaceAll(result, "#", "\\rceil", false);
-
-  // Remove "*" (multiplication)
-  std::erase(result, '*');
-
-  // Remove "(x,y,z)"
-  util::replaceAll(result, "(x,y,z)", "", false);
-
-  // Replace "{(...)}" with "{...}"
-  static RE2 const regexNameInParensInCurlyBrackets{R"re(\{\((.+)\)\})re"};
-  assert(regexNameInParensInCurlyBrackets.ok());
-  encloseMatchesInBrackets(result, regexNameInParensInCurlyBrackets,
-                           {'{', '}'});
-
-  // Replace (,) with \left(,\right)
-  util::replaceAll(result, "(", "\\left(");
-  util::replaceAll(result, ")", "\\right)");
-
-  // Remove whitespaces
-  std::erase_if(result, [](char c) {
-    return std::isspace(gsl::narrow_cast<unsigned char>(c));
-  });
-
   m_exprMathJax = result;
-}
\ No newline at end of file
+}
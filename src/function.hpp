@@ -10,6 +10,8 @@
 #ifndef FUNCTION_HPP_
 #define FUNCTION_HPP_
 
+#include "expression.hpp"
+
 #include <abcgOpenGLExternal.hpp>
 
 #include <string>
@@ -49,6 +51,15 @@ public:
     friend bool operator==(Data const &, Data const &) = default;
   };
 
+  // Number of arithmetic operations of one evaluation of the GLSL expression,
+  // as written and after common subexpressions are hoisted into temporaries
+  struct OpCount {
+    std::size_t original{};
+    std::size_t optimized{};
+
+    friend bool operator==(OpCount const &, OpCount const &) = default;
+  };
+
   Function() = default;
   explicit Function(Data data);
 
@@ -59,6 +70,49 @@ public:
   [[nodiscard]] std::string const &getGLSLExpression() const noexcept {
     return m_exprGLSL;
   };
+  // Declarations of the temporaries used by the GLSL expression
+  [[nodiscard]] std::string const &getGLSLTemporaries() const noexcept {
+    return m_codeGLSLTemporaries;
+  }
+  [[nodiscard]] OpCount const &getOpCount() const noexcept { return m_opCount; }
+  // Estimated cost of one evaluation of the function, including its local
+  // code, in arithmetic operations. Transcendental functions and loops of the
+  // local code are weighted by their relative cost.
+  [[nodiscard]] double getEvaluationCost() const noexcept {
+    return m_evaluationCost;
+  }
+  // Statements that return the gradient and the Hessian of the expression,
+  // or empty strings if the function cannot be differentiated symbolically
+  [[nodiscard]] std::string const &getGLSLGradient() const noexcept {
+    return m_codeGLSLGradient;
+  }
+  [[nodiscard]] std::string const &getGLSLHessian() const noexcept {
+    return m_codeGLSLHessian;
+  }
+  [[nodiscard]] bool hasAnalyticDerivatives() const noexcept {
+    return !m_codeGLSLGradient.empty();
+  }
+  // Statements that compute the Bernstein coefficients of the expression
+  // restricted to a segment (see SegmentPolynomial), or an empty string if the
+  // expression is not a polynomial of x, y and z
+  [[nodiscard]] std::string const &getGLSLPolynomial() const noexcept {
+    return m_codeGLSLPolynomial;
+  }
+  [[nodiscard]] int getPolynomialDegree() const noexcept {
+    return m_polynomialDegree;
+  }
+  [[nodiscard]] bool isPolynomial() const noexcept {
+    return m_polynomialDegree > 0;
+  }
+  // Statements that return the interval extension of the expression over a
+  // box (see extendToIntervals), or an empty string if the expression calls a
+  // function with no known interval extension
+  [[nodiscard]] std::string const &getGLSLInterval() const noexcept {
+    return m_codeGLSLInterval;
+  }
+  [[nodiscard]] bool hasIntervalExtension() const noexcept {
+    return !m_codeGLSLInterval.empty();
+  }
   [[nodiscard]] std::string getMathJaxEquation(float isoValue) const;
   [[nodiscard]] GLuint getThumbnailId() const noexcept { return m_thumbnailId; }
   [[nodiscard]] std::vector<Parameter> const &getParameters() const noexcept {
@@ -74,7 +128,16 @@ private:
   void convertToMathJax();
 
   Data m_data{};
+  Expression m_expression;
   std::string m_exprGLSL{"p.x+p.y+p.z"};
+  std::string m_codeGLSLTemporaries;
+  OpCount m_opCount{};
+  double m_evaluationCost{};
+  std::string m_codeGLSLGradient;
+  std::string m_codeGLSLHessian;
+  std::string m_codeGLSLPolynomial;
+  int m_polynomialDegree{};
+  std::string m_codeGLSLInterval;
   std::string m_exprMathJax{"x+y+z"};
   std::vector<Parameter> m_parameters;
   GLuint m_thumbnailId{};
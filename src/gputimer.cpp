@@ -0,0 +1,115 @@
+/**
+ * @file gputimer.cpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#include "gputimer.hpp"
+
+#include <abcgOpenGL.hpp>
+
+#if !defined(GL_TIME_ELAPSED)
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+#if !defined(GL_GPU_DISJOINT_EXT)
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+
+void GPUTimer::create() {
+  destroy();
+
+#if defined(__EMSCRIPTEN__)
+  m_supported = emscripten_webgl_enable_extension(
+      emscripten_webgl_get_current_context(),
+      "EXT_disjoint_timer_query_webgl2");
+#else
+  m_supported = GLEW_VERSION_3_3 != 0U || GLEW_ARB_timer_query != 0U;
+#endif
+  if (!m_supported) {
+    return;
+  }
+
+  for (auto &query : m_queries) {
+    abcg::glGenQueries(1, &query.id);
+  }
+}
+
+void GPUTimer::destroy() {
+  if (m_measuring) {
+    abcg::glEndQuery(GL_TIME_ELAPSED);
+    m_measuring = false;
+  }
+  for (auto &query : m_queries) {
+    if (query.id != 0) {
+      abcg::glDeleteQueries(1, &query.id);
+    }
+    query = {};
+  }
+  m_next = 0;
+  m_numPending = 0;
+  m_supported = false;
+}
+
+bool GPUTimer::begin() {
+  if (!m_supported || m_measuring || m_numPending == kNumQueries) {
+    return false;
+  }
+  abcg::glBeginQuery(GL_TIME_ELAPSED, m_queries.at(m_next).id);
+  m_measuring = true;
+  return true;
+}
+
+void GPUTimer::end(double workload) {
+  if (!m_measuring) {
+    return;
+  }
+  abcg::glEndQuery(GL_TIME_ELAPSED);
+  m_measuring = false;
+
+  auto &query{m_queries.at(m_next)};
+  query.workload = workload;
+  query.discarded = false;
+  m_next = (m_next + 1) % kNumQueries;
+  ++m_numPending;
+}
+
+std::vector<GPUTimer::Sample> GPUTimer::poll() {
+  std::vector<Sample> samples;
+  while (m_numPending > 0) {
+    auto &query{
+        m_queries.at((m_next + kNumQueries - m_numPending) % kNumQueries)};
+    GLuint available{};
+    abcg::glGetQueryObjectuiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available == GL_FALSE) {
+      break;
+    }
+    // 32 bits of nanoseconds are enough for up to 4 seconds per query
+    GLuint nanoseconds{};
+    abcg::glGetQueryObjectuiv(query.id, GL_QUERY_RESULT, &nanoseconds);
+    --m_numPending;
+    if (!query.discarded && query.workload > 0.0) {
+      samples.push_back({.seconds = static_cast<double>(nanoseconds) * 1e-9,
+                         .workload = query.workload});
+    }
+  }
+
+#if defined(__EMSCRIPTEN__)
+  // Results are undefined if the GPU was disjoint while measuring
+  GLint disjoint{};
+  abcg::glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+  if (disjoint != 0) {
+    samples.clear();
+  }
+#endif
+
+  return samples;
+}
+
+void GPUTimer::discardPending() noexcept {
+  for (auto &query : m_queries) {
+    query.discarded = true;
+  }
+}
@@ -0,0 +1,79 @@
+/**
+ * @file gputimer.hpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#ifndef GPUTIMER_HPP_
+#define GPUTIMER_HPP_
+
+#include <abcgOpenGLExternal.hpp>
+
+#include <array>
+#include <vector>
+
+// Measures the GPU time of groups of commands with GL_TIME_ELAPSED queries.
+//
+// Queries are kept in a ring buffer and their results are only read once
+// available, so measuring never stalls the pipeline. Results arrive a few
+// frames late, together with the workload given when the query ended (e.g.,
+// the number of pixels rendered). When all queries are pending, commands are
+// not measured.
+//
+// Timer queries require OpenGL 3.3 or EXT_disjoint_timer_query_webgl2 in the
+// WebAssembly build. In WebGL, results are discarded when the GPU reports a
+// disjoint operation (e.g., a change of clock frequency).
+class GPUTimer {
+public:
+  static constexpr std::size_t kNumQueries{4};
+
+  struct Sample {
+    double seconds{};
+    double workload{};
+  };
+
+  GPUTimer() = default;
+  ~GPUTimer() { destroy(); }
+
+  GPUTimer(GPUTimer const &) = delete;
+  GPUTimer &operator=(GPUTimer const &) = delete;
+  GPUTimer(GPUTimer &&) = delete;
+  GPUTimer &operator=(GPUTimer &&) = delete;
+
+  void create();
+  void destroy();
+
+  [[nodiscard]] bool isSupported() const noexcept { return m_supported; }
+
+  // Starts measuring the commands issued until end. Returns false if timer
+  // queries are not supported or all of them are pending.
+  bool begin();
+  void end(double workload);
+
+  // Returns the samples of the queries that finished since the last call,
+  // oldest first.
+  [[nodiscard]] std::vector<Sample> poll();
+
+  // Discards the results of the pending queries, e.g., after the measured
+  // workload changed.
+  void discardPending() noexcept;
+
+private:
+  struct Query {
+    GLuint id{};
+    double workload{};
+    bool discarded{};
+  };
+
+  std::array<Query, kNumQueries> m_queries{};
+  // Index of the next query to begin
+  std::size_t m_next{};
+  std::size_t m_numPending{};
+  bool m_supported{};
+  bool m_measuring{};
+};
+
+#endif
@@ -0,0 +1,253 @@
+/**
+ * @file interval.cpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#include "interval.hpp"
+
+#include "util.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+using NodeKind = Expression::NodeKind;
+
+// Thrown when the expression has no interval extension
+class NoIntervalExtension : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+constexpr std::array<std::string_view, 3> kCoordinates{"x", "y", "z"};
+
+struct Signature {
+  std::string_view name;
+  std::size_t numArguments{};
+};
+
+// Functions that are monotonically increasing in each argument. Their
+// interval extension is the function itself, since GLSL applies it to both
+// bounds.
+constexpr std::array kIncreasingFunctions{
+    Signature{"exp", 1},     Signature{"exp2", 1},  Signature{"sinh", 1},
+    Signature{"tanh", 1},    Signature{"asinh", 1}, Signature{"atan", 1},
+    Signature{"sign", 1},    Signature{"floor", 1}, Signature{"ceil", 1},
+    Signature{"round", 1},   Signature{"trunc", 1}, Signature{"radians", 1},
+    Signature{"degrees", 1}, Signature{"min", 2},   Signature{"max", 2}};
+
+// Functions whose interval extension is the function of raycast.frag of the
+// same name prefixed with 'i'
+constexpr std::array kIntervalFunctions{
+    Signature{"sin", 1},        Signature{"cos", 1},
+    Signature{"tan", 1},        Signature{"asin", 1},
+    Signature{"acos", 1},       Signature{"atan", 2},
+    Signature{"cosh", 1},       Signature{"acosh", 1},
+    Signature{"atanh", 1},      Signature{"log", 1},
+    Signature{"log2", 1},       Signature{"sqrt", 1},
+    Signature{"inversesqrt", 1}, Signature{"abs", 1},
+    Signature{"fract", 1},      Signature{"mod", 2},
+    Signature{"step", 2},       Signature{"pow", 2},
+    Signature{"clamp", 3},      Signature{"mix", 3},
+    Signature{"smoothstep", 3}};
+
+// Upper bound of the absolute value of an exponent evaluated by repeated
+// squaring
+constexpr double kMaxIntegerExponent{64.0};
+
+bool isInteger(double value) { return value == std::trunc(value); }
+
+class IntervalEmitter {
+public:
+  IntervalEmitter(Expression const &expression,
+                  std::string_view temporaryPrefix)
+      : m_expression{expression}, m_valueNumbers{expression.numberValues()},
+        m_temporaryPrefix{temporaryPrefix} {
+    m_intervals.resize(std::ranges::max(m_valueNumbers) + std::size_t{1});
+  }
+
+  std::string emitCode() {
+    auto const root{emit(m_expression.getRoot())};
+    m_code += std::format("return {};\n", root);
+    return std::move(m_code);
+  }
+
+private:
+  // Returns the interval of a node: the name of its temporary, the code of a
+  // coordinate, or the constructor of a constant interval. Only nodes that
+  // the root depends on are evaluated.
+  std::string emit(Expression::Node const &node);
+  // Declares a temporary initialized with the given code and returns its name
+  std::string declare(std::string_view code);
+  std::string convertTerms(Expression::Node const &node);
+  std::string convertPower(Expression::Node const &node);
+  std::string convertCall(Expression::Node const &node);
+  [[nodiscard]] std::optional<double>
+  getConstantValue(Expression::Node const &node) const;
+
+  Expression const &m_expression;
+  std::vector<std::uint32_t> m_valueNumbers;
+  std::string_view m_temporaryPrefix;
+  // Interval of each value number, or an empty string if not evaluated yet
+  std::vector<std::string> m_intervals;
+  std::size_t m_numTemporaries{};
+  std::string m_code;
+};
+
+std::string IntervalEmitter::emit(Expression::Node const &node) {
+  auto const index{std::distance(m_expression.getNodes().data(), &node)};
+  auto const value{m_valueNumbers.at(gsl::narrow_cast<std::size_t>(index))};
+  if (!m_intervals.at(value).empty()) {
+    return m_intervals.at(value);
+  }
+
+  std::string interval;
+  auto const text{m_expression.getText(node)};
+  switch (node.kind) {
+  case NodeKind::Number:
+    interval = std::format("vec2({})", util::formatFloat(node.value));
+    break;
+  case NodeKind::Identifier:
+    interval = std::ranges::find(kCoordinates, text) != kCoordinates.end()
+                   ? std::format("@P.@{}", text)
+                   : std::format("vec2({})", text);
+    break;
+  case NodeKind::Group:
+  case NodeKind::Identity:
+    interval = emit(m_expression.getOperand(node, 0));
+    break;
+  case NodeKind::Negate:
+    interval = declare(
+        std::format("ineg({})", emit(m_expression.getOperand(node, 0))));
+    break;
+  case NodeKind::Sum:
+  case NodeKind::Product:
+    interval = declare(convertTerms(node));
+    break;
+  case NodeKind::Power:
+    interval = declare(convertPower(node));
+    break;
+  case NodeKind::Call:
+    interval = declare(convertCall(node));
+    break;
+  }
+  m_intervals.at(value) = interval;
+  return interval;
+}
+
+std::string IntervalEmitter::declare(std::string_view code) {
+  auto name{std::format("{}{}", m_temporaryPrefix, m_numTemporaries++)};
+  m_code += std::format("vec2 {}={};\n", name, code);
+  return name;
+}
+
+// Sums and products are evaluated from left to right
+std::string IntervalEmitter::convertTerms(Expression::Node const &node) {
+  std::string result;
+  for (auto const &operand : m_expression.getOperands(node)) {
+    auto const term{emit(m_expression.getNode(operand.node))};
+    if (result.empty()) {
+      result = operand.op == '-' ? std::format("ineg({})", term) : term;
+      continue;
+    }
+    auto const *function{operand.op == '-'   ? "isub"
+                         : operand.op == '/' ? "idiv"
+                         : operand.op == '*' ? "imul"
+                                             : "iadd"};
+    result = std::format("{}({},{})", function, result, term);
+  }
+  return result;
+}
+
+// Powers with constant integer exponents are evaluated by repeated squaring,
+// which is also defined for negative bases
+std::string IntervalEmitter::convertPower(Expression::Node const &node) {
+  auto const &base{m_expression.getOperand(node, 0)};
+  auto const &exponent{m_expression.getOperand(node, 1)};
+  auto const value{getConstantValue(exponent)};
+  if (!value) {
+    return std::format("ipow({},{})", emit(base), emit(exponent));
+  }
+  if (*value == 0.0) {
+    return "vec2(1.0)";
+  }
+  if (!isInteger(*value) || std::abs(*value) > kMaxIntegerExponent) {
+    return std::format("ipow({},{})", emit(base), util::formatFloat(*value));
+  }
+  auto const integerValue{gsl::narrow_cast<int>(*value)};
+  if (integerValue < 0) {
+    return std::format("idiv(vec2(1.0),ipow({},{}))", emit(base),
+                       -integerValue);
+  }
+  return std::format("ipow({},{})", emit(base), integerValue);
+}
+
+std::string IntervalEmitter::convertCall(Expression::Node const &node) {
+  auto const name{m_expression.getText(node)};
+  auto const numArguments{std::size_t{node.numOperands}};
+  auto const isCalled{[&](auto const &function) {
+    return function.name == name && function.numArguments == numArguments;
+  }};
+
+  std::string function;
+  if (std::ranges::any_of(kIncreasingFunctions, isCalled)) {
+    function = name;
+  } else if (std::ranges::any_of(kIntervalFunctions, isCalled)) {
+    function = std::format("i{}", name);
+  } else {
+    throw NoIntervalExtension(std::format("Unknown interval of {}", name));
+  }
+
+  std::string arguments;
+  for (auto const &operand : m_expression.getOperands(node)) {
+    if (!arguments.empty()) {
+      arguments += ',';
+    }
+    arguments += emit(m_expression.getNode(operand.node));
+  }
+  return std::format("{}({})", function, arguments);
+}
+
+// Returns the value of a number, possibly grouped or negated
+std::optional<double>
+IntervalEmitter::getConstantValue(Expression::Node const &node) const {
+  switch (node.kind) {
+  case NodeKind::Number:
+    return node.value;
+  case NodeKind::Group:
+  case NodeKind::Identity:
+    return getConstantValue(m_expression.getOperand(node, 0));
+  case NodeKind::Negate:
+    if (auto const value{getConstantValue(m_expression.getOperand(node, 0))}) {
+      return -*value;
+    }
+    return std::nullopt;
+  default:
+    return std::nullopt;
+  }
+}
+
+} // namespace
+
+std::optional<std::string>
+extendToIntervals(Expression const &expression,
+                  std::string_view temporaryPrefix) {
+  if (!expression.isValid()) {
+    return std::nullopt;
+  }
+
+  try {
+    return IntervalEmitter{expression, temporaryPrefix}.emitCode();
+  } catch (NoIntervalExtension const &) {
+    return std::nullopt;
+  }
+}
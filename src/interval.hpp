@@ -0,0 +1,37 @@
+/**
+ * @file interval.hpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#ifndef INTERVAL_HPP_
+#define INTERVAL_HPP_
+
+#include "expression.hpp"
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Generates the GLSL code of the interval extension of a valid expression.
+//
+// The code evaluates the expression with intervals stored as vec2 (lower and
+// upper bounds) and returns an interval that contains every value of the
+// expression in a box. The coordinates are written as @P.@x, @P.@y and @P.@z,
+// which must be the intervals of the box, and any other name is a constant
+// interval. Operators and functions are evaluated by the interval functions
+// of raycast.frag (iadd, imul, isin, ...), or by the built-in function itself
+// if it is monotonically increasing. Each node is evaluated once into a
+// temporary named with 'temporaryPrefix' followed by a number, and nodes of
+// equal value share their temporary.
+//
+// Returns std::nullopt if the expression calls a function with no known
+// interval extension.
+[[nodiscard]] std::optional<std::string>
+extendToIntervals(Expression const &expression,
+                  std::string_view temporaryPrefix);
+
+#endif
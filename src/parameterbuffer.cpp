@@ -0,0 +1,88 @@
+/**
+ * @file parameterbuffer.cpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#include "parameterbuffer.hpp"
+
+#include <abcgOpenGL.hpp>
+
+void ParameterBuffer::create(GLuint bindingPoint) {
+  destroy();
+
+  abcg::glGenBuffers(1, &m_buffer);
+  m_values.assign(getNumVectors(0) * 4, 0.0f);
+  m_capacity = m_values.size();
+
+  abcg::glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+  abcg::glBufferData(GL_UNIFORM_BUFFER,
+                     gsl::narrow<GLsizeiptr>(m_capacity * sizeof(float)),
+                     m_values.data(), GL_DYNAMIC_DRAW);
+  abcg::glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+  abcg::glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, m_buffer);
+}
+
+void ParameterBuffer::update(
+    std::vector<Function::Parameter> const &parameters) {
+  auto const range{pack(parameters)};
+  if (!range.has_value()) {
+    return;
+  }
+
+  abcg::glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+  if (m_values.size() > m_capacity) {
+    // Reallocating keeps the buffer bound to its binding point
+    m_capacity = m_values.size();
+    abcg::glBufferData(GL_UNIFORM_BUFFER,
+                       gsl::narrow<GLsizeiptr>(m_capacity * sizeof(float)),
+                       m_values.data(), GL_DYNAMIC_DRAW);
+  } else {
+    abcg::glBufferSubData(
+        GL_UNIFORM_BUFFER,
+        gsl::narrow<GLintptr>(range->offset * sizeof(float)),
+        gsl::narrow<GLsizeiptr>(range->count * sizeof(float)),
+        &m_values.at(range->offset));
+  }
+  abcg::glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void ParameterBuffer::destroy() {
+  if (m_buffer != 0) {
+    abcg::glDeleteBuffers(1, &m_buffer);
+    m_buffer = 0;
+  }
+  m_capacity = 0;
+  m_values.clear();
+}
+
+std::optional<ParameterBuffer::Range>
+ParameterBuffer::pack(std::vector<Function::Parameter> const &parameters) {
+  auto const numValues{getNumVectors(parameters.size()) * 4};
+  if (m_values.size() != numValues) {
+    m_values.assign(numValues, 0.0f);
+    for (auto const index : iter::range(parameters.size())) {
+      m_values[index] = parameters[index].value;
+    }
+    return Range{.offset = 0, .count = numValues};
+  }
+
+  std::optional<Range> range;
+  for (auto const index : iter::range(parameters.size())) {
+    auto const value{parameters[index].value};
+    if (m_values[index] == value) {
+      continue;
+    }
+    m_values[index] = value;
+    if (!range.has_value()) {
+      range = Range{.offset = index, .count = 1};
+    } else {
+      range->count = index - range->offset + 1;
+    }
+  }
+  return range;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file parameterbuffer.hpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#ifndef PARAMETERBUFFER_HPP_
+#define PARAMETERBUFFER_HPP_
+
+#include "function.hpp"
+
+#include <abcgOpenGLExternal.hpp>
+
+#include <algorithm>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Uniform buffer with the values of the parameters of a function, packed into
+// the vec4 array of the ParamsBlock uniform block of raycast.frag.
+//
+// The array has getNumVectors elements, so the program must be built for the
+// number of parameters. The buffer grows as needed, up to the maximum size of
+// a uniform block, which is at least 16 KB (4096 parameters). Only the values
+// that changed since the last update are uploaded.
+class ParameterBuffer {
+public:
+  // Range of elements of getValues
+  struct Range {
+    std::size_t offset{};
+    std::size_t count{};
+
+    friend bool operator==(Range const &, Range const &) = default;
+  };
+
+  ParameterBuffer() = default;
+  ~ParameterBuffer() { destroy(); }
+
+  ParameterBuffer(ParameterBuffer const &) = delete;
+  ParameterBuffer &operator=(ParameterBuffer const &) = delete;
+  ParameterBuffer(ParameterBuffer &&) = delete;
+  ParameterBuffer &operator=(ParameterBuffer &&) = delete;
+
+  // Returns the number of vec4 elements that hold the given number of
+  // parameters. Arrays cannot be empty, so it is at least one.
+  [[nodiscard]] static constexpr std::size_t
+  getNumVectors(std::size_t numParameters) noexcept {
+    return std::max<std::size_t>(1, (numParameters + 3) / 4);
+  }
+
+  // Creates the buffer and binds it to the given binding point.
+  void create(GLuint bindingPoint);
+  // Packs and uploads the values of the parameters.
+  void update(std::vector<Function::Parameter> const &parameters);
+  void destroy();
+
+  // Packs the values of the parameters, and returns the range of values that
+  // differ from the ones previously packed, if any.
+  [[nodiscard]] std::optional<Range>
+  pack(std::vector<Function::Parameter> const &parameters);
+
+  [[nodiscard]] std::span<float const> getValues() const noexcept {
+    return m_values;
+  }
+
+private:
+  GLuint m_buffer{};
+  // Number of values the buffer can hold
+  std::size_t m_capacity{};
+  std::vector<float> m_values;
+};
+
+#endif
@@ -0,0 +1,449 @@
+/**
+ * @file polynomial.cpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#include "polynomial.hpp"
+
+#include "util.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+using NodeKind = Expression::NodeKind;
+
+// Thrown when the expression is not a polynomial
+class NotPolynomial : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+constexpr std::array<std::string_view, 3> kCoordinates{"x", "y", "z"};
+
+bool isInteger(double value) { return value == std::trunc(value); }
+
+// Polynomial of the coordinates and of the remaining names of an expression.
+// Exponents are indexed by variable: the coordinates x, y, z come first,
+// followed by the other names. Only the other names may have negative
+// exponents.
+using Exponents = std::vector<int>;
+using Terms = std::map<Exponents, double>;
+
+class PolynomialExpander {
+public:
+  // Upper bound of the number of terms of any intermediate polynomial
+  static constexpr std::size_t kMaxTerms{std::size_t{1} << 12};
+  // Upper bound of the absolute value of the integer exponent of a power
+  static constexpr double kMaxExponent{64.0};
+
+  explicit PolynomialExpander(Expression const &expression);
+
+  [[nodiscard]] Terms expand() const;
+  [[nodiscard]] std::span<std::string_view const> getNames() const noexcept {
+    return m_names;
+  }
+
+private:
+  [[nodiscard]] Terms constant(double value) const;
+  [[nodiscard]] Terms variable(std::string_view name) const;
+  [[nodiscard]] static Terms scale(Terms terms, double factor);
+  [[nodiscard]] static Terms add(Terms lhs, Terms const &rhs);
+  [[nodiscard]] static Terms multiply(Terms const &lhs, Terms const &rhs);
+  [[nodiscard]] static Terms reciprocal(Terms const &terms);
+  [[nodiscard]] Terms power(Terms const &base, Terms const &exponent) const;
+  [[nodiscard]] Terms convertCall(std::string_view name,
+                                  std::span<Terms const> arguments) const;
+
+  Expression const &m_expression;
+  // Names of the variables, starting with the coordinates
+  std::vector<std::string_view> m_names{kCoordinates.begin(),
+                                        kCoordinates.end()};
+};
+
+int getDegree(Exponents const &exponents) {
+  return exponents[0] + exponents[1] + exponents[2];
+}
+
+bool isCoordinateFree(Exponents const &exponents) {
+  return getDegree(exponents) == 0;
+}
+
+std::optional<double> getConstantValue(Terms const &terms) {
+  if (terms.empty()) {
+    return 0.0;
+  }
+  if (auto const &[exponents, coefficient]{*terms.begin()};
+      terms.size() == 1 &&
+      std::ranges::all_of(exponents, [](int e) { return e == 0; })) {
+    return coefficient;
+  }
+  return std::nullopt;
+}
+
+PolynomialExpander::PolynomialExpander(Expression const &expression)
+    : m_expression{expression} {
+  for (auto const &node : expression.getNodes()) {
+    if (node.kind != NodeKind::Identifier) {
+      continue;
+    }
+    if (auto const name{expression.getText(node)};
+        std::ranges::find(m_names, name) == m_names.end()) {
+      m_names.push_back(name);
+    }
+  }
+}
+
+Terms PolynomialExpander::expand() const {
+  auto const nodes{m_expression.getNodes()};
+  std::vector<Terms> polynomials(nodes.size());
+  for (std::size_t index{}; index < nodes.size(); ++index) {
+    auto const &node{nodes[index]};
+    std::vector<Terms> operands;
+    for (auto const &operand : m_expression.getOperands(node)) {
+      auto &terms{polynomials[operand.node]};
+      if (operand.op == '-') {
+        operands.push_back(scale(std::move(terms), -1.0));
+      } else if (operand.op == '/') {
+        operands.push_back(reciprocal(terms));
+      } else {
+        operands.push_back(std::move(terms));
+      }
+    }
+
+    auto &result{polynomials[index]};
+    switch (node.kind) {
+    case NodeKind::Number:
+      result = constant(node.value);
+      break;
+    case NodeKind::Identifier:
+      result = variable(m_expression.getText(node));
+      break;
+    case NodeKind::Call:
+      result = convertCall(m_expression.getText(node), operands);
+      break;
+    case NodeKind::Group:
+    case NodeKind::Identity:
+      result = std::move(operands.front());
+      break;
+    case NodeKind::Negate:
+      result = scale(std::move(operands.front()), -1.0);
+      break;
+    case NodeKind::Sum:
+      result = std::move(operands.front());
+      for (auto const &operand : std::span{operands}.subspan(1)) {
+        result = add(std::move(result), operand);
+      }
+      break;
+    case NodeKind::Product:
+      result = std::move(operands.front());
+      for (auto const &operand : std::span{operands}.subspan(1)) {
+        result = multiply(result, operand);
+      }
+      break;
+    case NodeKind::Power:
+      result = power(operands[0], operands[1]);
+      break;
+    }
+  }
+  return std::move(polynomials.back());
+}
+
+Terms PolynomialExpander::constant(double value) const {
+  if (!std::isfinite(value)) {
+    throw NotPolynomial{"Non-finite constant"};
+  }
+  if (value == 0.0) {
+    return {};
+  }
+  return {{Exponents(m_names.size()), value}};
+}
+
+Terms PolynomialExpander::variable(std::string_view name) const {
+  Exponents exponents(m_names.size());
+  auto const itr{std::ranges::find(m_names, name)};
+  exponents.at(static_cast<std::size_t>(itr - m_names.begin())) = 1;
+  return {{std::move(exponents), 1.0}};
+}
+
+Terms PolynomialExpander::scale(Terms terms, double factor) {
+  for (auto &[exponents, coefficient] : terms) {
+    coefficient *= factor;
+  }
+  return terms;
+}
+
+Terms PolynomialExpander::add(Terms lhs, Terms const &rhs) {
+  for (auto const &[exponents, coefficient] : rhs) {
+    auto const [itr, inserted]{lhs.try_emplace(exponents, coefficient)};
+    if (!inserted) {
+      itr->second += coefficient;
+      if (itr->second == 0.0) {
+        lhs.erase(itr);
+      }
+    }
+  }
+  if (lhs.size() > kMaxTerms) {
+    throw NotPolynomial{"Too many terms"};
+  }
+  return lhs;
+}
+
+Terms PolynomialExpander::multiply(Terms const &lhs, Terms const &rhs) {
+  Terms result;
+  for (auto const &[lhsExponents, lhsCoefficient] : lhs) {
+    for (auto const &[rhsExponents, rhsCoefficient] : rhs) {
+      auto exponents{lhsExponents};
+      for (std::size_t index{}; index < exponents.size(); ++index) {
+        exponents[index] += rhsExponents[index];
+      }
+      if (getDegree(exponents) > SegmentPolynomial::kMaxDegree) {
+        throw NotPolynomial{"Degree too high"};
+      }
+      result = add(std::move(result),
+                   {{std::move(exponents), lhsCoefficient * rhsCoefficient}});
+    }
+  }
+  return result;
+}
+
+// Only monomials without coordinates have a reciprocal
+Terms PolynomialExpander::reciprocal(Terms const &terms) {
+  if (terms.size() != 1 || !isCoordinateFree(terms.begin()->first)) {
+    throw NotPolynomial{"Division by a polynomial"};
+  }
+  auto const &[exponents, coefficient]{*terms.begin()};
+  Exponents inverse(exponents.size());
+  std::ranges::transform(exponents, inverse.begin(), std::negate{});
+  return {{std::move(inverse), 1.0 / coefficient}};
+}
+
+Terms PolynomialExpander::power(Terms const &base,
+                                Terms const &exponent) const {
+  auto const value{getConstantValue(exponent)};
+  if (!value) {
+    throw NotPolynomial{"Non-constant exponent"};
+  }
+  if (auto const baseValue{getConstantValue(base)}) {
+    return constant(std::pow(*baseValue, *value));
+  }
+  if (!isInteger(*value) || std::abs(*value) > kMaxExponent) {
+    throw NotPolynomial{"Non-integer exponent"};
+  }
+
+  auto const count{static_cast<int>(std::abs(*value))};
+  Terms result{constant(1.0)};
+  for (auto step{0}; step < count; ++step) {
+    result = multiply(result, base);
+  }
+  return *value < 0.0 ? reciprocal(result) : result;
+}
+
+Terms PolynomialExpander::convertCall(std::string_view name,
+                                      std::span<Terms const> arguments) const {
+  if (name == "pow" && arguments.size() == 2) {
+    return power(arguments[0], arguments[1]);
+  }
+  // Square roots of numbers, as in the coefficient sqrt(5)
+  if (name == "sqrt" && arguments.size() == 1) {
+    if (auto const value{getConstantValue(arguments[0])}) {
+      return constant(std::sqrt(*value));
+    }
+  }
+  throw NotPolynomial{"Function call"};
+}
+
+// Monomial of the coordinates with a coefficient written in GLSL
+struct Monomial {
+  std::array<int, 3> exponents{};
+  std::string coefficient;
+};
+
+// Writes the coefficients of the terms with the same coordinate exponents as
+// GLSL expressions of the other names.
+std::vector<Monomial>
+collectMonomials(Terms const &terms, std::span<std::string_view const> names) {
+  std::map<std::array<int, 3>, std::string, std::greater<>> coefficients;
+  for (auto const &[exponents, coefficient] : terms) {
+    auto &code{coefficients[{exponents[0], exponents[1], exponents[2]}]};
+    if (!code.empty() || coefficient < 0.0) {
+      code += coefficient < 0.0 ? '-' : '+';
+    }
+
+    std::string factors;
+    std::string divisors;
+    for (std::size_t index{kCoordinates.size()}; index < exponents.size();
+         ++index) {
+      auto &text{exponents[index] > 0 ? factors : divisors};
+      for (auto count{std::abs(exponents[index])}; count > 0; --count) {
+        text += exponents[index] > 0 ? '*' : '/';
+        text += names[index];
+      }
+    }
+
+    auto const magnitude{std::abs(coefficient)};
+    if (magnitude == 1.0 && !factors.empty()) {
+      code += std::string_view{factors}.substr(1);
+    } else {
+      code += util::formatFloat(magnitude);
+      code += factors;
+    }
+    code += divisors;
+  }
+
+  std::vector<Monomial> monomials;
+  monomials.reserve(coefficients.size());
+  for (auto &[exponents, coefficient] : coefficients) {
+    monomials.push_back({exponents, std::move(coefficient)});
+  }
+  return monomials;
+}
+
+// Writes the code that evaluates a sum of monomials on a segment by Horner's
+// rule in the Bernstein basis.
+//
+// Monomials are sorted in decreasing order of exponents, and are grouped by
+// the exponent of x, then y, then z. At each level, the groups are
+// accumulated as p = p * c^(e - e') + q, where c is the coordinate of the
+// level, e and e' are the exponents of consecutive groups, and q is the next
+// group. Multiplying by a coordinate, which is linear in s, raises the degree
+// by one. Polynomials of different degrees are added after raising the degree
+// of the lower one, which is the product by the constant 1 = (1 - s) + s.
+class BernsteinWriter {
+public:
+  explicit BernsteinWriter(std::span<Monomial const> monomials)
+      : m_monomials{monomials} {}
+
+  [[nodiscard]] std::string write(int degree) {
+    auto result{emit(0, m_monomials, 0)};
+    while (result < degree) {
+      elevate(0, result);
+    }
+    return std::move(m_code);
+  }
+
+private:
+  static constexpr std::array<std::string_view, 3> kArrays{"polyX", "polyY",
+                                                           "polyZ"};
+
+  int emit(std::size_t level, std::span<Monomial const> monomials,
+           std::size_t target);
+  void multiply(std::size_t target, int &degree, std::size_t level);
+  void elevate(std::size_t target, int &degree);
+
+  std::span<Monomial const> m_monomials;
+  std::string m_code;
+};
+
+// Writes the sum of the monomials to the array 'target' and returns its degree
+int BernsteinWriter::emit(std::size_t level,
+                          std::span<Monomial const> monomials,
+                          std::size_t target) {
+  auto degree{0};
+  auto previous{-1};
+  while (!monomials.empty()) {
+    auto const exponent{monomials.front().exponents.at(level)};
+    auto const size{static_cast<std::size_t>(std::ranges::find_if(
+                        monomials,
+                        [level, exponent](auto const &monomial) {
+                          return monomial.exponents.at(level) != exponent;
+                        }) -
+                    monomials.begin())};
+    auto const group{monomials.first(size)};
+    monomials = monomials.subspan(size);
+
+    // A group is a constant if its only monomial has no remaining coordinate
+    auto const isConstant{
+        group.size() == 1 &&
+        std::ranges::all_of(
+            std::span{group.front().exponents}.subspan(level + 1),
+            [](int e) { return e == 0; })};
+    auto const &coefficient{group.front().coefficient};
+
+    if (previous < 0) {
+      if (isConstant) {
+        m_code += std::format("{}[0]={};\n", kArrays.at(target), coefficient);
+      } else {
+        degree = emit(level + 1, group, target);
+      }
+    } else {
+      for (; previous > exponent; --previous) {
+        multiply(target, degree, level);
+      }
+      if (isConstant) {
+        m_code += std::format("bernsteinAdd({},{},{});\n", kArrays.at(target),
+                              degree, coefficient);
+      } else {
+        auto const scratch{level + 1};
+        auto groupDegree{emit(level + 1, group, scratch)};
+        while (groupDegree < degree) {
+          elevate(scratch, groupDegree);
+        }
+        while (degree < groupDegree) {
+          elevate(target, degree);
+        }
+        m_code += std::format("bernsteinAdd({},{},{});\n", kArrays.at(target),
+                              degree, kArrays.at(scratch));
+      }
+    }
+    previous = exponent;
+  }
+
+  for (; previous > 0; --previous) {
+    multiply(target, degree, level);
+  }
+  return degree;
+}
+
+void BernsteinWriter::multiply(std::size_t target, int &degree,
+                               std::size_t level) {
+  auto const coordinate{kCoordinates.at(level)};
+  m_code += std::format("bernsteinMul({},{},P0.{},P1.{});\n",
+                        kArrays.at(target), degree, coordinate, coordinate);
+  ++degree;
+}
+
+void BernsteinWriter::elevate(std::size_t target, int &degree) {
+  m_code += std::format("bernsteinMul({},{},1.0,1.0);\n", kArrays.at(target),
+                        degree);
+  ++degree;
+}
+
+} // namespace
+
+std::optional<SegmentPolynomial>
+expandPolynomial(Expression const &expression) {
+  if (!expression.isValid()) {
+    return std::nullopt;
+  }
+
+  try {
+    PolynomialExpander const expander{expression};
+    auto const terms{expander.expand()};
+
+    auto degree{0};
+    for (auto const &[exponents, coefficient] : terms) {
+      degree = std::max(degree, getDegree(exponents));
+    }
+    if (degree < 1) {
+      return std::nullopt;
+    }
+
+    auto const monomials{collectMonomials(terms, expander.getNames())};
+    return SegmentPolynomial{.degree = degree,
+                             .code = BernsteinWriter{monomials}.write(degree)};
+  } catch (NotPolynomial const &) {
+    return std::nullopt;
+  }
+}
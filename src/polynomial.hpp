@@ -0,0 +1,46 @@
+/**
+ * @file polynomial.hpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#ifndef POLYNOMIAL_HPP_
+#define POLYNOMIAL_HPP_
+
+#include "expression.hpp"
+
+#include <optional>
+#include <string>
+
+// GLSL code that restricts a polynomial expression to a line segment.
+//
+// Along the segment from P0 to P1, the expression is a univariate polynomial
+// of s in [0, 1]. The code writes the coefficients of that polynomial in the
+// Bernstein basis of the given degree to the array polyX, using polyY and
+// polyZ as scratch arrays, and the functions bernsteinMul and bernsteinAdd of
+// raycast.frag.
+struct SegmentPolynomial {
+  static constexpr int kMaxDegree{10};
+
+  int degree{};
+  std::string code;
+
+  friend bool operator==(SegmentPolynomial const &,
+                         SegmentPolynomial const &) = default;
+};
+
+// Expands a valid expression into a sum of monomials of the coordinates x, y
+// and z, and generates the code that evaluates it by Horner's rule on a
+// segment.
+//
+// Coefficients may contain any other name, such as a parameter, since names
+// are constant along the segment. Returns std::nullopt if the expression is
+// not a polynomial of x, y and z, for instance if it calls a function or
+// divides by a coordinate, or if its degree is not in [1, kMaxDegree].
+[[nodiscard]] std::optional<SegmentPolynomial>
+expandPolynomial(Expression const &expression);
+
+#endif
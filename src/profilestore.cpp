@@ -0,0 +1,156 @@
+/**
+ * @file profilestore.cpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#include "profilestore.hpp"
+
+#include "util.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+constexpr std::string_view kFileHeader{"ImpVis profiles 1"};
+constexpr std::string_view kFileName{"profiles.txt"};
+
+} // namespace
+
+void ProfileStore::onCreate(std::size_t maxEntries) {
+  m_maxEntries = maxEntries;
+  m_entries.clear();
+  m_useCount = 0;
+  m_modified = false;
+  m_path.clear();
+
+#if !defined(__EMSCRIPTEN__)
+  auto const prefPath{util::getPrefPath()};
+  if (prefPath.empty()) {
+    return;
+  }
+  m_path = prefPath / kFileName;
+  load();
+#endif
+}
+
+void ProfileStore::onDestroy() {
+  save();
+#if !defined(__EMSCRIPTEN__)
+  if (m_writer.joinable()) {
+    m_writer.join();
+  }
+#endif
+}
+
+std::optional<ProfileStore::Profile> ProfileStore::find(std::uint64_t key) {
+  auto const itr{m_entries.find(key)};
+  if (itr == m_entries.end()) {
+    return std::nullopt;
+  }
+  // Only refreshes the LRU stamp, which alone is not worth a write
+  itr->second.lastUse = ++m_useCount;
+  return itr->second.profile;
+}
+
+void ProfileStore::update(std::uint64_t key, Profile const &profile) {
+  m_entries.insert_or_assign(
+      key, Entry{.profile = profile, .lastUse = ++m_useCount});
+  m_modified = true;
+
+  if (m_entries.size() > m_maxEntries) {
+    auto const leastRecentlyUsed{std::ranges::min_element(
+        m_entries, {}, [](auto const &entry) { return entry.second.lastUse; })};
+    m_entries.erase(leastRecentlyUsed);
+  }
+}
+
+void ProfileStore::save() {
+  if (!m_modified || m_path.empty()) {
+    return;
+  }
+  m_modified = false;
+
+#if !defined(__EMSCRIPTEN__)
+  Entries entries(m_entries.begin(), m_entries.end());
+  // Assigning to a running writer waits for it to finish first
+  m_writer = std::jthread{[path = m_path, entries = std::move(entries)] {
+    write(path, entries);
+  }};
+#endif
+}
+
+void ProfileStore::load() {
+  std::ifstream stream(m_path);
+  if (!stream) {
+    return;
+  }
+
+  std::string line;
+  if (!std::getline(stream, line) || line != kFileHeader) {
+    return;
+  }
+
+  while (std::getline(stream, line)) {
+    std::istringstream lineStream{line};
+    std::uint64_t key{};
+    Entry entry{};
+    lineStream >> std::hex >> key >> std::dec >> entry.lastUse >>
+        entry.profile.numChunksEstimate >> entry.profile.frameTime >>
+        entry.profile.frameCost;
+    if (!lineStream || !std::isfinite(entry.profile.numChunksEstimate) ||
+        entry.profile.numChunksEstimate < 1.0) {
+      continue;
+    }
+    m_useCount = std::max(m_useCount, entry.lastUse);
+    m_entries.insert_or_assign(key, entry);
+  }
+
+  while (m_entries.size() > m_maxEntries) {
+    auto const leastRecentlyUsed{std::ranges::min_element(
+        m_entries, {}, [](auto const &entry) { return entry.second.lastUse; })};
+    m_entries.erase(leastRecentlyUsed);
+  }
+}
+
+void ProfileStore::write(std::filesystem::path const &path,
+                         Entries const &entries) {
+  std::string contents{kFileHeader};
+  contents += '\n';
+  for (auto const &[key, entry] : entries) {
+    contents += std::format("{:016x} {} {} {} {}\n", key, entry.lastUse,
+                            entry.profile.numChunksEstimate,
+                            entry.profile.frameTime, entry.profile.frameCost);
+  }
+
+  // Write to a temporary file first so that a crash or a concurrent instance
+  // never leaves a partially written store under the final name
+  auto tempPath{path};
+  tempPath += ".tmp";
+  {
+    std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+    if (!stream) {
+      return;
+    }
+    stream.write(contents.data(),
+                 gsl::narrow<std::streamsize>(contents.size()));
+    if (!stream) {
+      stream.close();
+      std::error_code errorCode;
+      std::filesystem::remove(tempPath, errorCode);
+      return;
+    }
+  }
+
+  std::error_code errorCode;
+  std::filesystem::rename(tempPath, path, errorCode);
+  if (errorCode) {
+    std::filesystem::remove(tempPath, errorCode);
+  }
+}
@@ -0,0 +1,86 @@
+/**
+ * @file profilestore.hpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#ifndef PROFILESTORE_HPP_
+#define PROFILESTORE_HPP_
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if !defined(__EMSCRIPTEN__)
+#include <thread>
+#endif
+
+// Persistent store of rendering profiles, i.e., the number of chunks a frame
+// converged to and the time it took to render, keyed by a hash of what was
+// rendered (see Raycast::getProfileKey).
+//
+// Profiles are loaded from a text file under the user's preference path when
+// the store is created, and are written back on a separate thread whenever
+// save() is called with unsaved changes. The file is written to a temporary
+// file and then renamed, so an interrupted write never leaves a truncated
+// store behind. The least recently used profiles are dropped when the store
+// exceeds a maximum number of entries.
+//
+// In the WebAssembly build, profiles are kept in memory only.
+class ProfileStore {
+public:
+  static constexpr std::size_t kDefaultMaxEntries{1024};
+
+  struct Profile {
+    double numChunksEstimate{1.0};
+    double frameTime{};
+    // Estimated cost of the frame, in units of RenderState::estimatePixelCost
+    // times the number of pixels, used to scale the number of chunks to other
+    // render sizes and settings
+    double frameCost{};
+  };
+
+  ProfileStore() = default;
+  ProfileStore(ProfileStore const &) = delete;
+  ProfileStore(ProfileStore &&) = delete;
+  ProfileStore &operator=(ProfileStore const &) = delete;
+  ProfileStore &operator=(ProfileStore &&) = delete;
+  ~ProfileStore() { onDestroy(); }
+
+  void onCreate(std::size_t maxEntries = kDefaultMaxEntries);
+  // Writes unsaved changes and waits for the write to finish
+  void onDestroy();
+
+  [[nodiscard]] std::optional<Profile> find(std::uint64_t key);
+  void update(std::uint64_t key, Profile const &profile);
+
+  // Writes the profiles in the background if they changed since the last call
+  void save();
+
+private:
+  struct Entry {
+    Profile profile;
+    std::uint64_t lastUse{};
+  };
+  using Entries = std::vector<std::pair<std::uint64_t, Entry>>;
+
+  std::unordered_map<std::uint64_t, Entry> m_entries;
+  std::size_t m_maxEntries{kDefaultMaxEntries};
+  std::uint64_t m_useCount{};
+  std::filesystem::path m_path;
+  bool m_modified{};
+#if !defined(__EMSCRIPTEN__)
+  std::jthread m_writer;
+#endif
+
+  void load();
+  static void write(std::filesystem::path const &path, Entries const &entries);
+};
+
+#endif
@@ -0,0 +1,245 @@
+/**
+ * @file programbinarycache.cpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#include "programbinarycache.hpp"
+
+#include "util.hpp"
+
+#include <abcgOpenGL.hpp>
+
+#include <fstream>
+
+namespace {
+
+constexpr std::array<char, 4> kMagic{'I', 'V', 'P', 'B'};
+constexpr std::uint32_t kFileVersion{1};
+constexpr std::string_view kFileExtension{".bin"};
+
+struct FileHeader {
+  std::array<char, 4> magic{};
+  std::uint32_t version{};
+  std::uint64_t driverHash{};
+  std::uint64_t checksum{};
+  std::uint32_t binaryFormat{};
+  std::uint32_t binaryLength{};
+};
+
+std::uint64_t computeChecksum(std::span<char const> data) {
+  return util::hashFNV1a(std::string_view{data.data(), data.size()});
+}
+
+} // namespace
+
+void ProgramBinaryCache::onCreate(std::uintmax_t maxSizeBytes) {
+  m_enabled = false;
+  m_maxSizeBytes = maxSizeBytes;
+
+#if !defined(__EMSCRIPTEN__)
+  GLint numFormats{};
+  abcg::glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+  if (numFormats <= 0) {
+    return;
+  }
+  m_supportedFormats.resize(gsl::narrow<std::size_t>(numFormats));
+  abcg::glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, m_supportedFormats.data());
+
+  auto const prefPath{util::getPrefPath()};
+  if (prefPath.empty()) {
+    return;
+  }
+  m_directory = prefPath / "shadercache";
+  std::error_code errorCode;
+  std::filesystem::create_directories(m_directory, errorCode);
+  if (errorCode) {
+    return;
+  }
+
+  auto const getString{[](GLenum name) -> std::string_view {
+    // NOLINTNEXTLINE(*reinterpret-cast)
+    auto const *str{reinterpret_cast<char const *>(abcg::glGetString(name))};
+    return str == nullptr ? std::string_view{} : std::string_view{str};
+  }};
+  m_driverHash = util::hashFNV1a(getString(GL_VENDOR));
+  m_driverHash = util::hashFNV1a(getString(GL_RENDERER), m_driverHash);
+  m_driverHash = util::hashFNV1a(getString(GL_VERSION), m_driverHash);
+
+  m_enabled = true;
+#endif
+}
+
+GLuint ProgramBinaryCache::load(std::uint64_t sourceHash) {
+  if (!m_enabled) {
+    return 0;
+  }
+
+  auto const path{getFilePath(sourceHash)};
+  std::ifstream stream(path, std::ios::binary);
+  if (!stream) {
+    return 0;
+  }
+
+  auto const discard{[&path, &stream] {
+    stream.close();
+    std::error_code errorCode;
+    std::filesystem::remove(path, errorCode);
+    return GLuint{};
+  }};
+
+  FileHeader header{};
+  // NOLINTNEXTLINE(*reinterpret-cast)
+  stream.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (!stream || header.magic != kMagic || header.version != kFileVersion ||
+      header.driverHash != m_driverHash || header.binaryLength == 0) {
+    return discard();
+  }
+
+  std::vector<char> binary(header.binaryLength);
+  stream.read(binary.data(), gsl::narrow<std::streamsize>(binary.size()));
+  auto const formatSupported{
+      std::ranges::find(m_supportedFormats,
+                        gsl::narrow_cast<GLint>(header.binaryFormat)) !=
+      m_supportedFormats.end()};
+  if (!stream || !formatSupported ||
+      computeChecksum(binary) != header.checksum) {
+    return discard();
+  }
+  stream.close();
+
+  auto const program{abcg::glCreateProgram()};
+  abcg::glProgramBinary(program, header.binaryFormat, binary.data(),
+                        gsl::narrow<GLsizei>(binary.size()));
+
+  // The driver may still reject a binary with a supported format (e.g., after
+  // an update that kept the version string)
+  GLint linkStatus{};
+  abcg::glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+  if (linkStatus == GL_FALSE) {
+    abcg::glDeleteProgram(program);
+    return discard();
+  }
+
+  // Refresh the modification time used as the LRU stamp for eviction
+  std::error_code errorCode;
+  std::filesystem::last_write_time(
+      path, std::filesystem::file_time_type::clock::now(), errorCode);
+
+  return program;
+}
+
+void ProgramBinaryCache::store(std::uint64_t sourceHash, GLuint program) {
+  if (!m_enabled) {
+    return;
+  }
+
+  GLint binaryLength{};
+  abcg::glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+  if (binaryLength <= 0) {
+    return;
+  }
+
+  std::vector<char> binary(gsl::narrow<std::size_t>(binaryLength));
+  GLenum binaryFormat{};
+  GLsizei length{};
+  abcg::glGetProgramBinary(program, binaryLength, &length, &binaryFormat,
+                           binary.data());
+  if (length <= 0) {
+    return;
+  }
+  binary.resize(gsl::narrow<std::size_t>(length));
+
+  FileHeader const header{.magic = kMagic,
+                          .version = kFileVersion,
+                          .driverHash = m_driverHash,
+                          .checksum = computeChecksum(binary),
+                          .binaryFormat = binaryFormat,
+                          .binaryLength =
+                              gsl::narrow<std::uint32_t>(binary.size())};
+
+  // Write to a temporary file first so that a crash or a concurrent instance
+  // never leaves a partially written binary under the final name
+  auto const path{getFilePath(sourceHash)};
+  auto tempPath{path};
+  tempPath += ".tmp";
+  {
+    std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+    if (!stream) {
+      return;
+    }
+    // NOLINTNEXTLINE(*reinterpret-cast)
+    stream.write(reinterpret_cast<char const *>(&header), sizeof(header));
+    stream.write(binary.data(), gsl::narrow<std::streamsize>(binary.size()));
+    if (!stream) {
+      stream.close();
+      std::error_code errorCode;
+      std::filesystem::remove(tempPath, errorCode);
+      return;
+    }
+  }
+
+  std::error_code errorCode;
+  std::filesystem::rename(tempPath, path, errorCode);
+  if (errorCode) {
+    std::filesystem::remove(tempPath, errorCode);
+    return;
+  }
+
+  evict();
+}
+
+std::filesystem::path
+ProgramBinaryCache::getFilePath(std::uint64_t sourceHash) const {
+  auto const key{util::hashFNV1a(
+      std::string_view{
+          // NOLINTNEXTLINE(*reinterpret-cast)
+          reinterpret_cast<char const *>(&sourceHash), sizeof(sourceHash)},
+      m_driverHash)};
+  return m_directory / std::format("{:016x}{}", key, kFileExtension);
+}
+
+void ProgramBinaryCache::evict() const {
+  struct CacheFile {
+    std::filesystem::path path;
+    std::uintmax_t size{};
+    std::filesystem::file_time_type lastWriteTime;
+  };
+
+  std::vector<CacheFile> files;
+  std::uintmax_t totalSize{};
+  std::error_code errorCode;
+  for (auto const &entry :
+       std::filesystem::directory_iterator(m_directory, errorCode)) {
+    if (!entry.is_regular_file(errorCode) ||
+        entry.path().extension() != kFileExtension) {
+      continue;
+    }
+    auto const size{entry.file_size(errorCode)};
+    if (errorCode) {
+      continue;
+    }
+    files.push_back({.path = entry.path(),
+                     .size = size,
+                     .lastWriteTime = entry.last_write_time(errorCode)});
+    totalSize += size;
+  }
+
+  if (totalSize <= m_maxSizeBytes) {
+    return;
+  }
+
+  // Remove the least recently used files first
+  std::ranges::sort(files, {}, &CacheFile::lastWriteTime);
+  for (auto const &file : files) {
+    if (totalSize <= m_maxSizeBytes) {
+      break;
+    }
+    if (std::filesystem::remove(file.path, errorCode)) {
+      totalSize -= file.size;
+    }
+  }
+}
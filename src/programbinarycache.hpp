@@ -0,0 +1,58 @@
+/**
+ * @file programbinarycache.hpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#ifndef PROGRAMBINARYCACHE_HPP_
+#define PROGRAMBINARYCACHE_HPP_
+
+#include <abcgOpenGLExternal.hpp>
+
+#include <filesystem>
+#include <vector>
+
+// Persistent cache of linked program binaries (glGetProgramBinary /
+// glProgramBinary).
+//
+// Binaries are stored one per file in a cache directory under the user's
+// preference path. File names are derived from the hash of the shader sources
+// combined with the GL vendor, renderer and version strings, so a driver update
+// simply misses the cache. Files are written to a temporary file and then
+// renamed, so an interrupted write never leaves a truncated binary behind.
+// The least recently used files are removed when the total size of the cache
+// exceeds a cap.
+//
+// The cache is disabled in the WebAssembly build, since WebGL does not expose
+// program binaries, and when the driver reports no binary formats.
+class ProgramBinaryCache {
+public:
+  static constexpr std::uintmax_t kDefaultMaxSizeBytes{64ULL * 1024 * 1024};
+
+  void onCreate(std::uintmax_t maxSizeBytes = kDefaultMaxSizeBytes);
+
+  [[nodiscard]] bool isEnabled() const noexcept { return m_enabled; }
+
+  // Returns a linked program created from the binary stored for the given
+  // source hash, or 0 if not found or if the driver rejected the binary.
+  [[nodiscard]] GLuint load(std::uint64_t sourceHash);
+
+  // Stores the binary of a successfully linked program.
+  void store(std::uint64_t sourceHash, GLuint program);
+
+private:
+  bool m_enabled{};
+  std::filesystem::path m_directory;
+  std::uint64_t m_driverHash{};
+  std::uintmax_t m_maxSizeBytes{kDefaultMaxSizeBytes};
+  std::vector<GLint> m_supportedFormats;
+
+  [[nodiscard]] std::filesystem::path
+  getFilePath(std::uint64_t sourceHash) const;
+  void evict() const;
+};
+
+#endif
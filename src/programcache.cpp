@@ -0,0 +1,108 @@
+/**
+ * @file programcache.cpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#include "programcache.hpp"
+
+#include <abcgOpenGL.hpp>
+
+ProgramCache::Program const *ProgramCache::find(std::uint64_t key) {
+  auto const itr{m_index.find(key)};
+  if (itr == m_index.end()) {
+    ++m_misses;
+    return nullptr;
+  }
+
+  ++m_hits;
+  m_programs.splice(m_programs.begin(), m_programs, itr->second);
+  return &m_programs.front();
+}
+
+ProgramCache::Program const &
+ProgramCache::insert(std::uint64_t key, GLuint program,
+                     std::span<UniformBlockBinding const> blockBindings,
+                     std::span<char const *const> uniformNames,
+                     std::size_t sourceSize) {
+  for (auto const &binding : blockBindings) {
+    auto const index{abcg::glGetUniformBlockIndex(program, binding.name)};
+    if (index == GL_INVALID_INDEX) {
+      abcg::glDeleteProgram(program);
+      throw abcg::RuntimeError(std::format(
+          "\"{}\" does not identify an active uniform block of program",
+          binding.name));
+    }
+    abcg::glUniformBlockBinding(program, index, binding.bindingPoint);
+  }
+
+  std::vector<GLint> uniformLocations;
+  uniformLocations.reserve(uniformNames.size());
+  for (auto const *name : uniformNames) {
+    uniformLocations.push_back(abcg::glGetUniformLocation(program, name));
+  }
+
+  // Use the size of the driver's program binary as the memory estimate when
+  // available, or the size of the shader sources otherwise
+  std::size_t memoryBytes{sourceSize};
+#if !defined(__EMSCRIPTEN__)
+  GLint binaryLength{};
+  abcg::glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+  if (binaryLength > 0) {
+    memoryBytes = gsl::narrow<std::size_t>(binaryLength);
+  }
+#endif
+
+  // Replace an existing entry with the same key
+  if (auto const itr{m_index.find(key)}; itr != m_index.end()) {
+    abcg::glDeleteProgram(itr->second->id);
+    m_programs.erase(itr->second);
+    m_index.erase(itr);
+  }
+
+  m_programs.push_front({.key = key,
+                         .id = program,
+                         .uniformLocations = std::move(uniformLocations),
+                         .memoryBytes = memoryBytes});
+  m_index[key] = m_programs.begin();
+
+  evict();
+
+  return m_programs.front();
+}
+
+void ProgramCache::clear() {
+  for (auto const &program : m_programs) {
+    abcg::glDeleteProgram(program.id);
+  }
+  m_programs.clear();
+  m_index.clear();
+}
+
+ProgramCache::Stats ProgramCache::getStats() const noexcept {
+  Stats stats{.size = m_programs.size(),
+              .capacity = m_capacity,
+              .hits = m_hits,
+              .misses = m_misses};
+  for (auto const &program : m_programs) {
+    stats.memoryBytes += program.memoryBytes;
+  }
+  return stats;
+}
+
+void ProgramCache::evict() {
+  auto itr{m_programs.end()};
+  while (m_programs.size() > m_capacity && itr != m_programs.begin()) {
+    --itr;
+    // Never evict the most recently inserted or the active program
+    if (itr == m_programs.begin() || itr->key == m_activeKey) {
+      continue;
+    }
+    abcg::glDeleteProgram(itr->id);
+    m_index.erase(itr->key);
+    itr = m_programs.erase(itr);
+  }
+}
@@ -0,0 +1,92 @@
+/**
+ * @file programcache.hpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#ifndef PROGRAMCACHE_HPP_
+#define PROGRAMCACHE_HPP_
+
+#include <abcgOpenGLExternal.hpp>
+
+#include <list>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+// Bounded least-recently-used cache of linked shader programs.
+//
+// Programs are keyed by a hash of their fully assembled shader sources. Each
+// entry also keeps the uniform block bindings and the uniform locations that
+// were queried when the program was inserted, so that switching to a cached
+// program does not require any further GL queries.
+class ProgramCache {
+public:
+  struct UniformBlockBinding {
+    char const *name{};
+    GLuint bindingPoint{};
+  };
+
+  struct Program {
+    std::uint64_t key{};
+    GLuint id{};
+    std::vector<GLint> uniformLocations;
+    std::size_t memoryBytes{};
+  };
+
+  struct Stats {
+    std::size_t size{};
+    std::size_t capacity{};
+    std::size_t hits{};
+    std::size_t misses{};
+    std::size_t memoryBytes{};
+  };
+
+  explicit ProgramCache(std::size_t capacity = 16) : m_capacity(capacity) {}
+  ~ProgramCache() = default;
+
+  ProgramCache(ProgramCache const &) = delete;
+  ProgramCache &operator=(ProgramCache const &) = delete;
+  ProgramCache(ProgramCache &&) = delete;
+  ProgramCache &operator=(ProgramCache &&) = delete;
+
+  // Returns the program with the given key and marks it as the most recently
+  // used, or nullptr if not found. Updates the hit/miss counters.
+  [[nodiscard]] Program const *find(std::uint64_t key);
+
+  // Returns true if a program with the given key is cached, without touching
+  // the LRU order or the hit/miss counters.
+  [[nodiscard]] bool contains(std::uint64_t key) const {
+    return m_index.contains(key);
+  }
+
+  // Takes ownership of a linked program, binds its uniform blocks and queries
+  // the given uniform locations. The least recently used programs are deleted
+  // if the capacity is exceeded, except the one marked as active.
+  Program const &insert(std::uint64_t key, GLuint program,
+                        std::span<UniformBlockBinding const> blockBindings,
+                        std::span<char const *const> uniformNames,
+                        std::size_t sourceSize);
+
+  // Protects the program with the given key from eviction.
+  void setActive(std::uint64_t key) noexcept { m_activeKey = key; }
+
+  void clear();
+
+  [[nodiscard]] Stats getStats() const noexcept;
+
+private:
+  std::size_t m_capacity{};
+  std::list<Program> m_programs; // Most recently used first
+  std::unordered_map<std::uint64_t, std::list<Program>::iterator> m_index;
+  std::uint64_t m_activeKey{};
+  std::size_t m_hits{};
+  std::size_t m_misses{};
+
+  void evict();
+};
+
+#endif
@@ -0,0 +1,232 @@
+/**
+ * @file programscheduler.cpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#include "programscheduler.hpp"
+
+#include <abcgOpenGL.hpp>
+
+#if !defined(GL_COMPLETION_STATUS_KHR)
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+void ProgramScheduler::onCreate() {
+#if defined(__EMSCRIPTEN__)
+  m_parallelCompile = emscripten_webgl_enable_extension(
+      emscripten_webgl_get_current_context(), "KHR_parallel_shader_compile");
+#else
+  m_parallelCompile = GLEW_KHR_parallel_shader_compile != 0U;
+  if (m_parallelCompile) {
+    // Let the driver choose the number of compiler threads
+    glMaxShaderCompilerThreadsKHR(0xFFFFFFFFU);
+  }
+#endif
+}
+
+void ProgramScheduler::onDestroy() {
+  for (auto &job : m_jobs) {
+    destroy(job);
+  }
+  m_jobs.clear();
+}
+
+void ProgramScheduler::submit(std::uint64_t key,
+                              std::vector<abcg::ShaderSource> sources,
+                              Priority priority, bool throwOnError) {
+  // Only the latest foreground request is waited for. Earlier ones keep
+  // building in the background, since they will likely be reused.
+  if (priority == Priority::Foreground) {
+    for (auto &job : m_jobs) {
+      job.priority = Priority::Background;
+    }
+  }
+
+  if (auto itr{std::ranges::find(m_jobs, key, &Job::key)};
+      itr != m_jobs.end()) {
+    if (priority == Priority::Foreground) {
+      itr->priority = priority;
+      itr->throwOnError = throwOnError;
+    }
+    return;
+  }
+
+  std::size_t sourceSize{};
+  for (auto const &source : sources) {
+    sourceSize += source.source.size();
+  }
+
+  Job job{.key = key,
+          .sources = std::move(sources),
+          .sourceSize = sourceSize,
+          .priority = priority,
+          .throwOnError = throwOnError};
+
+  // Foreground jobs are started before any queued background job
+  if (priority == Priority::Foreground) {
+    m_jobs.push_front(std::move(job));
+  } else {
+    m_jobs.push_back(std::move(job));
+  }
+}
+
+bool ProgramScheduler::isScheduled(std::uint64_t key) const {
+  return std::ranges::find(m_jobs, key, &Job::key) != m_jobs.end();
+}
+
+void ProgramScheduler::clearBackgroundQueue() {
+  std::erase_if(m_jobs, [](Job const &job) {
+    return job.priority == Priority::Background && job.phase == Phase::Queued;
+  });
+}
+
+std::vector<ProgramScheduler::Result> ProgramScheduler::poll() {
+  auto const hasForegroundJob{std::ranges::any_of(m_jobs, [](Job const &job) {
+    return job.priority == Priority::Foreground;
+  })};
+
+  // Start queued jobs, foreground first
+  auto numInFlight{getNumInFlight()};
+  auto const maxInFlight{m_parallelCompile ? kMaxInFlightParallel
+                                           : std::size_t{1}};
+  for (auto const priority : {Priority::Foreground, Priority::Background}) {
+    if (priority == Priority::Background && !m_parallelCompile &&
+        hasForegroundJob) {
+      break;
+    }
+    for (auto &job : m_jobs) {
+      if (job.phase != Phase::Queued || job.priority != priority) {
+        continue;
+      }
+      // A foreground job never waits for background jobs
+      if (numInFlight >= maxInFlight && priority == Priority::Background) {
+        break;
+      }
+      start(job);
+      ++numInFlight;
+    }
+  }
+
+  std::vector<Result> results;
+  for (auto itr{m_jobs.begin()}; itr != m_jobs.end();) {
+    auto &job{*itr};
+    if (job.phase == Phase::Queued || !isReady(job)) {
+      ++itr;
+      continue;
+    }
+
+    // Background builds never throw, since no one is waiting for them
+    auto const throwOnError{job.priority == Priority::Foreground &&
+                            job.throwOnError};
+
+    if (job.phase == Phase::Compile) {
+      auto const compiled{
+          abcg::checkOpenGLShaderCompile(job.shaders, throwOnError)};
+      if (compiled) {
+        job.program = link(job.shaders);
+        job.shaders.clear();
+        if (job.program != 0) {
+          job.phase = Phase::Link;
+          job.timer.restart();
+          ++itr;
+          continue;
+        }
+      }
+      job.shaders.clear();
+      results.push_back({.key = job.key, .sourceSize = job.sourceSize});
+    } else {
+      auto const linked{abcg::checkOpenGLShaderLink(job.program, throwOnError)};
+      results.push_back({.key = job.key,
+                         .program = linked ? job.program : 0,
+                         .sourceSize = job.sourceSize});
+      m_firstBuild = false;
+    }
+    itr = m_jobs.erase(itr);
+  }
+
+  return results;
+}
+
+std::size_t ProgramScheduler::getNumInFlight() const noexcept {
+  return gsl::narrow_cast<std::size_t>(
+      std::ranges::count_if(m_jobs, [](Job const &job) {
+        return job.phase != Phase::Queued;
+      }));
+}
+
+void ProgramScheduler::start(Job &job) {
+  job.shaders = abcg::triggerOpenGLShaderCompile(job.sources);
+  job.sources.clear();
+  job.sources.shrink_to_fit();
+  job.phase = Phase::Compile;
+  job.timer.restart();
+}
+
+bool ProgramScheduler::isReady(Job const &job) const {
+  if (m_parallelCompile) {
+    GLint completed{GL_TRUE};
+    if (job.phase == Phase::Compile) {
+      for (auto const &shader : job.shaders) {
+        abcg::glGetShaderiv(shader.shader, GL_COMPLETION_STATUS_KHR,
+                            &completed);
+        if (completed == GL_FALSE) {
+          break;
+        }
+      }
+    } else {
+      abcg::glGetProgramiv(job.program, GL_COMPLETION_STATUS_KHR, &completed);
+    }
+    return completed != GL_FALSE;
+  }
+
+#if defined(__EMSCRIPTEN__)
+  // Postpone compile/link status checking to avoid stalling the browser if it
+  // takes too long to build the shader.
+  auto const timeout{m_firstBuild ? 0.1 : 0.05};
+#else
+  auto const timeout{0.0};
+#endif
+  return job.timer.elapsed() >= timeout;
+}
+
+GLuint ProgramScheduler::link(std::vector<abcg::OpenGLShader> const &shaders) {
+  auto const program{abcg::glCreateProgram()};
+  if (program == 0) {
+    for (auto const &shader : shaders) {
+      abcg::glDeleteShader(shader.shader);
+    }
+    return 0;
+  }
+
+#if !defined(__EMSCRIPTEN__)
+  // Allows ProgramBinaryCache to retrieve the binary after linking
+  abcg::glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                            GL_TRUE);
+#endif
+
+  for (auto const &shader : shaders) {
+    abcg::glAttachShader(program, shader.shader);
+  }
+  abcg::glLinkProgram(program);
+  for (auto const &shader : shaders) {
+    abcg::glDetachShader(program, shader.shader);
+    abcg::glDeleteShader(shader.shader);
+  }
+
+  return program;
+}
+
+void ProgramScheduler::destroy(Job &job) {
+  for (auto const &shader : job.shaders) {
+    abcg::glDeleteShader(shader.shader);
+  }
+  job.shaders.clear();
+  if (job.program != 0) {
+    abcg::glDeleteProgram(job.program);
+    job.program = 0;
+  }
+}
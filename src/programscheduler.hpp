@@ -0,0 +1,91 @@
+/**
+ * @file programscheduler.hpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#ifndef PROGRAMSCHEDULER_HPP_
+#define PROGRAMSCHEDULER_HPP_
+
+#include <abcgOpenGLShader.hpp>
+#include <abcgTimer.hpp>
+
+#include <deque>
+
+// Keeps several shader programs building at the same time.
+//
+// When GL_KHR_parallel_shader_compile is available, the driver compiles and
+// links on its own threads and the build status is polled with
+// GL_COMPLETION_STATUS_KHR, so up to kMaxInFlightParallel programs are kept in
+// flight. Otherwise, querying the status blocks until the build finishes, so
+// only one program is built at a time, and background (prewarm) builds only
+// start when no foreground build is pending.
+class ProgramScheduler {
+public:
+  enum class Priority : std::uint8_t { Foreground, Background };
+
+  struct Result {
+    std::uint64_t key{};
+    GLuint program{}; // 0 if the build failed
+    std::size_t sourceSize{};
+  };
+
+  void onCreate();
+  void onDestroy();
+
+  [[nodiscard]] bool isParallelCompileSupported() const noexcept {
+    return m_parallelCompile;
+  }
+
+  // Queues the build of a program identified by 'key'. If a job with the same
+  // key is already scheduled, it is promoted to the given priority instead.
+  // A new foreground job demotes the previous one to the background.
+  void submit(std::uint64_t key, std::vector<abcg::ShaderSource> sources,
+              Priority priority, bool throwOnError = false);
+
+  [[nodiscard]] bool isScheduled(std::uint64_t key) const;
+
+  // Drops background jobs that have not started building yet.
+  void clearBackgroundQueue();
+
+  // Starts queued builds and collects the finished ones, including failed
+  // builds (with program 0).
+  [[nodiscard]] std::vector<Result> poll();
+
+  [[nodiscard]] std::size_t getNumInFlight() const noexcept;
+  [[nodiscard]] std::size_t getNumQueued() const noexcept {
+    return m_jobs.size() - getNumInFlight();
+  }
+
+private:
+  static constexpr std::size_t kMaxInFlightParallel{4};
+
+  enum class Phase : std::uint8_t { Queued, Compile, Link };
+
+  struct Job {
+    std::uint64_t key{};
+    std::vector<abcg::ShaderSource> sources;
+    std::size_t sourceSize{};
+    Priority priority{};
+    bool throwOnError{};
+    Phase phase{Phase::Queued};
+    std::vector<abcg::OpenGLShader> shaders;
+    GLuint program{};
+    abcg::Timer timer;
+  };
+
+  std::deque<Job> m_jobs;
+  bool m_parallelCompile{};
+  bool m_firstBuild{true};
+
+  void start(Job &job);
+  [[nodiscard]] bool isReady(Job const &job) const;
+  [[nodiscard]] static GLuint
+  link(std::vector<abcg::OpenGLShader> const &shaders);
+  static void destroy(Job &job);
+};
+
+#endif
@@ -14,32 +14,107 @@
 
 #include <abcgOpenGL.hpp>
 
-#include <fstream>
+#include <cmath>
 
 namespace {
 
-std::string getColormapDefinition(std::string_view name,
-                                  std::vector<glm::vec4> const &colors) {
-  auto const emitArray{[&name](std::vector<glm::vec4> const &lut) {
-    auto out{std::format("const vec4 {}[{}] = vec4[{}](\n", name, lut.size(),
-                         lut.size())};
-    for (std::size_t const index : iter::range(lut.size())) {
-      auto const &color{lut[index]};
-      out += std::format("    vec4({:.6f}, {:.6f}, {:.6f}, {:.6f}){}", color.r,
-                         color.g, color.b, color.a,
-                         (index + 1 < lut.size() ? ",\n" : "\n"));
+// Returns the size of a refinement level of a frame of the given size
+glm::ivec2 scaleRenderSize(glm::ivec2 size, double scale) {
+  return glm::max(glm::ivec2{glm::vec2{size} * gsl::narrow_cast<float>(scale)},
+                  glm::ivec2{1});
+}
+
+// Returns the element of the Halton low-discrepancy sequence of the given
+// base, in [0, 1)
+float getHaltonValue(std::size_t index, std::size_t base) {
+  auto value{0.0f};
+  auto fraction{1.0f};
+  while (index > 0) {
+    fraction /= gsl::narrow_cast<float>(base);
+    value += fraction * gsl::narrow_cast<float>(index % base);
+    index /= base;
+  }
+  return value;
+}
+
+// Formats the value of a parameter as a GLSL float literal. Negative values
+// are parenthesized so that they can replace a name after any operator.
+std::string formatParameterValue(float value) {
+  auto literal{std::format("{}", value)};
+  if (literal.find_first_of(".e") == std::string::npos) {
+    literal += ".0";
+  }
+  return value < 0.0f ? std::format("({})", literal) : literal;
+}
+
+// Returns the GLSL code that replaces the name of each parameter: its value if
+// it is folded as a constant, or the element of uParams.data that holds it
+// otherwise.
+std::vector<std::string>
+getParameterBindings(std::vector<Function::Parameter> const &parameters,
+                     bool foldValues) {
+  static std::array const variables{'x', 'y', 'z', 'w'};
+
+  std::vector<std::string> bindings;
+  bindings.reserve(parameters.size());
+  for (auto &&[index, parameter] : iter::enumerate(parameters)) {
+    if (foldValues && std::isfinite(parameter.value)) {
+      bindings.push_back(formatParameterValue(parameter.value));
+    } else {
+      bindings.push_back(std::format("uParams.data[{}].{}", index / 4,
+                                     variables.at(index % 4)));
     }
-    out += ");\n\n";
-    return out;
+  }
+  return bindings;
+}
+
+// Replaces the parameter names of a GLSL expression with their bindings, and
+// the "@P.@" prefixes of the coordinates with "P.", in a single pass over the
+// expression. Coordinate names are copied as is, so they are never mistaken
+// for parameters, and a replacement is never matched again.
+std::string bindParameters(std::string_view expression,
+                           std::vector<Function::Parameter> const &parameters,
+                           std::span<std::string const> bindings) {
+  constexpr std::string_view pointPrefix{"@P.@"};
+
+  auto const isIdentifier{[](char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
   }};
 
-  std::string str;
-  str.reserve(32768);
+  auto const readIdentifier{[&](std::size_t &pos) {
+    auto const start{pos};
+    while (pos < expression.size() && isIdentifier(expression[pos])) {
+      ++pos;
+    }
+    return expression.substr(start, pos - start);
+  }};
 
-  str += emitArray(colors);
-  str += std::format("const int {}_SIZE = {};\n", name, colors.size());
+  std::string result;
+  result.reserve(expression.size() * 2);
+  std::size_t pos{};
+  while (pos < expression.size()) {
+    if (expression.substr(pos).starts_with(pointPrefix)) {
+      pos += pointPrefix.size();
+      result += "P.";
+      result += readIdentifier(pos);
+      continue;
+    }
+    if (!isIdentifier(expression[pos])) {
+      result += expression[pos++];
+      continue;
+    }
 
-  return str;
+    auto const token{readIdentifier(pos)};
+    auto const itr{
+        std::ranges::find(parameters, token, &Function::Parameter::name)};
+    if (itr == parameters.end()) {
+      result += token;
+      continue;
+    }
+    result += bindings[static_cast<std::size_t>(
+        std::distance(parameters.begin(), itr))];
+  }
+  return result;
 }
 
 } // namespace
@@ -53,8 +128,22 @@ void Raycast::handleEvent(SDL_Event const &event) {
 }
 
 void Raycast::onCreate(RenderState const &renderState) {
-  createProgram(renderState);
+  createUBOs();
   createVBOs();
+  m_programBinaryCache.onCreate();
+  m_profileStore.onCreate();
+  m_gpuTimer.create();
+#if defined(__EMSCRIPTEN__)
+  m_floatLinearSupported = emscripten_webgl_enable_extension(
+      emscripten_webgl_get_current_context(), "OES_texture_float_linear");
+#else
+  // Float textures are always filterable in desktop OpenGL
+  m_floatLinearSupported = true;
+#endif
+  abcg::glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &m_maxFieldTextureSize);
+  m_programScheduler.onCreate();
+  loadShaderTemplates();
+  createProgram(renderState);
 
 #if defined(__EMSCRIPTEN__)
   m_documentVisible =
@@ -76,7 +165,7 @@ void Raycast::onUpdate() {
 void Raycast::onPaint(Camera const &camera, RenderState const &renderState,
                       glm::quat lightRotation) {
 
-  if (hasStateInvalidatedFrame(renderState)) {
+  if (!m_programRenderState.isProgramEquivalent(renderState)) {
     // Disable exception throwing when creating user-defined shader programs to
     // avoid printing the information log to the console.
     // In the WebAssembly build, it also prevents throwing an uncaught JS
@@ -88,58 +177,67 @@ void Raycast::onPaint(Camera const &camera, RenderState const &renderState,
     createProgram(renderState);
   }
 
-#if defined(__EMSCRIPTEN__)
-  static bool firstProgramBuild{true};
-  // Postpone compile/link status checking to avoid stalling the browser if it
-  // takes too long to build the shader.
-  auto const buildPhaseTimeout{firstProgramBuild ? 0.1 : 0.05};
-#else
-  auto const buildPhaseTimeout{0.0};
-#endif
+  for (auto const &result : m_programScheduler.poll()) {
+    auto const isPending{m_pendingProgramKey == result.key};
+    if (isPending) {
+      m_pendingProgramKey.reset();
+    }
+
+    if (result.program == 0) {
+      m_programBuildFailed = m_programBuildFailed || isPending;
+      continue;
+    }
+
+    // Already loaded from the binary cache while building
+    if (m_programCache.contains(result.key)) {
+      abcg::glDeleteProgram(result.program);
+      continue;
+    }
 
-  if (m_programBuildPhase == ProgramBuildPhase::Compile &&
-      m_programBuildTime.elapsed() >= buildPhaseTimeout) {
-    m_programBuildPhase = ProgramBuildPhase::Done;
-    if (abcg::checkOpenGLShaderCompile(m_shaderIDs, m_throwOnProgramBuild)) {
-      m_nextProgram =
-          abcg::triggerOpenGLShaderLink(m_shaderIDs, m_throwOnProgramBuild);
-      if (m_nextProgram != 0) {
-        m_programBuildTime.restart();
-        m_programBuildPhase = ProgramBuildPhase::Link;
+    m_programBinaryCache.store(result.key, result.program);
+    auto const &program{
+        m_programCache.insert(result.key, result.program, kUniformBlockBindings,
+                              kUniformNames, result.sourceSize)};
+    if (isPending) {
+      // Replace with new program. The previous one stays in the cache.
+      useProgram(program);
+      m_respecializing = false;
+      if (m_usingFallback) {
+        // Restart the frame at full resolution
+        m_usingFallback = false;
+        resetFrameState();
       }
-    } else {
-      m_programBuildFailed = true;
     }
   }
 
-  if (m_programBuildPhase == ProgramBuildPhase::Link &&
-      m_programBuildTime.elapsed() >= buildPhaseTimeout) {
-    if (abcg::checkOpenGLShaderLink(m_nextProgram, m_throwOnProgramBuild)) {
-      // Replace with new program
-      abcg::glDeleteProgram(m_program);
-      m_program = m_nextProgram;
-      m_nextProgram = 0;
-      m_programBuildFailed = false;
-      createUBOs();
-      setupVAO();
-    } else {
-      m_programBuildFailed = true;
-    }
-    m_programBuildPhase = ProgramBuildPhase::Done;
-#if defined(__EMSCRIPTEN__)
-    firstProgramBuild = false;
-#endif
+  for (auto const &sample : m_gpuTimer.poll()) {
+    onChunkTimed(sample);
   }
 
-  if (m_programBuildPhase != ProgramBuildPhase::Done) {
+  if (m_pendingProgramKey.has_value() && !m_usingFallback &&
+      !m_respecializing) {
     return;
   }
 
-  if (!m_frameState.isRendering || hasStateInvalidatedFrame(renderState)) {
+  auto const isStateChanged{hasStateInvalidatedFrame(renderState)};
+  if (isStateChanged) {
+    m_presentedStateValid = false;
+  }
+  if (!m_frameState.isRendering || isStateChanged) {
     if (!m_frameState.isRendering) {
       onFrameCompleted();
     }
-    startNewFrame(renderState);
+
+    // Refinement restarts from the coarsest level whenever the view changes
+    auto const lightDirWorld{
+        glm::mat3(camera.getInvViewMatrix()) *
+        glm::normalize(glm::vec3{lightRotation * kLightDirection})};
+    auto const isViewChanged{
+        camera.getViewMatrix() != m_cameraUBOData.viewMatrix ||
+        camera.getProjMatrix() != m_cameraUBOData.projMatrix ||
+        camera.getModelMatrix() != m_cameraUBOData.modelMatrix ||
+        lightDirWorld != m_shadingUBOData.lightDirWorld};
+    startNewFrame(renderState, isStateChanged || isViewChanged);
 
     // Update camera and shading UBO data
     m_cameraUBOData.eye = camera.getPosition();
@@ -158,32 +256,41 @@ void Raycast::onPaint(Camera const &camera, RenderState const &renderState,
 
     m_cameraUBOData.maxModelScale = camera.getModelScale();
 
+    // Colormaps are uploaded only when changed
+    m_sequentialColormap.update(renderState.getSequentialColormap());
+    m_divergingColormap.update(renderState.getDivergingColormap());
+
     m_shadingUBOData.insideKdId = renderState.insideKdId;
     m_shadingUBOData.outsideKdId = renderState.outsideKdId;
-    m_shadingUBOData.lightDirWorld =
-        glm::mat3(m_cameraUBOData.invViewMatrix) *
-        glm::normalize(glm::vec3{lightRotation * kLightDirection});
-
-    for (auto &&[index, param] :
-         iter::enumerate(renderState.function.getParameters())) {
-      auto const vecIndex{index / 4};
-      auto const varIndex{gsl::narrow<int>(index % 4)};
-      m_paramsUBOData.data.at(vecIndex)[varIndex] = param.value;
-    }
+    m_shadingUBOData.lightDirWorld = lightDirWorld;
+
+    m_parameterBuffer.update(renderState.function.getParameters());
 
     if (m_onFrameStart) {
       m_onFrameStart();
     }
   }
 
+  // The brick map and the scalar field texture are rendered over several UI
+  // frames. Frames restart to use them once they are complete.
+  if (renderState.useBrickMap) {
+    renderBrickMap(renderState);
+  }
+  if (renderState.useFieldTexture) {
+    renderFieldTexture(renderState);
+  }
+
   if (m_frameState.isRendering) {
     renderChunk(renderState);
-    if (m_frameState.nextChunkY >= m_frameState.viewportSize.y) {
+    if (m_frameState.nextTile >= m_frameState.tiles.size()) {
       m_frameState.isRendering = false;
 
       if (m_onFrameEnd) {
         m_onFrameEnd();
       }
+      m_presentedRenderSize = m_frameState.renderSize;
+      m_presentedLevelScale = m_frameState.levelScale;
+      m_presentedStateValid = true;
     }
   }
 }
@@ -191,193 +298,252 @@ void Raycast::onPaint(Camera const &camera, RenderState const &renderState,
 void Raycast::onDestroy() {
   abcg::glDeleteVertexArrays(1, &m_VAO);
   abcg::glDeleteBuffers(1, &m_VBO);
-  abcg::glDeleteBuffers(1, &m_UBOParams);
   abcg::glDeleteBuffers(1, &m_UBOShading);
   abcg::glDeleteBuffers(1, &m_UBOCamera);
-  abcg::glDeleteProgram(m_program);
+  m_parameterBuffer.destroy();
+  m_brickMap.destroy();
+  m_brickMapKey.reset();
+  m_brickMapLayers = 0;
+  m_fieldTexture.destroy();
+  m_fieldTextureKey.reset();
+  m_fieldTextureLayers = 0;
+  m_divergingColormap.destroy();
+  m_sequentialColormap.destroy();
+  m_programScheduler.onDestroy();
+  m_profileStore.onDestroy();
+  m_gpuTimer.destroy();
+  if (m_chunkFence != nullptr) {
+    abcg::glDeleteSync(m_chunkFence);
+    m_chunkFence = nullptr;
+  }
+  m_programCache.clear();
+  m_program = nullptr;
 }
 
 void Raycast::createProgram(RenderState const &renderState) {
-  static auto const &assetsPath{abcg::Application::getAssetsPath()};
-
-  auto const readFile{[](std::filesystem::path const &path) -> std::string {
-    auto const utf8Path{abcg::pathToUtf8(path)};
-    std::ifstream stream(utf8Path, std::ios::binary);
-    if (!stream) {
-      throw abcg::RuntimeError(std::format("Failed to read file {}", utf8Path));
-    }
+  // After a parameter is edited, the program that reads the parameters from
+  // uniforms keeps rendering at full resolution while their values are folded
+  // into a new one
+  auto const canRenderWithProgram{
+      m_program != nullptr && !m_usingFallback &&
+      !m_pendingProgramKey.has_value() &&
+      m_programRenderState.canProgramRender(renderState)};
+
+  m_programRenderState = renderState;
+  m_pendingProgramKey.reset();
+  m_usingFallback = false;
+  m_respecializing = false;
+
+  auto sources{
+      createProgramSources(renderState, ProgramVariant::Specialized)};
+  auto const key{getProgramKey(sources)};
+
+  if (auto const *program{m_programCache.find(key)}) {
+    useProgram(*program);
+    return;
+  }
 
-    std::ostringstream ss;
-    ss << stream.rdbuf();
-    return ss.str();
-  }};
+  if (auto const *program{loadProgramBinary(key, sources)}) {
+    useProgram(*program);
+    return;
+  }
 
-  std::vector<abcg::ShaderSource> sources{
-      {.source =
-           readFile(assetsPath / std::filesystem::path{kVertexShaderPath}),
-       .stage = abcg::ShaderStage::Vertex},
-      {.source =
-           readFile(assetsPath / std::filesystem::path{kFragmentShaderPath}),
-       .stage = abcg::ShaderStage::Fragment}};
+  m_pendingProgramKey = key;
+  m_programScheduler.submit(key, std::move(sources),
+                            ProgramScheduler::Priority::Foreground,
+                            m_throwOnProgramBuild);
 
-  // Replace placeholders
-  std::string definitions{};
-  if (renderState.boundsShape == RenderState::BoundsShape::Box) {
-    definitions += "#define USE_BOUNDING_BOX\n";
+  if (canRenderWithProgram) {
+    m_respecializing = true;
+    return;
   }
 
-  if (renderState.raymarchRootTest == RenderState::RootTestMode::SignChange) {
-    definitions += "#define USE_SIGN_TEST\n";
-  } else if (renderState.raymarchRootTest ==
-             RenderState::RootTestMode::Taylor1stOrder) {
-    definitions += "#define USE_TAYLOR_1ST\n";
-  } else if (renderState.raymarchRootTest ==
-             RenderState::RootTestMode::Taylor2ndOrder) {
-    definitions += "#define USE_TAYLOR_2ND\n";
+  // Render with the generic variant in the meantime if it is available, or
+  // build it so that later changes of rendering options can use it
+  auto genericSources{
+      createProgramSources(renderState, ProgramVariant::Generic)};
+  auto const genericKey{getProgramKey(genericSources)};
+  auto const *generic{m_programCache.find(genericKey)};
+  if (generic == nullptr) {
+    generic = loadProgramBinary(genericKey, genericSources);
   }
-
-  if (renderState.raymarchGradientEvaluation ==
-      RenderState::GradientMode::CentralDifference) {
-    definitions += "#define GRADIENT_CENTRAL_DIFFERENCE\n";
-  } else if (renderState.raymarchGradientEvaluation ==
-             RenderState::GradientMode::FivePointStencil) {
-    definitions += "#define GRADIENT_FIVE_POINT_STENCIL\n";
+  if (generic != nullptr) {
+    useProgram(*generic);
+    m_usingFallback = true;
+  } else if (!m_programScheduler.isScheduled(genericKey)) {
+    m_programScheduler.submit(genericKey, std::move(genericSources),
+                              ProgramScheduler::Priority::Background);
   }
+}
 
-  if (renderState.raymarchAdaptive) {
-    definitions += "#define USE_ADAPTIVE_RAY_MARCH\n";
+void Raycast::prewarm(std::vector<RenderState> const &renderStates) {
+  m_programScheduler.clearBackgroundQueue();
+
+  // Without parallel compilation, polling a build blocks the frame until the
+  // build finishes, so speculative builds would stutter the idle UI
+  if (!m_programScheduler.isParallelCompileSupported()) {
+    return;
   }
 
-  if (renderState.renderingMode == RenderState::RenderingMode::LitSurface) {
-    definitions += "#define USE_BLINN_PHONG\n";
+  // Specialized variants first, since they are the ones that get displayed
+  for (auto const variant :
+       {ProgramVariant::Specialized, ProgramVariant::Generic}) {
+    for (auto const &renderState : renderStates) {
+      auto sources{createProgramSources(renderState, variant)};
+      auto const key{getProgramKey(sources)};
+      if (m_programCache.contains(key) ||
+          m_programScheduler.isScheduled(key) ||
+          loadProgramBinary(key, sources) != nullptr) {
+        continue;
+      }
+      m_programScheduler.submit(key, std::move(sources),
+                                ProgramScheduler::Priority::Background);
+    }
   }
+}
+
+void Raycast::loadShaderTemplates() {
+  static auto const &assetsPath{abcg::Application::getAssetsPath()};
 
-  if (renderState.renderingMode == RenderState::RenderingMode::LitSurface ||
-      renderState.renderingMode == RenderState::RenderingMode::UnlitSurface) {
-    definitions += "#define SHOW_ISOSURFACE\n";
+  m_vertexShaderTemplate = ShaderTemplate::load(
+      assetsPath / std::filesystem::path{kVertexShaderPath},
+      abcg::ShaderStage::Vertex);
+  m_fragmentShaderTemplate = ShaderTemplate::load(
+      assetsPath / std::filesystem::path{kFragmentShaderPath},
+      abcg::ShaderStage::Fragment, kPlaceholderNames);
+}
 
-    if (renderState.msaaSamples > 1) {
+std::vector<abcg::ShaderSource>
+Raycast::createProgramSources(RenderState const &renderState,
+                              ProgramVariant variant) const {
+  auto const &function{renderState.function};
+  auto const &parameters{function.getParameters()};
+
+  // The parameter block is sized for the parameters of the function
+  std::string definitions{std::format(
+      "#define PARAMS_SIZE {}\n",
+      ParameterBuffer::getNumVectors(parameters.size()))};
+  if (variant == ProgramVariant::Generic) {
+    definitions += "#define GENERIC_VARIANT\n";
+  } else {
+    auto const define{[&definitions](std::string_view name, auto value) {
+      definitions += std::format("#define {} {}\n", name, value);
+    }};
+
+    // Enumerations are converted to the integer constants of raycast.frag
+    define("kUseBoundingBox",
+           renderState.boundsShape == RenderState::BoundsShape::Box);
+    define("kRaymarchMethod", static_cast<int>(renderState.raymarchMethod));
+    define("kRootTest", static_cast<int>(renderState.raymarchRootTest));
+    define("kGradientMode",
+           static_cast<int>(renderState.raymarchGradientEvaluation));
+    define("kRenderingMode", static_cast<int>(renderState.renderingMode));
+    define("kSurfaceColorMode",
+           static_cast<int>(renderState.surfaceColorMode));
+    define("kUseShadows", renderState.useShadows);
+    define("kUseFog", renderState.useFog);
+    define("kInwardNormals", renderState.inwardNormals);
+    define("kShowAxes", renderState.showAxes);
+    define("ISOSURFACE_RAYMARCH_STEPS", renderState.isosurfaceRaymarchSteps);
+    define("DVR_RAYMARCH_STEPS", renderState.dvrRaymarchSteps);
+
+    if (renderState.getEffectiveMSAASamples() > 1) {
       definitions += "#define MSAA_ENABLED\n";
       definitions += std::format("#define MSAA_{}X\n", renderState.msaaSamples);
     }
   }
 
-  if (renderState.useShadows) {
-    definitions += "#define USE_SHADOWS\n";
+  if (function.hasAnalyticDerivatives()) {
+    definitions += "#define ANALYTIC_DERIVATIVES\n";
   }
-
-  if (renderState.useFog) {
-    definitions += "#define USE_FOG\n";
+  // The specialized variant only needs the polynomial if it is used
+  if (function.isPolynomial() &&
+      (variant == ProgramVariant::Generic ||
+       renderState.raymarchMethod == RenderState::RaymarchMethod::Polynomial)) {
+    definitions += std::format("#define POLYNOMIAL_DEGREE {}\n",
+                               function.getPolynomialDegree());
   }
-
-  if (renderState.surfaceColorMode ==
-      RenderState::SurfaceColorMode::UnitNormal) {
-    definitions += "#define SHOW_NORMAL_VECTOR\n";
-  } else if (renderState.surfaceColorMode ==
-             RenderState::SurfaceColorMode::GaussianCurvature) {
-    definitions += "#define USE_CURVATURE\n";
-    definitions += "#define SHOW_GAUSSIAN_CURVATURE\n";
-  } else if (renderState.surfaceColorMode ==
-             RenderState::SurfaceColorMode::MeanCurvature) {
-    definitions += "#define USE_CURVATURE\n";
-    definitions += "#define SHOW_MEAN_CURVATURE\n";
-  } else if (renderState.surfaceColorMode ==
-             RenderState::SurfaceColorMode::MaxAbsCurvature) {
-    definitions += "#define USE_CURVATURE\n";
-    definitions += "#define SHOW_MAX_CURVATURE\n";
-  } else if (renderState.surfaceColorMode ==
-             RenderState::SurfaceColorMode::NormalMagnitude) {
-    definitions += "#define SHOW_NORMAL_MAGNITUDE\n";
+  if (function.hasIntervalExtension() &&
+      (variant == ProgramVariant::Generic ||
+       renderState.usesIntervalExtension())) {
+    definitions += "#define INTERVAL_EXTENSION\n";
   }
 
-  if (renderState.inwardNormals) {
-    definitions += "#define INWARD_NORMALS\n";
-  }
+  // Parameter values are only folded into the specialized variant, so that
+  // the generic variant does not depend on them, and not while a parameter is
+  // edited, so that the same program renders edits of any parameter
+  auto const &data{function.getData()};
+  auto const bindings{getParameterBindings(
+      parameters, variant == ProgramVariant::Specialized &&
+                      !renderState.editedParameter.has_value())};
+  auto const bind{[&](std::string_view code) {
+    return bindParameters(code, parameters, bindings);
+  }};
+  auto const expression{bind(function.getGLSLExpression())};
+  // Temporaries of common subexpressions may use the variables of the local
+  // code, so they are declared after it
+  auto const codeLocal{std::format("{}\n{}", data.codeLocal,
+                                   bind(function.getGLSLTemporaries()))};
+  auto const gradient{bind(function.getGLSLGradient())};
+  auto const hessian{bind(function.getGLSLHessian())};
+  auto const polynomial{bind(function.getGLSLPolynomial())};
+  auto const interval{bind(function.getGLSLInterval())};
+
+  std::array<std::string_view, kPlaceholderNames.size()> values{};
+  auto const setValue{
+      [&values](Placeholder placeholder, std::string_view value) {
+        values.at(static_cast<std::size_t>(placeholder)) = value;
+      }};
+  setValue(Placeholder::Definitions, definitions);
+  setValue(Placeholder::CodeGlobal, data.codeGlobal);
+  setValue(Placeholder::CodeLocal, codeLocal);
+  setValue(Placeholder::ExpressionLHS, expression);
+  setValue(Placeholder::CodeGradient, gradient);
+  setValue(Placeholder::CodeHessian, hessian);
+  setValue(Placeholder::CodePolynomial, polynomial);
+  setValue(Placeholder::CodeInterval, interval);
+
+  return {m_vertexShaderTemplate.assemble(),
+          m_fragmentShaderTemplate.assemble(values)};
+}
 
-  if (renderState.showAxes) {
-    definitions += "#define SHOW_AXES\n";
+std::uint64_t
+Raycast::getProgramKey(std::vector<abcg::ShaderSource> const &sources) {
+  std::uint64_t key{util::hashFNV1a({})};
+  for (auto const &source : sources) {
+    key = util::hashFNV1a(source.source, key);
   }
+  return key;
+}
 
-  definitions += "#define ISOSURFACE_RAYMARCH_STEPS " +
-                 std::to_string(renderState.isosurfaceRaymarchSteps) + '\n';
-  definitions += "#define DVR_RAYMARCH_STEPS " +
-                 std::to_string(renderState.dvrRaymarchSteps) + '\n';
-
-  definitions += getColormapDefinition(
-      "SEQ_COLORMAP", renderState.surfaceColorMode ==
-                              RenderState::SurfaceColorMode::NormalMagnitude
-                          ? renderState.normalLengthColormap
-                          : renderState.maxAbsCurvColormap);
-
-  definitions += getColormapDefinition(
-      "DIV_COLORMAP",
-      renderState.renderingMode == RenderState::RenderingMode::DirectVolume
-          ? renderState.dvrColormap
-          : renderState.curvatureColormap);
-
-  auto &fragmentShader{sources.at(1)};
-  util::replaceAll(fragmentShader.source, "@DEFINITIONS@", definitions);
-
-  util::replaceAll(fragmentShader.source, "@ISOVALUE@",
-                     std::to_string(renderState.isoValue));
-
-  util::replaceAll(fragmentShader.source, "@BOUND_RADIUS@",
-                     std::to_string(renderState.boundsRadius));
-
-  auto const &data{renderState.function.getData()};
-  std::string const codeLocal{data.codeLocal};
-  std::string const codeGlobal{data.codeGlobal};
-
-  std::string expression{renderState.function.getGLSLExpression()};
-
-  // Replace parameter names with uParams.data[index]
-  for (auto &&[index, param] :
-       iter::enumerate(renderState.function.getParameters())) {
-
-    auto const vecIndex{index / 4};
-    static std::array const variables{'x', 'y', 'z', 'w'};
-    auto const var{variables.at(index % 4)};
-
-    util::replaceAll(expression, param.name,
-                       std::format("uParams.data[{}].{}", vecIndex, var), true);
+ProgramCache::Program const *
+Raycast::loadProgramBinary(std::uint64_t key,
+                           std::vector<abcg::ShaderSource> const &sources) {
+  auto const program{m_programBinaryCache.load(key)};
+  if (program == 0) {
+    return nullptr;
   }
 
-  // This replacement must be performed AFTER the replacement of parameter names
-  // with uParams.data[index]. Otherwise, "P" can be wrongly interpreted as
-  // a parameter.
-  util::replaceAll(expression, "@P.@", "P.");
-
-  util::replaceAll(fragmentShader.source, "@CODE_LOCAL@", codeLocal);
-  util::replaceAll(fragmentShader.source, "@CODE_GLOBAL@", codeGlobal);
-  util::replaceAll(fragmentShader.source, "@EXPRESSION_LHS@", expression);
-
-  // Interrupted during building?
-  if (m_programBuildPhase != ProgramBuildPhase::Done) {
-    // Delete shaders
-    for (auto const &shaderID : m_shaderIDs) {
-      if (shaderID.shader == 0) {
-        continue;
-      }
-      abcg::glDeleteShader(shaderID.shader);
-    }
+  std::size_t sourceSize{};
+  for (auto const &source : sources) {
+    sourceSize += source.source.size();
   }
-  // Interrupted during linking?
-  if (m_programBuildPhase == ProgramBuildPhase::Link) {
-    abcg::glDeleteProgram(m_nextProgram);
-  }
-
-  m_programBuildTime.restart();
-  m_shaderIDs = abcg::triggerOpenGLShaderCompile(sources);
-  m_programBuildPhase = ProgramBuildPhase::Compile;
+  return &m_programCache.insert(key, program, kUniformBlockBindings,
+                                kUniformNames, sourceSize);
+}
 
-  m_frameState.capturedState = renderState;
+void Raycast::useProgram(ProgramCache::Program const &program) {
+  m_program = &program;
+  m_programCache.setActive(program.key);
+  m_programBuildFailed = false;
+  setupVAO();
 }
 
 void Raycast::createUBOs() {
   destroyUBOs();
 
-  auto createUBO{[&]<typename T>(T const &data, GLuint bindingPoint,
-                                 GLchar const *uniformBlockName) {
+  // Uniform block bindings are set per program by ProgramCache::insert
+  auto createUBO{[&]<typename T>(T const &data, GLuint bindingPoint) {
     GLuint buffer{};
     abcg::glGenBuffers(1, &buffer);
 
@@ -389,43 +555,17 @@ void Raycast::createUBOs() {
     // Link the buffer to a binding point
     abcg::glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, buffer);
 
-    // Connect the binding point to the block index of the program
-    auto const index{abcg::glGetUniformBlockIndex(m_program, uniformBlockName)};
-    if (index == GL_INVALID_INDEX) {
-      destroyUBOs();
-      throw abcg::RuntimeError(std::format(
-          "\"{}\" does not identify an active uniform block of program",
-          uniformBlockName));
-    }
-    abcg::glUniformBlockBinding(m_program, index, bindingPoint);
-
     return buffer;
   }};
 
-  m_UBOCamera = createUBO(m_cameraUBOData, 0, "CameraBlock");
-  m_UBOShading = createUBO(m_shadingUBOData, 1, "ShadingBlock");
-  m_UBOParams = createUBO(m_paramsUBOData, 2, "ParamsBlock");
-
-  // Get location of other uniform variables
-  m_isoValueLocation = abcg::glGetUniformLocation(m_program, "uIsoValue");
-  m_dvrDensityLocation = abcg::glGetUniformLocation(m_program, "uDVRDensity");
-  m_dvrFalloffLocation = abcg::glGetUniformLocation(m_program, "uDVRFalloff");
-  m_gaussianCurvatureFalloffLocation =
-      abcg::glGetUniformLocation(m_program, "uGaussianCurvatureFalloff");
-  m_meanCurvatureFalloffLocation =
-      abcg::glGetUniformLocation(m_program, "uMeanCurvatureFalloff");
-  m_maxAbsCurvatureFalloffLocation =
-      abcg::glGetUniformLocation(m_program, "uMaxAbsCurvatureFalloff");
-  m_normalLengthFalloffLocation =
-      abcg::glGetUniformLocation(m_program, "uNormalLengthFalloff");
-  m_colorTextureLocation =
-      abcg::glGetUniformLocation(m_program, "uColorTexture");
-  m_depthTextureLocation =
-      abcg::glGetUniformLocation(m_program, "uDepthTexture");
+  // Binding points must match kUniformBlockBindings
+  m_UBOCamera = createUBO(m_cameraUBOData, 0);
+  m_UBOShading = createUBO(m_shadingUBOData, 1);
+  m_parameterBuffer.create(2);
 }
 
 void Raycast::destroyUBOs() {
-  abcg::glDeleteBuffers(1, &m_UBOParams);
+  m_parameterBuffer.destroy();
   abcg::glDeleteBuffers(1, &m_UBOShading);
   abcg::glDeleteBuffers(1, &m_UBOCamera);
 }
@@ -449,7 +589,7 @@ void Raycast::setupVAO() {
   abcg::glBindVertexArray(m_VAO);
 
   auto const setUpVertexAttribute{[&](auto name, auto size, intptr_t offset) {
-    auto const location{abcg::glGetAttribLocation(m_program, name)};
+    auto const location{abcg::glGetAttribLocation(m_program->id, name)};
     if (location >= 0) {
       abcg::glEnableVertexAttribArray(gsl::narrow<GLuint>(location));
       // NOLINTBEGIN(*reinterpret-cast, performance-no-int-to-ptr)
@@ -472,33 +612,188 @@ void Raycast::setupVAO() {
 }
 
 void Raycast::resetFrameState() {
+  // The profile of what was rendered until now will not change anymore
+  m_profileStore.save();
   m_frameState.frameTimer.restart();
   m_frameState.numChunksEstimate = 1.0;
+  m_frameState.seedNumChunksEstimate = true;
+  m_frameState.gpuSecondsPerPixel = 0.0;
+  m_gpuTimer.discardPending();
   m_frameState.isRendering = false;
-  m_frameState.nextChunkY = 0;
-  m_frameState.chunkHeight = 0;
+  m_frameState.chunkPixels = 0.0;
+  m_frameState.restartRefinement = true;
+  m_frameState.tiles.clear();
+  m_frameState.nextTile = 0;
   m_frameState.lastFrameTime = 0.0;
+  m_presentedStateValid = false;
 }
 
-void Raycast::startNewFrame(RenderState const &renderState) {
-  m_frameState.frameTimer.restart();
+void Raycast::startNewFrame(RenderState const &renderState,
+                            bool restartRefinement) {
   m_frameState.isRendering = true;
   m_frameState.capturedState = renderState;
-  m_frameState.nextChunkY = 0;
-  m_frameState.chunkHeight =
-      std::max(1, m_frameState.viewportSize.y /
-                      gsl::narrow_cast<int>(m_frameState.numChunksEstimate));
+  auto const divisor{m_usingFallback ? kFallbackResolutionDivisor : 1};
+  m_frameState.fullRenderSize =
+      glm::max(m_frameState.viewportSize / divisor, glm::ivec2{1});
+  auto const fullPixels{gsl::narrow<double>(m_frameState.fullRenderSize.x) *
+                        gsl::narrow<double>(m_frameState.fullRenderSize.y)};
+  if (m_frameState.seedNumChunksEstimate) {
+    m_frameState.seedNumChunksEstimate = false;
+    // Start from the number of chunks that kept the UI at kMinimumUIFPS the
+    // last time the same function was rendered, scaled by the change of cost
+    // of the frame. Otherwise, estimate it from the cost model, instead of
+    // waiting for the first frames to adapt it.
+    auto numChunksEstimate{
+        estimateFrameTime(renderState, m_frameState.fullRenderSize) *
+        kMinimumUIFPS};
+    if (auto const profile{m_profileStore.find(getProfileKey(renderState))};
+        profile.has_value() && profile->frameCost > 0.0) {
+      auto const frameCost{renderState.estimatePixelCost() * fullPixels};
+      numChunksEstimate =
+          profile->numChunksEstimate * frameCost / profile->frameCost;
+      m_frameState.lastFrameTime = profile->frameTime;
+    }
+    m_frameState.numChunksEstimate = std::clamp(
+        numChunksEstimate, 1.0, gsl::narrow<double>(kMaxTotalChunks));
+  }
+
+  // Each completed level is followed by the next finer one. Once at the
+  // finest level, frames are rendered again at that level until the view
+  // changes.
+  auto const getNextLevelScale{[&renderState](double levelScale) {
+    return renderState.progressiveRefinement ? std::min(levelScale * 2.0, 1.0)
+                                             : 1.0;
+  }};
+  auto const isRestarted{restartRefinement};
+  auto const isInteracting{restartRefinement &&
+                           m_interactionTimer.elapsed() < kInteractionTime};
+  if (restartRefinement) {
+    m_interactionTimer.restart();
+  }
+  restartRefinement = std::exchange(m_frameState.restartRefinement, false) ||
+                      restartRefinement;
+  auto const isFirstLevel{restartRefinement ||
+                          m_frameState.levelScale >= 1.0};
+  if (isInteracting) {
+    m_frameState.levelScale = getInteractiveLevelScale(renderState);
+  } else if (restartRefinement) {
+    m_frameState.levelScale =
+        renderState.progressiveRefinement ? getCoarsestLevelScale() : 1.0;
+  } else {
+    m_frameState.levelScale = getNextLevelScale(m_frameState.levelScale);
+  }
+  m_frameState.renderSize =
+      scaleRenderSize(m_frameState.fullRenderSize, m_frameState.levelScale);
+  // Hits are only valid if the state did not change since the presented
+  // frame, so a restart means that the view changed
+  m_frameState.reprojectHits =
+      m_presentedStateValid && (isRestarted || m_frameState.levelScale < 1.0);
+
+  // Frames at the finest level that follow a frame at that level add another
+  // sample to the average of the previous ones
+  auto const isAccumulating{
+      renderState.temporalSupersampling && !m_usingFallback &&
+      !restartRefinement && m_presentedStateValid &&
+      m_presentedLevelScale >= 1.0 && m_frameState.levelScale >= 1.0};
+  m_frameState.sampleIndex =
+      isAccumulating ? m_frameState.sampleIndex + 1 : 0;
+  m_frameState.isPrepassRendered = false;
+  m_frameState.useFieldTexture = isFieldTextureReady(renderState);
+  m_frameState.useBrickMap = isBrickMapReady(renderState);
+
+  if (isFirstLevel) {
+    m_frameState.frameTimer.restart();
+    m_frameState.renderedPixels = 0.0;
+    m_frameState.refinementPixels = 0.0;
+    for (auto levelScale{m_frameState.levelScale};;
+         levelScale = getNextLevelScale(levelScale)) {
+      auto const size{
+          scaleRenderSize(m_frameState.fullRenderSize, levelScale)};
+      m_frameState.refinementPixels +=
+          gsl::narrow<double>(size.x) * gsl::narrow<double>(size.y);
+      if (levelScale >= 1.0) {
+        break;
+      }
+    }
+  }
+
+  // The tile under the focus position is rendered first, followed by the
+  // others from the center out
+  auto const size{m_frameState.renderSize};
+  glm::ivec2 const numTiles{(size + kTileSize - 1) / kTileSize};
+  auto const center{glm::vec2{size} * 0.5f};
+  std::optional<glm::ivec2> focusTile;
+  if (m_focusPosition.has_value()) {
+    focusTile = glm::ivec2{glm::clamp(*m_focusPosition, 0.0f, 1.0f) *
+                           glm::vec2{size}} /
+                kTileSize;
+  }
+  auto &tiles{m_frameState.tiles};
+  tiles.clear();
+  for (auto const y : iter::range(numTiles.y)) {
+    for (auto const x : iter::range(numTiles.x)) {
+      glm::ivec2 const position{x * kTileSize, y * kTileSize};
+      tiles.emplace_back(position, glm::min(glm::ivec2{kTileSize},
+                                            size - position));
+    }
+  }
+  auto const getPriority{[&](glm::ivec4 const &tile) {
+    if (focusTile == glm::ivec2{tile} / kTileSize) {
+      return -1.0f;
+    }
+    auto const tileCenter{glm::vec2{tile.x, tile.y} +
+                          glm::vec2{tile.z, tile.w} * 0.5f};
+    return glm::distance(tileCenter, center);
+  }};
+  std::ranges::stable_sort(tiles, {}, getPriority);
+  m_frameState.nextTile = 0;
+
+  m_frameState.chunkPixels =
+      fullPixels / std::max(m_frameState.numChunksEstimate, 1.0);
+}
+
+double Raycast::getCoarsestLevelScale() const noexcept {
+  // Coarsest level that is expected to be rendered in a single chunk, as each
+  // level has a quarter of the pixels of the next one
+  auto levelScale{1.0};
+  while (levelScale > kMinLevelScale &&
+         levelScale * levelScale * m_frameState.numChunksEstimate > 1.0) {
+    levelScale *= 0.5;
+  }
+  return levelScale;
+}
+
+double
+Raycast::getInteractiveLevelScale(RenderState const &renderState) const {
+  // Estimated time of a frame at full resolution, preferably from GPU timings
+  auto const fullPixels{gsl::narrow<double>(m_frameState.fullRenderSize.x) *
+                        gsl::narrow<double>(m_frameState.fullRenderSize.y)};
+  auto const frameTime{
+      m_frameState.gpuSecondsPerPixel > 0.0
+          ? m_frameState.gpuSecondsPerPixel * fullPixels
+          : estimateFrameTime(renderState, m_frameState.fullRenderSize)};
+  auto const targetFrameTime{
+      1.0 / gsl::narrow_cast<double>(renderState.interactiveTargetFPS)};
+  if (frameTime <= targetFrameTime) {
+    return 1.0;
+  }
+  // The number of pixels is proportional to the square of the scale
+  return std::clamp(std::sqrt(targetFrameTime / frameTime),
+                    gsl::narrow_cast<double>(renderState.minRenderScale), 1.0);
 }
 
 void Raycast::renderChunk(RenderState const &renderState) {
-  if (m_program == 0) {
+  // Do not queue another chunk while the GPU is still rendering the previous
+  // one, so that the GPU never runs more than one UI frame behind
+  if (m_program == nullptr || isGPUBehind()) {
     return;
   }
 
-  auto const chunkY{m_frameState.nextChunkY};
-  auto const chunkHeight{
-      std::min(m_frameState.chunkHeight, m_frameState.viewportSize.y - chunkY)};
-  if (chunkHeight <= 0) {
+  if (m_frameState.gpuSecondsPerPixel > 0.0) {
+    updateChunkPixels(renderState);
+  }
+
+  if (m_frameState.nextTile >= m_frameState.tiles.size()) {
     return;
   }
 
@@ -506,10 +801,9 @@ void Raycast::renderChunk(RenderState const &renderState) {
   abcg::glDepthFunc(GL_ALWAYS);
   abcg::glDepthMask(GL_TRUE);
 
-  abcg::glEnable(GL_SCISSOR_TEST);
-  abcg::glScissor(0, chunkY, m_frameState.viewportSize.x, chunkHeight);
+  abcg::glViewport(0, 0, m_frameState.renderSize.x, m_frameState.renderSize.y);
 
-  abcg::glUseProgram(m_program);
+  abcg::glUseProgram(m_program->id);
 
   auto const updateUBO{[]<typename T>(GLuint buffer, std::span<T> const span) {
     abcg::glBindBuffer(GL_UNIFORM_BUFFER, buffer);
@@ -520,26 +814,45 @@ void Raycast::renderChunk(RenderState const &renderState) {
   updateUBO(m_UBOCamera, std::span{&m_cameraUBOData, sizeof(m_cameraUBOData)});
   updateUBO(m_UBOShading,
             std::span{&m_shadingUBOData, sizeof(m_shadingUBOData)});
-  updateUBO(m_UBOParams, std::span{&m_paramsUBOData, sizeof(m_paramsUBOData)});
 
-  abcg::glUniform1f(m_isoValueLocation, renderState.isoValue);
-  abcg::glUniform1f(m_dvrDensityLocation, renderState.dvrDensity);
-  abcg::glUniform1f(m_dvrFalloffLocation, renderState.dvrFalloff);
-  abcg::glUniform1f(m_gaussianCurvatureFalloffLocation,
+  abcg::glUniform1f(getUniformLocation(Uniform::IsoValue),
+                    renderState.isoValue);
+  abcg::glUniform1f(getUniformLocation(Uniform::BoundRadius),
+                    renderState.boundsRadius);
+  abcg::glUniform1f(getUniformLocation(Uniform::DVRDensity),
+                    renderState.dvrDensity);
+  abcg::glUniform1f(getUniformLocation(Uniform::DVRFalloff),
+                    renderState.dvrFalloff);
+  abcg::glUniform1f(getUniformLocation(Uniform::DVROpacityThreshold),
+                    renderState.dvrOpacityThreshold);
+  abcg::glUniform1i(getUniformLocation(Uniform::DVRAdaptiveStep),
+                    renderState.dvrAdaptiveStep ? 1 : 0);
+  abcg::glUniform1f(getUniformLocation(Uniform::GaussianCurvatureFalloff),
                     renderState.gaussianCurvatureFalloff);
-  abcg::glUniform1f(m_meanCurvatureFalloffLocation,
+  abcg::glUniform1f(getUniformLocation(Uniform::MeanCurvatureFalloff),
                     renderState.meanCurvatureFalloff);
-  abcg::glUniform1f(m_maxAbsCurvatureFalloffLocation,
+  abcg::glUniform1f(getUniformLocation(Uniform::MaxAbsCurvatureFalloff),
                     renderState.maxAbsCurvatureFalloff);
-  abcg::glUniform1f(m_normalLengthFalloffLocation,
+  abcg::glUniform1f(getUniformLocation(Uniform::NormalLengthFalloff),
                     renderState.normalLengthFalloff);
 
+  if (m_usingFallback) {
+    setGenericVariantUniforms(renderState);
+  }
+
+  abcg::glActiveTexture(GL_TEXTURE2);
+  abcg::glBindTexture(GL_TEXTURE_2D, m_sequentialColormap.getTexture());
+  abcg::glUniform1i(getUniformLocation(Uniform::SequentialColormap), 2);
+  abcg::glActiveTexture(GL_TEXTURE3);
+  abcg::glBindTexture(GL_TEXTURE_2D, m_divergingColormap.getTexture());
+  abcg::glUniform1i(getUniformLocation(Uniform::DivergingColormap), 3);
+
   if (renderState.showAxes) {
     if (m_depthTextureGetter) {
       if (auto const depthTexture{m_depthTextureGetter()}; depthTexture > 0) {
         abcg::glActiveTexture(GL_TEXTURE0);
         abcg::glBindTexture(GL_TEXTURE_2D, depthTexture);
-        abcg::glUniform1i(m_depthTextureLocation, 0);
+        abcg::glUniform1i(getUniformLocation(Uniform::DepthTexture), 0);
       }
     }
 
@@ -547,43 +860,500 @@ void Raycast::renderChunk(RenderState const &renderState) {
       if (auto const colorTexture{m_colorTextureGetter()}; colorTexture > 0) {
         abcg::glActiveTexture(GL_TEXTURE1);
         abcg::glBindTexture(GL_TEXTURE_2D, colorTexture);
-        abcg::glUniform1i(m_colorTextureLocation, 1);
+        abcg::glUniform1i(getUniformLocation(Uniform::ColorTexture), 1);
       }
     }
   }
 
+  auto reprojectHits{false};
+  if (m_frameState.reprojectHits && m_positionTextureGetter) {
+    if (auto const positionTexture{m_positionTextureGetter()};
+        positionTexture > 0) {
+      abcg::glActiveTexture(GL_TEXTURE4);
+      abcg::glBindTexture(GL_TEXTURE_2D, positionTexture);
+      abcg::glUniform1i(getUniformLocation(Uniform::PositionTexture), 4);
+      abcg::glUniform2i(getUniformLocation(Uniform::ReprojectionSize),
+                        m_presentedRenderSize.x, m_presentedRenderSize.y);
+      reprojectHits = true;
+    }
+  }
+  abcg::glUniform1i(getUniformLocation(Uniform::ReprojectHits),
+                    reprojectHits ? 1 : 0);
+
+  // Rays of the prepass also skip the empty bricks of the brick map. The
+  // samplers of 3D textures are always set, as samplers of different types
+  // must not refer to the same texture unit.
+  abcg::glUniform1i(getUniformLocation(Uniform::BrickMap), 6);
+  abcg::glUniform1i(getUniformLocation(Uniform::FieldTexture), 7);
+  if (m_frameState.useBrickMap) {
+    abcg::glActiveTexture(GL_TEXTURE6);
+    abcg::glBindTexture(GL_TEXTURE_3D, m_brickMap.getTexture());
+    abcg::glUniform1i(getUniformLocation(Uniform::BrickMapSize),
+                      m_brickMap.getSize());
+  }
+  abcg::glUniform1i(getUniformLocation(Uniform::UseBrickMap),
+                    m_frameState.useBrickMap ? 1 : 0);
+  abcg::glUniform1i(getUniformLocation(Uniform::ShowSkippedBricks),
+                    m_frameState.useBrickMap && renderState.showSkippedBricks
+                        ? 1
+                        : 0);
+
+  if (m_frameState.useFieldTexture) {
+    abcg::glActiveTexture(GL_TEXTURE7);
+    abcg::glBindTexture(GL_TEXTURE_3D, m_fieldTexture.getTexture());
+    abcg::glUniform1i(getUniformLocation(Uniform::FieldTextureSize),
+                      m_fieldTexture.getSize());
+  }
+  abcg::glUniform1i(getUniformLocation(Uniform::UseFieldTexture),
+                    m_frameState.useFieldTexture ? 1 : 0);
+
+  // Rays of surfaces start at the nearest hits of the depth prepass. The
+  // prepass is not timed, as its cost does not scale with the chunk pixels.
+  auto const usePrepass{renderState.renderingMode !=
+                        RenderState::RenderingMode::DirectVolume};
+  if (usePrepass && !m_frameState.isPrepassRendered) {
+    renderDepthPrepass();
+    m_frameState.isPrepassRendered = true;
+  }
+  abcg::glUniform1i(getUniformLocation(Uniform::UsePrepass),
+                    usePrepass ? 1 : 0);
+  if (usePrepass) {
+    abcg::glActiveTexture(GL_TEXTURE5);
+    abcg::glBindTexture(GL_TEXTURE_2D, m_prepassTarget.getColorTexture());
+    abcg::glUniform1i(getUniformLocation(Uniform::PrepassTexture), 5);
+  }
+
+  // Pixels are sampled at the points of a Halton sequence centered at the
+  // pixel center
+  glm::vec2 sampleOffset{};
+  if (auto const index{m_frameState.sampleIndex}; index > 0) {
+    sampleOffset =
+        glm::vec2{getHaltonValue(index, 2), getHaltonValue(index, 3)} - 0.5f;
+  }
+  abcg::glUniform2fv(getUniformLocation(Uniform::SampleOffset), 1,
+                     &sampleOffset.x);
+
+  // Render tiles until the chunk is full. The last tile may overshoot it.
+  auto const isTimed{m_gpuTimer.begin()};
+  abcg::glEnable(GL_SCISSOR_TEST);
   abcg::glBindVertexArray(m_VAO);
-  abcg::glDrawArrays(GL_TRIANGLES, 0, 3);
+  auto chunkPixels{0.0};
+  auto &tiles{m_frameState.tiles};
+  while (m_frameState.nextTile < tiles.size() &&
+         chunkPixels < m_frameState.chunkPixels) {
+    auto const &tile{tiles[m_frameState.nextTile++]};
+    abcg::glScissor(tile.x, tile.y, tile.z, tile.w);
+    abcg::glDrawArrays(GL_TRIANGLES, 0, 3);
+    chunkPixels += gsl::narrow<double>(tile.z) * gsl::narrow<double>(tile.w);
+  }
   abcg::glBindVertexArray(0);
+  if (isTimed) {
+    m_gpuTimer.end(chunkPixels);
+  }
+  m_chunkFence = abcg::glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  m_frameState.renderedPixels += chunkPixels;
 
   abcg::glUseProgram(0);
   abcg::glDisable(GL_SCISSOR_TEST);
+  abcg::glViewport(0, 0, m_frameState.viewportSize.x,
+                   m_frameState.viewportSize.y);
   abcg::glDepthFunc(GL_LESS);
   abcg::glDisable(GL_DEPTH_TEST);
+}
+
+void Raycast::renderDepthPrepass() {
+  // The prepass texture must not be sampled while it is rendered to
+  abcg::glActiveTexture(GL_TEXTURE5);
+  abcg::glBindTexture(GL_TEXTURE_2D, 0);
+
+  GLint framebuffer{};
+  abcg::glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+  m_prepassTarget.bind();
+
+  auto const gridSize{getPrepassGridSize(m_frameState.renderSize)};
+  abcg::glViewport(0, 0, gridSize.x, gridSize.y);
+  abcg::glUniform1i(getUniformLocation(Uniform::RenderPrepass), 1);
+  abcg::glUniform1i(getUniformLocation(Uniform::PrepassTileSize),
+                    kPrepassTileSize);
+  abcg::glUniform2i(getUniformLocation(Uniform::RenderSize),
+                    m_frameState.renderSize.x, m_frameState.renderSize.y);
+
+  abcg::glBindVertexArray(m_VAO);
+  abcg::glDrawArrays(GL_TRIANGLES, 0, 3);
+  abcg::glBindVertexArray(0);
+
+  abcg::glUniform1i(getUniformLocation(Uniform::RenderPrepass), 0);
+  abcg::glBindFramebuffer(GL_FRAMEBUFFER, gsl::narrow<GLuint>(framebuffer));
+  abcg::glViewport(0, 0, m_frameState.renderSize.x, m_frameState.renderSize.y);
+}
+
+void Raycast::renderBrickMap(RenderState const &renderState) {
+  if (auto const key{getBrickMapKey(renderState)}; m_brickMapKey != key) {
+    m_brickMap.resize(renderState.brickMapSize, VolumeTarget::kRGBA32F);
+    m_brickMapKey = key;
+    m_brickMapLayers = 0;
+  }
+
+  auto const size{m_brickMap.getSize()};
+  if (m_program == nullptr || m_brickMapLayers >= size) {
+    return;
+  }
+
+  // Render as many layers as fit in the cost budget of a UI frame
+  auto const brickEvaluations{isBrickMapBounded(renderState)
+                                  ? kBrickIntervalEvaluations
+                                  : kBrickSampleEvaluations};
+  auto const layerCost{(renderState.function.getEvaluationCost() + 1.0) *
+                       brickEvaluations * gsl::narrow<double>(size) *
+                       gsl::narrow<double>(size)};
+  auto const numLayers{
+      std::clamp(gsl::narrow_cast<int>(kBrickMapCostPerFrame / layerCost), 1,
+                 size - m_brickMapLayers)};
+
+  // The brick map must not be sampled while it is rendered to
+  abcg::glActiveTexture(GL_TEXTURE6);
+  abcg::glBindTexture(GL_TEXTURE_3D, 0);
+
+  GLint framebuffer{};
+  abcg::glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+
+  abcg::glUseProgram(m_program->id);
+  abcg::glUniform1f(getUniformLocation(Uniform::IsoValue),
+                    renderState.isoValue);
+  abcg::glUniform1f(getUniformLocation(Uniform::BoundRadius),
+                    renderState.boundsRadius);
+  abcg::glUniform1i(getUniformLocation(Uniform::BrickMap), 6);
+  abcg::glUniform1i(getUniformLocation(Uniform::FieldTexture), 7);
+  abcg::glUniform1i(getUniformLocation(Uniform::RenderBrickMap), 1);
+  abcg::glUniform1i(getUniformLocation(Uniform::BrickMapSize), size);
+
+  // Each fragment of a layer evaluates the range of one brick
+  abcg::glViewport(0, 0, size, size);
+  abcg::glBindVertexArray(m_VAO);
+  for (auto const layer :
+       iter::range(m_brickMapLayers, m_brickMapLayers + numLayers)) {
+    m_brickMap.bindLayer(layer);
+    abcg::glUniform1i(getUniformLocation(Uniform::RenderLayer), layer);
+    abcg::glDrawArrays(GL_TRIANGLES, 0, 3);
+  }
+  abcg::glBindVertexArray(0);
+  m_brickMapLayers += numLayers;
+
+  abcg::glUniform1i(getUniformLocation(Uniform::RenderBrickMap), 0);
+  abcg::glUseProgram(0);
+  abcg::glBindFramebuffer(GL_FRAMEBUFFER, gsl::narrow<GLuint>(framebuffer));
+  abcg::glViewport(0, 0, m_frameState.viewportSize.x,
+                   m_frameState.viewportSize.y);
+}
+
+bool Raycast::isBrickMapReady(RenderState const &renderState) const {
+  if (!renderState.useBrickMap || m_brickMap.getSize() == 0 ||
+      m_brickMapLayers < m_brickMap.getSize()) {
+    return false;
+  }
+  return m_brickMapKey == getBrickMapKey(renderState);
+}
+
+bool Raycast::isBrickMapBounded(
+    RenderState const &renderState) const noexcept {
+  // The fallback program is the generic variant, which always has the
+  // interval extension of the function
+  return renderState.function.hasIntervalExtension() &&
+         (m_usingFallback || renderState.usesIntervalExtension());
+}
+
+std::uint64_t
+Raycast::getBrickMapKey(RenderState const &renderState) const {
+  // Ranges bounded by the interval extension differ from the ones estimated
+  // from samples, so the map is rendered again if the program changes
+  return util::hashFNV1a(std::format("{} {}", renderState.brickMapSize,
+                                     isBrickMapBounded(renderState)),
+                         getFunctionValuesKey(renderState));
+}
 
-  m_frameState.nextChunkY += chunkHeight;
+void Raycast::renderFieldTexture(RenderState const &renderState) {
+  // Sizes whose texture failed to be allocated are not attempted again
+  if (renderState.fieldTextureSize > m_maxFieldTextureSize) {
+    return;
+  }
+
+  auto const format{getFieldTextureFormat(renderState)};
+  auto const key{util::hashFNV1a(std::format("{} {}",
+                                             renderState.fieldTextureSize,
+                                             format.internalFormat),
+                                 getFunctionValuesKey(renderState))};
+  if (m_fieldTextureKey != key) {
+    try {
+      m_fieldTexture.resize(renderState.fieldTextureSize, format);
+    } catch (abcg::Exception const &exception) {
+      // Frames evaluate the function directly until the setting is reset
+      // (see getMaxFieldTextureSize)
+      fmt::print(stderr, "{}\n", exception.what());
+      m_fieldTexture.destroy();
+      m_fieldTextureKey.reset();
+      m_fieldTextureLayers = 0;
+      m_maxFieldTextureSize = renderState.fieldTextureSize - 1;
+      return;
+    }
+    m_fieldTextureKey = key;
+    m_fieldTextureLayers = 0;
+  }
+
+  auto const size{m_fieldTexture.getSize()};
+  if (m_program == nullptr || m_fieldTextureLayers >= size) {
+    return;
+  }
+
+  // Render as many layers as fit in the cost budget of a UI frame
+  auto const layerCost{(renderState.function.getEvaluationCost() + 1.0) *
+                       gsl::narrow<double>(size) * gsl::narrow<double>(size)};
+  auto const numLayers{std::clamp(
+      gsl::narrow_cast<int>(kFieldTextureCostPerFrame / layerCost), 1,
+      size - m_fieldTextureLayers)};
+
+  // The texture must not be sampled while it is rendered to
+  abcg::glActiveTexture(GL_TEXTURE7);
+  abcg::glBindTexture(GL_TEXTURE_3D, 0);
+
+  GLint framebuffer{};
+  abcg::glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+
+  abcg::glUseProgram(m_program->id);
+  abcg::glUniform1f(getUniformLocation(Uniform::IsoValue),
+                    renderState.isoValue);
+  abcg::glUniform1f(getUniformLocation(Uniform::BoundRadius),
+                    renderState.boundsRadius);
+  abcg::glUniform1i(getUniformLocation(Uniform::BrickMap), 6);
+  abcg::glUniform1i(getUniformLocation(Uniform::FieldTexture), 7);
+  abcg::glUniform1i(getUniformLocation(Uniform::RenderFieldTexture), 1);
+  abcg::glUniform1i(getUniformLocation(Uniform::FieldTextureSize), size);
+
+  // Each fragment of a layer evaluates the function at one texel
+  abcg::glViewport(0, 0, size, size);
+  abcg::glBindVertexArray(m_VAO);
+  for (auto const layer :
+       iter::range(m_fieldTextureLayers, m_fieldTextureLayers + numLayers)) {
+    m_fieldTexture.bindLayer(layer);
+    abcg::glUniform1i(getUniformLocation(Uniform::RenderLayer), layer);
+    abcg::glDrawArrays(GL_TRIANGLES, 0, 3);
+  }
+  abcg::glBindVertexArray(0);
+  m_fieldTextureLayers += numLayers;
+
+  abcg::glUniform1i(getUniformLocation(Uniform::RenderFieldTexture), 0);
+  abcg::glUseProgram(0);
+  abcg::glBindFramebuffer(GL_FRAMEBUFFER, gsl::narrow<GLuint>(framebuffer));
+  abcg::glViewport(0, 0, m_frameState.viewportSize.x,
+                   m_frameState.viewportSize.y);
+}
+
+bool Raycast::isFieldTextureReady(RenderState const &renderState) const {
+  if (!renderState.useFieldTexture || m_fieldTexture.getSize() == 0 ||
+      m_fieldTextureLayers < m_fieldTexture.getSize()) {
+    return false;
+  }
+  auto const key{util::hashFNV1a(
+      std::format("{} {}", renderState.fieldTextureSize,
+                  getFieldTextureFormat(renderState).internalFormat),
+      getFunctionValuesKey(renderState))};
+  return m_fieldTextureKey == key;
+}
+
+VolumeTarget::Format Raycast::getFieldTextureFormat(
+    RenderState const &renderState) const noexcept {
+  // Single-precision textures are only used if they can be filtered
+  return renderState.fieldTexturePrecision ==
+                     RenderState::FieldTexturePrecision::Single &&
+                 m_floatLinearSupported
+             ? VolumeTarget::kR32F
+             : VolumeTarget::kR16F;
+}
+
+std::uint64_t
+Raycast::getFunctionValuesKey(RenderState const &renderState) {
+  // The brick map and the scalar field texture hold values of the function
+  // regardless of the isovalue, so they only depend on the function, the
+  // values of its parameters and the bounds
+  auto const &data{renderState.function.getData()};
+  auto key{util::hashFNV1a(renderState.function.getGLSLExpression())};
+  key = util::hashFNV1a(data.codeLocal, key);
+  key = util::hashFNV1a(data.codeGlobal, key);
+  key = util::hashFNV1a(util::formatFloat(renderState.boundsRadius), key);
+  for (auto const &parameter : renderState.function.getParameters()) {
+    key = util::hashFNV1a(util::formatFloat(parameter.value), key);
+  }
+  return key;
+}
+
+glm::ivec2 Raycast::getPrepassGridSize(glm::ivec2 renderSize) {
+  // One ray per tile corner, including the corners past the last tiles
+  return (renderSize + kPrepassTileSize - 1) / kPrepassTileSize + 1;
+}
+
+void Raycast::setGenericVariantUniforms(
+    RenderState const &renderState) const {
+  auto const setInt{[this](Uniform uniform, int value) {
+    abcg::glUniform1i(getUniformLocation(uniform), value);
+  }};
+
+  setInt(Uniform::UseBoundingBox,
+         renderState.boundsShape == RenderState::BoundsShape::Box ? 1 : 0);
+  setInt(Uniform::RaymarchMethod,
+         static_cast<int>(renderState.raymarchMethod));
+  setInt(Uniform::RootTest, static_cast<int>(renderState.raymarchRootTest));
+  setInt(Uniform::GradientMode,
+         static_cast<int>(renderState.raymarchGradientEvaluation));
+  setInt(Uniform::RenderingMode, static_cast<int>(renderState.renderingMode));
+  setInt(Uniform::SurfaceColorMode,
+         static_cast<int>(renderState.surfaceColorMode));
+  setInt(Uniform::UseShadows, renderState.useShadows ? 1 : 0);
+  setInt(Uniform::UseFog, renderState.useFog ? 1 : 0);
+  setInt(Uniform::InwardNormals, renderState.inwardNormals ? 1 : 0);
+  setInt(Uniform::ShowAxes, renderState.showAxes ? 1 : 0);
+  setInt(Uniform::IsosurfaceRaymarchSteps,
+         renderState.isosurfaceRaymarchSteps);
+  setInt(Uniform::DVRRaymarchSteps, renderState.dvrRaymarchSteps);
 }
 
 void Raycast::onFrameCompleted() {
   auto const fps{gsl::narrow<double>(ImGui::GetIO().Framerate)};
-  auto const deltaFPSNormalized{(kMinimumUIFPS - fps) / kMinimumUIFPS};
-  auto const newNumChunksEstimate{m_frameState.numChunksEstimate +
-                                  deltaFPSNormalized};
 
-  m_frameState.numChunksEstimate = std::clamp(
-      newNumChunksEstimate, 1.0, gsl::narrow<double>(kMaxTotalChunks));
+  // One chunk is rendered per frame of the UI, so the frame time of the UI is
+  // about the time of a chunk. A frame rendered in a single chunk above
+  // kMinimumUIFPS may be limited by vertical sync, so it only gives an upper
+  // bound of the time per unit of cost.
+  auto const levelPixels{gsl::narrow<double>(m_frameState.renderSize.x) *
+                         gsl::narrow<double>(m_frameState.renderSize.y)};
+  auto const chunkCost{m_frameState.capturedState.estimatePixelCost() *
+                       std::min(m_frameState.chunkPixels, levelPixels)};
+  // When the GPU time of chunks is measured, chunk sizes follow it instead
+  // (see updateChunkPixels)
+  if (m_frameState.gpuSecondsPerPixel <= 0.0) {
+    if (fps > 0.0 && chunkCost > 0.0) {
+      auto const secondsPerCost{1.0 / (fps * chunkCost)};
+      if (fps < kMinimumUIFPS || m_frameState.numChunksEstimate > 1.0) {
+        m_secondsPerCost =
+            m_isCostCalibrated ? std::lerp(m_secondsPerCost, secondsPerCost,
+                                           kCostCalibrationWeight)
+                               : secondsPerCost;
+        m_isCostCalibrated = true;
+      } else if (secondsPerCost < m_secondsPerCost) {
+        // An upper bound can lower the estimate, but not raise it
+        m_secondsPerCost = secondsPerCost;
+      }
+    }
+
+    auto const deltaFPSNormalized{(kMinimumUIFPS - fps) / kMinimumUIFPS};
+    auto const newNumChunksEstimate{m_frameState.numChunksEstimate +
+                                    deltaFPSNormalized};
+
+    m_frameState.numChunksEstimate = std::clamp(
+        newNumChunksEstimate, 1.0, gsl::narrow<double>(kMaxTotalChunks));
+  }
+
+  // Coarser levels are previews of the frame
+  if (chunkCost > 0.0 && m_frameState.levelScale >= 1.0) {
+    m_frameState.lastFrameTime = m_frameState.frameTimer.elapsed();
 
-  m_frameState.lastFrameTime = m_frameState.frameTimer.elapsed();
+    auto const &captured{m_frameState.capturedState};
+    m_profileStore.update(
+        getProfileKey(captured),
+        {.numChunksEstimate = m_frameState.numChunksEstimate,
+         .frameTime = m_frameState.lastFrameTime,
+         .frameCost = captured.estimatePixelCost() * levelPixels});
+  }
 
   ++m_frameState.frameCount;
 }
 
-void Raycast::onResize(glm::ivec2 size) { m_frameState.viewportSize = size; }
+void Raycast::onChunkTimed(GPUTimer::Sample const &sample) {
+  auto const secondsPerPixel{sample.seconds / sample.workload};
+  auto &gpuSecondsPerPixel{m_frameState.gpuSecondsPerPixel};
+  gpuSecondsPerPixel =
+      gpuSecondsPerPixel > 0.0
+          ? std::lerp(gpuSecondsPerPixel, secondsPerPixel, kGPUTimeWeight)
+          : secondsPerPixel;
+
+  // Unlike the frame rate of the UI, GPU times are not limited by vertical
+  // sync, so they also calibrate the cost model
+  if (auto const pixelCost{m_frameState.capturedState.estimatePixelCost()};
+      pixelCost > 0.0) {
+    auto const secondsPerCost{secondsPerPixel / pixelCost};
+    m_secondsPerCost = m_isCostCalibrated
+                           ? std::lerp(m_secondsPerCost, secondsPerCost,
+                                       kCostCalibrationWeight)
+                           : secondsPerCost;
+    m_isCostCalibrated = true;
+  }
+}
+
+void Raycast::updateChunkPixels(RenderState const &renderState) {
+  auto const fullPixels{gsl::narrow<double>(m_frameState.fullRenderSize.x) *
+                        gsl::narrow<double>(m_frameState.fullRenderSize.y)};
+  auto const budget{gsl::narrow_cast<double>(renderState.chunkTimeBudget) *
+                    1e-3};
+  m_frameState.chunkPixels =
+      std::clamp(budget / m_frameState.gpuSecondsPerPixel,
+                 fullPixels / gsl::narrow<double>(kMaxTotalChunks), fullPixels);
+  m_frameState.numChunksEstimate = fullPixels / m_frameState.chunkPixels;
+}
+
+bool Raycast::isGPUBehind() {
+  if (m_chunkFence == nullptr) {
+    return false;
+  }
+  auto const status{
+      abcg::glClientWaitSync(m_chunkFence, GL_SYNC_FLUSH_COMMANDS_BIT, 0)};
+  if (status == GL_TIMEOUT_EXPIRED) {
+    return true;
+  }
+  abcg::glDeleteSync(m_chunkFence);
+  m_chunkFence = nullptr;
+  return false;
+}
+
+std::uint64_t Raycast::getProfileKey(RenderState const &renderState) const {
+  // Profiles are kept per function, rendering mode and viewport size. Other
+  // settings only scale the cost of the frame.
+  auto const &data{renderState.function.getData()};
+  auto key{util::hashFNV1a(data.name)};
+  key = util::hashFNV1a(data.expression, key);
+  key = util::hashFNV1a(data.codeLocal, key);
+  key = util::hashFNV1a(data.codeGlobal, key);
+  key = util::hashFNV1a(
+      std::format("{} {} {}", static_cast<int>(renderState.renderingMode),
+                  m_frameState.viewportSize.x, m_frameState.viewportSize.y),
+      key);
+  return key;
+}
+
+double Raycast::estimateFrameTime(RenderState const &renderState,
+                                  glm::ivec2 renderSize) const {
+  return m_secondsPerCost * renderState.estimatePixelCost() *
+         gsl::narrow<double>(renderSize.x) * gsl::narrow<double>(renderSize.y);
+}
+
+bool Raycast::isSlowToRender(RenderState const &renderState) const {
+  auto const frameTime{
+      estimateFrameTime(renderState, m_frameState.viewportSize)};
+  return frameTime * kMinimumUIFPS > gsl::narrow<double>(kMaxTotalChunks);
+}
+
+void Raycast::onResize(glm::ivec2 size) {
+  m_frameState.viewportSize = size;
+  m_presentedRenderSize = size;
+  // Resizing the targets discards their contents
+  m_presentedStateValid = false;
+  // Sized for the finest level. Coarser levels use the lower-left region.
+  m_prepassTarget.resize(getPrepassGridSize(glm::max(size, glm::ivec2{1})));
+}
 
 bool Raycast::hasStateInvalidatedFrame(
-    RenderState const &renderState) const noexcept {
+    RenderState const &renderState) const {
   auto const &captured{m_frameState.capturedState};
   auto const &current{renderState};
 
-  return captured != current;
+  return captured != current ||
+         m_frameState.useFieldTexture != isFieldTextureReady(renderState) ||
+         m_frameState.useBrickMap != isBrickMapReady(renderState);
 }
\ No newline at end of file
@@ -11,10 +11,22 @@
 #define RAYCAST_HPP_
 
 #include "camera.hpp"
+#include "colormaptexture.hpp"
+#include "gputimer.hpp"
+#include "parameterbuffer.hpp"
+#include "profilestore.hpp"
+#include "programbinarycache.hpp"
+#include "programcache.hpp"
+#include "programscheduler.hpp"
 #include "renderstate.hpp"
+#include "rendertarget.hpp"
+#include "shadertemplate.hpp"
+#include "volumetarget.hpp"
 
 #include <abcgOpenGLShader.hpp>
 
+#include <optional>
+
 class Raycast {
 public:
   void handleEvent(SDL_Event const &event);
@@ -25,32 +37,111 @@ public:
   void onResize(glm::ivec2 size);
   void onDestroy();
 
+  // Speculatively builds the programs of the given render states in the
+  // background, replacing any previous prewarm request that has not started.
+  // Does nothing if programs cannot be built in parallel.
+  void prewarm(std::vector<RenderState> const &renderStates);
+
   [[nodiscard]] bool isProgramValid() const noexcept {
     return !m_programBuildFailed;
   }
 
+  // True while frames are rendered at a reduced resolution with the generic
+  // variant, waiting for the specialized variant to be built.
+  [[nodiscard]] bool isFallbackActive() const noexcept {
+    return m_usingFallback;
+  }
+
+  // True when a frame has been rendered at the finest refinement level
   [[nodiscard]] bool isFrameComplete() const noexcept {
-    return !m_frameState.isRendering && m_frameState.frameCount > 0;
+    return !m_frameState.isRendering && m_frameState.frameCount > 0 &&
+           m_frameState.levelScale >= 1.0;
+  }
+
+  // True if the presented frame is not a coarse level of progressive
+  // refinement
+  [[nodiscard]] bool isPresentedFrameRefined() const noexcept {
+    return m_presentedLevelScale >= 1.0;
+  }
+
+  // Resolution scale of the presented frame, relative to the viewport or to
+  // the fallback resolution
+  [[nodiscard]] double getPresentedLevelScale() const noexcept {
+    return m_presentedLevelScale;
   }
 
   [[nodiscard]] std::size_t getFrameCount() const noexcept {
     return m_frameState.frameCount;
   }
 
+  // Largest RenderState::fieldTextureSize that can be used. It is limited by
+  // GL_MAX_3D_TEXTURE_SIZE, and lowered below any size whose texture failed
+  // to be allocated.
+  [[nodiscard]] int getMaxFieldTextureSize() const noexcept {
+    return m_maxFieldTextureSize;
+  }
+
+  // Fraction of the pixels of all refinement levels rendered so far
   [[nodiscard]] float getRenderProgress() const noexcept {
-    return std::clamp(gsl::narrow<float>(m_frameState.nextChunkY) /
-                          gsl::narrow<float>(m_frameState.viewportSize.y),
+    if (m_frameState.refinementPixels <= 0.0) {
+      return 0.0f;
+    }
+    return std::clamp(gsl::narrow_cast<float>(m_frameState.renderedPixels /
+                                              m_frameState.refinementPixels),
                       0.0f, 1.0f);
   }
 
+  // Position, normalized to [0, 1] with the origin at the lower-left corner,
+  // whose tile is rendered first at each refinement level.
+  void setFocusPosition(std::optional<glm::vec2> position) noexcept {
+    m_focusPosition = position;
+  }
+
+  // Size of the lower-left region of the viewport covered by the frame being
+  // rendered.
+  [[nodiscard]] glm::ivec2 getFrameRenderSize() const noexcept {
+    return m_frameState.renderSize;
+  }
+
+  // Index of the sample of each pixel rendered in the current frame when
+  // samples are accumulated over frames (RenderState::temporalSupersampling).
+  // Frames with index 0 are not jittered and restart the accumulation.
+  [[nodiscard]] std::size_t getFrameSampleIndex() const noexcept {
+    return m_frameState.sampleIndex;
+  }
+
+  // Same as getFrameRenderSize, but for the last completed frame.
+  [[nodiscard]] glm::ivec2 getPresentedRenderSize() const noexcept {
+    return m_presentedRenderSize;
+  }
+
   [[nodiscard]] double getLastFrameTime() const noexcept {
     return m_frameState.lastFrameTime;
   }
 
+  // True if, according to the cost model of RenderState::estimatePixelCost,
+  // frames of the given render state take so long to render that the UI falls
+  // below kMinimumUIFPS even when frames are split into kMaxTotalChunks.
+  [[nodiscard]] bool isSlowToRender(RenderState const &renderState) const;
+
+  // Whether chunk heights are sized to RenderState::chunkTimeBudget from
+  // measured GPU times, instead of adapted to the frame rate of the UI
+  [[nodiscard]] bool isGPUTimingSupported() const noexcept {
+    return m_gpuTimer.isSupported();
+  }
+
   [[nodiscard]] int getNumRenderChunks() const noexcept {
     return gsl::narrow_cast<int>(m_frameState.numChunksEstimate);
   }
 
+  [[nodiscard]] ProgramCache::Stats getProgramCacheStats() const noexcept {
+    return m_programCache.getStats();
+  }
+
+  [[nodiscard]] ProgramScheduler const &getProgramScheduler() const noexcept {
+    return m_programScheduler;
+  }
+
   [[nodiscard]] glm::vec3 getLightDirection() const noexcept {
     return m_shadingUBOData.lightDirWorld;
   }
@@ -65,6 +156,13 @@ public:
     m_depthTextureGetter.swap(depthTextureGetter);
   }
 
+  // Source of the surface positions of the previous frame, used to predict
+  // where rays hit the surface while the view changes
+  void setReprojectionSrcPositionGetter(
+      std::function<GLuint()> positionTextureGetter) noexcept {
+    m_positionTextureGetter.swap(positionTextureGetter);
+  }
+
   void setFrameStartCallback(std::function<void()> onFrameStart) noexcept {
     m_onFrameStart.swap(onFrameStart);
   }
@@ -116,13 +214,43 @@ private:
   };
   static_assert(sizeof(ShadingUBOData) == 48);
 
-  struct ParamsUBOData {
-    std::array<glm::vec4, 4> data;
-  };
+  // Variants of the raycast program of a render state. In the generic variant,
+  // all rendering options except MSAA are uniforms, so it only depends on the
+  // expression.
+  enum class ProgramVariant : std::uint8_t { Specialized, Generic };
 
-  // Maximum number of vertical slices a frame can be divided into.
+  // Resolution divisor of frames rendered with the generic variant.
+  static constexpr auto kFallbackResolutionDivisor{2};
+
+  // Maximum number of chunks a frame can be divided into.
   static constexpr auto kMaxTotalChunks{32};
 
+  // Resolution scale of the coarsest level of progressive refinement. Each
+  // following level doubles the scale, up to the full resolution.
+  static constexpr auto kMinLevelScale{0.125};
+
+  // Frames restarted within this time, in seconds, of the previous change of
+  // the view are considered part of an interaction, and are rendered at the
+  // scale that meets RenderState::interactiveTargetFPS
+  static constexpr auto kInteractionTime{0.25};
+
+  // Width and height of the tiles of a frame, in pixels of its level
+  static constexpr auto kTileSize{64};
+
+  // Width and height, in pixels, of the tiles of the depth prepass. The
+  // prepass marches one ray through each tile corner.
+  static constexpr auto kPrepassTileSize{8};
+
+  // Cost, in arithmetic operations (see Function::getEvaluationCost), of the
+  // layers of the scalar field texture rendered in each UI frame
+  static constexpr auto kFieldTextureCostPerFrame{2e8};
+  // Same as kFieldTextureCostPerFrame, but for the layers of the brick map,
+  // whose bricks take kBrickSamples^3 evaluations of the function (see
+  // raycast.frag), or about four if bounded by the interval extension
+  static constexpr auto kBrickMapCostPerFrame{2e8};
+  static constexpr auto kBrickSampleEvaluations{125.0};
+  static constexpr auto kBrickIntervalEvaluations{4.0};
+
   // Minimum FPS allowed for the UI.
   // If the actual FPS is lower than this, rendering of the next frame is
   // split into smaller chunks, up to kMaxTotalChunks.
@@ -130,54 +258,268 @@ private:
 
   abcg::Timer timer;
 
+  // Weight of a new measurement of the time per unit of pixel cost
+  static constexpr auto kCostCalibrationWeight{0.25};
+  // Seconds per unit of pixel cost assumed until it is measured, as for a GPU
+  // of about 10 billion operations per second. Slower than most GPUs, so that
+  // the first frames of a session are split into enough chunks, and slow
+  // functions are reported, before any frame has been timed.
+  static constexpr auto kDefaultSecondsPerCost{1e-10};
+  // Weight of a new measurement of the GPU time per pixel
+  static constexpr auto kGPUTimeWeight{0.5};
+
   struct FrameState {
     bool isRendering{};
 
     double numChunksEstimate{1.0};
-    int chunkHeight{};
-    int nextChunkY{};
-
+    // Whether numChunksEstimate must be estimated from the cost model when
+    // the next frame starts
+    bool seedNumChunksEstimate{true};
+    // GPU time per pixel measured for the current state, or 0 if not measured
+    // yet
+    double gpuSecondsPerPixel{};
+    // Number of pixels rendered per chunk. numChunksEstimate is relative to
+    // the pixels of the finest level.
+    double chunkPixels{};
+
+    // Whether rays start marching near the surface positions of the presented
+    // frame instead of at the bounds. Only frames restarted by a change of
+    // the view and coarse levels are reprojected, so that the finest level is
+    // always marched in full once the view settles.
+    bool reprojectHits{};
+    std::size_t sampleIndex{};
+    // Whether the depth prepass of the level being rendered is done
+    bool isPrepassRendered{};
+    // Whether the frame samples the scalar field texture, and whether its
+    // rays skip the empty bricks of the brick map
+    bool useFieldTexture{};
+    bool useBrickMap{};
+    // Resolution scale of the refinement level being rendered
+    double levelScale{1.0};
+    // Whether the next frame must start again from the coarsest level
+    bool restartRefinement{true};
+    // Tiles of the level being rendered (x, y, width, height), in the order
+    // they are rendered
+    std::vector<glm::ivec4> tiles;
+    std::size_t nextTile{};
+    // Pixels of all levels since the coarsest one, and how many of them were
+    // rendered
+    double refinementPixels{};
+    double renderedPixels{};
+
+    // Measures the time of all levels since the coarsest one
     abcg::Timer frameTimer;
 
     RenderState capturedState;
     glm::ivec2 viewportSize{};
+    // Size of the finest level
+    glm::ivec2 fullRenderSize{};
+    // Size of the level being rendered
+    glm::ivec2 renderSize{};
 
     std::size_t frameCount{};
     double lastFrameTime{};
   };
   FrameState m_frameState;
+  // Seconds to render one unit of the pixel cost estimated by
+  // RenderState::estimatePixelCost, and whether it was measured
+  double m_secondsPerCost{kDefaultSecondsPerCost};
+  bool m_isCostCalibrated{};
 
   CameraUBOData m_cameraUBOData;
   ShadingUBOData m_shadingUBOData;
-  ParamsUBOData m_paramsUBOData;
+
+  static constexpr std::array kUniformBlockBindings{
+      ProgramCache::UniformBlockBinding{.name = "CameraBlock",
+                                        .bindingPoint = 0},
+      ProgramCache::UniformBlockBinding{.name = "ShadingBlock",
+                                        .bindingPoint = 1},
+      ProgramCache::UniformBlockBinding{.name = "ParamsBlock",
+                                        .bindingPoint = 2}};
+
+  // Uniform variables whose locations are cached with each program.
+  // The order must match kUniformNames.
+  enum class Uniform : std::uint8_t {
+    IsoValue,
+    BoundRadius,
+    DVRDensity,
+    DVRFalloff,
+    DVROpacityThreshold,
+    DVRAdaptiveStep,
+    GaussianCurvatureFalloff,
+    MeanCurvatureFalloff,
+    MaxAbsCurvatureFalloff,
+    NormalLengthFalloff,
+    ColorTexture,
+    DepthTexture,
+    SequentialColormap,
+    DivergingColormap,
+    ReprojectHits,
+    PositionTexture,
+    ReprojectionSize,
+    SampleOffset,
+    RenderPrepass,
+    UsePrepass,
+    PrepassTexture,
+    PrepassTileSize,
+    RenderSize,
+    RenderLayer,
+    RenderBrickMap,
+    UseBrickMap,
+    BrickMap,
+    BrickMapSize,
+    ShowSkippedBricks,
+    RenderFieldTexture,
+    UseFieldTexture,
+    FieldTexture,
+    FieldTextureSize,
+    // Generic variant only
+    UseBoundingBox,
+    RaymarchMethod,
+    RootTest,
+    GradientMode,
+    RenderingMode,
+    SurfaceColorMode,
+    UseShadows,
+    UseFog,
+    InwardNormals,
+    ShowAxes,
+    IsosurfaceRaymarchSteps,
+    DVRRaymarchSteps
+  };
+  static constexpr std::array<char const *, 45> kUniformNames{
+      "uIsoValue",
+      "uBoundRadius",
+      "uDVRDensity",
+      "uDVRFalloff",
+      "uDVROpacityThreshold",
+      "uDVRAdaptiveStep",
+      "uGaussianCurvatureFalloff",
+      "uMeanCurvatureFalloff",
+      "uMaxAbsCurvatureFalloff",
+      "uNormalLengthFalloff",
+      "uColorTexture",
+      "uDepthTexture",
+      "uSequentialColormap",
+      "uDivergingColormap",
+      "uReprojectHits",
+      "uPositionTexture",
+      "uReprojectionSize",
+      "uSampleOffset",
+      "uRenderPrepass",
+      "uUsePrepass",
+      "uPrepassTexture",
+      "uPrepassTileSize",
+      "uRenderSize",
+      "uRenderLayer",
+      "uRenderBrickMap",
+      "uUseBrickMap",
+      "uBrickMap",
+      "uBrickMapSize",
+      "uShowSkippedBricks",
+      "uRenderFieldTexture",
+      "uUseFieldTexture",
+      "uFieldTexture",
+      "uFieldTextureSize",
+      "uUseBoundingBox",
+      "uRaymarchMethod",
+      "uRootTest",
+      "uGradientMode",
+      "uRenderingMode",
+      "uSurfaceColorMode",
+      "uUseShadows",
+      "uUseFog",
+      "uInwardNormals",
+      "uShowAxes",
+      "uIsosurfaceRaymarchSteps",
+      "uDVRRaymarchSteps"};
+
+  // Placeholders of the fragment shader template.
+  // The order must match kPlaceholderNames.
+  enum class Placeholder : std::uint8_t {
+    Definitions,
+    CodeGlobal,
+    CodeLocal,
+    ExpressionLHS,
+    CodeGradient,
+    CodeHessian,
+    CodePolynomial,
+    CodeInterval
+  };
+  static constexpr std::array<std::string_view, 8> kPlaceholderNames{
+      "DEFINITIONS",     "CODE_GLOBAL",   "CODE_LOCAL",
+      "EXPRESSION_LHS",  "CODE_GRADIENT", "CODE_HESSIAN",
+      "CODE_POLYNOMIAL", "CODE_INTERVAL"};
+
+  ShaderTemplate m_vertexShaderTemplate;
+  ShaderTemplate m_fragmentShaderTemplate;
 
   GLuint m_VAO{};
   GLuint m_VBO{};
-  GLuint m_program{};
   GLuint m_UBOCamera{};
   GLuint m_UBOShading{};
-  GLuint m_UBOParams{};
-  GLint m_isoValueLocation{};
-  GLint m_dvrDensityLocation{};
-  GLint m_dvrFalloffLocation{};
-  GLint m_gaussianCurvatureFalloffLocation{};
-  GLint m_meanCurvatureFalloffLocation{};
-  GLint m_maxAbsCurvatureFalloffLocation{};
-  GLint m_normalLengthFalloffLocation{};
-  GLint m_colorTextureLocation{};
-  GLint m_depthTextureLocation{};
+  // Surface hit parameters (x) and hit flags (w) of the rays through the
+  // corners of the tiles of the depth prepass
+  RenderTarget m_prepassTarget{{RenderTarget::kRGBA32F}};
+  // Range of the function in each brick of a grid over the bounds, used to
+  // skip the empty bricks when RenderState::useBrickMap is set. It is
+  // rendered over several UI frames, a few layers at a time, and rays only
+  // skip bricks once it is complete.
+  VolumeTarget m_brickMap;
+  // Hash of what the brick map was rendered from, or std::nullopt if it must
+  // be rendered again
+  std::optional<std::uint64_t> m_brickMapKey;
+  int m_brickMapLayers{};
+  // Function sampled at a grid of points over the bounds, used instead of
+  // evaluating the function when RenderState::useFieldTexture is set. It is
+  // rendered over several UI frames, a few layers at a time.
+  VolumeTarget m_fieldTexture;
+  std::optional<std::uint64_t> m_fieldTextureKey;
+  int m_fieldTextureLayers{};
+  int m_maxFieldTextureSize{};
+  // Whether R32F textures are filterable (OES_texture_float_linear)
+  bool m_floatLinearSupported{};
+  ParameterBuffer m_parameterBuffer;
+
+  ColormapTexture m_sequentialColormap;
+  ColormapTexture m_divergingColormap;
+
+  ProgramCache m_programCache;
+  ProgramBinaryCache m_programBinaryCache;
+  ProfileStore m_profileStore;
+  GPUTimer m_gpuTimer;
+  // Signaled when the GPU finishes the last chunk
+  GLsync m_chunkFence{};
+  ProgramCache::Program const *m_program{};
 
   std::function<GLuint()> m_colorTextureGetter;
   std::function<GLuint()> m_depthTextureGetter;
+  std::function<GLuint()> m_positionTextureGetter;
 
   std::function<void()> m_onFrameStart;
   std::function<void()> m_onFrameEnd;
 
-  enum class ProgramBuildPhase : std::uint8_t { Compile, Link, Done };
-  ProgramBuildPhase m_programBuildPhase{ProgramBuildPhase::Done};
-  abcg::Timer m_programBuildTime;
-  std::vector<abcg::OpenGLShader> m_shaderIDs;
-  GLuint m_nextProgram{};
+  // Render state the current program was generated from. Only changes that
+  // make RenderState::isProgramEquivalent fail trigger a rebuild.
+  RenderState m_programRenderState;
+
+  ProgramScheduler m_programScheduler;
+  // Key of the program being built for the current render state, if any
+  std::optional<std::uint64_t> m_pendingProgramKey;
+  // Whether m_program is the generic variant of the current render state
+  bool m_usingFallback{};
+  // Whether m_program is the program of a render state whose edited parameter
+  // has been released, waiting for the program with its value folded
+  bool m_respecializing{};
+  glm::ivec2 m_presentedRenderSize{};
+  double m_presentedLevelScale{1.0};
+  // Whether the presented frame was rendered with the current render state
+  // into the current targets, so that its surface positions and colors can
+  // be reused
+  bool m_presentedStateValid{};
+  // Measures the time since the view last changed
+  abcg::Timer m_interactionTimer;
+  std::optional<glm::vec2> m_focusPosition;
   bool m_throwOnProgramBuild{};
   bool m_programBuildFailed{};
 #if defined(__EMSCRIPTEN__)
@@ -185,6 +527,19 @@ private:
 #endif
 
   void createProgram(RenderState const &renderState);
+  void loadShaderTemplates();
+  [[nodiscard]] std::vector<abcg::ShaderSource>
+  createProgramSources(RenderState const &renderState,
+                       ProgramVariant variant) const;
+  [[nodiscard]] static std::uint64_t
+  getProgramKey(std::vector<abcg::ShaderSource> const &sources);
+  [[nodiscard]] ProgramCache::Program const *
+  loadProgramBinary(std::uint64_t key,
+                    std::vector<abcg::ShaderSource> const &sources);
+  void useProgram(ProgramCache::Program const &program);
+  [[nodiscard]] GLint getUniformLocation(Uniform uniform) const {
+    return m_program->uniformLocations.at(static_cast<std::size_t>(uniform));
+  }
   void createUBOs();
   void destroyUBOs();
   void createVBOs();
@@ -192,11 +547,37 @@ private:
 
   // Adaptive rendering
   void resetFrameState();
-  void startNewFrame(RenderState const &renderState);
+  void startNewFrame(RenderState const &renderState, bool restartRefinement);
+  [[nodiscard]] double getCoarsestLevelScale() const noexcept;
+  [[nodiscard]] double
+  getInteractiveLevelScale(RenderState const &renderState) const;
   void renderChunk(RenderState const &renderState);
+  void renderDepthPrepass();
+  void renderBrickMap(RenderState const &renderState);
+  [[nodiscard]] bool isBrickMapReady(RenderState const &renderState) const;
+  [[nodiscard]] bool
+  isBrickMapBounded(RenderState const &renderState) const noexcept;
+  [[nodiscard]] std::uint64_t
+  getBrickMapKey(RenderState const &renderState) const;
+  void renderFieldTexture(RenderState const &renderState);
+  [[nodiscard]] bool
+  isFieldTextureReady(RenderState const &renderState) const;
+  [[nodiscard]] VolumeTarget::Format
+  getFieldTextureFormat(RenderState const &renderState) const noexcept;
+  [[nodiscard]] static std::uint64_t
+  getFunctionValuesKey(RenderState const &renderState);
+  [[nodiscard]] static glm::ivec2 getPrepassGridSize(glm::ivec2 renderSize);
+  void setGenericVariantUniforms(RenderState const &renderState) const;
   void onFrameCompleted();
+  void onChunkTimed(GPUTimer::Sample const &sample);
+  void updateChunkPixels(RenderState const &renderState);
+  [[nodiscard]] bool isGPUBehind();
+  [[nodiscard]] std::uint64_t
+  getProfileKey(RenderState const &renderState) const;
+  [[nodiscard]] double estimateFrameTime(RenderState const &renderState,
+                                         glm::ivec2 renderSize) const;
   [[nodiscard]] bool
-  hasStateInvalidatedFrame(RenderState const &renderState) const noexcept;
+  hasStateInvalidatedFrame(RenderState const &renderState) const;
 };
 
 #endif
@@ -16,6 +16,8 @@ RenderPipeline::RenderPipeline()
 void RenderPipeline::onCreate(RenderState const &renderState) {
   m_background.onCreate();
   m_raycast.onCreate(renderState);
+  m_raycast.setReprojectionSrcPositionGetter(
+      [this] { return m_raycastSwapChain.front().getColorTexture(1); });
   m_axes.onCreate();
   m_arrow.onCreate();
 }
@@ -59,6 +61,10 @@ void RenderPipeline::onPaint(RenderState &renderState, AppState const &appState,
     GLenum const drawBuffer{GL_COLOR_ATTACHMENT0};
     abcg::glDrawBuffers(1, &drawBuffer);
 
+    // Overlays must cover the same region as the raycast frame
+    auto const renderSize{m_raycast.getFrameRenderSize()};
+    abcg::glViewport(0, 0, renderSize.x, renderSize.y);
+
     if (renderState.surfaceColorMode ==
             RenderState::SurfaceColorMode::UnitNormal ||
         renderState.surfaceColorMode ==
@@ -76,6 +82,26 @@ void RenderPipeline::onPaint(RenderState &renderState, AppState const &appState,
       RenderTarget::unbind();
     }
 
+    auto const viewportSize{m_raycastSwapChain.back().getSize()};
+    abcg::glViewport(0, 0, viewportSize.x, viewportSize.y);
+
+    // Frames rendered at a reduced resolution are not accumulated, and the
+    // first sample replaces the average
+    m_presentAccumulation =
+        renderState.temporalSupersampling && renderSize == viewportSize;
+    if (m_presentAccumulation) {
+      auto const sampleIndex{std::min(m_raycast.getFrameSampleIndex(),
+                                      kMaxAccumulatedSamples - 1)};
+      auto const sampleWeight{1.0f /
+                              gsl::narrow_cast<float>(sampleIndex + 1)};
+      m_accumulationSwapChain.back().bind();
+      m_textureBlit.accumulate(
+          m_accumulationSwapChain.front().getColorTexture(0),
+          m_raycastSwapChain.back().getColorTexture(0), sampleWeight);
+      RenderTarget::unbind();
+      m_accumulationSwapChain.swap();
+    }
+
     m_raycastSwapChain.swap();
   });
 
@@ -87,8 +113,25 @@ void RenderPipeline::onPaint(RenderState &renderState, AppState const &appState,
   abcg::glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
   auto const t{std::clamp(ImGui::GetTime() / 1.5, 0.0, 1.0)};
   auto const fade{glm::smoothstep(0.0f, 1.0f, gsl::narrow_cast<float>(t))};
-  m_textureBlit.blit(m_raycastSwapChain.front().getColorTexture(0),
-                     glm::vec4{fade});
+  // Frames rendered at a reduced resolution only cover the lower-left region
+  auto const &front{m_raycastSwapChain.front()};
+  auto const presentedSize{m_raycast.getPresentedRenderSize()};
+  auto const texCoordScale{glm::vec2{presentedSize} /
+                           glm::vec2{front.getSize()}};
+  if (m_presentAccumulation) {
+    m_textureBlit.blit(m_accumulationSwapChain.front().getColorTexture(0),
+                       glm::vec4{fade});
+  } else if (presentedSize == front.getSize()) {
+    m_textureBlit.blit(front.getColorTexture(0), glm::vec4{fade});
+  } else {
+    // Tolerate differences of surface positions up to a few texels, assuming
+    // that the bounding geometry fills the view
+    auto const positionTolerance{kUpsampleToleranceTexels * 2.0f *
+                                 renderState.boundsRadius /
+                                 gsl::narrow_cast<float>(presentedSize.y)};
+    m_textureBlit.upsample(front.getColorTexture(0), front.getColorTexture(1),
+                           glm::vec4{fade}, texCoordScale, positionTolerance);
+  }
   abcg::glDisable(GL_BLEND);
 }
 
@@ -97,6 +140,8 @@ void RenderPipeline::onResize(glm::ivec2 size) {
   m_background.onResize(size);
   m_backgroundTarget.resize(size);
   m_raycastSwapChain.resize(size);
+  m_accumulationSwapChain.resize(size);
+  m_presentAccumulation = false;
   m_raycast.onResize(size);
 }
 
@@ -120,26 +165,73 @@ RenderPipeline::readPixelData(glm::ivec2 pixelPosition) const {
     return std::nullopt;
   }
 
-  m_raycastSwapChain.front().bind();
+  auto const &target{m_raycastSwapChain.front()};
+  target.bind();
+
+  // Map to the region covered by the last frame
+  auto const position{pixelPosition * m_raycast.getPresentedRenderSize() /
+                      target.getSize()};
 
   abcg::glReadBuffer(GL_COLOR_ATTACHMENT1);
   glm::vec4 data{};
 
-  abcg::glReadPixels(pixelPosition.x, pixelPosition.y, 1, 1, GL_RGBA, GL_FLOAT,
-                     &data[0]);
+  abcg::glReadPixels(position.x, position.y, 1, 1, GL_RGBA, GL_FLOAT, &data[0]);
 
   std::optional<PixelData> result;
   if (data.w > 0.5f) {
     PixelData pixelData{.position = glm::vec3(data)};
 
-    if (m_raycastSwapChain.front().getColorAttachmentCount() > 2) {
+    if (target.getColorAttachmentCount() > 2) {
       abcg::glReadBuffer(GL_COLOR_ATTACHMENT2);
-      abcg::glReadPixels(pixelPosition.x, pixelPosition.y, 1, 1, GL_RGBA,
-                         GL_FLOAT, &pixelData.extraData[0]);
+      abcg::glReadPixels(position.x, position.y, 1, 1, GL_RGBA, GL_FLOAT,
+                         &pixelData.extraData[0]);
     }
     result = pixelData;
   }
 
   RenderTarget::unbind();
   return result;
-}
\ No newline at end of file
+}
+
+std::optional<float> RenderPipeline::readAverageDVRSamples() const {
+  auto const size{m_raycast.getPresentedRenderSize()};
+  if (m_raycast.getFrameCount() == 0 || size.x <= 0 || size.y <= 0) {
+    return std::nullopt;
+  }
+
+  auto const &target{m_raycastSwapChain.front()};
+  if (target.getColorAttachmentCount() <= 2) {
+    return std::nullopt;
+  }
+  target.bind();
+
+  // The number of samples of each ray is in the w component of the data #1
+  // attachment, and rays that entered the bounds have w = 1 in data #0
+  std::vector<glm::vec4> positions(gsl::narrow<std::size_t>(size.x));
+  std::vector<glm::vec4> data(positions.size());
+  auto sum{0.0};
+  std::size_t count{};
+  auto const numRows{std::min(kDVRSampleRows, size.y)};
+  for (auto const row : iter::range(numRows)) {
+    // Center row of each of numRows horizontal bands of the frame
+    auto const y{(2 * row + 1) * size.y / (2 * numRows)};
+    abcg::glReadBuffer(GL_COLOR_ATTACHMENT1);
+    abcg::glReadPixels(0, y, size.x, 1, GL_RGBA, GL_FLOAT, positions.data());
+    abcg::glReadBuffer(GL_COLOR_ATTACHMENT2);
+    abcg::glReadPixels(0, y, size.x, 1, GL_RGBA, GL_FLOAT, data.data());
+
+    for (auto const index : iter::range(positions.size())) {
+      if (positions[index].w > 0.5f) {
+        sum += data[index].w;
+        ++count;
+      }
+    }
+  }
+
+  RenderTarget::unbind();
+
+  if (count == 0) {
+    return std::nullopt;
+  }
+  return gsl::narrow_cast<float>(sum / gsl::narrow_cast<double>(count));
+}
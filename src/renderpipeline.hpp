@@ -31,8 +31,15 @@ public:
   void onResize(glm::ivec2 size);
   void onDestroy();
 
+  void prewarm(std::vector<RenderState> const &renderStates) {
+    m_raycast.prewarm(renderStates);
+  }
+
   void setArrowState(bool visible, glm::vec3 position,
                      glm::vec3 normal) noexcept;
+  void setFocusPosition(std::optional<glm::vec2> position) noexcept {
+    m_raycast.setFocusPosition(position);
+  }
 
   [[nodiscard]] Raycast const &getRaycast() const noexcept { return m_raycast; }
   [[nodiscard]] glm::vec3 getLightDirection() const noexcept {
@@ -45,8 +52,20 @@ public:
   };
   [[nodiscard]] std::optional<PixelData>
   readPixelData(glm::ivec2 pixelPosition) const;
+  // Average number of samples of the rays of direct volume rendering that
+  // entered the bounds in the last frame, estimated from a few rows of pixels
+  [[nodiscard]] std::optional<float> readAverageDVRSamples() const;
 
 private:
+  // Tolerance, in texels, of the surface positions interpolated when a frame
+  // rendered at a reduced resolution is upsampled
+  static constexpr auto kUpsampleToleranceTexels{4.0f};
+  // Number of samples averaged with equal weights when samples are
+  // accumulated over frames. Later samples are blended with this weight.
+  static constexpr std::size_t kMaxAccumulatedSamples{64};
+  // Rows of pixels read by readAverageDVRSamples
+  static constexpr auto kDVRSampleRows{16};
+
   RenderTarget m_axesTarget{{
       RenderTarget::kRGBA8,   // Color
       RenderTarget::kDepth24, // Depth
@@ -60,6 +79,12 @@ private:
       RenderTarget::kRGBA32F, // Data #0
       RenderTarget::kRGBA32F, // Data #1
   }};
+  // Average of the samples of the frames rendered since the view last changed
+  SwapChain m_accumulationSwapChain{{
+      RenderTarget::kRGBA32F, // Color
+  }};
+  // Whether the front accumulation target holds the presented frame
+  bool m_presentAccumulation{};
 
   Arrow m_arrow;
   Axes m_axes;
@@ -14,6 +14,10 @@
 
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <array>
+#include <optional>
+
 struct RenderState {
   static constexpr auto kMinDvrDensity{0.5f};
   static constexpr auto kMaxDvrDensity{50.0f};
@@ -23,6 +27,11 @@ struct RenderState {
   static_assert(kMinDvrDensity <= kInitialDvrDensity &&
                 kInitialDvrDensity < kMaxDvrDensity);
 
+  static constexpr auto kMinBrickMapSize{8};
+  static constexpr auto kMaxBrickMapSize{64};
+
+  static constexpr std::array kFieldTextureSizes{128, 256, 512};
+
   enum class BoundsShape : std::uint8_t { Sphere, Box };
   enum class RenderingMode : std::uint8_t {
     LitSurface,
@@ -37,6 +46,12 @@ struct RenderState {
     MeanCurvature,
     MaxAbsCurvature,
   };
+  enum class RaymarchMethod : std::uint8_t {
+    Adaptive,
+    FixedStep,
+    Polynomial,
+    Interval
+  };
   enum class RootTestMode : std::uint8_t {
     SignChange,
     Taylor1stOrder,
@@ -45,8 +60,12 @@ struct RenderState {
   enum class GradientMode : std::uint8_t {
     ForwardDifference,
     CentralDifference,
-    FivePointStencil
+    FivePointStencil,
+    Analytic
   };
+  enum class FieldTexturePrecision : std::uint8_t { Half, Single };
+  // Visualization modes of the top button bar
+  enum class Preset : std::uint8_t { Shaded, Volume, Normals, Curvature };
 
   Function function;
 
@@ -64,9 +83,14 @@ struct RenderState {
   BoundsShape boundsShape{BoundsShape::Sphere};
   float boundsRadius{2.5f};
 
-  bool raymarchAdaptive{true};
+  RaymarchMethod raymarchMethod{RaymarchMethod::Adaptive};
   int isosurfaceRaymarchSteps{150};
   int dvrRaymarchSteps{450};
+  // Accumulated opacity at which rays of direct volume rendering stop
+  float dvrOpacityThreshold{0.99f};
+  // Whether the steps of direct volume rendering are lengthened, up to four
+  // times, where the transfer function is transparent and varies slowly
+  bool dvrAdaptiveStep{true};
   RootTestMode raymarchRootTest{RootTestMode::SignChange};
   GradientMode raymarchGradientEvaluation{GradientMode::ForwardDifference};
   RenderingMode renderingMode{RenderingMode::LitSurface};
@@ -76,7 +100,47 @@ struct RenderState {
   bool showAxes{true};
   bool inwardNormals{true};
 
+  // Whether rays skip the bricks of a grid over the bounds that cannot contain
+  // the isosurface, or where the volume is transparent, according to the
+  // range of the function in each brick
+  bool useBrickMap{};
+  // Number of bricks along each axis of the grid
+  int brickMapSize{32};
+  // Whether pixels are tinted by the fraction of bricks skipped by their rays
+  bool showSkippedBricks{};
+
+  // Whether the function is evaluated once at a grid of points over the bounds
+  // into a 3D texture, which direct volume rendering and the isosurface ray
+  // marching sample instead of evaluating the function. Isosurfaces are then
+  // a preview, found with the adaptive or fixed-step method regardless of
+  // raymarchMethod.
+  bool useFieldTexture{};
+  // Number of points along each axis of the grid (see kFieldTextureSizes)
+  int fieldTextureSize{kFieldTextureSizes.front()};
+  // Single precision is only used if float textures are filterable
+  FieldTexturePrecision fieldTexturePrecision{FieldTexturePrecision::Half};
+
   int msaaSamples{1};
+  // Whether pixels are antialiased by averaging one jittered sample per frame
+  // while the view does not change, instead of tracing msaaSamples rays per
+  // pixel in every frame
+  bool temporalSupersampling{};
+  // GPU time, in milliseconds, of the chunk of the frame rendered in each frame
+  // of the UI. Only used when GPU timer queries are supported.
+  float chunkTimeBudget{12.0f};
+  // Whether frames are first rendered at reduced resolutions, from 1/8 up to
+  // the full resolution, so that slow functions show a preview sooner
+  bool progressiveRefinement{true};
+  // While the view changes, frames are rendered at the resolution scale that
+  // is expected to keep this frame rate, but not below minRenderScale
+  float interactiveTargetFPS{30.0f};
+  float minRenderScale{0.25f};
+
+  // Index of the parameter being edited in the parameters window, if any.
+  // The values of the parameters are folded into the specialized program as
+  // constants, but they are all read from uniforms while one is edited, so
+  // that editing any of them does not rebuild the program.
+  std::optional<std::size_t> editedParameter;
 
   std::vector<glm::vec4> maxAbsCurvColormap{
       {0.0f, 0.0f, 0.0f, 1.0f}, // #000000
@@ -113,6 +177,188 @@ struct RenderState {
       {0.5f, 0.0f, 0.0f, 1.0f}    // #7f0000
   };
 
+  void applyPreset(Preset preset) noexcept {
+    switch (preset) {
+    case Preset::Shaded:
+      renderingMode = RenderingMode::LitSurface;
+      surfaceColorMode = SurfaceColorMode::SideSign;
+      useFog = true;
+      useShadows = true;
+      break;
+    case Preset::Volume:
+      renderingMode = RenderingMode::DirectVolume;
+      surfaceColorMode = SurfaceColorMode::SideSign;
+      useFog = false;
+      useShadows = false;
+      break;
+    case Preset::Normals:
+      renderingMode = RenderingMode::UnlitSurface;
+      surfaceColorMode = SurfaceColorMode::UnitNormal;
+      useFog = false;
+      useShadows = false;
+      break;
+    case Preset::Curvature:
+      renderingMode = RenderingMode::UnlitSurface;
+      surfaceColorMode = SurfaceColorMode::GaussianCurvature;
+      useFog = false;
+      useShadows = false;
+      break;
+    }
+  }
+
+  [[nodiscard]] std::vector<glm::vec4> const &
+  getSequentialColormap() const noexcept {
+    return surfaceColorMode == SurfaceColorMode::NormalMagnitude
+               ? normalLengthColormap
+               : maxAbsCurvColormap;
+  }
+
+  [[nodiscard]] std::vector<glm::vec4> const &
+  getDivergingColormap() const noexcept {
+    return renderingMode == RenderingMode::DirectVolume ? dvrColormap
+                                                        : curvatureColormap;
+  }
+
+  // Whether the specialized program evaluates the interval extension of the
+  // function, to march rays with the interval method or to bound the function
+  // in the bricks of the brick map
+  [[nodiscard]] bool usesIntervalExtension() const noexcept {
+    return function.hasIntervalExtension() &&
+           (raymarchMethod == RaymarchMethod::Interval || useBrickMap);
+  }
+
+  [[nodiscard]] int getEffectiveMSAASamples() const noexcept {
+    return renderingMode == RenderingMode::DirectVolume || temporalSupersampling
+               ? 1
+               : msaaSamples;
+  }
+
+  // Returns an estimate of the cost of rendering one pixel, in arithmetic
+  // operations (see Function::getEvaluationCost). Rays are assumed to take all
+  // their steps, so it is an upper bound rather than an average.
+  [[nodiscard]] double estimatePixelCost() const noexcept {
+    // Evaluations of the function of each gradient mode, as in raycast.frag.
+    // The analytic gradient is assumed to cost about three evaluations, and
+    // the analytic Hessian, with six distinct entries, about six.
+    static constexpr std::array kGradientEvaluations{4.0, 6.0, 12.0, 3.0};
+    static constexpr auto kHessianEvaluations{19.0};
+    static constexpr auto kAnalyticHessianEvaluations{6.0};
+    // Evaluations and subdivisions of the polynomial method. A subdivision
+    // costs about the square of the degree.
+    static constexpr auto kPolynomialEvaluations{16.0};
+    static constexpr auto kPolynomialSubdivisions{32.0};
+    // Subdivisions of the interval method. Evaluating the interval extension
+    // costs about four evaluations of the function.
+    static constexpr auto kIntervalSubdivisions{64.0};
+    static constexpr auto kIntervalEvaluationCost{4.0};
+    // Trilinear sample of the scalar field texture
+    static constexpr auto kFieldTextureSampleCost{8.0};
+
+    auto const evaluation{function.getEvaluationCost() + 1.0};
+    auto const gradientMode{
+        raymarchGradientEvaluation == GradientMode::Analytic &&
+                !function.hasAnalyticDerivatives()
+            ? GradientMode::FivePointStencil
+            : raymarchGradientEvaluation};
+    auto const gradient{
+        kGradientEvaluations.at(static_cast<std::size_t>(gradientMode))};
+
+    // Function values of the ray marching methods, sampled from the scalar
+    // field texture if it is used
+    auto const sample{useFieldTexture ? kFieldTextureSampleCost : evaluation};
+
+    if (renderingMode == RenderingMode::DirectVolume) {
+      return static_cast<double>(dvrRaymarchSteps) * sample;
+    }
+
+    // Taylor root tests evaluate the gradient at both ends of each step
+    auto const stepEvaluations{
+        raymarchRootTest == RootTestMode::SignChange ? 1.0
+                                                     : 1.0 + 2.0 * gradient};
+    auto const steps{static_cast<double>(isosurfaceRaymarchSteps)};
+    auto march{steps * (sample + (stepEvaluations - 1.0) * evaluation)};
+    if (raymarchMethod == RaymarchMethod::Polynomial &&
+        function.isPolynomial() && !useFieldTexture) {
+      auto const degree{static_cast<double>(function.getPolynomialDegree())};
+      march = kPolynomialEvaluations * evaluation +
+              kPolynomialSubdivisions * degree * degree;
+    }
+    if (raymarchMethod == RaymarchMethod::Interval &&
+        function.hasIntervalExtension() && !useFieldTexture) {
+      march = kIntervalSubdivisions * kIntervalEvaluationCost * evaluation;
+    }
+
+    auto shading{gradient * evaluation};
+    if (surfaceColorMode == SurfaceColorMode::GaussianCurvature ||
+        surfaceColorMode == SurfaceColorMode::MeanCurvature ||
+        surfaceColorMode == SurfaceColorMode::MaxAbsCurvature) {
+      shading += (function.hasAnalyticDerivatives()
+                      ? kAnalyticHessianEvaluations
+                      : kHessianEvaluations) *
+                 evaluation;
+    }
+
+    auto const shadows{
+        renderingMode == RenderingMode::LitSurface && useShadows ? 2.0 : 1.0};
+    return (march * shadows + shading) *
+           static_cast<double>(getEffectiveMSAASamples());
+  }
+
+  // Returns true if both states generate the same raycast shader source.
+  // Fields not compared here (isovalue, bounds radius, falloffs, colors,
+  // colormaps, DVR opacity threshold and adaptive steps, brick map and scalar
+  // field texture settings, parameter values while a parameter is edited)
+  // are uploaded as uniforms or textures and only restart the frame, except
+  // that enabling the brick map adds the interval extension to the program.
+  // Which parameter is edited does not matter.
+  [[nodiscard]] bool
+  isProgramEquivalent(RenderState const &other) const noexcept {
+    auto const &parameters{function.getParameters()};
+    auto const &otherParameters{other.function.getParameters()};
+    auto sameParameters{
+        editedParameter.has_value() == other.editedParameter.has_value() &&
+        parameters.size() == otherParameters.size()};
+    for (std::size_t index{}; sameParameters && index < parameters.size();
+         ++index) {
+      auto const &lhs{parameters[index]};
+      auto const &rhs{otherParameters[index]};
+      sameParameters = lhs.name == rhs.name && (editedParameter.has_value() ||
+                                                lhs.value == rhs.value);
+    }
+
+    return sameParameters &&
+           function.getGLSLExpression() ==
+               other.function.getGLSLExpression() &&
+           function.getData().codeLocal == other.function.getData().codeLocal &&
+           function.getData().codeGlobal ==
+               other.function.getData().codeGlobal &&
+           boundsShape == other.boundsShape &&
+           raymarchMethod == other.raymarchMethod &&
+           isosurfaceRaymarchSteps == other.isosurfaceRaymarchSteps &&
+           dvrRaymarchSteps == other.dvrRaymarchSteps &&
+           raymarchRootTest == other.raymarchRootTest &&
+           raymarchGradientEvaluation == other.raymarchGradientEvaluation &&
+           renderingMode == other.renderingMode &&
+           surfaceColorMode == other.surfaceColorMode &&
+           useShadows == other.useShadows && useFog == other.useFog &&
+           showAxes == other.showAxes && inwardNormals == other.inwardNormals &&
+           usesIntervalExtension() == other.usesIntervalExtension() &&
+           getEffectiveMSAASamples() == other.getEffectiveMSAASamples();
+  }
+
+  // Returns true if the program of this state can also render the other
+  // state, which is the case if a parameter is edited in this state and both
+  // only differ in parameter values, and in whether a parameter is edited.
+  [[nodiscard]] bool
+  canProgramRender(RenderState const &other) const noexcept {
+    if (!editedParameter.has_value()) {
+      return false;
+    }
+    auto edited{other};
+    edited.editedParameter = editedParameter;
+    return isProgramEquivalent(edited);
+  }
+
   friend bool operator==(RenderState const &, RenderState const &) = default;
 };
 
@@ -13,13 +13,13 @@
 
 namespace {
 
-GLuint createAndBindAttachmentTexture() {
+GLuint createAndBindAttachmentTexture(GLint filter = GL_NEAREST) {
   GLuint texture{};
   abcg::glGenTextures(1, &texture);
   abcg::glBindTexture(GL_TEXTURE_2D, texture);
 
-  abcg::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  abcg::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  abcg::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+  abcg::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
   abcg::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
   abcg::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
@@ -113,7 +113,11 @@ void RenderTarget::destroy() {
 }
 
 void RenderTarget::createColorTexture(AttachmentSpec const &spec) {
-  auto const texture{createAndBindAttachmentTexture()};
+  // Normalized color attachments are linearly filtered so that frames rendered
+  // at a reduced resolution are smoothly upscaled when presented. Float
+  // attachments are not filterable in OpenGL ES 3.0.
+  auto const texture{createAndBindAttachmentTexture(
+      spec.type == GL_UNSIGNED_BYTE ? GL_LINEAR : GL_NEAREST)};
 
   // Allocate texture storage
   if (spec.type == GL_FLOAT) {
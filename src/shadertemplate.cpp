@@ -0,0 +1,115 @@
+/**
+ * @file shadertemplate.cpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#include "shadertemplate.hpp"
+
+#include <abcgApplication.hpp>
+#include <abcgException.hpp>
+#include <abcgUtil.hpp>
+
+#include <fstream>
+#include <sstream>
+
+ShaderTemplate::ShaderTemplate(std::string source, abcg::ShaderStage stage,
+                               std::span<std::string_view const> slotNames)
+    : m_source{std::move(source)}, m_stage{stage},
+      m_numSlots{slotNames.size()} {
+  std::string_view const str{m_source};
+  std::size_t literalStart{};
+  std::size_t pos{};
+  while (pos < str.size()) {
+    auto const open{str.find('@', pos)};
+    if (open == std::string_view::npos) {
+      break;
+    }
+    auto const close{str.find('@', open + 1)};
+    if (close == std::string_view::npos) {
+      break;
+    }
+
+    auto const name{str.substr(open + 1, close - open - 1)};
+    auto const itr{std::ranges::find(slotNames, name)};
+    if (itr == slotNames.end()) {
+      // Not a placeholder. The closing '@' may open the next one.
+      pos = close;
+      continue;
+    }
+
+    m_segments.push_back(
+        {.offset = literalStart,
+         .length = open - literalStart,
+         .slot = static_cast<std::size_t>(
+             std::distance(slotNames.begin(), itr))});
+    literalStart = close + 1;
+    pos = literalStart;
+  }
+
+  m_segments.push_back(
+      {.offset = literalStart, .length = str.size() - literalStart});
+}
+
+ShaderTemplate
+ShaderTemplate::load(std::filesystem::path const &path,
+                     abcg::ShaderStage stage,
+                     std::span<std::string_view const> slotNames) {
+  auto const utf8Path{abcg::pathToUtf8(path)};
+  std::ifstream stream(utf8Path, std::ios::binary);
+  if (!stream) {
+    throw abcg::RuntimeError(
+        std::format("Failed to read shader file {}", utf8Path));
+  }
+
+  std::ostringstream ss;
+  ss << stream.rdbuf();
+  return {ss.str(), stage, slotNames};
+}
+
+abcg::ShaderSource
+ShaderTemplate::assemble(std::span<std::string_view const> values) const {
+  if (values.size() != m_numSlots) {
+    throw abcg::RuntimeError(std::format(
+        "Shader template has {} slots but {} values were given", m_numSlots,
+        values.size()));
+  }
+
+  std::size_t size{};
+  for (auto const &segment : m_segments) {
+    size += segment.length;
+    if (segment.slot != kNoSlot) {
+      size += values[segment.slot].size();
+    }
+  }
+
+  std::string source;
+  source.reserve(size);
+  std::string_view const str{m_source};
+  for (auto const &segment : m_segments) {
+    source += str.substr(segment.offset, segment.length);
+    if (segment.slot != kNoSlot) {
+      source += values[segment.slot];
+    }
+  }
+
+  return {.source = std::move(source), .stage = m_stage};
+}
+
+std::vector<abcg::ShaderSource>
+loadProgramSources(std::string_view vertexShaderPath,
+                   std::string_view fragmentShaderPath) {
+  auto const &assetsPath{abcg::Application::getAssetsPath()};
+
+  return {ShaderTemplate::load(
+              assetsPath / std::filesystem::path{vertexShaderPath},
+              abcg::ShaderStage::Vertex)
+              .assemble(),
+          ShaderTemplate::load(
+              assetsPath / std::filesystem::path{fragmentShaderPath},
+              abcg::ShaderStage::Fragment)
+              .assemble()};
+}
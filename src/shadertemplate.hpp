@@ -0,0 +1,74 @@
+/**
+ * @file shadertemplate.hpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#ifndef SHADERTEMPLATE_HPP_
+#define SHADERTEMPLATE_HPP_
+
+#include <abcgOpenGLShader.hpp>
+
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Shader source with placeholders of the form @NAME@ that are filled in when
+// the source is assembled.
+//
+// The source is scanned once, when the template is created, and split into
+// literal segments separated by slots. Assembling a variant computes the final
+// size first, so the result is written into a single allocation without
+// searching the source again.
+class ShaderTemplate {
+public:
+  ShaderTemplate() = default;
+
+  // Creates a template of the given source. Only the placeholders named in
+  // 'slotNames' (without the enclosing '@') are turned into slots. The slot
+  // index of a placeholder is the index of its name in 'slotNames'.
+  ShaderTemplate(std::string source, abcg::ShaderStage stage,
+                 std::span<std::string_view const> slotNames = {});
+
+  // Same as above, but reads the source from a file. Throws
+  // abcg::RuntimeError if the file cannot be read.
+  [[nodiscard]] static ShaderTemplate
+  load(std::filesystem::path const &path, abcg::ShaderStage stage,
+       std::span<std::string_view const> slotNames = {});
+
+  [[nodiscard]] abcg::ShaderStage getStage() const noexcept { return m_stage; }
+  [[nodiscard]] std::size_t getNumSlots() const noexcept { return m_numSlots; }
+
+  // Returns the shader source with each placeholder replaced by the value of
+  // its slot. 'values' must have one element per slot name.
+  [[nodiscard]] abcg::ShaderSource
+  assemble(std::span<std::string_view const> values = {}) const;
+
+private:
+  static constexpr auto kNoSlot{static_cast<std::size_t>(-1)};
+
+  // Literal text of the source followed by an optional slot
+  struct Segment {
+    std::size_t offset{};
+    std::size_t length{};
+    std::size_t slot{kNoSlot};
+  };
+
+  std::string m_source;
+  abcg::ShaderStage m_stage{};
+  std::size_t m_numSlots{};
+  std::vector<Segment> m_segments;
+};
+
+// Reads the vertex and fragment shaders of a program without placeholders.
+// The paths are relative to the assets directory.
+[[nodiscard]] std::vector<abcg::ShaderSource>
+loadProgramSources(std::string_view vertexShaderPath,
+                   std::string_view fragmentShaderPath);
+
+#endif
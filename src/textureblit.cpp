@@ -9,20 +9,15 @@
 
 #include "textureblit.hpp"
 
+#include "shadertemplate.hpp"
+
 #include <abcgOpenGL.hpp>
 
 void TextureBlit::create() {
   destroy();
 
-  auto const &assetsPath{abcg::Application::getAssetsPath()};
-
-  std::vector<abcg::ShaderSource> const sources{
-      {.source = abcg::pathToUtf8(assetsPath /
-                                  std::filesystem::path{kVertexShaderPath}),
-       .stage = abcg::ShaderStage::Vertex},
-      {.source = abcg::pathToUtf8(assetsPath /
-                                  std::filesystem::path{kFragmentShaderPath}),
-       .stage = abcg::ShaderStage::Fragment}};
+  auto const sources{
+      loadProgramSources(kVertexShaderPath, kFragmentShaderPath)};
 
   m_program = abcg::createOpenGLProgram(sources);
 
@@ -62,6 +57,31 @@ void TextureBlit::create() {
   m_colorTextureLocation =
       abcg::glGetUniformLocation(m_program, "uColorTexture");
   m_tintColorLocation = abcg::glGetUniformLocation(m_program, "uTintColor");
+  m_texCoordScaleLocation =
+      abcg::glGetUniformLocation(m_program, "uTexCoordScale");
+
+  // The upsampling program shares the vertex shader and the VAO
+  m_upsampleProgram = abcg::createOpenGLProgram(
+      loadProgramSources(kVertexShaderPath, kUpsampleFragmentShaderPath));
+  m_upsampleColorTextureLocation =
+      abcg::glGetUniformLocation(m_upsampleProgram, "uColorTexture");
+  m_upsamplePositionTextureLocation =
+      abcg::glGetUniformLocation(m_upsampleProgram, "uPositionTexture");
+  m_upsampleTintColorLocation =
+      abcg::glGetUniformLocation(m_upsampleProgram, "uTintColor");
+  m_upsampleTexCoordScaleLocation =
+      abcg::glGetUniformLocation(m_upsampleProgram, "uTexCoordScale");
+  m_upsamplePositionToleranceLocation =
+      abcg::glGetUniformLocation(m_upsampleProgram, "uPositionTolerance");
+
+  m_accumulateProgram = abcg::createOpenGLProgram(
+      loadProgramSources(kVertexShaderPath, kAccumulateFragmentShaderPath));
+  m_accumulateAccumulationTextureLocation =
+      abcg::glGetUniformLocation(m_accumulateProgram, "uAccumulationTexture");
+  m_accumulateSampleTextureLocation =
+      abcg::glGetUniformLocation(m_accumulateProgram, "uSampleTexture");
+  m_accumulateSampleWeightLocation =
+      abcg::glGetUniformLocation(m_accumulateProgram, "uSampleWeight");
 }
 
 void TextureBlit::destroy() {
@@ -77,9 +97,18 @@ void TextureBlit::destroy() {
     abcg::glDeleteProgram(m_program);
     m_program = 0;
   }
+  if (m_upsampleProgram != 0) {
+    abcg::glDeleteProgram(m_upsampleProgram);
+    m_upsampleProgram = 0;
+  }
+  if (m_accumulateProgram != 0) {
+    abcg::glDeleteProgram(m_accumulateProgram);
+    m_accumulateProgram = 0;
+  }
 }
 
-void TextureBlit::blit(GLuint colorTexture, glm::vec4 tintColor) {
+void TextureBlit::blit(GLuint colorTexture, glm::vec4 tintColor,
+                       glm::vec2 texCoordScale) {
   if (m_program == 0) {
     create();
   }
@@ -90,10 +119,62 @@ void TextureBlit::blit(GLuint colorTexture, glm::vec4 tintColor) {
   abcg::glBindTexture(GL_TEXTURE_2D, colorTexture);
   abcg::glUniform1i(m_colorTextureLocation, 0);
   abcg::glUniform4fv(m_tintColorLocation, 1, &tintColor[0]);
+  abcg::glUniform2fv(m_texCoordScaleLocation, 1, &texCoordScale[0]);
 
   abcg::glBindVertexArray(m_VAO);
   abcg::glDrawArrays(GL_TRIANGLES, 0, 3);
   abcg::glBindVertexArray(0);
 
+  abcg::glUseProgram(0);
+}
+
+void TextureBlit::upsample(GLuint colorTexture, GLuint positionTexture,
+                           glm::vec4 tintColor, glm::vec2 texCoordScale,
+                           float positionTolerance) {
+  if (m_program == 0) {
+    create();
+  }
+
+  abcg::glUseProgram(m_upsampleProgram);
+
+  abcg::glActiveTexture(GL_TEXTURE0);
+  abcg::glBindTexture(GL_TEXTURE_2D, colorTexture);
+  abcg::glUniform1i(m_upsampleColorTextureLocation, 0);
+  abcg::glActiveTexture(GL_TEXTURE1);
+  abcg::glBindTexture(GL_TEXTURE_2D, positionTexture);
+  abcg::glUniform1i(m_upsamplePositionTextureLocation, 1);
+  abcg::glUniform4fv(m_upsampleTintColorLocation, 1, &tintColor[0]);
+  abcg::glUniform2fv(m_upsampleTexCoordScaleLocation, 1, &texCoordScale[0]);
+  abcg::glUniform1f(m_upsamplePositionToleranceLocation, positionTolerance);
+
+  abcg::glBindVertexArray(m_VAO);
+  abcg::glDrawArrays(GL_TRIANGLES, 0, 3);
+  abcg::glBindVertexArray(0);
+
+  abcg::glActiveTexture(GL_TEXTURE0);
+  abcg::glUseProgram(0);
+}
+
+void TextureBlit::accumulate(GLuint accumulationTexture, GLuint sampleTexture,
+                             float sampleWeight) {
+  if (m_program == 0) {
+    create();
+  }
+
+  abcg::glUseProgram(m_accumulateProgram);
+
+  abcg::glActiveTexture(GL_TEXTURE0);
+  abcg::glBindTexture(GL_TEXTURE_2D, accumulationTexture);
+  abcg::glUniform1i(m_accumulateAccumulationTextureLocation, 0);
+  abcg::glActiveTexture(GL_TEXTURE1);
+  abcg::glBindTexture(GL_TEXTURE_2D, sampleTexture);
+  abcg::glUniform1i(m_accumulateSampleTextureLocation, 1);
+  abcg::glUniform1f(m_accumulateSampleWeightLocation, sampleWeight);
+
+  abcg::glBindVertexArray(m_VAO);
+  abcg::glDrawArrays(GL_TRIANGLES, 0, 3);
+  abcg::glBindVertexArray(0);
+
+  abcg::glActiveTexture(GL_TEXTURE0);
   abcg::glUseProgram(0);
 }
\ No newline at end of file
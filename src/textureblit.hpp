@@ -25,11 +25,31 @@ public:
   TextureBlit(TextureBlit &&) = delete;
   TextureBlit &operator=(TextureBlit &&) = delete;
 
-  void blit(GLuint colorTexture, glm::vec4 tintColor = glm::vec4{1.0});
+  // texCoordScale selects the lower-left fraction of the texture to be
+  // stretched over the viewport.
+  void blit(GLuint colorTexture, glm::vec4 tintColor = glm::vec4{1.0},
+            glm::vec2 texCoordScale = glm::vec2{1.0});
+
+  // Same as blit, but colors are only interpolated between texels whose
+  // surface positions in positionTexture are within positionTolerance, so
+  // that silhouettes and depth discontinuities stay sharp.
+  void upsample(GLuint colorTexture, GLuint positionTexture,
+                glm::vec4 tintColor, glm::vec2 texCoordScale,
+                float positionTolerance);
+
+  // Renders the running average of the samples accumulated in
+  // accumulationTexture blended with the new sample in sampleTexture, given
+  // its weight. Both textures must have the size of the viewport.
+  void accumulate(GLuint accumulationTexture, GLuint sampleTexture,
+                  float sampleWeight);
 
 private:
   static constexpr std::string_view kVertexShaderPath{"shaders/blit.vert"};
   static constexpr std::string_view kFragmentShaderPath{"shaders/blit.frag"};
+  static constexpr std::string_view kUpsampleFragmentShaderPath{
+      "shaders/upsample.frag"};
+  static constexpr std::string_view kAccumulateFragmentShaderPath{
+      "shaders/accumulate.frag"};
 
   GLuint m_VAO{};
   GLuint m_VBO{};
@@ -37,6 +57,19 @@ private:
 
   GLint m_colorTextureLocation{};
   GLint m_tintColorLocation{};
+  GLint m_texCoordScaleLocation{};
+
+  GLuint m_upsampleProgram{};
+  GLint m_upsampleColorTextureLocation{};
+  GLint m_upsamplePositionTextureLocation{};
+  GLint m_upsampleTintColorLocation{};
+  GLint m_upsampleTexCoordScaleLocation{};
+  GLint m_upsamplePositionToleranceLocation{};
+
+  GLuint m_accumulateProgram{};
+  GLint m_accumulateAccumulationTextureLocation{};
+  GLint m_accumulateSampleTextureLocation{};
+  GLint m_accumulateSampleWeightLocation{};
 
   void create();
   void destroy();
@@ -19,6 +19,7 @@
 #include "ui_widgets.hpp"
 
 #include <abcgUtil.hpp>
+#include <cppitertools/itertools.hpp>
 
 #if defined(__EMSCRIPTEN__)
 #include "ui_emscripten.hpp"
@@ -78,7 +79,8 @@ namespace {
 constexpr std::size_t kMainWindowWidth{251};
 
 #ifndef NDEBUG
-void debugInfo(AppContext &context, Camera &camera) {
+void debugInfo(AppContext &context, Camera &camera, Raycast const &raycast,
+               std::optional<float> dvrSamplesPerPixel) {
   auto &appState{context.appState};
 
   if (appState.updateLogWindowLayout) {
@@ -108,6 +110,30 @@ void debugInfo(AppContext &context, Camera &camera) {
     ImGui::Text("%s", std::format("DVR raymarch steps: {}\n",
                                   renderState.dvrRaymarchSteps)
                           .c_str());
+    if (renderState.renderingMode == RenderState::RenderingMode::DirectVolume) {
+      auto const samples{dvrSamplesPerPixel.has_value()
+                             ? std::format("{:.1f}", *dvrSamplesPerPixel)
+                             : std::string{"-"}};
+      ImGui::Text("%s", std::format("DVR samples per pixel: {}\n", samples)
+                            .c_str());
+    }
+    auto const cacheStats{raycast.getProgramCacheStats()};
+    ImGui::Text(
+        "%s",
+        std::format("Program cache:\n  Size: {}/{}\n  Hits: {}\n  Misses: "
+                    "{}\n  Memory: {:.1f} KiB\n",
+                    cacheStats.size, cacheStats.capacity, cacheStats.hits,
+                    cacheStats.misses,
+                    gsl::narrow_cast<double>(cacheStats.memoryBytes) / 1024.0)
+            .c_str());
+    auto const &scheduler{raycast.getProgramScheduler()};
+    ImGui::Text("%s",
+                std::format("Program builds:\n  In flight: {}\n  Queued: {}\n  "
+                            "Parallel compile: {}\n",
+                            scheduler.getNumInFlight(),
+                            scheduler.getNumQueued(),
+                            scheduler.isParallelCompileSupported())
+                    .c_str());
     ImGui::Spacing();
 
     auto const &data{renderState.function.getData()};
@@ -117,7 +143,17 @@ void debugInfo(AppContext &context, Camera &camera) {
         "MathJax:\n%s",
         renderState.function.getMathJaxEquation(renderState.isoValue).c_str());
     ImGui::Spacing();
-    ImGui::Text("GLSL:\n%s", renderState.function.getGLSLExpression().c_str());
+    ImGui::Text("GLSL:\n%s%s",
+                renderState.function.getGLSLTemporaries().c_str(),
+                renderState.function.getGLSLExpression().c_str());
+    auto const &opCount{renderState.function.getOpCount()};
+    ImGui::Text("%s", std::format("Arithmetic ops: {} ({} before CSE)",
+                                  opCount.optimized, opCount.original)
+                          .c_str());
+    ImGui::Text("%s", std::format("Evaluation cost: {:.0f} ({:.0f} per pixel)",
+                                  renderState.function.getEvaluationCost(),
+                                  renderState.estimatePixelCost())
+                          .c_str());
 
     if (!renderState.function.getParameters().empty()) {
       std::string functionParams;
@@ -207,6 +243,17 @@ void UI::onPaintUI(AppContext &context, RenderPipeline &pipeline,
 
   ImGui::PushFont(m_proportionalFont);
 
+#ifndef NDEBUG
+  if (auto const frameCount{pipeline.getRaycast().getFrameCount()};
+      context.appState.showDebugInfo &&
+      context.renderState.renderingMode ==
+          RenderState::RenderingMode::DirectVolume &&
+      frameCount != m_dvrSamplesFrameCount) {
+    m_dvrSamplesPerPixel = pipeline.readAverageDVRSamples();
+    m_dvrSamplesFrameCount = frameCount;
+  }
+#endif
+
   mainWindow(context, camera, pipeline.getRaycast());
 
   switch (context.renderState.renderingMode) {
@@ -298,7 +345,7 @@ void UI::mainWindow(AppContext &context, Camera &camera,
         ImGui::EndTabItem();
       }
       if (ImGui::BeginTabItem("Settings")) {
-        uiTabs::settingsTab(context, camera);
+        uiTabs::settingsTab(context, camera, raycast);
         ImGui::EndTabItem();
       }
       if (ImGui::BeginTabItem("About")) {
@@ -313,6 +360,7 @@ void UI::mainWindow(AppContext &context, Camera &camera,
 
   // Parameters
   auto const showParameters{!parameters.empty()};
+  std::optional<std::size_t> editedParameter;
   if (showParameters) {
     auto const height{(isMainWindowCollapsed ? 22 : uiWindowSize.y) + 10};
     ImGui::SetNextWindowPos(
@@ -331,8 +379,13 @@ void UI::mainWindow(AppContext &context, Camera &camera,
 
     auto const step{0.01f};
     auto const spacing{6};
-    for (auto const &parameter : parameters) {
+    for (auto &&[index, parameter] : iter::enumerate(parameters)) {
       auto value{parameter.value};
+      auto const trackEdit{[&editedParameter, parameterIndex = index] {
+        if (ImGui::IsItemActive()) {
+          editedParameter = parameterIndex;
+        }
+      }};
 
       // Left arrow button
       ImGui::PushButtonRepeat(true);
@@ -341,6 +394,7 @@ void UI::mainWindow(AppContext &context, Camera &camera,
               ImGuiDir_Left)) {
         value -= step;
       }
+      trackEdit();
       ImGui::PopButtonRepeat();
 
       // Drag slider
@@ -351,6 +405,7 @@ void UI::mainWindow(AppContext &context, Camera &camera,
           std::format("{}: {:.2f}", parameter.name, parameter.value)};
       ImGui::DragFloat(label.c_str(), &value, 0.01f, 0.f, 0.f, format.c_str(),
                        ImGuiSliderFlags_NoRoundToFormat);
+      trackEdit();
       if (ImGui::IsItemHovered() && !ImGui::IsAnyMouseDown()) {
         ImGui::SetTooltip("Drag to change");
       }
@@ -364,6 +419,7 @@ void UI::mainWindow(AppContext &context, Camera &camera,
               ImGuiDir_Right)) {
         value += step;
       }
+      trackEdit();
       ImGui::PopButtonRepeat();
 
       renderState.function.setParameter(parameter.name, value);
@@ -371,6 +427,8 @@ void UI::mainWindow(AppContext &context, Camera &camera,
 
     ImGui::End();
   }
+  // Parameter values are folded into the program once the edit ends
+  renderState.editedParameter = editedParameter;
 
   progressIndicator(
       ImVec2(gsl::narrow<float>(appState.windowSize.x) - uiWindowSize.x - 5,
@@ -382,7 +440,7 @@ void UI::mainWindow(AppContext &context, Camera &camera,
 #ifndef NDEBUG
   if (appState.showDebugInfo) {
     ImGui::PushFont(m_monospacedFont);
-    debugInfo(context, camera);
+    debugInfo(context, camera, raycast, m_dvrSamplesPerPixel);
     ImGui::PopFont();
   }
 #endif
@@ -399,21 +457,26 @@ void UI::topButtonBar(AppContext &context) {
     char const *label;
     char const *tooltip;
     ImGuiKey shortcutKey;
+    RenderState::Preset preset;
   };
 
   static constexpr std::array<ButtonInfo, 4> buttonInfo{
       {{.label = "Shaded",
         .tooltip = "Shaded isosurface",
-        .shortcutKey = ImGuiKey_1},
+        .shortcutKey = ImGuiKey_1,
+        .preset = RenderState::Preset::Shaded},
        {.label = "Volume",
         .tooltip = "Volume rendering\nof the scalar field",
-        .shortcutKey = ImGuiKey_2},
+        .shortcutKey = ImGuiKey_2,
+        .preset = RenderState::Preset::Volume},
        {.label = "Normals",
         .tooltip = "Isosurface colored\nby normals",
-        .shortcutKey = ImGuiKey_3},
+        .shortcutKey = ImGuiKey_3,
+        .preset = RenderState::Preset::Normals},
        {.label = "Curvature",
         .tooltip = "Isosurface colored\nby curvature",
-        .shortcutKey = ImGuiKey_4}}};
+        .shortcutKey = ImGuiKey_4,
+        .preset = RenderState::Preset::Curvature}}};
 
   auto const &io{ImGui::GetIO()};
   auto const buttonSize{ImVec2{47.0f, 47.0f}};
@@ -422,35 +485,7 @@ void UI::topButtonBar(AppContext &context) {
   ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2{5.0f, 4.0f});
 
   auto const activateMode{[&](std::size_t index) {
-    switch (index) {
-    case 0:
-      renderState.renderingMode = RenderState::RenderingMode::LitSurface;
-      renderState.surfaceColorMode = RenderState::SurfaceColorMode::SideSign;
-      renderState.useFog = true;
-      renderState.useShadows = true;
-      break;
-    case 1:
-      renderState.renderingMode = RenderState::RenderingMode::DirectVolume;
-      renderState.surfaceColorMode = RenderState::SurfaceColorMode::SideSign;
-      renderState.useFog = false;
-      renderState.useShadows = false;
-      break;
-    case 2:
-      renderState.renderingMode = RenderState::RenderingMode::UnlitSurface;
-      renderState.surfaceColorMode = RenderState::SurfaceColorMode::UnitNormal;
-      renderState.useFog = false;
-      renderState.useShadows = false;
-      break;
-    case 3:
-      renderState.renderingMode = RenderState::RenderingMode::UnlitSurface;
-      renderState.surfaceColorMode =
-          RenderState::SurfaceColorMode::GaussianCurvature;
-      renderState.useFog = false;
-      renderState.useShadows = false;
-      break;
-    default:
-      break;
-    }
+    renderState.applyPreset(buttonInfo.at(index).preset);
   }};
 
   // Keyboard shortcuts: Ctrl + [1–4]
@@ -741,6 +776,7 @@ void UI::surfaceInfoTooltip(RenderPipeline &pipeline,
     showText("Optical depth: {:.2g}", pixelData->extraData.x);
     showText("Avg. scalar (weigthed): {:.2g}", pixelData->extraData.y);
     showText("Opacity: {:.3g}%", pixelData->extraData.z * 100.0f);
+    showText("Samples: {:.0f}", pixelData->extraData.w);
   }
 
   ImGui::EndTooltip();
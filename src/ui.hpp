@@ -52,6 +52,10 @@ private:
 
   std::vector<GLuint> m_buttonTextures;
   std::optional<RenderPipeline::PixelData> m_lastPixelData;
+  // Average samples per pixel of direct volume rendering shown in the debug
+  // info window, read once per frame
+  std::optional<float> m_dvrSamplesPerPixel;
+  std::size_t m_dvrSamplesFrameCount{};
 };
 
 #endif
\ No newline at end of file
@@ -67,6 +67,8 @@ void uiEditor::functionEditor(AppContext &context, Raycast const &raycast,
   static constexpr std::size_t kMaxEditorTextSize{80UL * 16};
   static constexpr auto kEditorErrorMessage{
       "ERROR: Ill-formed code or expression"};
+  static constexpr auto kEditorSlowMessage{
+      "WARNING: Slow to render with the current settings"};
 
   auto &appState{context.appState};
   auto &renderState{context.renderState};
@@ -105,6 +107,12 @@ void uiEditor::functionEditor(AppContext &context, Raycast const &raycast,
 
     ImVec4 const redColor{1.0f, 0.35f, 0.35f, 1.0f};
     ImGui::TextColored(redColor, "%s", kEditorErrorMessage);
+  } else if (raycast.isSlowToRender(renderState)) {
+    auto const textSize{ImGui::CalcTextSize(kEditorSlowMessage)};
+    ImGui::SameLine(uiWindowSize.x - textSize.x - 8);
+
+    ImVec4 const yellowColor{1.0f, 0.85f, 0.35f, 1.0f};
+    ImGui::TextColored(yellowColor, "%s", kEditorSlowMessage);
   }
   ImGui::BeginChild("##childScopes", ImVec2(0, uiWindowSize.y / 2),
                     ImGuiChildFlags_Borders |
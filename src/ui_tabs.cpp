@@ -138,7 +138,8 @@ void uiTabs::functionsTab(AppContext &context, Camera &camera,
   }
 }
 
-void uiTabs::settingsTab(AppContext &context, Camera &camera) {
+void uiTabs::settingsTab(AppContext &context, Camera &camera,
+                         Raycast const &raycast) {
   ImGui::BeginChild("##childSettingsTab", ImVec2(0, -1),
                     ImGuiChildFlags_Borders);
 
@@ -190,10 +191,22 @@ void uiTabs::settingsTab(AppContext &context, Camera &camera) {
     ImGui::BeginDisabled(appState.useRecommendedSettings || DVRSelected);
 
     // Raymarch method combo box
-    static constexpr std::array items{"Adaptive", "Fixed-step"};
-    auto currentIndex{renderState.raymarchAdaptive ? 0ul : 1ul};
+    // Functions that are not polynomials, or that have no interval extension,
+    // use the adaptive method instead
+    static constexpr std::array items{"Adaptive", "Fixed-step", "Polynomial",
+                                      "Interval"};
+    static constexpr std::array itemsEnum{
+        RenderState::RaymarchMethod::Adaptive,
+        RenderState::RaymarchMethod::FixedStep,
+        RenderState::RaymarchMethod::Polynomial,
+        RenderState::RaymarchMethod::Interval};
+
+    auto const currentIndex{
+        gsl::narrow<std::size_t>(renderState.raymarchMethod)};
     auto const newIndex{uiWidgets::combo("Method", items, currentIndex)};
-    renderState.raymarchAdaptive = newIndex == 0;
+    if (newIndex != currentIndex) {
+      renderState.raymarchMethod = itemsEnum.at(newIndex);
+    }
 
     // Isosurface raymarch steps
     auto const minSteps{5};
@@ -219,12 +232,15 @@ void uiTabs::settingsTab(AppContext &context, Camera &camera) {
     }
 
     // Gradient evaluation combo box
+    // Functions without analytic derivatives use the 5-point stencil instead
     static constexpr std::array gradientItems{
-        "Forward difference", "Central difference", "5-point stencil"};
+        "Forward difference", "Central difference", "5-point stencil",
+        "Analytic"};
     static constexpr std::array gradientItemsEnum{
         RenderState::GradientMode::ForwardDifference,
         RenderState::GradientMode::CentralDifference,
-        RenderState::GradientMode::FivePointStencil};
+        RenderState::GradientMode::FivePointStencil,
+        RenderState::GradientMode::Analytic};
 
     auto const currentGradientIndex{
         gsl::narrow<std::size_t>(renderState.raymarchGradientEvaluation)};
@@ -240,6 +256,87 @@ void uiTabs::settingsTab(AppContext &context, Camera &camera) {
     ImGui::EndDisabled();
   }
 
+  ImGui::SeparatorText("Empty space skipping");
+  {
+    ImGui::Checkbox("Brick map", &renderState.useBrickMap);
+    uiWidgets::showDelayedTooltip(
+        "Skip the regions of the bounds where the function cannot reach the "
+        "isovalue, or where the volume is transparent. Approximate for "
+        "functions without an interval extension: features thinner than the "
+        "sample spacing of the bricks may be skipped");
+
+    ImGui::BeginDisabled(!renderState.useBrickMap);
+
+    ImGui::SameLine(134.0f, 0.0f);
+    ImGui::Checkbox("Show skipped", &renderState.showSkippedBricks);
+    uiWidgets::showDelayedTooltip(
+        "Tint pixels by the fraction of bricks skipped by their rays");
+
+    // Bricks along each axis of the grid over the bounds
+    ImGui::PushItemWidth(156);
+    ImGui::SliderInt("Bricks", &renderState.brickMapSize,
+                     RenderState::kMinBrickMapSize,
+                     RenderState::kMaxBrickMapSize, "%d",
+                     ImGuiSliderFlags_AlwaysClamp);
+    ImGui::PopItemWidth();
+
+    ImGui::EndDisabled();
+  }
+
+  ImGui::SeparatorText("Scalar field texture");
+  {
+    // Sizes of the grid larger than the GPU supports are not offered
+    auto const &sizes{RenderState::kFieldTextureSizes};
+    auto const maxSize{raycast.getMaxFieldTextureSize()};
+
+    ImGui::BeginDisabled(maxSize < sizes.front());
+    ImGui::Checkbox("Cache function", &renderState.useFieldTexture);
+    uiWidgets::showDelayedTooltip(
+        "Evaluate the function once into a 3D texture, and sample it in volume "
+        "rendering and in a preview of the isosurface");
+    ImGui::EndDisabled();
+
+    ImGui::BeginDisabled(!renderState.useFieldTexture);
+
+    ImGui::SameLine(134.0f, 0.0f);
+    auto isSinglePrecision{renderState.fieldTexturePrecision ==
+                           RenderState::FieldTexturePrecision::Single};
+    ImGui::Checkbox("32-bit", &isSinglePrecision);
+    uiWidgets::showDelayedTooltip(
+        "Store single-precision values instead of half-precision values, if "
+        "float textures can be filtered");
+    renderState.fieldTexturePrecision =
+        isSinglePrecision ? RenderState::FieldTexturePrecision::Single
+                          : RenderState::FieldTexturePrecision::Half;
+
+    // Points along each axis of the grid over the bounds
+    static constexpr std::array sizeItems{"128", "256", "512"};
+    static_assert(sizeItems.size() == RenderState::kFieldTextureSizes.size());
+    auto const currentSize{
+        std::ranges::find(sizes, renderState.fieldTextureSize)};
+    auto const currentSizeIndex{
+        gsl::narrow<std::size_t>(std::distance(sizes.begin(), currentSize))};
+    ImGui::PushItemWidth(156);
+    if (ImGui::BeginCombo("Resolution", sizeItems.at(currentSizeIndex))) {
+      for (auto const index : iter::range(sizes.size())) {
+        if (sizes.at(index) > maxSize) {
+          continue;
+        }
+        auto const isSelected{currentSizeIndex == index};
+        if (ImGui::Selectable(sizeItems.at(index), isSelected)) {
+          renderState.fieldTextureSize = sizes.at(index);
+        }
+        if (isSelected) {
+          ImGui::SetItemDefaultFocus();
+        }
+      }
+      ImGui::EndCombo();
+    }
+    ImGui::PopItemWidth();
+
+    ImGui::EndDisabled();
+  }
+
   ImGui::SeparatorText("Camera projection");
   {
     // Camera projection combo box
@@ -350,17 +447,24 @@ void uiTabs::settingsTab(AppContext &context, Camera &camera) {
       }
 
       // Antialiasing combo box
-      static constexpr std::array AAItems{"Off", "2x MSAA", "4x MSAA",
-                                          "8x MSAA", "16x MSAA"};
+      // The last item accumulates samples over frames
+      static constexpr std::array AAItems{"Off",     "2x MSAA",  "4x MSAA",
+                                          "8x MSAA", "16x MSAA", "Temporal"};
+      auto const temporalAAIndex{AAItems.size() - 1};
       auto const currentAAIndex{
-          gsl::narrow_cast<std::size_t>(std::log2(renderState.msaaSamples))};
+          renderState.temporalSupersampling
+              ? temporalAAIndex
+              : gsl::narrow_cast<std::size_t>(
+                    std::log2(renderState.msaaSamples))};
 
       ImGui::PushItemWidth(148);
       auto const newAAIndex{
           uiWidgets::combo("Anti-alias", AAItems, currentAAIndex)};
       ImGui::PopItemWidth();
 
-      renderState.msaaSamples = 1 << newAAIndex;
+      renderState.temporalSupersampling = newAAIndex == temporalAAIndex;
+      renderState.msaaSamples =
+          renderState.temporalSupersampling ? 1 : 1 << newAAIndex;
 
       ImGui::BeginDisabled(renderState.renderingMode !=
                            RenderState::RenderingMode::LitSurface);
@@ -379,6 +483,15 @@ void uiTabs::settingsTab(AppContext &context, Camera &camera) {
                        maxSteps);
 
       ImGui::EndDisabled();
+
+      ImGui::SliderFloat("Max opacity", &renderState.dvrOpacityThreshold,
+                         0.9f, 1.0f, "%.3f", ImGuiSliderFlags_AlwaysClamp);
+      uiWidgets::showDelayedTooltip(
+          "Accumulated opacity at which rays stop marching the volume");
+      ImGui::Checkbox("Adaptive steps", &renderState.dvrAdaptiveStep);
+      uiWidgets::showDelayedTooltip(
+          "Take longer steps where the volume is transparent and its color "
+          "varies slowly");
     }
 
     ImGui::Checkbox("Background", &appState.drawBackground);
@@ -386,6 +499,10 @@ void uiTabs::settingsTab(AppContext &context, Camera &camera) {
     ImGui::Checkbox("Axes", &renderState.showAxes);
 
     ImGui::Checkbox("Info tooltip", &appState.showSurfaceInfoTooltip);
+    ImGui::SameLine(134.0f, 0.0f);
+    ImGui::Checkbox("Progressive", &renderState.progressiveRefinement);
+    uiWidgets::showDelayedTooltip(
+        "Render a low-resolution preview first and refine it");
 
 #if defined(__EMSCRIPTEN__)
     if (!UI::s_noEquation.has_value()) {
@@ -409,8 +526,7 @@ void uiTabs::settingsTab(AppContext &context, Camera &camera) {
   ImGui::EndChild();
 }
 
-void uiTabs::aboutTab([[maybe_unused]] AppContext &context,
-                      Raycast const &raycast) {
+void uiTabs::aboutTab(AppContext &context, Raycast const &raycast) {
   ImGui::BeginChild("##childAboutTab", ImVec2(0, -1), ImGuiChildFlags_Borders);
 
   if (ImGui::IsWindowHovered()) {
@@ -468,6 +584,25 @@ void uiTabs::aboutTab([[maybe_unused]] AppContext &context,
         "%s",
         std::format("Render chunks: {}", raycast.getNumRenderChunks()).c_str());
 
+    if (raycast.isGPUTimingSupported()) {
+      ImGui::SliderFloat("Chunk budget", &context.renderState.chunkTimeBudget,
+                         4.0f, 60.0f, "%.0f ms");
+      uiWidgets::showDelayedTooltip(
+          "GPU time of the part of the frame rendered per UI frame");
+    }
+
+    ImGui::Text("%s", std::format("Render scale: {:.0f}%",
+                                  raycast.getPresentedLevelScale() * 100.0)
+                          .c_str());
+    ImGui::SliderFloat("Target FPS", &context.renderState.interactiveTargetFPS,
+                       10.0f, 120.0f, "%.0f");
+    uiWidgets::showDelayedTooltip(
+        "Frame rate kept by lowering the resolution while the view changes");
+    ImGui::SliderFloat("Min scale", &context.renderState.minRenderScale,
+                       0.125f, 1.0f, "%.2f");
+    uiWidgets::showDelayedTooltip(
+        "Lowest resolution scale used while the view changes");
+
     ImGui::PopItemWidth();
   }
 
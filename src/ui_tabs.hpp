@@ -18,7 +18,8 @@ namespace uiTabs {
 
 void functionsTab(AppContext &context, Camera &camera,
                   float parentWindowHeight);
-void settingsTab(AppContext &context, Camera &camera);
+void settingsTab(AppContext &context, Camera &camera,
+                 Raycast const &raycast);
 void aboutTab(AppContext &context, Raycast const &raycast);
 
 } // namespace uiTabs
@@ -10,10 +10,15 @@
 #ifndef UTIL_HPP_
 #define UTIL_HPP_
 
+#include <abcgExternal.hpp>
 #include <abcgOpenGLExternal.hpp>
 
 #include <gsl/gsl>
 
+#include <cmath>
+#include <filesystem>
+#include <format>
+
 namespace util {
 
 template <typename Fun>
@@ -74,6 +79,42 @@ inline std::size_t replaceAll(std::string &inout, std::string_view what,
       inout, what, with, [](auto &, auto) {}, matchIdentifier);
 }
 
+// Computes the 64-bit FNV-1a hash of 'str', continuing from 'seed' so that
+// several strings can be hashed as if concatenated. Unlike std::hash, the
+// result is stable across runs and platforms.
+constexpr std::uint64_t
+hashFNV1a(std::string_view str, std::uint64_t seed = 14695981039346656037ULL) {
+  constexpr std::uint64_t prime{1099511628211ULL};
+  for (auto const c : str) {
+    seed ^= static_cast<unsigned char>(c);
+    seed *= prime;
+  }
+  return seed;
+}
+
+// Returns the user-writable directory of the application, or an empty path if
+// it is not available. The directory is created if it does not exist.
+inline std::filesystem::path getPrefPath() {
+  auto *prefPath{SDL_GetPrefPath("hbatagelo", "ImpVis")};
+  if (prefPath == nullptr) {
+    return {};
+  }
+  std::string_view const utf8Path{prefPath};
+  std::filesystem::path const path{
+      std::u8string{utf8Path.begin(), utf8Path.end()}};
+  SDL_free(prefPath);
+  return path;
+}
+
+// Formats a number as a GLSL float literal (e.g. 42 as 42.0)
+inline std::string formatFloat(double value) {
+  auto integralPart{0.0};
+  if (FP_ZERO == std::fpclassify(std::modf(value, &integralPart))) {
+    return std::format("{:.1f}", value);
+  }
+  return std::format("{:.12g}", value);
+}
+
 // Converts a string_view to a lowercase std::string (ASCII only).
 inline std::string toLower(std::string_view str) {
   std::string result{str};
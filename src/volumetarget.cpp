@@ -0,0 +1,78 @@
+/**
+ * @file volumetarget.cpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#include "volumetarget.hpp"
+
+#include <abcgOpenGL.hpp>
+
+void VolumeTarget::resize(int size, Format const &format) {
+  if (size == m_size && format == m_format && m_texture != 0) {
+    return;
+  }
+
+  if (size <= 0) {
+    throw abcg::RuntimeError("Invalid volume target size");
+  }
+
+  destroy();
+  m_size = size;
+  m_format = format;
+
+  abcg::glGenTextures(1, &m_texture);
+  abcg::glBindTexture(GL_TEXTURE_3D, m_texture);
+  abcg::glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, format.filter);
+  abcg::glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, format.filter);
+  abcg::glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  abcg::glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  abcg::glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  abcg::glTexImage3D(GL_TEXTURE_3D, 0, format.internalFormat, size, size, size,
+                     0, format.format, format.type, nullptr);
+  abcg::glBindTexture(GL_TEXTURE_3D, 0);
+
+  // Large volumes may not fit in the memory of the GPU
+  if (glGetError() == GL_OUT_OF_MEMORY) {
+    destroy();
+    throw abcg::RuntimeError(
+        std::format("Out of memory for volume target of size {}", size));
+  }
+
+  abcg::glGenFramebuffers(1, &m_fbo);
+  abcg::glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+  abcg::glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                  m_texture, 0, 0);
+
+  auto const status{abcg::glCheckFramebufferStatus(GL_FRAMEBUFFER)};
+  abcg::glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    destroy();
+    throw abcg::RuntimeError(std::format(
+        "Volume target framebuffer incomplete: status = 0x{:X}", status));
+  }
+}
+
+void VolumeTarget::bindLayer(int layer) const {
+  if (m_fbo == 0) {
+    throw abcg::RuntimeError("Attempting to bind invalid volume target");
+  }
+  abcg::glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+  abcg::glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                  m_texture, 0, layer);
+}
+
+void VolumeTarget::destroy() {
+  if (m_texture != 0) {
+    abcg::glDeleteTextures(1, &m_texture);
+    m_texture = 0;
+  }
+  if (m_fbo != 0) {
+    abcg::glDeleteFramebuffers(1, &m_fbo);
+    m_fbo = 0;
+  }
+  m_size = 0;
+}
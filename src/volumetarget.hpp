@@ -0,0 +1,73 @@
+/**
+ * @file volumetarget.hpp
+ *
+ * This file is part of ImpVis (https://github.com/hbatagelo/impvis).
+ *
+ * @copyright (c) 2022--2026 Harlen Batagelo. All rights reserved.
+ * ImpVis is released under the MIT license.
+ */
+
+#ifndef VOLUMETARGET_HPP_
+#define VOLUMETARGET_HPP_
+
+#include <abcgOpenGLExternal.hpp>
+
+// Cubic 3D texture rendered one layer at a time, with a framebuffer that
+// attaches the layer being rendered.
+//
+// The raycast program fills these textures with values of the function over
+// the bounds, such as the range of the function in each brick of the brick
+// map, or the function sampled at each texel of the scalar field texture.
+class VolumeTarget {
+public:
+  struct Format {
+    GLint internalFormat{GL_RGBA32F};
+    GLenum format{GL_RGBA};
+    GLenum type{GL_FLOAT};
+    GLint filter{GL_NEAREST};
+
+    friend bool operator==(Format const &, Format const &) = default;
+  };
+
+  // Float formats. Only half floats are filterable in OpenGL ES 3.0. Linear
+  // filtering of R32F requires OES_texture_float_linear.
+  static constexpr Format kRGBA32F{.internalFormat = GL_RGBA32F,
+                                   .format = GL_RGBA,
+                                   .type = GL_FLOAT,
+                                   .filter = GL_NEAREST};
+  static constexpr Format kR16F{.internalFormat = GL_R16F,
+                                .format = GL_RED,
+                                .type = GL_HALF_FLOAT,
+                                .filter = GL_LINEAR};
+  static constexpr Format kR32F{.internalFormat = GL_R32F,
+                                .format = GL_RED,
+                                .type = GL_FLOAT,
+                                .filter = GL_LINEAR};
+
+  VolumeTarget() = default;
+  ~VolumeTarget() { destroy(); }
+
+  VolumeTarget(VolumeTarget const &) = delete;
+  VolumeTarget &operator=(VolumeTarget const &) = delete;
+  VolumeTarget(VolumeTarget &&) = delete;
+  VolumeTarget &operator=(VolumeTarget &&) = delete;
+
+  // Reallocates the texture with the given number of texels along each axis
+  // and format, unless it already has them. The contents are undefined until
+  // every layer is rendered again.
+  void resize(int size, Format const &format);
+  // Binds the framebuffer with the given layer attached
+  void bindLayer(int layer) const;
+  void destroy();
+
+  [[nodiscard]] int getSize() const noexcept { return m_size; }
+  [[nodiscard]] GLuint getTexture() const noexcept { return m_texture; }
+
+private:
+  GLuint m_fbo{};
+  GLuint m_texture{};
+  int m_size{};
+  Format m_format;
+};
+
+#endif
@@ -120,7 +120,20 @@ void Window::onPaint() {
   m_ui.onPaint();
 
   if (appState.useRecommendedSettings) {
-    applyRecommendedSettings();
+    applyRecommendedSettings(renderState);
+  }
+
+  // Stop caching the function if its texture is larger than the GPU supports
+  // or failed to be allocated, and select the largest size that may fit
+  if (auto const maxSize{m_pipeline.getRaycast().getMaxFieldTextureSize()};
+      renderState.fieldTextureSize > maxSize) {
+    renderState.useFieldTexture = false;
+    renderState.fieldTextureSize = RenderState::kFieldTextureSizes.front();
+    for (auto const size : RenderState::kFieldTextureSizes) {
+      if (size <= maxSize) {
+        renderState.fieldTextureSize = size;
+      }
+    }
   }
 
   auto const minScale{0.1f / renderState.boundsRadius};
@@ -131,11 +144,33 @@ void Window::onPaint() {
     m_camera.setModelScale(clampedModelScale);
   }
 
+  // Progressive refinement starts from the tile under the mouse cursor
+  std::optional<glm::vec2> focusPosition;
+  if (auto const &guiIO{ImGui::GetIO()};
+      ImGui::IsMousePosValid(&guiIO.MousePos)) {
+    glm::vec2 const windowSize{appState.windowSize};
+    glm::vec2 const position{guiIO.MousePos.x / windowSize.x,
+                             1.0f - (guiIO.MousePos.y / windowSize.y)};
+    if (glm::all(glm::greaterThanEqual(position, glm::vec2{0.0f})) &&
+        glm::all(glm::lessThan(position, glm::vec2{1.0f}))) {
+      focusPosition = position;
+    }
+  }
+  m_pipeline.setFocusPosition(focusPosition);
+
   auto const lightRotation{m_trackBallLight.getRotation()};
   m_pipeline.onPaint(renderState, appState, m_camera, lightRotation);
 
-  // Handle screenshots
-  if (appState.takeScreenshot && m_pipeline.getRaycast().getFrameCount() > 0) {
+  auto const &raycast{m_pipeline.getRaycast()};
+  if (raycast.isFrameComplete()) {
+    prewarmPrograms();
+  }
+
+  // Handle screenshots. Wait for the specialized program and the finest
+  // refinement level so that the screenshot is not a reduced-resolution
+  // preview.
+  if (appState.takeScreenshot && raycast.getFrameCount() > 0 &&
+      !raycast.isFallbackActive() && raycast.isPresentedFrameRefined()) {
     saveScreenshotPNG("screenshot.png");
     appState.takeScreenshot = false;
   }
@@ -232,16 +267,92 @@ void Window::selectInitialFunction() {
   }
 }
 
-void Window::applyRecommendedSettings() {
-  auto const &data{m_context.renderState.function.getData()};
-  auto &renderState{m_context.renderState};
+void Window::prewarmPrograms() {
+  auto const &appState{m_context.appState};
+  auto const &renderState{m_context.renderState};
+
+  // Parameter values are not settled while a parameter is edited
+  if (renderState.editedParameter.has_value()) {
+    return;
+  }
+  if (m_prewarmedState.has_value() &&
+      m_prewarmedState->isProgramEquivalent(renderState)) {
+    return;
+  }
+  // Settled parameter values are folded into the programs of the current
+  // function, but not into the ones of other functions, which are not
+  // prewarmed again
+  auto isValueChange{false};
+  if (m_prewarmedState.has_value()) {
+    auto settled{renderState};
+    for (auto const &parameter : m_prewarmedState->function.getParameters()) {
+      settled.function.setParameter(parameter.name, parameter.value);
+    }
+    isValueChange = m_prewarmedState->isProgramEquivalent(settled);
+  }
+  m_prewarmedState = renderState;
+
+  std::vector<RenderState> renderStates;
+
+  // Edits of any parameter, so that they start without waiting for the
+  // program that reads the parameters from uniforms
+  if (!renderState.function.getParameters().empty()) {
+    renderStates.emplace_back(renderState).editedParameter = 0;
+  }
+
+  // Other visualization modes of the current function
+  for (auto const preset :
+       {RenderState::Preset::Shaded, RenderState::Preset::Volume,
+        RenderState::Preset::Normals, RenderState::Preset::Curvature}) {
+    auto &variant{renderStates.emplace_back(renderState)};
+    variant.applyPreset(preset);
+    if (appState.useRecommendedSettings) {
+      applyRecommendedSettings(variant);
+    }
+  }
+
+  // Previous and next functions of the catalog, in the current mode
+  auto const &groups{m_context.functionManager.getGroups()};
+  if (!isValueChange &&
+      renderState.function.getData().name != "User-defined" &&
+      appState.selectedFunctionGroupIndex < groups.size()) {
+    auto const &functions{
+        groups.at(appState.selectedFunctionGroupIndex).functions};
+    auto const index{appState.selectedFunctionIndex};
+    for (auto const neighbor : {index + 1, index - 1}) {
+      // index - 1 wraps around to a large value when index is 0
+      if (neighbor >= functions.size()) {
+        continue;
+      }
+      auto &variant{renderStates.emplace_back(renderState)};
+      variant.function = functions.at(neighbor);
+      variant.boundsRadius = variant.function.getData().boundsRadius;
+      if (appState.useRecommendedSettings) {
+        applyRecommendedSettings(variant);
+      }
+    }
+  }
+
+  m_pipeline.prewarm(renderStates);
+}
+
+void Window::applyRecommendedSettings(RenderState &renderState) {
+  auto const &data{renderState.function.getData()};
 
   renderState.boundsShape = util::toLower(data.boundsShape) == "box"
                                 ? RenderState::BoundsShape::Box
                                 : RenderState::BoundsShape::Sphere;
   renderState.boundsRadius = data.boundsRadius;
-  renderState.raymarchAdaptive =
-      util::toLower(data.isosurfaceRaymarchMethod) != "fixed-step";
+  auto const raymarchMethod{util::toLower(data.isosurfaceRaymarchMethod)};
+  if (raymarchMethod == "fixed-step") {
+    renderState.raymarchMethod = RenderState::RaymarchMethod::FixedStep;
+  } else if (raymarchMethod == "polynomial") {
+    renderState.raymarchMethod = RenderState::RaymarchMethod::Polynomial;
+  } else if (raymarchMethod == "interval") {
+    renderState.raymarchMethod = RenderState::RaymarchMethod::Interval;
+  } else {
+    renderState.raymarchMethod = RenderState::RaymarchMethod::Adaptive;
+  }
 
   auto const rootTestMode{util::toLower(data.isosurfaceRaymarchRootTest)};
   if (rootTestMode == "taylor 1st-order") {
@@ -254,7 +365,12 @@ void Window::applyRecommendedSettings() {
 
   auto const gradientEvaluation{
       util::toLower(data.isosurfaceRaymarchGradientEvaluation)};
-  if (gradientEvaluation == "central difference") {
+  auto const hasAnalyticDerivatives{
+      renderState.function.hasAnalyticDerivatives()};
+  if (hasAnalyticDerivatives) {
+    renderState.raymarchGradientEvaluation =
+        RenderState::GradientMode::Analytic;
+  } else if (gradientEvaluation == "central difference") {
     renderState.raymarchGradientEvaluation =
         RenderState::GradientMode::CentralDifference;
   } else if (gradientEvaluation == "5-point stencil") {
@@ -273,18 +389,23 @@ void Window::applyRecommendedSettings() {
 
   auto rayMarchSteps{data.isosurfaceRaymarchSteps};
 
-  // Force 5-point stencil and 2x step count for curvature visualization
-  if (renderState.surfaceColorMode ==
+  auto const usesCurvature{
+      renderState.surfaceColorMode ==
           RenderState::SurfaceColorMode::GaussianCurvature ||
       renderState.surfaceColorMode ==
           RenderState::SurfaceColorMode::MeanCurvature ||
       renderState.surfaceColorMode ==
-          RenderState::SurfaceColorMode::MaxAbsCurvature) {
+          RenderState::SurfaceColorMode::MaxAbsCurvature};
+
+  // Force 5-point stencil and 2x step count for curvature visualization, to
+  // reduce the noise of finite differences. Analytic derivatives are exact.
+  if (usesCurvature && !hasAnalyticDerivatives) {
     renderState.raymarchGradientEvaluation =
         RenderState::GradientMode::FivePointStencil;
     rayMarchSteps =
         gsl::narrow_cast<int>(gsl::narrow<float>(rayMarchSteps) * 2.0f);
-  } else if (!renderState.useShadows && rayMarchSteps > 60) {
+  } else if (!usesCurvature && !renderState.useShadows &&
+             rayMarchSteps > 60) {
     rayMarchSteps =
         gsl::narrow_cast<int>(gsl::narrow<float>(rayMarchSteps) * 0.75f);
   }
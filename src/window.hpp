@@ -45,8 +45,12 @@ private:
 
   abcg::TrackBall m_trackBallLight;
 
-  void applyRecommendedSettings();
+  // State of the last frame whose likely next programs were prewarmed
+  std::optional<RenderState> m_prewarmedState;
+
+  static void applyRecommendedSettings(RenderState &renderState);
   void selectInitialFunction();
+  void prewarmPrograms();
 
   friend class UI;
 };
@@ -0,0 +1,255 @@
+#include "function.hpp"
+#include "parameterbuffer.hpp"
+#include "shadertemplate.hpp"
+#include "util.hpp"
+
+#include <fmt/core.h>
+#include <toml.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+namespace {
+
+std::filesystem::path const kShadersDir{SHADERS_DIR};
+std::filesystem::path const kFunctionsDir{FUNCTIONS_DIR};
+std::array<std::string_view, 8> const kPlaceholderNames{
+    "DEFINITIONS",     "CODE_GLOBAL",   "CODE_LOCAL",
+    "EXPRESSION_LHS",  "CODE_GRADIENT", "CODE_HESSIAN",
+    "CODE_POLYNOMIAL", "CODE_INTERVAL"};
+
+// Prevents the compiler from discarding the measured work
+std::size_t volatile sink{};
+
+// Returns the mean time, in microseconds, of one call of 'fun' over 'numRuns'
+// calls.
+template <typename Fun> double measure(int numRuns, Fun &&fun) {
+  auto const start{std::chrono::steady_clock::now()};
+  for (auto run{0}; run < numRuns; ++run) {
+    fun();
+  }
+  std::chrono::duration<double, std::micro> const elapsed{
+      std::chrono::steady_clock::now() - start};
+  return elapsed.count() / numRuns;
+}
+
+std::string readFile(std::filesystem::path const &path) {
+  std::ifstream stream(path, std::ios::binary);
+  std::ostringstream ss;
+  ss << stream.rdbuf();
+  return ss.str();
+}
+
+struct Variant {
+  std::string definitions;
+  std::string expression;
+};
+
+// Combinations of rendering options and expressions similar to the ones of
+// the function catalog.
+std::vector<Variant> createVariants() {
+  std::array const expressions{
+      "@P.@x*@P.@x + @P.@y*@P.@y + @P.@z*@P.@z - 1.0",
+      "pow(@P.@x*@P.@x + 2.25*@P.@y*@P.@y + @P.@z*@P.@z - 1.0, 3.0) - "
+      "@P.@x*@P.@x*@P.@z*@P.@z*@P.@z - 0.1125*@P.@y*@P.@y*@P.@z*@P.@z*@P.@z",
+      "sin(@P.@x)*cos(@P.@y) + sin(@P.@y)*cos(@P.@z) + sin(@P.@z)*cos(@P.@x)"};
+
+  std::vector<Variant> variants;
+  for (auto const *expression : expressions) {
+    for (auto const renderingMode : {0, 1, 2}) {
+      for (auto const useShadows : {false, true}) {
+        std::string definitions;
+        definitions += "#define PARAMS_SIZE 1\n";
+        definitions += "#define kUseBoundingBox false\n";
+        definitions += "#define kRaymarchMethod 0\n";
+        definitions += "#define kRootTest 1\n";
+        definitions += "#define kGradientMode 1\n";
+        definitions +=
+            std::format("#define kRenderingMode {}\n", renderingMode);
+        definitions += "#define kSurfaceColorMode 0\n";
+        definitions += std::format("#define kUseShadows {}\n", useShadows);
+        definitions += "#define kUseFog true\n";
+        definitions += "#define kInwardNormals false\n";
+        definitions += "#define kShowAxes true\n";
+        definitions += "#define ISOSURFACE_RAYMARCH_STEPS 500\n";
+        definitions += "#define DVR_RAYMARCH_STEPS 250\n";
+        variants.push_back(
+            {.definitions = std::move(definitions), .expression = expression});
+      }
+    }
+  }
+  return variants;
+}
+
+void benchmarkShaderAssembly() {
+  constexpr auto numRuns{200};
+
+  auto const vertexShaderPath{kShadersDir / "raycast.vert"};
+  auto const fragmentShaderPath{kShadersDir / "raycast.frag"};
+  auto const variants{createVariants()};
+
+  // Sources read from disk and patched with one replacement pass per
+  // placeholder, as done before the introduction of ShaderTemplate
+  auto const replaceTime{measure(numRuns, [&] {
+    for (auto const &variant : variants) {
+      auto const vertexSource{readFile(vertexShaderPath)};
+      auto fragmentSource{readFile(fragmentShaderPath)};
+      util::replaceAll(fragmentSource, "@DEFINITIONS@", variant.definitions);
+      util::replaceAll(fragmentSource, "@CODE_LOCAL@", "");
+      util::replaceAll(fragmentSource, "@CODE_GLOBAL@", "");
+      util::replaceAll(fragmentSource, "@EXPRESSION_LHS@", variant.expression);
+      util::replaceAll(fragmentSource, "@CODE_GRADIENT@", "");
+      util::replaceAll(fragmentSource, "@CODE_HESSIAN@", "");
+      util::replaceAll(fragmentSource, "@CODE_POLYNOMIAL@", "");
+      util::replaceAll(fragmentSource, "@CODE_INTERVAL@", "");
+      sink = sink + vertexSource.size() + fragmentSource.size();
+    }
+  })};
+
+  auto const loadTime{measure(numRuns, [&] {
+    auto const fragmentTemplate{ShaderTemplate::load(
+        fragmentShaderPath, abcg::ShaderStage::Fragment, kPlaceholderNames)};
+    sink = sink + fragmentTemplate.getNumSlots();
+  })};
+
+  auto const vertexTemplate{
+      ShaderTemplate::load(vertexShaderPath, abcg::ShaderStage::Vertex)};
+  auto const fragmentTemplate{ShaderTemplate::load(
+      fragmentShaderPath, abcg::ShaderStage::Fragment, kPlaceholderNames)};
+  auto const assembleTime{measure(numRuns, [&] {
+    for (auto const &variant : variants) {
+      std::array<std::string_view, 7> const values{
+          variant.definitions, "", "", variant.expression, "", "", ""};
+      auto const vertexSource{vertexTemplate.assemble()};
+      auto const fragmentSource{fragmentTemplate.assemble(values)};
+      sink = sink + vertexSource.source.size() + fragmentSource.source.size();
+    }
+  })};
+
+  auto const numVariants{static_cast<double>(variants.size())};
+  fmt::print("Raycast shader assembly ({} variants)\n", variants.size());
+  fmt::print("  Read + replaceAll:        {:8.2f} us/variant\n",
+             replaceTime / numVariants);
+  fmt::print("  Template load (once):     {:8.2f} us\n", loadTime);
+  fmt::print("  Template assemble:        {:8.2f} us/variant ({:.1f}x)\n",
+             assembleTime / numVariants, replaceTime / assembleTime);
+}
+
+// Returns an expression of at least 'size' bytes made of terms similar to the
+// ones of the function catalog.
+std::string createExpression(std::size_t size) {
+  std::string expression;
+  expression.reserve(size + 64);
+  while (expression.size() < size) {
+    expression += "sin(x*a+1.5)^2/(y-b)+z^3*exp(-r*[x^2+y^2])-";
+  }
+  expression += "1";
+  return expression;
+}
+
+void benchmarkFunctionConstruction() {
+  constexpr std::size_t minSize{1 << 10};
+  constexpr std::size_t maxSize{1 << 22};
+
+  fmt::print("\nFunction construction (tokenize, parse, GLSL and MathJax)\n");
+  for (auto size{minSize}; size <= maxSize; size *= 4) {
+    Function::Data data;
+    data.expression = createExpression(size);
+    auto const numRuns{static_cast<int>(std::max<std::size_t>(
+        1, (std::size_t{1} << 20) / size))};
+    auto const time{measure(numRuns, [&] {
+      Function const function{data};
+      sink = sink + function.getGLSLExpression().size();
+    })};
+    fmt::print("  {:8} bytes: {:12.2f} us ({:.1f} ns/byte)\n",
+               data.expression.size(), time,
+               time * 1000.0 / static_cast<double>(data.expression.size()));
+  }
+}
+
+// Measures the per-frame cost of packing the parameters of a function when one
+// of them changes, as while it is dragged. The packing is linear in the number
+// of parameters, but only the changed value is uploaded.
+void benchmarkParameterUpdates() {
+  constexpr std::size_t minParameters{16};
+  constexpr std::size_t maxParameters{4096};
+  constexpr auto numRuns{10000};
+
+  fmt::print("\nParameter buffer update with one changed value\n");
+  for (auto numParameters{minParameters}; numParameters <= maxParameters;
+       numParameters *= 4) {
+    std::vector<Function::Parameter> parameters(numParameters);
+    for (std::size_t index{}; index < numParameters; ++index) {
+      parameters[index].name = std::format("p{}", index);
+    }
+
+    ParameterBuffer buffer;
+    auto const fullRange{buffer.pack(parameters)};
+
+    std::size_t uploadedValues{};
+    auto const time{measure(numRuns, [&] {
+      parameters[numParameters / 2].value += 1.0f;
+      if (auto const range{buffer.pack(parameters)}) {
+        uploadedValues += range->count;
+      }
+    })};
+    fmt::print("  {:5} parameters: {:8.3f} us, {:4} bytes uploaded "
+               "(instead of {} bytes)\n",
+               numParameters, time,
+               uploadedValues * sizeof(float) / numRuns,
+               fullRange->count * sizeof(float));
+  }
+}
+
+// Prints the number of arithmetic operations of one evaluation of each catalog
+// function, before and after common subexpression elimination
+void printCatalogOpCounts() {
+  std::set<std::filesystem::path> paths;
+  for (auto const &entry :
+       std::filesystem::directory_iterator{kFunctionsDir}) {
+    if (entry.is_regular_file() && entry.path().extension() == ".toml") {
+      paths.insert(entry.path());
+    }
+  }
+
+  fmt::print("\nArithmetic ops per evaluation of the catalog functions\n");
+  fmt::print("  {:<40} {:>6} {:>6}\n", "Function", "Before", "After");
+  Function::OpCount total{};
+  for (auto const &path : paths) {
+    toml::table table = toml::parse_file(path.string());
+    for (auto &&[key, value] : table) {
+      if (value.is_value()) {
+        continue;
+      }
+      auto const subTable{table[key]};
+      Function::Data data;
+      data.name = subTable["name"].value_or(data.name);
+      data.expression = subTable["expression"].value_or(data.expression);
+      data.codeLocal = subTable["code_local"].value_or(data.codeLocal);
+      data.codeGlobal = subTable["code_global"].value_or(data.codeGlobal);
+      if (data.expression.empty()) {
+        continue;
+      }
+
+      auto const opCount{Function{data}.getOpCount()};
+      fmt::print("  {:<40} {:>6} {:>6}\n", data.name, opCount.original,
+                 opCount.optimized);
+      total.original += opCount.original;
+      total.optimized += opCount.optimized;
+    }
+  }
+  fmt::print("  {:<40} {:>6} {:>6}\n", "Total", total.original,
+             total.optimized);
+}
+
+} // namespace
+
+int main() {
+  benchmarkShaderAssembly();
+  benchmarkFunctionConstruction();
+  benchmarkParameterUpdates();
+  printCatalogOpCounts();
+  return 0;
+}
@@ -1,309 +1,202 @@
 #include <gtest/gtest.h>
 
+#include "expression.hpp"
 #include "function.hpp"
-#include "function_test.hpp"
 
 /**
- * getBracketsPos
+ * Expression::tokenize
  **/
 
-// Test the function with a string that does not contain any enclosing brackets
-TEST(GetBracketsPosTest, NoEnclosingBrackets) {
-  std::string_view str{"f  *x+1"};
-  auto const pos{1};
-  auto const expectedOutput{std::pair{std::string::npos, std::string::npos}};
-  auto const output{getBracketsPos(str, pos, std::pair{'(', ')'})};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test the function with a string that does not contain the closing bracket
-TEST(GetBracketsPosTest, NoClosingBracket) {
-  std::string_view str{"f((x)+"};
-  auto const pos{1};
-  auto const expectedOutput{std::pair{std::string::npos, std::string::npos}};
-  auto const output{getBracketsPos(str, pos, std::pair{'(', ')'})};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test the function with string that has a non-whitespace character from the
-// pos parameter and the first bracket
-TEST(GetBracketsPosTest, NonWhitespaceCharBeforeFirstBracket) {
-  std::string_view str{"f(x)"};
-  auto const pos{0};
-  auto const expectedOutput{std::pair{std::string::npos, std::string::npos}};
-  auto const output{getBracketsPos(str, pos, std::pair{'(', ')'})};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test the function with a string that has enclosing brackets but no nested
-// brackets
-TEST(GetBracketsPosTest, BracketsFoundWithNoNestedBrackets) {
-  std::string_view str{"f(x)"};
-  auto const pos{1};
-  auto const expectedOutput{std::pair<std::size_t, std::size_t>{1, 3}};
-  auto const output{getBracketsPos(str, pos, std::pair{'(', ')'})};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test the function with a string that has enclosing brackets and one level of
-// nested brackets
-TEST(GetBracketsPosTest, BracketsFoundWithNestedBrackets) {
-  std::string_view str{"f   ((x)+1)"};
-  auto const pos{1};
-  auto const expectedOutput{std::pair<std::size_t, std::size_t>{4, 10}};
-  auto const output{getBracketsPos(str, pos, std::pair{'(', ')'})};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test the function with a string that has enclosing brackets and multiple
-// levels of nested brackets
-TEST(GetBracketsPosTest, BracketsFoundWithMultipleNestedBrackets) {
-  std::string_view str{"f   (((x)+1)+1)"};
-  auto const pos{1};
-  auto const expectedOutput{std::pair<std::size_t, std::size_t>{4, 14}};
-  auto const output{getBracketsPos(str, pos, std::pair{'(', ')'})};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test the function with a string that has enclosing brackets of different
-// types
-TEST(GetBracketsPosTest, DifferentEnclosingBrackets) {
-  std::string_view str{"f   {{{x]+1]+1]"};
-  auto const pos{1};
-  auto const expectedOutput{std::pair<std::size_t, std::size_t>{4, 14}};
-  auto const output{getBracketsPos(str, pos, std::pair{'{', ']'})};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test with empty string
-TEST(GetBracketsPosTest, EmptyString) {
-  std::string_view str;
-  auto const pos{0};
-  auto const expectedOutput{std::pair{std::string::npos, std::string::npos}};
-  auto const output{getBracketsPos(str, pos, std::pair{'(', ')'})};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test with position at end of string
-TEST(GetBracketsPosTest, PositionAtEnd) {
-  std::string_view str{"f(x)"};
-  auto const pos{4};
-  auto const expectedOutput{std::pair{std::string::npos, std::string::npos}};
-  auto const output{getBracketsPos(str, pos, std::pair{'(', ')'})};
-  EXPECT_EQ(output, expectedOutput);
+// Test the tokenizer with an empty string
+TEST(TokenizeTest, EmptyString) {
+  auto const tokens{Expression::tokenize("")};
+  ASSERT_EQ(tokens.size(), 1);
+  EXPECT_EQ(tokens[0].kind, Expression::TokenKind::End);
+}
+
+// Test the tokenizer with integral, fractional and exponent notations
+TEST(TokenizeTest, Numbers) {
+  std::string_view const str{"1 2.5 .5 1e-3 3E+2"};
+  auto const tokens{Expression::tokenize(str)};
+  ASSERT_EQ(tokens.size(), 6);
+  std::array const expectedTexts{"1", "2.5", ".5", "1e-3", "3E+2"};
+  for (std::size_t idx{}; idx < expectedTexts.size(); ++idx) {
+    EXPECT_EQ(tokens[idx].kind, Expression::TokenKind::Number);
+    EXPECT_EQ(str.substr(tokens[idx].offset, tokens[idx].length),
+              expectedTexts.at(idx));
+  }
 }
 
-/**
- * getBracketsPosReverse
- **/
+// Test the tokenizer with an exponent marker that is not followed by digits
+TEST(TokenizeTest, NumberFollowedByIdentifier) {
+  auto const tokens{Expression::tokenize("2e")};
+  ASSERT_EQ(tokens.size(), 3);
+  EXPECT_EQ(tokens[0].kind, Expression::TokenKind::Number);
+  EXPECT_EQ(tokens[0].length, 1);
+  EXPECT_EQ(tokens[1].kind, Expression::TokenKind::Identifier);
+}
 
-// Test the function with a string that has no enclosing brackets
-TEST(GetBracketsPosReverseTest, NoEnclosingBrackets) {
-  std::string_view str{"x+1  "};
-  auto const pos{4};
-  auto const expectedOutput{std::pair{std::string::npos, std::string::npos}};
-  auto const output{getBracketsPosReverse(str, pos, std::pair{'(', ')'})};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test the function with a string that does not contain the opening bracket
-TEST(GetBracketsPosReverseTest, NoOpeningBracket) {
-  std::string_view str{"(x)+1)"};
-  auto const pos{5};
-  auto const expectedOutput{std::pair{std::string::npos, std::string::npos}};
-  auto const output{getBracketsPosReverse(str, pos, std::pair{'(', ')'})};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test the function with string that has a non-whitespace character from the
-// pos parameter and the first bracket
-TEST(GetBracketsPosReverseTest, NonWhitespaceCharBeforeFirstBracket) {
-  std::string_view str{"(x)+1"};
-  auto const pos{3};
-  auto const expectedOutput{std::pair{std::string::npos, std::string::npos}};
-  auto const output{getBracketsPosReverse(str, pos, std::pair{'(', ')'})};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test the function with a string that has enclosing brackets but no nested
-// Brackets
-TEST(GetBracketsPosReverseTest, BracketsFoundWithNoNestedBrackets) {
-  std::string_view str{"x+(x)"};
-  auto const pos{4};
-  auto const expectedOutput{std::pair<std::size_t, std::size_t>{4, 2}};
-  auto const output{getBracketsPosReverse(str, pos, std::pair{'(', ')'})};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test the function with a string that has enclosing brackets and one level of
-// nested brackets
-TEST(GetBracketsPosReverseTest, BracketsFoundWithNestedBrackets) {
-  std::string_view str{"1+((x)+1)  +x"};
-  auto const pos{10};
-  auto const expectedOutput{std::pair<std::size_t, std::size_t>{8, 2}};
-  auto const output{getBracketsPosReverse(str, pos, std::pair{'(', ')'})};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test the function with a string that has enclosing brackets and multiple
-// levels of nested brackets
-TEST(GetBracketsPosReverseTest, BracketsFoundWithMultipleNestedBrackets) {
-  std::string_view str{"1+(((x)+1)+1)  +x"};
-  auto const pos{14};
-  auto const expectedOutput{std::pair<std::size_t, std::size_t>{12, 2}};
-  auto const output{getBracketsPosReverse(str, pos, std::pair{'(', ')'})};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test the function with a string that has enclosing brackets of different
-// types
-TEST(GetBracketsPosReverseTest, DifferentEnclosingBrackets) {
-  std::string_view str{"1+{{{x]+1]+1]  +x"};
-  auto const pos{14};
-  auto const expectedOutput{std::pair<std::size_t, std::size_t>{12, 2}};
-  auto const output{getBracketsPosReverse(str, pos, std::pair{'{', ']'})};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test with position out of bounds
-TEST(GetBracketsPosReverseTest, PositionOutOfBounds) {
-  std::string_view str{"(x)"};
-  auto const pos{10};
-  auto const expectedOutput{std::pair{std::string::npos, std::string::npos}};
-  auto const output{getBracketsPosReverse(str, pos, std::pair{'(', ')'})};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test with position at zero (edge case)
-TEST(GetBracketsPosReverseTest, PositionAtZero) {
-  std::string_view str{"(x)"};
-  auto const pos{0};
-  auto const expectedOutput{std::pair{std::string::npos, std::string::npos}};
-  auto const output{getBracketsPosReverse(str, pos, std::pair{'(', ')'})};
-  EXPECT_EQ(output, expectedOutput);
+// Test the tokenizer with identifiers that contain digits and underscores
+TEST(TokenizeTest, Identifiers) {
+  auto const tokens{Expression::tokenize("_a1 x2y")};
+  ASSERT_EQ(tokens.size(), 3);
+  EXPECT_EQ(tokens[0].kind, Expression::TokenKind::Identifier);
+  EXPECT_EQ(tokens[0].length, 3);
+  EXPECT_EQ(tokens[1].kind, Expression::TokenKind::Identifier);
+  EXPECT_EQ(tokens[1].length, 3);
+}
+
+// Test the tokenizer with "**" as exponentiation
+TEST(TokenizeTest, DoubleStar) {
+  auto const tokens{Expression::tokenize("x**2*y")};
+  ASSERT_EQ(tokens.size(), 6);
+  EXPECT_EQ(tokens[1].kind, Expression::TokenKind::Caret);
+  EXPECT_EQ(tokens[1].length, 2);
+  EXPECT_EQ(tokens[3].kind, Expression::TokenKind::Asterisk);
+}
+
+// Test the tokenizer with a line feed
+TEST(TokenizeTest, LineBreak) {
+  auto const tokens{Expression::tokenize("x +\n y")};
+  ASSERT_EQ(tokens.size(), 4);
+  EXPECT_FALSE(tokens[1].lineBreakBefore);
+  EXPECT_TRUE(tokens[2].lineBreakBefore);
+}
+
+// Test the tokenizer with a character that is not part of the grammar
+TEST(TokenizeTest, InvalidCharacter) {
+  auto const tokens{Expression::tokenize("x$y")};
+  ASSERT_EQ(tokens.size(), 4);
+  EXPECT_EQ(tokens[1].kind, Expression::TokenKind::Invalid);
 }
 
 /**
- * getSizesOfGLSLOperands
+ * Expression parsing
  **/
 
-// Test the function with an empty string
-TEST(GetSizeOfGLSLOperandsTest, EmptyString) {
-  std::string_view str;
-  auto const pos{0};
-  auto const expectedOutput{std::pair<std::size_t, std::size_t>{0, 0}};
-  auto const output{getSizesOfGLSLOperands(str, pos)};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test the function with wrong position of the operator
-TEST(GetSizeOfGLSLOperandsTest, WrongOperatorPosition) {
-  std::string_view str{"x-2"};
-  auto const pos{2};
-  auto const expectedOutput{std::pair<std::size_t, std::size_t>{0, 0}};
-  auto const output{getSizesOfGLSLOperands(str, pos)};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test the function with a simple expression
-TEST(GetSizeOfGLSLOperandsTest, SimpleExpression) {
-  std::string_view str{"x*2"};
-  auto const pos{1};
-  auto const expectedOutput{std::pair<std::size_t, std::size_t>{1, 1}};
-  auto const output{getSizesOfGLSLOperands(str, pos)};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test the function with negative operands
-TEST(GetSizeOfGLSLOperandsTest, NegativeOperands) {
-  std::string_view str{"-4.2/-x"};
-  auto const pos{4};
-  auto const expectedOutput{std::pair<std::size_t, std::size_t>{3, 2}};
-  auto const output{getSizesOfGLSLOperands(str, pos)};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test the function with an expression that has a non-parenthesized function
-// call as right operand
-TEST(GetSizeOfGLSLOperandsTest, RightOperandWithNonParenthesizeFunctionCall) {
-  std::string_view str{"(2*(x+y))*-sin(var2_+(y - 3.14))"};
-  auto const pos{9};
-  auto const expectedOutput{std::pair<std::size_t, std::size_t>{9, 4}};
-  auto const output{getSizesOfGLSLOperands(str, pos)};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test the function with an expression that has a parenthesized function call
-// as right operand
-TEST(GetSizeOfGLSLOperandsTest, RightOperandWithParenthesizeFunctionCall) {
-  std::string_view str{"(2*(x+y))*-(sin(var2_+(y - 3.14)))"};
-  auto const pos{9};
-  auto const expectedOutput{std::pair<std::size_t, std::size_t>{9, 24}};
-  auto const output{getSizesOfGLSLOperands(str, pos)};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test the function with variables as operands
-TEST(GetSizeOfGLSLOperandsTest, VariableAsOperands) {
-  std::string_view str{"1/_myVar123^foo42bar*(x+1)"};
-  auto const pos{11};
-  auto const expectedOutput{std::pair<std::size_t, std::size_t>{9, 8}};
-  auto const output{getSizesOfGLSLOperands(str, pos)};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test the function with floating point numbers as operands
-TEST(GetSizeOfGLSLOperandsTest, ExpressionWithFloatingPointNumbers) {
-  std::string_view str{"3.14*2.3"};
-  auto const pos{4};
-  auto const expectedOutput{std::pair<std::size_t, std::size_t>{4, 3}};
-  auto const output{getSizesOfGLSLOperands(str, pos)};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test the function with a string that has no operands
-TEST(GetSizeOfGLSLOperandsTest, NoOperands) {
-  std::string_view str{"+"};
-  auto const pos{0};
-  auto const expectedOutput{std::pair<std::size_t, std::size_t>{0, 0}};
-  auto const output{getSizesOfGLSLOperands(str, pos)};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test the function with a string that has only a left operand
-TEST(GetSizeOfGLSLOperandsTest, OnlyLeftOperand) {
-  std::string_view str{"x/"};
-  auto const pos{1};
-  auto const expectedOutput{std::pair<std::size_t, std::size_t>{1, 0}};
-  auto const output{getSizesOfGLSLOperands(str, pos)};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test the function with a string that has only a right operand
-TEST(GetSizeOfGLSLOperandsTest, OnlyRightOperand) {
-  std::string_view str{"+x"};
-  auto const pos{0};
-  auto const expectedOutput{std::pair<std::size_t, std::size_t>{0, 1}};
-  auto const output{getSizesOfGLSLOperands(str, pos)};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test with parenthesized left operand
-TEST(GetSizeOfGLSLOperandsTest, ParenthesizedLeftOperand) {
-  std::string_view str{"(x+y)*z"};
-  auto const pos{5};
-  auto const expectedOutput{std::pair<std::size_t, std::size_t>{5, 1}};
-  auto const output{getSizesOfGLSLOperands(str, pos)};
-  EXPECT_EQ(output, expectedOutput);
-}
-
-// Test with parenthesized right operand
-TEST(GetSizeOfGLSLOperandsTest, ParenthesizedRightOperand) {
-  std::string_view str{"x*(y+z)"};
-  auto const pos{1};
-  auto const expectedOutput{std::pair<std::size_t, std::size_t>{1, 5}};
-  auto const output{getSizesOfGLSLOperands(str, pos)};
-  EXPECT_EQ(output, expectedOutput);
+// Test that an empty expression is a syntax error
+TEST(ExpressionTest, EmptyIsInvalid) {
+  Expression const expression{""};
+  EXPECT_FALSE(expression.isValid());
+  EXPECT_FALSE(expression.getError().empty());
+}
+
+// Test that terms of a sum are collected into a single node
+TEST(ExpressionTest, SumIsNary) {
+  Expression const expression{"a+b-c+d"};
+  ASSERT_TRUE(expression.isValid());
+  auto const &root{expression.getRoot()};
+  EXPECT_EQ(root.kind, Expression::NodeKind::Sum);
+  auto const operands{expression.getOperands(root)};
+  ASSERT_EQ(operands.size(), 4);
+  EXPECT_EQ(operands[0].op, '\0');
+  EXPECT_EQ(operands[1].op, '+');
+  EXPECT_EQ(operands[2].op, '-');
+  EXPECT_EQ(operands[3].op, '+');
+}
+
+// Test that products bind tighter than sums
+TEST(ExpressionTest, ProductInsideSum) {
+  Expression const expression{"a*b/c+d"};
+  ASSERT_TRUE(expression.isValid());
+  auto const &root{expression.getRoot()};
+  EXPECT_EQ(root.kind, Expression::NodeKind::Sum);
+  auto const &product{expression.getOperand(root, 0)};
+  EXPECT_EQ(product.kind, Expression::NodeKind::Product);
+  EXPECT_EQ(expression.getOperands(product).size(), 3);
+}
+
+// Test that exponentiation is right-associative
+TEST(ExpressionTest, PowerIsRightAssociative) {
+  Expression const expression{"x^2^3"};
+  ASSERT_TRUE(expression.isValid());
+  auto const &root{expression.getRoot()};
+  EXPECT_EQ(root.kind, Expression::NodeKind::Power);
+  EXPECT_EQ(expression.getOperand(root, 0).kind,
+            Expression::NodeKind::Identifier);
+  EXPECT_EQ(expression.getOperand(root, 1).kind, Expression::NodeKind::Power);
+}
+
+// Test that -x^2 is parsed as -(x^2)
+TEST(ExpressionTest, NegationBindsLooserThanPower) {
+  Expression const expression{"-x^2"};
+  ASSERT_TRUE(expression.isValid());
+  auto const &root{expression.getRoot()};
+  EXPECT_EQ(root.kind, Expression::NodeKind::Negate);
+  EXPECT_EQ(expression.getOperand(root, 0).kind, Expression::NodeKind::Power);
+}
+
+// Test a function call with more than one argument
+TEST(ExpressionTest, CallArguments) {
+  Expression const expression{"max(x, y+1)"};
+  ASSERT_TRUE(expression.isValid());
+  auto const &root{expression.getRoot()};
+  EXPECT_EQ(root.kind, Expression::NodeKind::Call);
+  EXPECT_EQ(expression.getText(root), "max");
+  EXPECT_EQ(expression.getOperands(root).size(), 2);
+}
+
+// Test square brackets as grouping symbols
+TEST(ExpressionTest, Brackets) {
+  Expression const expression{"[x+1]*2"};
+  ASSERT_TRUE(expression.isValid());
+  auto const &group{expression.getOperand(expression.getRoot(), 0)};
+  EXPECT_EQ(group.kind, Expression::NodeKind::Group);
+  EXPECT_EQ(expression.getText(group), "[");
+}
+
+// Test the value of a number in exponent notation
+TEST(ExpressionTest, NumberValue) {
+  Expression const expression{"2.5e1"};
+  ASSERT_TRUE(expression.isValid());
+  EXPECT_DOUBLE_EQ(expression.getRoot().value, 25.0);
+}
+
+// Test that the error of mismatched brackets reports the column
+TEST(ExpressionTest, MismatchedBrackets) {
+  Expression const expression{"(x+1]"};
+  EXPECT_FALSE(expression.isValid());
+  EXPECT_NE(expression.getError().find("column 5"), std::string::npos);
+}
+
+// Test an expression with a missing closing parenthesis
+TEST(ExpressionTest, MissingClosingParen) {
+  Expression const expression{"sin(x+1"};
+  EXPECT_FALSE(expression.isValid());
+  // Tokens are available even if the expression is invalid
+  EXPECT_EQ(expression.getTokens().size(), 6);
+}
+
+// Test that nesting deeper than the limit is rejected
+TEST(ExpressionTest, DeepNestingIsInvalid) {
+  auto const depth{Expression::kMaxNestingDepth + 1};
+  Expression const expression{std::string(depth, '(') + "x" +
+                              std::string(depth, ')')};
+  EXPECT_FALSE(expression.isValid());
+}
+
+// Test that a long chain of terms does not deepen the tree
+TEST(ExpressionTest, LongSum) {
+  constexpr std::size_t numTerms{100000};
+  std::string str{"x"};
+  for (std::size_t term{1}; term < numTerms; ++term) {
+    str += "+x";
+  }
+  Expression const expression{str};
+  ASSERT_TRUE(expression.isValid());
+  EXPECT_EQ(expression.getOperands(expression.getRoot()).size(), numTerms);
+}
+
+// Test that value numbers ignore brackets and the notation of numbers
+TEST(ExpressionTest, NumberValues) {
+  Expression const expression{"(x+2)*(x+2.0)-x"};
+  ASSERT_TRUE(expression.isValid());
+  auto const numbers{expression.numberValues()};
+  auto const &root{expression.getRoot()};
+  auto const factors{expression.getOperands(expression.getOperand(root, 0))};
+  auto const other{expression.getOperands(root)[1]};
+  EXPECT_EQ(numbers[factors[0].node], numbers[factors[1].node]);
+  EXPECT_NE(numbers[factors[0].node], numbers[other.node]);
 }
 
 /**
@@ -669,3 +562,229 @@ TEST(FunctionTest, PowerWithFractionalExponent) {
   // Should use mpow(x, 2.5) for fractional exponent
   EXPECT_NE(glsl.find("mpow"), std::string::npos);
 }
+
+// Test the GLSL code of function calls, powers and brackets
+TEST(FunctionTest, GLSLOfCallsPowersAndBrackets) {
+  Function::Data data;
+  data.expression = "sin(x)^2 + [y] - x^-2";
+  Function func(data);
+
+  EXPECT_EQ(func.getGLSLExpression(),
+            "mpow2(sin(@P.@x))+(@P.@y)-mpow(@P.@x,-2.0)");
+}
+
+// Test MathJax with nested fractions and a line break
+TEST(FunctionTest, MathJaxWithNestedFractionsAndLineBreak) {
+  Function::Data data;
+  data.expression = "x/y/z +\\n alpha*x";
+  Function func(data);
+
+  EXPECT_EQ(func.getMathJaxEquation(0.0f),
+            "\\frac{\\frac{x}{y}}{z}+\\\\&\\alpha x=0");
+}
+
+// Test that an invalid expression is still converted token by token
+TEST(FunctionTest, InvalidExpression) {
+  Function::Data data;
+  data.expression = "x + (y";
+  Function func(data);
+
+  EXPECT_EQ(func.getGLSLExpression(), "@P.@x+(@P.@y");
+}
+
+// Test the construction of a function with a long expression
+TEST(FunctionTest, LongExpression) {
+  Function::Data data;
+  while (data.expression.size() < (1 << 20)) {
+    data.expression += "sin(x*a)^2/(y-b)+";
+  }
+  data.expression += "z";
+  Function func(data);
+
+  EXPECT_FALSE(func.getGLSLExpression().empty());
+  EXPECT_EQ(func.getParameters().size(), 2);
+}
+
+// Test that a repeated subexpression is evaluated once into a temporary
+TEST(FunctionTest, CommonSubexpressionElimination) {
+  Function::Data data;
+  data.expression = "cos(k*x)*y + cos(k*x)*z";
+  Function func(data);
+
+  EXPECT_EQ(func.getGLSLTemporaries(), "float _cse0=cos(k*@P.@x);\n");
+  EXPECT_EQ(func.getGLSLExpression(), "_cse0*@P.@y+_cse0*@P.@z");
+  EXPECT_EQ(func.getOpCount().original, 7);
+  EXPECT_EQ(func.getOpCount().optimized, 5);
+}
+
+// Test that names of temporaries do not collide with names of the user code
+TEST(FunctionTest, CommonSubexpressionNameCollision) {
+  Function::Data data;
+  data.expression = "sin(x)+sin(x)";
+  data.codeGlobal = "float _cse0(float v) { return v; }";
+  Function func(data);
+
+  EXPECT_EQ(func.getGLSLTemporaries(), "float _cse0_0=sin(@P.@x);\n");
+  EXPECT_EQ(func.getGLSLExpression(), "_cse0_0+_cse0_0");
+}
+
+// Test that leaves are not hoisted into temporaries
+TEST(FunctionTest, NoTemporariesForLeaves) {
+  Function::Data data;
+  data.expression = "-x*y - x";
+  Function func(data);
+
+  EXPECT_TRUE(func.getGLSLTemporaries().empty());
+  EXPECT_EQ(func.getOpCount().original, func.getOpCount().optimized);
+}
+
+// Test the analytic gradient and Hessian of a polynomial
+TEST(FunctionTest, AnalyticDerivatives) {
+  Function::Data data;
+  data.expression = "x^2+y^2+z^2-1";
+  Function func(data);
+
+  EXPECT_TRUE(func.hasAnalyticDerivatives());
+  EXPECT_EQ(func.getGLSLGradient(),
+            "return vec3(2.0*@P.@x,2.0*@P.@y,2.0*@P.@z);\n");
+  EXPECT_EQ(func.getGLSLHessian(),
+            "return mat3(2.0,0.0,0.0,0.0,2.0,0.0,0.0,0.0,2.0);\n");
+}
+
+// Test that terms shared by the derivatives are evaluated into temporaries
+TEST(FunctionTest, AnalyticDerivativesTemporaries) {
+  Function::Data data;
+  data.expression = "sqrt(x^2+y^2)-1";
+  Function func(data);
+
+  EXPECT_EQ(func.getGLSLGradient(),
+            "float _cse0=inversesqrt(mpow2(@P.@x)+mpow2(@P.@y));\n"
+            "return vec3(@P.@x*_cse0,@P.@y*_cse0,0.0);\n");
+}
+
+// Test that functions with unknown derivatives or user code are not
+// differentiated
+TEST(FunctionTest, NoAnalyticDerivatives) {
+  Function::Data data;
+  data.expression = "foo(x)";
+  EXPECT_FALSE(Function{data}.hasAnalyticDerivatives());
+
+  data.expression = "sin(x)";
+  data.codeLocal = "float a=1.0;";
+  Function func(data);
+  EXPECT_FALSE(func.hasAnalyticDerivatives());
+  EXPECT_TRUE(func.getGLSLGradient().empty());
+  EXPECT_TRUE(func.getGLSLHessian().empty());
+}
+
+// Test the Bernstein coefficients of a polynomial on a segment
+TEST(FunctionTest, SegmentPolynomial) {
+  Function::Data data;
+  data.expression = "x^2+y^2+z^2-1";
+  Function func(data);
+
+  EXPECT_TRUE(func.isPolynomial());
+  EXPECT_EQ(func.getPolynomialDegree(), 2);
+  EXPECT_EQ(func.getGLSLPolynomial(), "polyX[0]=1.0;\n"
+                                      "bernsteinMul(polyX,0,P0.x,P1.x);\n"
+                                      "bernsteinMul(polyX,1,P0.x,P1.x);\n"
+                                      "polyY[0]=1.0;\n"
+                                      "bernsteinMul(polyY,0,P0.y,P1.y);\n"
+                                      "bernsteinMul(polyY,1,P0.y,P1.y);\n"
+                                      "polyZ[0]=1.0;\n"
+                                      "bernsteinMul(polyZ,0,P0.z,P1.z);\n"
+                                      "bernsteinMul(polyZ,1,P0.z,P1.z);\n"
+                                      "bernsteinAdd(polyZ,2,-1.0);\n"
+                                      "bernsteinAdd(polyY,2,polyZ);\n"
+                                      "bernsteinAdd(polyX,2,polyY);\n");
+}
+
+// Test that parameters are kept as factors of the coefficients
+TEST(FunctionTest, SegmentPolynomialParameters) {
+  Function::Data data;
+  data.expression = "x^2/a^2-1";
+  Function func(data);
+
+  EXPECT_EQ(func.getPolynomialDegree(), 2);
+  EXPECT_EQ(func.getGLSLPolynomial(), "polyX[0]=1.0/a/a;\n"
+                                      "bernsteinMul(polyX,0,P0.x,P1.x);\n"
+                                      "bernsteinMul(polyX,1,P0.x,P1.x);\n"
+                                      "bernsteinAdd(polyX,2,-1.0);\n");
+}
+
+// Test that functions that are not polynomials of the coordinates, or that
+// have local code, are not expanded
+TEST(FunctionTest, NoSegmentPolynomial) {
+  Function::Data data;
+  for (auto const *expression : {"sin(x)", "1/x", "x^0.5", "a", "x^11"}) {
+    data.expression = expression;
+    EXPECT_FALSE(Function{data}.isPolynomial()) << expression;
+  }
+
+  data.expression = "x^2+y^2+z^2-r";
+  data.codeLocal = "float r=x;";
+  Function func(data);
+  EXPECT_FALSE(func.isPolynomial());
+  EXPECT_TRUE(func.getGLSLPolynomial().empty());
+}
+
+// Test the interval extension of an expression
+TEST(FunctionTest, IntervalExtension) {
+  Function::Data data;
+  data.expression = "x^2+y^2+z^2-1";
+  Function func(data);
+
+  EXPECT_TRUE(func.hasIntervalExtension());
+  EXPECT_EQ(func.getGLSLInterval(),
+            "vec2 _cse0=ipow(@P.@x,2);\n"
+            "vec2 _cse1=ipow(@P.@y,2);\n"
+            "vec2 _cse2=ipow(@P.@z,2);\n"
+            "vec2 _cse3=isub(iadd(iadd(_cse0,_cse1),_cse2),vec2(1.0));\n"
+            "return _cse3;\n");
+}
+
+// Test that nodes of equal value share their temporary, and that names other
+// than the coordinates are constant intervals
+TEST(FunctionTest, IntervalExtensionSharedNodes) {
+  Function::Data data;
+  data.expression = "sin(x)*sin(x)-a/x";
+  Function func(data);
+
+  EXPECT_EQ(func.getGLSLInterval(), "vec2 _cse0=isin(@P.@x);\n"
+                                    "vec2 _cse1=imul(_cse0,_cse0);\n"
+                                    "vec2 _cse2=idiv(vec2(a),@P.@x);\n"
+                                    "vec2 _cse3=isub(_cse1,_cse2);\n"
+                                    "return _cse3;\n");
+}
+
+// Test that functions with unknown interval extensions or local code are not
+// extended
+TEST(FunctionTest, NoIntervalExtension) {
+  Function::Data data;
+  for (auto const *expression : {"foo(x)", "length(vec2(x,y))", "min(x)"}) {
+    data.expression = expression;
+    EXPECT_FALSE(Function{data}.hasIntervalExtension()) << expression;
+  }
+
+  data.expression = "sin(r)";
+  data.codeLocal = "float r=x;";
+  Function func(data);
+  EXPECT_FALSE(func.hasIntervalExtension());
+  EXPECT_TRUE(func.getGLSLInterval().empty());
+}
+
+// Test that the evaluation cost accounts for transcendental functions and for
+// loops of the local code
+TEST(FunctionTest, EvaluationCost) {
+  Function::Data data;
+  data.expression = "x*y";
+  auto const productCost{Function{data}.getEvaluationCost()};
+  data.expression = "sin(x)";
+  auto const sineCost{Function{data}.getEvaluationCost()};
+  EXPECT_GT(productCost, 0.0);
+  EXPECT_GT(sineCost, productCost);
+
+  data.expression = "x*y-s";
+  data.codeLocal = "float s=0.0;\nfor (int i=0; i<100; ++i) { s+=sin(x); }";
+  EXPECT_GT(Function{data}.getEvaluationCost(), 100.0 * sineCost);
+}